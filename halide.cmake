@@ -507,6 +507,12 @@ function(_halide_runtime_target_name HALIDE_TARGET OUTVAR)
         wasm_signext
         sve
         sve2
+        avx512_cascadelake
+        avx512_sapphirerapids
+        arm_dot_prod
+        arm_fp16
+        plan_memory
+        profile_hw
       )
     # Synthesize a one-or-two-char abbreviation based on the feature's position
     # in the KNOWN_FEATURES list.
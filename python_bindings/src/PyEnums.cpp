@@ -61,6 +61,7 @@ void define_enums(py::module &m) {
         .value("RoundUp", TailStrategy::RoundUp)
         .value("GuardWithIf", TailStrategy::GuardWithIf)
         .value("ShiftInwards", TailStrategy::ShiftInwards)
+        .value("Predicate", TailStrategy::Predicate)
         .value("Auto", TailStrategy::Auto)
     ;
 
@@ -132,6 +133,10 @@ void define_enums(py::module &m) {
         .value("AVX512_KNL", Target::Feature::AVX512_KNL)
         .value("AVX512_Skylake", Target::Feature::AVX512_Skylake)
         .value("AVX512_Cannonlake", Target::Feature::AVX512_Cannonlake)
+        .value("AVX512_Cascadelake", Target::Feature::AVX512_Cascadelake)
+        .value("AVX512_SapphireRapids", Target::Feature::AVX512_SapphireRapids)
+        .value("ARMDotProd", Target::Feature::ARMDotProd)
+        .value("ARMFp16", Target::Feature::ARMFp16)
         .value("TraceLoads", Target::Feature::TraceLoads)
         .value("TraceStores", Target::Feature::TraceStores)
         .value("TraceRealizations", Target::Feature::TraceRealizations)
@@ -149,6 +154,8 @@ void define_enums(py::module &m) {
         .value("WasmSignExt", Target::Feature::WasmSignExt)
         .value("SVE", Target::Feature::SVE)
         .value("SVE2", Target::Feature::SVE2)
+        .value("PlanMemory", Target::Feature::PlanMemory)
+        .value("ProfileHW", Target::Feature::ProfileHW)
         .value("FeatureEnd", Target::Feature::FeatureEnd);
 
     py::enum_<halide_type_code_t>(m, "TypeCode")
@@ -149,10 +149,18 @@ void define_func(py::module &m) {
         .def("store_at", (Func &(Func::*)(LoopLevel)) &Func::store_at,
             py::arg("loop_level"))
 
+        .def("hoist_storage", (Func &(Func::*)(Func, Var)) &Func::hoist_storage,
+            py::arg("f"), py::arg("var"))
+        .def("hoist_storage", (Func &(Func::*)(Func, RVar)) &Func::hoist_storage,
+            py::arg("f"), py::arg("var"))
+        .def("hoist_storage", (Func &(Func::*)(LoopLevel)) &Func::hoist_storage,
+            py::arg("loop_level"))
+
         .def("memoize", &Func::memoize)
         .def("compute_inline", &Func::compute_inline)
         .def("compute_root", &Func::compute_root)
         .def("store_root", &Func::store_root)
+        .def("hoist_storage_root", &Func::hoist_storage_root)
 
         .def("store_in", &Func::store_in,
             py::arg("memory_type"))
@@ -314,6 +322,9 @@ void define_func(py::module &m) {
         .def("fold_storage", &Func::fold_storage,
             py::arg("dim"), py::arg("extent"), py::arg("fold_forward") = true)
 
+        .def("ring_buffer", &Func::ring_buffer,
+            py::arg("extent"))
+
         .def("compute_with", (Func &(Func::*)(LoopLevel, const std::vector<std::pair<VarOrRVar, LoopAlignStrategy>> &)) &Func::compute_with,
             py::arg("loop_level"), py::arg("align"))
         .def("compute_with", (Func &(Func::*)(LoopLevel, LoopAlignStrategy)) &Func::compute_with,
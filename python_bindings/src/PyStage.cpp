@@ -20,6 +20,9 @@ void define_stage(py::module &m) {
             py::arg("loop_level"), py::arg("align"))
         .def("compute_with", (Stage &(Stage::*)(LoopLevel, LoopAlignStrategy)) &Stage::compute_with,
             py::arg("loop_level"), py::arg("align") = LoopAlignStrategy::Auto)
+
+        .def("atomic", &Stage::atomic,
+            py::arg("override_associativity_test") = false)
     ;
     add_schedule_methods(stage_class);
 }
@@ -1,8 +1,10 @@
 #include "BoundSmallAllocations.h"
 #include "Bounds.h"
 #include "IRMutator.h"
+#include "IROperator.h"
 #include "Simplify.h"
 #include "CodeGen_Internal.h"
+#include "InjectHostDevBufferCopies.h"
 
 namespace Halide {
 namespace Internal {
@@ -51,6 +53,40 @@ class BoundSmallAllocations : public IRMutator {
 
     bool in_thread_loop = false;
 
+    const Target &target;
+
+    // The stack used so far by the allocations of the current task,
+    // when the target has a stack budget. Codegen makes all of a
+    // task's stack allocations at its entry, and only reuses them for
+    // later allocations of the same type, so this counts every
+    // allocation visited in the task, not just the enclosing ones.
+    int64_t stack_used = 0;
+
+    // Whether we're inside a parallel task or device code.
+    bool in_task = false, in_device_code = false;
+
+    void use_stack(int64_t bytes) {
+        stack_used += bytes;
+        if (in_task) {
+            max_task_stack = std::max(max_task_stack, stack_used);
+        }
+    }
+
+    Stmt visit(const Fork *op) override {
+        // Each branch may run as a separate task, on another thread.
+        ScopedValue<bool> old_in_task(in_task, true);
+        Stmt first, rest;
+        {
+            ScopedValue<int64_t> old_stack_used(stack_used, 0);
+            first = mutate(op->first);
+        }
+        {
+            ScopedValue<int64_t> old_stack_used(stack_used, 0);
+            rest = mutate(op->rest);
+        }
+        return Fork::make(first, rest);
+    }
+
     Stmt visit(const For *op) override {
         Interval min_bounds = find_constant_bounds(op->min, scope);
         Interval max_bounds = find_constant_bounds(op->min + op->extent - 1, scope);
@@ -60,6 +96,40 @@ class BoundSmallAllocations : public IRMutator {
         ScopedBinding<Interval> bind(scope, op->name, b);
         ScopedValue<bool> old_in_thread_loop(in_thread_loop, in_thread_loop ||
                                              op->for_type == ForType::GPUThread);
+        bool device_loop = (op->device_api != DeviceAPI::None &&
+                            op->device_api != DeviceAPI::Host);
+        ScopedValue<bool> old_in_device_code(in_device_code, in_device_code || device_loop);
+        bool new_task = (op->for_type == ForType::Parallel);
+        ScopedValue<bool> old_in_task(in_task, in_task || new_task);
+        if (new_task) {
+            // The body becomes a separate function with its own stack
+            // allocations.
+            ScopedValue<int64_t> old_stack_used(stack_used, 0);
+            return IRMutator::visit(op);
+        }
+        return IRMutator::visit(op);
+    }
+
+    // Place an allocation on the stack or heap according to the
+    // target's stack budget.
+    Stmt apply_stack_budget(const Allocate *op, const int64_t *size_ptr) {
+        int64_t remaining = target.stack_budget - stack_used;
+        if (size_ptr) {
+            int64_t bytes = *size_ptr * op->type.bytes();
+            if (bytes > remaining) {
+                return Allocate::make(op->name, op->type, MemoryType::Heap, op->extents, op->condition,
+                                      mutate(op->body), op->new_expr, op->free_function);
+            }
+            use_stack(bytes);
+            return Allocate::make(op->name, op->type, MemoryType::Stack, {(int32_t)*size_ptr}, op->condition,
+                                  mutate(op->body), op->new_expr, op->free_function);
+        }
+
+        // The size has no constant bound. A stack buffer for it would
+        // have to be as big as whatever is left of the budget, and the
+        // thread pool would have to reserve all of that for every
+        // task, however little the allocation turns out to need. Leave
+        // it on the heap.
         return IRMutator::visit(op);
     }
 
@@ -88,13 +158,21 @@ class BoundSmallAllocations : public IRMutator {
                                   mutate(op->body), op->new_expr, op->free_function);
         }
 
+        if (target.stack_budget > 0 &&
+            !in_thread_loop &&
+            !in_device_code &&
+            op->memory_type == MemoryType::Auto &&
+            !op->new_expr.defined()) {
+            return apply_stack_budget(op, size_ptr);
+        }
+
         // 128 bytes is a typical minimum allocation size in
         // halide_malloc. For now we are very conservative, and only
         // round sizes up to a constant if they're smaller than that.
         int malloc_overhead = 128 / op->type.bytes();
         if (size_ptr &&
             (in_thread_loop ||
-             (op->memory_type == MemoryType::Stack && can_allocation_fit_on_stack(size)) ||
+             (op->memory_type == MemoryType::Stack && can_allocation_fit_on_stack(size, target)) ||
              op->memory_type == MemoryType::Register ||
              (op->memory_type == MemoryType::Auto && size <= malloc_overhead))) {
             user_assert(size >= 0 && size < (int64_t)1 << 31)
@@ -105,10 +183,25 @@ class BoundSmallAllocations : public IRMutator {
             return IRMutator::visit(op);
         }
     }
+
+public:
+    // The most stack used by the allocations of any one parallel task.
+    int64_t max_task_stack = 0;
+
+    BoundSmallAllocations(const Target &t) : target(t) {}
 };
 
-Stmt bound_small_allocations(const Stmt &s) {
-    return BoundSmallAllocations().mutate(s);
+Stmt bound_small_allocations(const Stmt &s, const Target &t) {
+    BoundSmallAllocations bounder(t);
+    Stmt result = bounder.mutate(s);
+    if (bounder.max_task_stack > 0) {
+        // Make sure the threads in the thread pool have room for the
+        // stack allocations of the parallel tasks.
+        Stmt reserve = call_extern_and_assert("halide_reserve_thread_stack",
+                                              {make_const(Int(32), bounder.max_task_stack)});
+        result = Block::make(reserve, result);
+    }
+    return result;
 }
 
 }  // namespace Internal
@@ -2,6 +2,7 @@
 #define HALIDE_BOUND_SMALL_ALLOCATIONS
 
 #include "IR.h"
+#include "Target.h"
 
 /** \file
  * Defines the lowering pass that attempts to rewrite small
@@ -16,8 +17,15 @@ namespace Internal {
  * Use bounds analysis to attempt to bound the sizes of small
  * allocations. Inside GPU kernels this is necessary in order to
  * compile. On the CPU this is also useful, because it prevents malloc
- * calls for (provably) tiny allocations. */
-Stmt bound_small_allocations(const Stmt &s);
+ * calls for (provably) tiny allocations.
+ *
+ * If the target has a stack_budget, allocations on the host with a
+ * constant bound are placed on the stack while they fit in what is
+ * left of it, and on the heap otherwise. Allocations with no constant
+ * bound stay on the heap. The thread pool is asked to give its threads
+ * enough extra stack for the most stack used by any one parallel
+ * task. */
+Stmt bound_small_allocations(const Stmt &s, const Target &t);
 
 }  // namespace Internal
 }  // namespace Halide
@@ -1269,6 +1269,37 @@ private:
         interval = result;
     }
 
+    void visit(const VectorReduce *op) override {
+        TRACK_BOUNDS_INTERVAL;
+        op->value.accept(this);
+        int factor = op->value.type().lanes() / op->type.lanes();
+        switch (op->op) {
+        case VectorReduce::Add:
+            // Assume no overflow for float, int32, and int64
+            if (!op->type.is_float() && (!op->type.is_int() || op->type.bits() < 32)) {
+                bounds_of_type(op->type);
+            } else {
+                if (interval.has_lower_bound()) {
+                    interval.min *= make_const(op->type.element_of(), factor);
+                }
+                if (interval.has_upper_bound()) {
+                    interval.max *= make_const(op->type.element_of(), factor);
+                }
+            }
+            break;
+        case VectorReduce::Min:
+        case VectorReduce::Max:
+        case VectorReduce::And:
+        case VectorReduce::Or:
+            // These are monotonic and idempotent, so the result is
+            // within the bounds of the lanes.
+            break;
+        case VectorReduce::Mul:
+            bounds_of_type(op->type);
+            break;
+        }
+    }
+
     void visit(const LetStmt *) override {
         internal_error << "Bounds of statement\n";
     }
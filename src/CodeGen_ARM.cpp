@@ -2,6 +2,7 @@
 #include <sstream>
 
 #include "CodeGen_ARM.h"
+#include "CodeGen_Internal.h"
 #include "ConciseCasts.h"
 #include "Debug.h"
 #include "IREquality.h"
@@ -464,6 +465,14 @@ void CodeGen_ARM::visit(const Div *op) {
 }
 
 void CodeGen_ARM::visit(const Add *op) {
+    // The dot-product instructions accumulate for free.
+    const VectorReduce *ra = op->a.as<VectorReduce>();
+    const VectorReduce *rb = op->b.as<VectorReduce>();
+    if ((ra && codegen_dot_product(ra, op->b)) ||
+        (rb && codegen_dot_product(rb, op->a))) {
+        return;
+    }
+
     CodeGen_Posix::visit(op);
 }
 
@@ -659,6 +668,17 @@ void CodeGen_ARM::visit(const Max *op) {
 }
 
 void CodeGen_ARM::visit(const Store *op) {
+    // SVE can scatter 32- and 64-bit lanes to arbitrary indices.
+    if (sve_enabled() &&
+        op->value.type().is_vector() &&
+        op->value.type().bits() >= 32 &&
+        !op->index.as<Ramp>() &&
+        upgrade_type_for_storage(op->value.type()) == op->value.type() &&
+        use_sve_gather_scatter(llvm_type_of(op->value.type()), true)) {
+        codegen_sve_scatter(op);
+        return;
+    }
+
     // Predicated store
     if (!is_one(op->predicate)) {
         CodeGen_Posix::visit(op);
@@ -840,6 +860,17 @@ void CodeGen_ARM::visit(const Store *op) {
 }
 
 void CodeGen_ARM::visit(const Load *op) {
+    // SVE can gather 32- and 64-bit lanes from arbitrary indices.
+    if (sve_enabled() &&
+        op->type.is_vector() &&
+        op->type.bits() >= 32 &&
+        !op->index.as<Ramp>() &&
+        upgrade_type_for_storage(op->type) == op->type &&
+        use_sve_gather_scatter(llvm_type_of(op->type), false)) {
+        codegen_sve_gather(op);
+        return;
+    }
+
     // Predicated load
     if (!is_one(op->predicate)) {
         CodeGen_Posix::visit(op);
@@ -1007,6 +1038,122 @@ void CodeGen_ARM::visit(const Call *op) {
     CodeGen_Posix::visit(op);
 }
 
+namespace {
+
+// Make a vector of pointers to the given lanes of a buffer.
+Value *sve_lane_pointers(IRBuilder<> *builder, Value *base, Value *index, llvm::Type *i64_t) {
+    int lanes = index->getType()->getVectorNumElements();
+    index = builder->CreateIntCast(index, VectorType::get(i64_t, lanes), true);
+    return builder->CreateInBoundsGEP(base, index);
+}
+
+}  // namespace
+
+bool CodeGen_ARM::use_sve_gather_scatter(llvm::Type *t, bool scatter) {
+    // Without a known vector length, LLVM only uses SVE for scalable
+    // vectors, which Halide doesn't make.
+    if (sve_vector_bits() == 0) {
+        return false;
+    }
+    auto key = std::make_pair(t, scatter);
+    auto it = sve_gather_scatter_legal.find(key);
+    if (it != sve_gather_scatter_legal.end()) {
+        return it->second;
+    }
+    std::unique_ptr<llvm::TargetMachine> tm = make_target_machine(*module);
+    llvm::TargetTransformInfo tti = tm->getTargetTransformInfo(*function);
+    unsigned alignment = t->getScalarSizeInBits() / 8;
+#if LLVM_VERSION >= 110
+    llvm::Align align(alignment);
+#elif LLVM_VERSION >= 100
+    llvm::MaybeAlign align(alignment);
+#endif
+#if LLVM_VERSION >= 100
+    bool legal = scatter ? tti.isLegalMaskedScatter(t, align) : tti.isLegalMaskedGather(t, align);
+#else
+    bool legal = scatter ? tti.isLegalMaskedScatter(t) : tti.isLegalMaskedGather(t);
+#endif
+    sve_gather_scatter_legal[key] = legal;
+    return legal;
+}
+
+void CodeGen_ARM::codegen_sve_gather(const Load *op) {
+    Value *base = codegen_buffer_pointer(op->name, op->type.element_of(), ConstantInt::get(i32_t, 0));
+    Value *ptrs = sve_lane_pointers(builder, base, codegen(op->index), i64_t);
+    Value *mask = is_one(op->predicate) ? nullptr : codegen(op->predicate);
+    Instruction *gather = builder->CreateMaskedGather(ptrs, op->type.bytes(), mask);
+    add_tbaa_metadata(gather, op->name, op->index);
+    value = gather;
+}
+
+void CodeGen_ARM::codegen_sve_scatter(const Store *op) {
+    Type t = op->value.type();
+    Value *val = codegen(op->value);
+    Value *base = codegen_buffer_pointer(op->name, t.element_of(), ConstantInt::get(i32_t, 0));
+    Value *ptrs = sve_lane_pointers(builder, base, codegen(op->index), i64_t);
+    Value *mask = is_one(op->predicate) ? nullptr : codegen(op->predicate);
+    Instruction *scatter = builder->CreateMaskedScatter(val, ptrs, t.bytes(), mask);
+    add_tbaa_metadata(scatter, op->name, op->index);
+}
+
+bool CodeGen_ARM::codegen_dot_product(const VectorReduce *op, const Expr &accumulator) {
+    const Mul *mul = op->value.as<Mul>();
+    if (neon_intrinsics_disabled() ||
+        target.bits != 64 ||
+        !target.has_feature(Target::ARMDotProd) ||
+        op->op != VectorReduce::Add ||
+        !mul ||
+        !op->type.is_int_or_uint() ||
+        op->type.bits() != 32) {
+        return false;
+    }
+
+    const int input_lanes = op->value.type().lanes();
+    const int factor = input_lanes / op->type.lanes();
+    // sdot and udot sum groups of four products of bytes into each
+    // 32-bit lane. An accumulator has to line up with those lanes.
+    if (factor % 4 != 0 || (accumulator.defined() && factor != 4)) {
+        return false;
+    }
+
+    string intrin;
+    Expr a, b;
+    for (Type narrow : {Int(8, input_lanes), UInt(8, input_lanes)}) {
+        a = lossless_cast(narrow, mul->a);
+        b = lossless_cast(narrow, mul->b);
+        if (a.defined() && b.defined()) {
+            intrin = narrow.is_int() ? "llvm.aarch64.neon.sdot." : "llvm.aarch64.neon.udot.";
+            break;
+        }
+    }
+    if (intrin.empty()) {
+        return false;
+    }
+
+    const int outputs = input_lanes / 4;
+    Type partial_type = op->type.with_lanes(outputs);
+    const int intrin_lanes = outputs >= 4 ? 4 : 2;
+    intrin += "v" + std::to_string(intrin_lanes) + "i32.v" + std::to_string(intrin_lanes * 4) + "i8";
+    Value *acc = codegen(accumulator.defined() ? accumulator : make_zero(partial_type));
+    value = call_intrin(llvm_type_of(partial_type), intrin_lanes, intrin, {acc, codegen(a), codegen(b)});
+
+    if (factor > 4) {
+        string name = unique_name('t');
+        sym_push(name, value);
+        value = codegen(VectorReduce::make(op->op, Variable::make(partial_type, name), op->type.lanes()));
+        sym_pop(name);
+    }
+    return true;
+}
+
+void CodeGen_ARM::visit(const VectorReduce *op) {
+    if (codegen_dot_product(op, Expr())) {
+        return;
+    }
+
+    CodeGen_Posix::visit(op);
+}
+
 string CodeGen_ARM::mcpu() const {
     if (target.bits == 32) {
         if (target.has_feature(Target::ARMv7s)) {
@@ -1034,18 +1181,27 @@ string CodeGen_ARM::mattrs() const {
         }
     } else {
         // TODO: Should Halide's SVE flags be 64-bit only?
-        string arch_flags;
+        vector<string> arch_flags;
         if (target.has_feature(Target::SVE2)) {
-            arch_flags = "+sve2";
+            arch_flags.push_back("+sve2");
         } else if (target.has_feature(Target::SVE)) {
-            arch_flags = "+sve";
+            arch_flags.push_back("+sve");
+        }
+        if (target.has_feature(Target::ARMDotProd)) {
+            arch_flags.push_back("+dotprod");
+        }
+        if (target.has_feature(Target::ARMFp16)) {
+            arch_flags.push_back("+fullfp16");
         }
 
         if (target.os == Target::IOS || target.os == Target::OSX) {
-            return arch_flags + "+reserve-x18";
-        } else {
-            return arch_flags;
+            arch_flags.push_back("+reserve-x18");
         }
+        string result;
+        for (const string &f : arch_flags) {
+            result += (result.empty() ? "" : ",") + f;
+        }
+        return result;
     }
 }
 
@@ -1058,9 +1214,34 @@ bool CodeGen_ARM::use_soft_float_abi() const {
           (target.os == Target::IOS && !target.has_feature(Target::ARMv7s))));
 }
 
+int CodeGen_ARM::sve_vector_bits() const {
+#if LLVM_VERSION >= 130
+    return sve_enabled() ? target.vector_bits : 0;
+#else
+    return 0;
+#endif
+}
+
 int CodeGen_ARM::native_vector_bits() const {
+    if (sve_vector_bits() != 0) {
+        return sve_vector_bits();
+    }
     return 128;
 }
 
+Type CodeGen_ARM::upgrade_type_for_arithmetic(const Type &t) const {
+    if (target.bits == 64 && target.has_feature(Target::ARMFp16) && t.element_of() == Float(16)) {
+        return t;
+    }
+    return CodeGen_Posix::upgrade_type_for_arithmetic(t);
+}
+
+Type CodeGen_ARM::upgrade_type_for_storage(const Type &t) const {
+    if (target.bits == 64 && target.has_feature(Target::ARMFp16) && t.element_of() == Float(16)) {
+        return t;
+    }
+    return CodeGen_Posix::upgrade_type_for_storage(t);
+}
+
 }  // namespace Internal
 }  // namespace Halide
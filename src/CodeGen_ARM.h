@@ -32,6 +32,20 @@ protected:
     void visit(const Store *) override;
     void visit(const Load *) override;
     void visit(const Call *) override;
+    void visit(const VectorReduce *) override;
+    // @}
+
+    /** Try to generate a VectorReduce that sums products of bytes with
+     * a dot-product instruction, adding the result to the given
+     * accumulator if it's defined. Returns false without generating
+     * any code if the target or the reduction isn't suitable. */
+    bool codegen_dot_product(const VectorReduce *op, const Expr &accumulator);
+
+    /** With ARMFp16, float16 is a native arithmetic and storage type
+     * on 64-bit ARM. */
+    // @{
+    Type upgrade_type_for_arithmetic(const Type &) const override;
+    Type upgrade_type_for_storage(const Type &) const override;
     // @}
 
     /** Various patterns to peephole match against */
@@ -70,6 +84,33 @@ protected:
     bool neon_intrinsics_disabled() {
         return target.has_feature(Target::NoNEON);
     }
+
+    // SVE is only used on 64-bit ARM.
+    bool sve_enabled() const {
+        return target.bits == 64 &&
+               (target.has_feature(Target::SVE) || target.has_feature(Target::SVE2));
+    }
+
+    /** The SVE vector length LLVM generates code for, or zero if
+     * vectors are NEON width. LLVM only uses SVE for fixed-width
+     * vectors when told the vector length with the vscale_range
+     * function attribute, which needs LLVM 13. */
+    int sve_vector_bits() const;
+
+    /** Whether LLVM will lower a gather (or scatter) of the given
+     * vector type to SVE instructions. Only then is it worth routing
+     * loads and stores at arbitrary indices through
+     * codegen_sve_gather/scatter; otherwise LLVM splits them into
+     * per-lane accesses, which is worse than what NEON does. */
+    bool use_sve_gather_scatter(llvm::Type *t, bool scatter);
+    std::map<std::pair<llvm::Type *, bool>, bool> sve_gather_scatter_legal;
+
+    /** Load or store lanes at arbitrary indices with an SVE gather or
+     * scatter. */
+    // @{
+    void codegen_sve_gather(const Load *op);
+    void codegen_sve_scatter(const Store *op);
+    // @}
 };
 
 }  // namespace Internal
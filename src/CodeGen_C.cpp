@@ -52,6 +52,8 @@ const string globals = R"INLINE_CODE(
 extern "C" {
 int64_t halide_current_time_ns(void *ctx);
 void halide_profiler_pipeline_end(void *, void *);
+void halide_profiler_pipeline_call_end(void *, void *);
+void halide_profiler_hw_pipeline_end(void *, void *);
 }
 
 #ifdef _WIN32
@@ -252,6 +254,12 @@ protected:
         IRGraphVisitor::visit(op);
     }
 
+    // Vector reductions are emitted as a tree of shuffles, which
+    // need vector types of their own.
+    void visit(const VectorReduce *op) override {
+        include(lower_vector_reduce(op));
+    }
+
     void visit(const For *op) override {
         for_types_used.insert(op->for_type);
         IRGraphVisitor::visit(op);
@@ -293,7 +301,7 @@ public:
 };
 
 CodeGen_C::CodeGen_C(ostream &s, Target t, OutputKind output_kind, const std::string &guard) :
-    IRPrinter(s), id("$$ BAD ID $$"), target(t), output_kind(output_kind), extern_c_open(false) {
+    IRPrinter(s), id("$$ BAD ID $$"), target(t), output_kind(output_kind), extern_c_open(false), emit_atomic_stores(false) {
 
     if (is_header()) {
         // If it's a header, emit an include guard.
@@ -2387,6 +2395,46 @@ void CodeGen_C::visit(const Store *op) {
     user_assert(is_one(op->predicate)) << "Predicated store is not supported by C backend.\n";
 
     Type t = op->value.type();
+
+    if (emit_atomic_stores) {
+        internal_assert(t.is_scalar()) << "Atomic store of vector value should have been scalarized\n";
+        string id_index = print_expr(op->index);
+        string address = "&((" + print_type(t) + " *)" + print_name(op->name) + ")[" + id_index + "]";
+
+        Stmt update = atomic_update(op);
+        VectorReduce::Operator reduce_op;
+        Expr current, rest;
+        if (t.is_int_or_uint() &&
+            match_reduction(update.as<Store>(), &reduce_op, &current, &rest) &&
+            reduce_op == VectorReduce::Add) {
+            string id_rest = print_expr(rest);
+            do_indent();
+            stream << "__atomic_fetch_add(" << address << ", " << id_rest << ", __ATOMIC_RELAXED);\n";
+        } else {
+            // Recompute the value until no other thread has changed
+            // the site in the meantime.
+            string old_name = unique_name('t');
+            string id_old = print_name(old_name);
+            do_indent();
+            stream << print_type(t) << " " << id_old << ";\n";
+            do_indent();
+            stream << "__atomic_load(" << address << ", &" << id_old << ", __ATOMIC_RELAXED);\n";
+            do_indent();
+            stream << "while (true)\n";
+            open_scope();
+            update = atomic_update(op, Variable::make(t, old_name));
+            string id_new = print_expr(update.as<Store>()->value);
+            string id_desired = print_name(unique_name('t'));
+            do_indent();
+            stream << print_type(t) << " " << id_desired << " = " << id_new << ";\n";
+            do_indent();
+            stream << "if (__atomic_compare_exchange(" << address << ", &" << id_old << ", &" << id_desired
+                   << ", false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) break;\n";
+            close_scope("");
+        }
+        cache.clear();
+        return;
+    }
     string id_value = print_expr(op->value);
     string name = print_name(op->name);
 
@@ -2568,6 +2616,11 @@ void CodeGen_C::visit(const Acquire *op) {
     close_scope("");
 }
 
+void CodeGen_C::visit(const Atomic *op) {
+    ScopedValue<bool> old_emit_atomic_stores(emit_atomic_stores, true);
+    op->body.accept(this);
+}
+
 void CodeGen_C::visit(const For *op) {
     string id_min = print_expr(op->min);
     string id_extent = print_expr(op->extent);
@@ -2654,7 +2707,7 @@ void CodeGen_C::visit(const Allocate *op) {
 
                 if (op->memory_type == MemoryType::Stack ||
                     (op->memory_type == MemoryType::Auto &&
-                     can_allocation_fit_on_stack(stack_bytes))) {
+                     can_allocation_fit_on_stack(stack_bytes, target))) {
                     on_stack = true;
                 }
             }
@@ -2822,6 +2875,10 @@ void CodeGen_C::visit(const Shuffle *op) {
     print_assignment(op->type, rhs.str());
 }
 
+void CodeGen_C::visit(const VectorReduce *op) {
+    print_expr(lower_vector_reduce(op));
+}
+
 void CodeGen_C::test() {
     LoweredArgument buffer_arg("buf", Argument::OutputBuffer, Int(32), 3, ArgumentEstimates{});
     LoweredArgument float_arg("alpha", Argument::InputScalar, Float(32), 0, ArgumentEstimates{});
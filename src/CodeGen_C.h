@@ -151,6 +151,10 @@ protected:
     /** True if at least one gpu-based for loop is used. */
     bool uses_gpu_for_loops;
 
+    /** Make stores atomic updates while this is set, i.e. while inside
+     * an Atomic node. */
+    bool emit_atomic_stores;
+
     /** Track which handle types have been forward-declared already. */
     std::set<const halide_handle_cplusplus_type *> forward_declared;
 
@@ -202,9 +206,11 @@ protected:
     void visit(const IfThenElse *) override;
     void visit(const Evaluate *) override;
     void visit(const Shuffle *) override;
+    void visit(const VectorReduce *) override;
     void visit(const Prefetch *) override;
     void visit(const Fork *) override;
     void visit(const Acquire *) override;
+    void visit(const Atomic *) override;
 
     void visit_binop(Type t, Expr a, Expr b, const char *op);
 
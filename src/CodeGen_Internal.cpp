@@ -3,8 +3,10 @@
 #include "Debug.h"
 #include "IntegerDivisionTable.h"
 #include "IRMutator.h"
+#include "IREquality.h"
 #include "IROperator.h"
 #include "LLVM_Headers.h"
+#include "Substitute.h"
 
 namespace Halide {
 namespace Internal {
@@ -161,6 +163,7 @@ bool function_takes_user_context(const std::string &name) {
         "halide_print",
         "halide_profiler_memory_allocate",
         "halide_profiler_memory_free",
+        "halide_profiler_memory_unplanned",
         "halide_profiler_pipeline_start",
         "halide_profiler_pipeline_end",
         "halide_profiler_stack_peak_update",
@@ -219,9 +222,9 @@ bool function_takes_user_context(const std::string &name) {
     return starts_with(name, "halide_error_");
 }
 
-bool can_allocation_fit_on_stack(int64_t size) {
+bool can_allocation_fit_on_stack(int64_t size, const Target &t) {
     user_assert(size > 0) << "Allocation size should be a positive number\n";
-    return (size <= 1024 * 16);
+    return (size <= (t.stack_budget > 0 ? t.stack_budget : 1024 * 16));
 }
 
 Expr lower_int_uint_div(Expr a, Expr b) {
@@ -405,6 +408,77 @@ Expr lower_euclidean_mod(Expr a, Expr b) {
     }
 }
 
+Expr lower_vector_reduce(const VectorReduce *op) {
+    Expr value = op->value;
+    const int lanes = op->type.lanes();
+    int factor = value.type().lanes() / lanes;
+
+    // While an even number of lanes are reduced into each output
+    // lane, combine neighbouring lanes. When reducing to a scalar,
+    // the two halves of the vector can be combined instead, which
+    // needs cheaper shuffles.
+    while (factor % 2 == 0) {
+        int half = value.type().lanes() / 2;
+        Expr a, b;
+        if (lanes == 1) {
+            a = Shuffle::make_slice(value, 0, 1, half);
+            b = Shuffle::make_slice(value, half, 1, half);
+        } else {
+            a = Shuffle::make_slice(value, 0, 2, half);
+            b = Shuffle::make_slice(value, 1, 2, half);
+        }
+        value = vector_reduce_binop(op->op, a, b);
+        factor /= 2;
+    }
+
+    // Then combine the remaining odd number of strided slices.
+    if (factor > 1) {
+        Expr result;
+        for (int i = 0; i < factor; i++) {
+            Expr slice = Shuffle::make_slice(value, i, factor, lanes);
+            result = result.defined() ? vector_reduce_binop(op->op, result, slice) : slice;
+        }
+        value = result;
+    }
+
+    // Each step uses the previous one twice.
+    return common_subexpression_elimination(value);
+}
+
+namespace {
+
+class ReplaceSiteLoads : public IRMutator {
+    using IRMutator::visit;
+
+    const std::string &buffer;
+    const Expr &index, &replacement;
+
+    Expr visit(const Load *op) override {
+        if (op->name == buffer && equal(op->index, index)) {
+            return replacement;
+        } else {
+            return IRMutator::visit(op);
+        }
+    }
+
+public:
+    ReplaceSiteLoads(const std::string &b, const Expr &i, const Expr &r) :
+        buffer(b), index(i), replacement(r) {}
+};
+
+}  // namespace
+
+Stmt atomic_update(const Store *op, Expr old_value) {
+    internal_assert(op->value.type().is_scalar())
+        << "Atomic store of vector value should have been scalarized\n";
+    Expr value = substitute_in_all_lets(op->value);
+    Expr index = substitute_in_all_lets(op->index);
+    if (old_value.defined()) {
+        value = ReplaceSiteLoads(op->name, index, old_value).mutate(value);
+    }
+    return Store::make(op->name, value, index, op->param, op->predicate, op->alignment);
+}
+
 namespace {
 
 // This mutator rewrites predicated loads and stores as unpredicated
@@ -609,6 +683,17 @@ void set_function_attributes_for_target(llvm::Function *fn, Target t) {
     // Turn off approximate reciprocals for division. It's too
     // inaccurate even for us.
     fn->addFnAttr("reciprocal-estimates", "none");
+
+#if LLVM_VERSION >= 130
+    // Tell LLVM the SVE vector length, so that it can use SVE
+    // registers and predication for fixed-width vectors. The +sve or
+    // +sve2 feature itself comes from CodeGen_ARM::mattrs.
+    if (t.arch == Target::ARM && t.bits == 64 && t.vector_bits != 0 &&
+        (t.has_feature(Target::SVE) || t.has_feature(Target::SVE2))) {
+        unsigned vscale = t.vector_bits / 128;
+        fn->addFnAttr(llvm::Attribute::getWithVScaleRangeArgs(fn->getContext(), vscale, vscale));
+    }
+#endif
 }
 
 void embed_bitcode(llvm::Module *M, const string &halide_command) {
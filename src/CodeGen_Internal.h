@@ -64,9 +64,10 @@ llvm::Type *llvm_type_of(llvm::LLVMContext *context, Halide::Type t);
 bool function_takes_user_context(const std::string &name);
 
 /** Given a size (in bytes), return True if the allocation size can fit
- * on the stack; otherwise, return False. This routine asserts if size is
- * non-positive. */
-bool can_allocation_fit_on_stack(int64_t size);
+ * on the stack; otherwise, return False. The limit is the target's
+ * stack_budget if it has one, and 16KB otherwise. This routine
+ * asserts if size is non-positive. */
+bool can_allocation_fit_on_stack(int64_t size, const Target &t);
 
 /** Given a Halide Euclidean division/mod operation, do constant optimizations
  * and possibly call lower_euclidean_div/lower_euclidean_mod if necessary.
@@ -84,6 +85,17 @@ Expr lower_euclidean_div(Expr a, Expr b);
 Expr lower_euclidean_mod(Expr a, Expr b);
 ///@}
 
+/** Given a VectorReduce, define it in terms of slices of the vector
+ * combined with ordinary binary operators, for backends that have no
+ * horizontal reduction instructions. */
+Expr lower_vector_reduce(const VectorReduce *op);
+
+/** Given a scalar Store inside an Atomic node, return the Store with
+ * all lets substituted in, so that the loads of the site being
+ * updated can be found by comparing indices. If old_value is
+ * defined, also replace those loads with it. */
+Stmt atomic_update(const Store *op, Expr old_value = Expr());
+
 /** Replace predicated loads/stores with unpredicated equivalents
  * inside branches. */
 Stmt unpredicate_loads_stores(Stmt s);
@@ -273,7 +273,8 @@ CodeGen_LLVM::CodeGen_LLVM(Target t) :
     min_f64(Float(64).min()),
     max_f64(Float(64).max()),
     destructor_block(nullptr),
-    strict_float(t.has_feature(Target::StrictFloat)) {
+    strict_float(t.has_feature(Target::StrictFloat)),
+    emit_atomic_stores(false) {
     initialize_llvm();
 }
 
@@ -563,6 +564,15 @@ std::unique_ptr<llvm::Module> CodeGen_LLVM::compile_trampolines(
     return codegen->finish_codegen();
 }
 
+std::unique_ptr<llvm::Module> CodeGen_LLVM::compile_empty_module(
+        const Target &target,
+        llvm::LLVMContext &context,
+        const std::string &name) {
+    std::unique_ptr<CodeGen_LLVM> codegen(new_for_target(target, context));
+    codegen->init_codegen(name);
+    return std::move(codegen->module);
+}
+
 void CodeGen_LLVM::init_codegen(const std::string &name, bool any_strict_float) {
     init_module();
 
@@ -3295,6 +3305,86 @@ void CodeGen_LLVM::visit(const Call *op) {
     }
 }
 
+void CodeGen_LLVM::visit(const Atomic *op) {
+    ScopedValue<bool> old_emit_atomic_stores(emit_atomic_stores, true);
+    codegen(op->body);
+}
+
+void CodeGen_LLVM::codegen_atomic_store(const Store *op) {
+    Halide::Type value_type = op->value.type();
+    user_assert(value_type == upgrade_type_for_storage(value_type))
+        << "atomic() is not supported for updates of type " << value_type << "\n";
+    internal_assert(value_type.is_scalar())
+        << "Atomic store of vector value should have been scalarized\n";
+
+    if (!is_one(op->predicate)) {
+        Stmt unpredicated = Store::make(op->name, op->value, op->index, op->param, const_true(), op->alignment);
+        codegen(IfThenElse::make(op->predicate, unpredicated));
+        return;
+    }
+
+    Value *ptr = codegen_buffer_pointer(op->name, value_type, op->index);
+
+    // Use an atomic read-modify-write instruction if there's one for
+    // the update.
+    Stmt update = atomic_update(op);
+    VectorReduce::Operator reduce_op;
+    Expr current, rest;
+    if (value_type.is_int_or_uint() &&
+        match_reduction(update.as<Store>(), &reduce_op, &current, &rest)) {
+        AtomicRMWInst::BinOp binop = AtomicRMWInst::BAD_BINOP;
+        switch (reduce_op) {
+        case VectorReduce::Add:
+            binop = AtomicRMWInst::Add;
+            break;
+        case VectorReduce::Min:
+            binop = value_type.is_int() ? AtomicRMWInst::Min : AtomicRMWInst::UMin;
+            break;
+        case VectorReduce::Max:
+            binop = value_type.is_int() ? AtomicRMWInst::Max : AtomicRMWInst::UMax;
+            break;
+        default:
+            break;
+        }
+        if (binop != AtomicRMWInst::BAD_BINOP) {
+            builder->CreateAtomicRMW(binop, ptr, codegen(rest), AtomicOrdering::Monotonic);
+            return;
+        }
+    }
+
+    // Otherwise, compute the new value from the value at the site, and
+    // swap it in if the site still holds that value. If another thread
+    // got there first, try again with the value it stored.
+    llvm::Type *int_type = llvm::Type::getIntNTy(*context, value_type.bits());
+    Value *int_ptr = builder->CreatePointerCast(ptr, int_type->getPointerTo());
+    // Other threads may be storing to the site concurrently, so the
+    // initial read must be atomic too.
+    LoadInst *orig = builder->CreateAlignedLoad(int_ptr, value_type.bytes());
+    orig->setAtomic(AtomicOrdering::Monotonic);
+    BasicBlock *entry_bb = builder->GetInsertBlock();
+    BasicBlock *loop_bb = BasicBlock::Create(*context, "atomic_cas_loop", function);
+    BasicBlock *after_bb = BasicBlock::Create(*context, "atomic_cas_done", function);
+    builder->CreateBr(loop_bb);
+    builder->SetInsertPoint(loop_bb);
+
+    PHINode *old_int = builder->CreatePHI(int_type, 2);
+    old_int->addIncoming(orig, entry_bb);
+    string old_name = unique_name('t');
+    sym_push(old_name, builder->CreateBitCast(old_int, llvm_type_of(value_type)));
+    update = atomic_update(op, Variable::make(value_type, old_name));
+    Value *new_int = builder->CreateBitCast(codegen(update.as<Store>()->value), int_type);
+    sym_pop(old_name);
+
+    Value *result = builder->CreateAtomicCmpXchg(int_ptr, old_int, new_int,
+                                                 AtomicOrdering::SequentiallyConsistent,
+                                                 AtomicOrdering::SequentiallyConsistent);
+    Value *current_int = builder->CreateExtractValue(result, {0});
+    Value *success = builder->CreateExtractValue(result, {1});
+    old_int->addIncoming(current_int, builder->GetInsertBlock());
+    builder->CreateCondBr(success, after_bb, loop_bb);
+    builder->SetInsertPoint(after_bb);
+}
+
 void CodeGen_LLVM::visit(const Prefetch *op) {
     internal_error << "Prefetch encountered during codegen\n";
 }
@@ -3874,6 +3964,11 @@ void CodeGen_LLVM::visit(const Fork *op) {
 }
 
 void CodeGen_LLVM::visit(const Store *op) {
+    if (emit_atomic_stores) {
+        codegen_atomic_store(op);
+        return;
+    }
+
     Halide::Type value_type = op->value.type();
     Halide::Type storage_type = upgrade_type_for_storage(value_type);
     if (value_type != storage_type) {
@@ -4101,6 +4196,56 @@ void CodeGen_LLVM::visit(const Shuffle *op) {
     }
 }
 
+void CodeGen_LLVM::visit(const VectorReduce *op) {
+    const int output_lanes = op->type.lanes();
+    const int factor = op->value.type().lanes() / output_lanes;
+
+    if (factor == 1) {
+        value = codegen(op->value);
+        return;
+    }
+
+    if (output_lanes == 1 && !op->type.is_float()) {
+        // LLVM's reduction intrinsics become horizontal reduction
+        // instructions where the target has them, and a tree of
+        // shuffles elsewhere. They're only unordered for integers.
+        Value *v = codegen(op->value);
+        bool is_signed = op->type.is_int();
+        switch (op->op) {
+        case VectorReduce::Add:
+            value = builder->CreateAddReduce(v);
+            break;
+        case VectorReduce::Mul:
+            value = builder->CreateMulReduce(v);
+            break;
+        case VectorReduce::Min:
+            value = builder->CreateIntMinReduce(v, is_signed);
+            break;
+        case VectorReduce::Max:
+            value = builder->CreateIntMaxReduce(v, is_signed);
+            break;
+        case VectorReduce::And:
+            value = builder->CreateAndReduce(v);
+            break;
+        case VectorReduce::Or:
+            value = builder->CreateOrReduce(v);
+            break;
+        }
+        return;
+    }
+
+    if (output_lanes > 1 && factor > 2 && factor % 2 == 0) {
+        // Reduce by a factor of two at a time, so that targets with
+        // instructions that combine neighbouring lanes can use them
+        // at each step.
+        Expr halved = VectorReduce::make(op->op, op->value, op->value.type().lanes() / 2);
+        value = codegen(VectorReduce::make(op->op, halved, output_lanes));
+        return;
+    }
+
+    value = codegen(lower_vector_reduce(op));
+}
+
 Value *CodeGen_LLVM::create_alloca_at_entry(llvm::Type *t, int n, bool zero_initialize, const string &name) {
     IRBuilderBase::InsertPoint here = builder->saveIP();
     BasicBlock *entry = &builder->GetInsertBlock()->getParent()->getEntryBlock();
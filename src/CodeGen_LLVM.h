@@ -81,6 +81,15 @@ public:
         const std::string &suffix,
         const std::vector<std::pair<std::string, ExternSignature>> &externs);
 
+    /** Make a module with the target triple, data layout and target
+     * options that compiling a Halide Module for the given target
+     * would produce, but containing none of its code. Used by the JIT
+     * when the object code for a Module is already in its cache. */
+    static std::unique_ptr<llvm::Module> compile_empty_module(
+        const Target &target,
+        llvm::LLVMContext &context,
+        const std::string &name);
+
 protected:
     CodeGen_LLVM(Target t);
 
@@ -390,7 +399,9 @@ protected:
     void visit(const IfThenElse *) override;
     void visit(const Evaluate *) override;
     void visit(const Shuffle *) override;
+    void visit(const VectorReduce *) override;
     void visit(const Prefetch *) override;
+    void visit(const Atomic *) override;
     // @}
 
     /** Generate code for an allocate node. It has no default
@@ -501,6 +512,10 @@ private:
     /** Turn off all unsafe math flags in scopes while this is set. */
     bool strict_float;
 
+    /** Make stores atomic updates while this is set, i.e. while inside
+     * an Atomic node. */
+    bool emit_atomic_stores;
+
     /** Embed an instance of halide_filter_metadata_t in the code, using
      * the given name (by convention, this should be ${FUNCTIONNAME}_metadata)
      * as extern "C" linkage. Note that the return value is a function-returning-
@@ -521,6 +536,11 @@ private:
     virtual void codegen_predicated_vector_load(const Load *op);
     virtual void codegen_predicated_vector_store(const Store *op);
 
+    /** Generate code for a scalar Store inside an Atomic node, using an
+     * atomic read-modify-write instruction if there's one for the
+     * update, and a compare-and-swap loop otherwise. */
+    virtual void codegen_atomic_store(const Store *op);
+
     void init_codegen(const std::string &name, bool any_strict_float = false);
     std::unique_ptr<llvm::Module> finish_codegen();
 
@@ -305,6 +305,55 @@ void CodeGen_OpenCL_Dev::CodeGen_OpenCL_C::visit(const Load *op) {
 void CodeGen_OpenCL_Dev::CodeGen_OpenCL_C::visit(const Store *op) {
     user_assert(is_one(op->predicate)) << "Predicated store is not supported inside OpenCL kernel.\n";
 
+    if (emit_atomic_stores) {
+        Type t = op->value.type();
+        internal_assert(t.is_scalar()) << "Atomic store of vector value should have been scalarized\n";
+        user_assert(t.bits() == 32) << "OpenCL only supports atomic updates of 32-bit values.\n";
+        string int_type = t.is_int() ? "int" : "uint";
+        string id_index = print_expr(op->index);
+        string address = "&((" + get_memory_space(op->name) + " " + print_type(t) + " *)" + print_name(op->name) + ")[" + id_index + "]";
+
+        Stmt update = atomic_update(op);
+        VectorReduce::Operator reduce_op;
+        Expr current, rest;
+        if (t.is_int_or_uint() &&
+            match_reduction(update.as<Store>(), &reduce_op, &current, &rest) &&
+            (reduce_op == VectorReduce::Add ||
+             reduce_op == VectorReduce::Min ||
+             reduce_op == VectorReduce::Max)) {
+            const char *fn = (reduce_op == VectorReduce::Add ? "atomic_add" :
+                              reduce_op == VectorReduce::Min ? "atomic_min" : "atomic_max");
+            string id_rest = print_expr(rest);
+            do_indent();
+            stream << fn << "(" << address << ", " << id_rest << ");\n";
+        } else {
+            // A compare-and-swap loop on the bits of the value.
+            string int_address = "(volatile " + get_memory_space(op->name) + " " + int_type + " *)" + address;
+            string id_old_bits = print_name(unique_name('t'));
+            do_indent();
+            stream << int_type << " " << id_old_bits << " = *" << int_address << ";\n";
+            do_indent();
+            stream << "while (true)\n";
+            open_scope();
+            string old_name = unique_name('t');
+            do_indent();
+            stream << print_type(t) << " " << print_name(old_name) << " = as_" << print_type(t) << "(" << id_old_bits << ");\n";
+            update = atomic_update(op, Variable::make(t, old_name));
+            string id_new = print_expr(update.as<Store>()->value);
+            string id_seen = print_name(unique_name('t'));
+            do_indent();
+            stream << int_type << " " << id_seen << " = atomic_cmpxchg(" << int_address << ", "
+                   << id_old_bits << ", as_" << int_type << "(" << id_new << "));\n";
+            do_indent();
+            stream << "if (" << id_seen << " == " << id_old_bits << ") break;\n";
+            do_indent();
+            stream << id_old_bits << " = " << id_seen << ";\n";
+            close_scope("");
+        }
+        cache.clear();
+        return;
+    }
+
     string id_value = print_expr(op->value);
     Type t = op->value.type();
 
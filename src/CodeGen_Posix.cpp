@@ -94,7 +94,7 @@ CodeGen_Posix::Allocation CodeGen_Posix::create_allocation(const std::string &na
             user_error << "Total size for allocation " << name << " is constant but exceeds " << str_max_size << ".";
         } else if (memory_type == MemoryType::Heap ||
                    (memory_type != MemoryType::Register &&
-                    !can_allocation_fit_on_stack(stack_bytes))) {
+                    !can_allocation_fit_on_stack(stack_bytes, target))) {
             // We should put the allocation on the heap if it's
             // explicitly placed on the heap, or if it's not
             // explicitly placed in registers and it's large. Large
@@ -255,7 +255,26 @@ CodeGen_Posix::Allocation CodeGen_Posix::create_allocation(const std::string &na
             debug(4) << "\n";
             Value *args[2] = { get_user_context(), llvm_size };
 
-            Value *call = builder->CreateCall(malloc_fn, args);
+            Value *call;
+            if (is_one(condition)) {
+                call = builder->CreateCall(malloc_fn, args);
+            } else {
+                // Don't call malloc at all if the condition is
+                // false. The pointer is then null, which the
+                // destructor skips.
+                BasicBlock *before_bb = builder->GetInsertBlock();
+                BasicBlock *malloc_bb = BasicBlock::Create(*context, name + "_malloc", function);
+                BasicBlock *after_bb = BasicBlock::Create(*context, name + "_after_malloc", function);
+                builder->CreateCondBr(llvm_condition, malloc_bb, after_bb);
+                builder->SetInsertPoint(malloc_bb);
+                Value *result = builder->CreateCall(malloc_fn, args);
+                builder->CreateBr(after_bb);
+                builder->SetInsertPoint(after_bb);
+                PHINode *phi = builder->CreatePHI(result->getType(), 2);
+                phi->addIncoming(result, malloc_bb);
+                phi->addIncoming(ConstantPointerNull::get(cast<PointerType>(result->getType())), before_bb);
+                call = phi;
+            }
 
             // Fix the type to avoid pointless bitcasts later
             call = builder->CreatePointerCast(call, llvm_type_of(type)->getPointerTo());
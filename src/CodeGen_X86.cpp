@@ -26,6 +26,13 @@ namespace {
 // existing flags, so that instruction patterns can just check for the
 // oldest feature flag that supports an instruction.
 Target complete_x86_target(Target t) {
+    if (t.has_feature(Target::AVX512_SapphireRapids)) {
+        t.set_feature(Target::AVX512_Cascadelake);
+        t.set_feature(Target::AVX512_Cannonlake);
+    }
+    if (t.has_feature(Target::AVX512_Cascadelake)) {
+        t.set_feature(Target::AVX512_Skylake);
+    }
     if (t.has_feature(Target::AVX512_Cannonlake) ||
         t.has_feature(Target::AVX512_Skylake) ||
         t.has_feature(Target::AVX512_KNL)) {
@@ -84,6 +91,14 @@ bool should_use_pmaddwd(Expr a, Expr b, vector<Expr> &result) {
 
 
 void CodeGen_X86::visit(const Add *op) {
+    // The dot-product instructions accumulate for free.
+    const VectorReduce *ra = op->a.as<VectorReduce>();
+    const VectorReduce *rb = op->b.as<VectorReduce>();
+    if ((ra && codegen_dot_product(ra, op->b)) ||
+        (rb && codegen_dot_product(rb, op->a))) {
+        return;
+    }
+
     vector<Expr> matches;
     if (should_use_pmaddwd(op->a, op->b, matches)) {
         codegen(Call::make(op->type, "pmaddwd", matches, Call::Extern));
@@ -431,7 +446,165 @@ void CodeGen_X86::visit(const Call *op) {
     CodeGen_Posix::visit(op);
 }
 
+namespace {
+
+// Narrow an operand of a dot product to the given type, if that can be
+// done without changing its value. Float operands must already be in
+// the narrow type, as the dot-product instructions round differently
+// than a conversion would.
+Expr narrow_dot_product_operand(const Expr &e, Type t) {
+    if (t.is_float()) {
+        const Cast *c = e.as<Cast>();
+        return (c && c->value.type() == t) ? c->value : Expr();
+    }
+    return lossless_cast(t, e);
+}
+
+}  // namespace
+
+bool CodeGen_X86::codegen_dot_product(const VectorReduce *op, const Expr &accumulator) {
+    const Mul *mul = op->value.as<Mul>();
+    if (op->op != VectorReduce::Add || !mul) {
+        return false;
+    }
+
+    const int input_lanes = op->value.type().lanes();
+    const int factor = input_lanes / op->type.lanes();
+
+    struct Pattern {
+        Target::Feature feature;
+        int factor;
+        Type result_type, a_type, b_type;
+        const char *intrin;
+    };
+    // Each instruction sums groups of 'factor' adjacent products into
+    // a 32-bit lane. The narrow operands are passed to the
+    // intrinsics packed into 32-bit lanes.
+    static const Pattern patterns[] = {
+        {Target::AVX512_Cascadelake, 4, Int(32), UInt(8), Int(8), "llvm.x86.avx512.vpdpbusd"},
+        {Target::AVX512_Cascadelake, 2, Int(32), Int(16), Int(16), "llvm.x86.avx512.vpdpwssd"},
+#if LLVM_VERSION >= 100
+        {Target::AVX512_SapphireRapids, 2, Float(32), BFloat(16), BFloat(16), "llvm.x86.avx512bf16.dpbf16ps"},
+#endif
+    };
+
+    for (const Pattern &p : patterns) {
+        if (!target.has_feature(p.feature) ||
+            op->type.element_of() != p.result_type ||
+            factor % p.factor != 0) {
+            continue;
+        }
+        // An accumulator has to line up with the instruction's results.
+        if (accumulator.defined() && factor != p.factor) {
+            continue;
+        }
+
+        Type a_type = p.a_type.with_lanes(input_lanes);
+        Type b_type = p.b_type.with_lanes(input_lanes);
+        Expr a = narrow_dot_product_operand(mul->a, a_type);
+        Expr b = narrow_dot_product_operand(mul->b, b_type);
+        if (!a.defined() || !b.defined()) {
+            a = narrow_dot_product_operand(mul->b, a_type);
+            b = narrow_dot_product_operand(mul->a, b_type);
+        }
+        if (!a.defined() || !b.defined()) {
+            continue;
+        }
+
+        const int outputs = input_lanes / p.factor;
+        Type partial_type = op->type.with_lanes(outputs);
+        Value *acc = codegen(accumulator.defined() ? accumulator : make_zero(partial_type));
+        llvm::Type *packed_type = llvm_type_of(Int(32, outputs));
+        Value *a_packed = builder->CreateBitCast(codegen(a), packed_type);
+        Value *b_packed = builder->CreateBitCast(codegen(b), packed_type);
+
+        const int intrin_lanes = outputs >= 16 ? 16 : outputs >= 8 ? 8 : 4;
+        string intrin = p.intrin;
+        intrin += intrin_lanes == 16 ? ".512" : intrin_lanes == 8 ? ".256" : ".128";
+        value = call_intrin(llvm_type_of(partial_type), intrin_lanes, intrin, {acc, a_packed, b_packed});
+
+        if (factor > p.factor) {
+            string name = unique_name('t');
+            sym_push(name, value);
+            value = codegen(VectorReduce::make(op->op, Variable::make(partial_type, name), op->type.lanes()));
+            sym_pop(name);
+        }
+        return true;
+    }
+
+    return false;
+}
+
+void CodeGen_X86::visit(const VectorReduce *op) {
+    const int input_lanes = op->value.type().lanes();
+    const int factor = input_lanes / op->type.lanes();
+
+    if (codegen_dot_product(op, Expr())) {
+        return;
+    }
+
+    if (op->op == VectorReduce::Add && factor % 2 == 0) {
+        // A sum of adjacent pairs of widening 16-bit multiplies is
+        // pmaddwd, which takes the interleaved pairs directly.
+        const Mul *mul = op->value.as<Mul>();
+        Type narrow = op->value.type().with_bits(16);
+        if (mul && op->type.is_int() && op->type.bits() == 32 && input_lanes >= 8) {
+            Expr a = lossless_cast(narrow, mul->a);
+            Expr b = lossless_cast(narrow, mul->b);
+            if (a.defined() && b.defined()) {
+                const bool avx2 = target.has_feature(Target::AVX2) && input_lanes >= 16;
+                Type pairs = op->type.with_lanes(input_lanes / 2);
+                value = call_intrin(pairs, avx2 ? 8 : 4,
+                                    avx2 ? "llvm.x86.avx2.pmadd.wd" : "llvm.x86.sse2.pmadd.wd",
+                                    {a, b});
+                if (factor > 2) {
+                    // Reduce the rest of the way with a fresh reduction
+                    // of the pairwise sums.
+                    string name = unique_name('t');
+                    sym_push(name, value);
+                    value = codegen(VectorReduce::make(op->op, Variable::make(pairs, name), op->type.lanes()));
+                    sym_pop(name);
+                }
+                return;
+            }
+        }
+    }
+
+    if (op->op == VectorReduce::Add && factor % 8 == 0 && input_lanes >= 16 &&
+        (op->type.is_int() || op->type.is_uint()) && op->type.bits() >= 16) {
+        // A sum of eight absolute differences of bytes is psadbw.
+        const Cast *cast = op->value.as<Cast>();
+        const Call *call = cast ? cast->value.as<Call>() : nullptr;
+        if (call && call->is_intrinsic(Call::absd) &&
+            call->type.is_uint() && call->type.bits() == 8 &&
+            call->args[0].type().is_uint()) {
+            const bool avx2 = target.has_feature(Target::AVX2) && input_lanes >= 32;
+            Type sums = UInt(64, input_lanes / 8);
+            value = call_intrin(sums, avx2 ? 4 : 2,
+                                avx2 ? "llvm.x86.avx2.psad.bw" : "llvm.x86.sse2.psad.bw",
+                                call->args);
+            Type narrowed = op->type.with_lanes(input_lanes / 8);
+            value = builder->CreateIntCast(value, llvm_type_of(narrowed), false);
+            if (factor > 8) {
+                string name = unique_name('t');
+                sym_push(name, value);
+                value = codegen(VectorReduce::make(op->op, Variable::make(narrowed, name), op->type.lanes()));
+                sym_pop(name);
+            }
+            return;
+        }
+    }
+
+    CodeGen_Posix::visit(op);
+}
+
 string CodeGen_X86::mcpu() const {
+#if LLVM_VERSION >= 100
+    if (target.has_feature(Target::AVX512_SapphireRapids)) return "cooperlake";
+#endif
+#if LLVM_VERSION >= 80
+    if (target.has_feature(Target::AVX512_Cascadelake)) return "cascadelake";
+#endif
     if (target.has_feature(Target::AVX512_Cannonlake)) return "cannonlake";
     if (target.has_feature(Target::AVX512_Skylake)) return "skylake-avx512";
     if (target.has_feature(Target::AVX512_KNL)) return "knl";
@@ -474,6 +647,14 @@ string CodeGen_X86::mattrs() const {
         if (target.has_feature(Target::AVX512_Cannonlake)) {
             features += ",+avx512ifma,+avx512vbmi";
         }
+        if (target.has_feature(Target::AVX512_Cascadelake)) {
+            features += ",+avx512vnni";
+        }
+#if LLVM_VERSION >= 100
+        if (target.has_feature(Target::AVX512_SapphireRapids)) {
+            features += ",+avx512bf16";
+        }
+#endif
     }
     return features;
 }
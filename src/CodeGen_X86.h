@@ -47,7 +47,14 @@ protected:
     void visit(const EQ *) override;
     void visit(const NE *) override;
     void visit(const Select *) override;
+    void visit(const VectorReduce *) override;
     // @}
+
+    /** Try to generate a VectorReduce that sums products of narrow
+     * values with one of the AVX512 dot-product instructions, adding
+     * the result to the given accumulator if it's defined. Returns
+     * false without generating any code if none of them apply. */
+    bool codegen_dot_product(const VectorReduce *op, const Expr &accumulator);
 };
 
 }  // namespace Internal
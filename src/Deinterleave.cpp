@@ -332,6 +332,23 @@ private:
             return Shuffle::make({ op }, indices);
         }
     }
+
+    Expr visit(const VectorReduce *op) override {
+        if (op->type.is_scalar()) {
+            return op;
+        }
+        // Pick out the groups of input lanes that reduce to the
+        // lanes we want, and reduce those.
+        int factor = op->value.type().lanes() / op->type.lanes();
+        std::vector<int> indices;
+        for (int i = 0; i < new_lanes; i++) {
+            int idx = i * lane_stride + starting_lane;
+            for (int j = 0; j < factor; j++) {
+                indices.push_back(idx * factor + j);
+            }
+        }
+        return VectorReduce::make(op->op, Shuffle::make({ op->value }, indices), new_lanes);
+    }
 };
 
 Expr deinterleave(Expr e, int starting_lane, int lane_stride, int new_lanes, const Scope<> &lets) {
@@ -122,6 +122,9 @@ protected:
     void visit(const Shuffle *op) override {
         internal_assert(false) << "Encounter unexpected statement \"Shuffle\" when differentiating.";
     }
+    void visit(const VectorReduce *op) override {
+        internal_assert(false) << "Encounter unexpected statement \"VectorReduce\" when differentiating.";
+    }
     void visit(const Prefetch *op) override {
         internal_assert(false) << "Encounter unexpected statement \"Prefetch\" when differentiating.";
     }
@@ -131,6 +134,9 @@ protected:
     void visit(const Acquire *op) override {
         internal_assert(false) << "Encounter unexpected statement \"Acquire\" when differentiating.";
     }
+    void visit(const Atomic *op) override {
+        internal_assert(false) << "Encounter unexpected statement \"Atomic\" when differentiating.";
+    }
 
 private:
     void accumulate(const Expr &stub, Expr adjoint);
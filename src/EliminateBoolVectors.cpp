@@ -271,6 +271,30 @@ private:
         return expr;
     }
 
+    Expr visit(const VectorReduce *op) override {
+        Expr value = mutate(op->value);
+        if (value.same_as(op->value)) {
+            return op;
+        } else if (op->type.is_bool() && !value.type().is_bool()) {
+            // The bool vector is now a mask of 0 for false and -1 for
+            // true, so all lanes are true when the max is true, and
+            // any lane is when the min is.
+            VectorReduce::Operator reduce_op = op->op;
+            if (reduce_op == VectorReduce::And) {
+                reduce_op = VectorReduce::Max;
+            } else if (reduce_op == VectorReduce::Or) {
+                reduce_op = VectorReduce::Min;
+            }
+            Expr expr = VectorReduce::make(reduce_op, value, op->type.lanes());
+            if (op->type.is_scalar()) {
+                expr = expr != make_zero(expr.type());
+            }
+            return expr;
+        } else {
+            return VectorReduce::make(op->op, value, op->type.lanes());
+        }
+    }
+
     template <typename NodeType, typename LetType>
     NodeType visit_let(const LetType *op) {
         Expr value = mutate(op->value);
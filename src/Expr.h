@@ -22,7 +22,7 @@ class IRMutator;
 class IRVisitor;
 
 /** All our IR node types get unique IDs for the purposes of RTTI */
-enum class IRNodeType {
+enum class IRNodeType : uint8_t {
     // Exprs, in order of strength
     IntImm,
     UIntImm,
@@ -53,6 +53,7 @@ enum class IRNodeType {
     Call,
     Let,
     Shuffle,
+    VectorReduce,
     // Stmts
     LetStmt,
     AssertStmt,
@@ -69,6 +70,7 @@ enum class IRNodeType {
     IfThenElse,
     Evaluate,
     Prefetch,
+    Atomic,
 };
 
 /** The abstract base classes for a node in the Halide IR. */
@@ -100,13 +102,28 @@ struct IRNode {
      * anyway, so this doesn't increase the memory footprint of an IR node.
      */
     IRNodeType node_type;
+
+    /** Whether this node is the canonical node for its structure in
+     * the hash-consing table (see IRHashConsing.h), and so must be
+     * removed from it when destroyed. Fits in the same padding as
+     * node_type. */
+    mutable bool hash_consed = false;
 };
 
+/** Remove a node from the hash-consing table. Called when a node with
+ * hash_consed set is destroyed. */
+void forget_hash_consed_node(const IRNode *node);
+
 template<>
 inline RefCount &ref_count<IRNode>(const IRNode *t) noexcept {return t->ref_count;}
 
 template<>
-inline void destroy<IRNode>(const IRNode *t) {delete t;}
+inline void destroy<IRNode>(const IRNode *t) {
+    if (t->hash_consed) {
+        forget_hash_consed_node(t);
+    }
+    delete t;
+}
 
 /** IR nodes are split into expressions and statements. These are
    similar to expressions and statements in C - expressions
@@ -129,6 +146,11 @@ struct BaseExprNode : public IRNode {
     Type type;
 };
 
+/** If hash-consing is enabled on this thread (see IRHashConsing.h),
+ * return the canonical node for a newly made constant, deleting the
+ * new one if it isn't it. Otherwise return the new node. */
+const BaseExprNode *hash_cons_constant(const BaseExprNode *node);
+
 /** We use the "curiously recurring template pattern" to avoid
    duplicated code in the IR Nodes. These classes live between the
    abstract base classes and the actual IR Nodes in the
@@ -210,7 +232,7 @@ struct IntImm : public ExprNode<IntImm> {
         IntImm *node = new IntImm;
         node->type = t;
         node->value = value;
-        return node;
+        return (const IntImm *)hash_cons_constant(node);
     }
 
     static const IRNodeType _node_type = IRNodeType::IntImm;
@@ -233,7 +255,7 @@ struct UIntImm : public ExprNode<UIntImm> {
         UIntImm *node = new UIntImm;
         node->type = t;
         node->value = value;
-        return node;
+        return (const UIntImm *)hash_cons_constant(node);
     }
 
     static const IRNodeType _node_type = IRNodeType::UIntImm;
@@ -266,7 +288,7 @@ struct FloatImm : public ExprNode<FloatImm> {
             internal_error << "FloatImm must be 16, 32, or 64-bit\n";
         }
 
-        return node;
+        return (const FloatImm *)hash_cons_constant(node);
     }
 
     static const IRNodeType _node_type = IRNodeType::FloatImm;
@@ -280,7 +302,7 @@ struct StringImm : public ExprNode<StringImm> {
         StringImm *node = new StringImm;
         node->type = type_of<const char *>();
         node->value = val;
-        return node;
+        return (const StringImm *)hash_cons_constant(node);
     }
 
     static const IRNodeType _node_type = IRNodeType::StringImm;
@@ -288,13 +288,16 @@ void Stage::set_dim_type(VarOrRVar var, ForType t) {
             // If it's an rvar and the for type is parallel, we need to
             // validate that this doesn't introduce a race condition.
             if (!dims[i].is_pure() && var.is_rvar && is_parallel(t)) {
-                user_assert(definition.schedule().allow_race_conditions())
+                user_assert(definition.schedule().allow_race_conditions() ||
+                            definition.schedule().atomic())
                     << "In schedule for " << name()
                     << ", marking var " << var.name()
                     << " as parallel or vectorized may introduce a race"
                     << " condition resulting in incorrect output."
                     << " It is possible to override this error using"
-                    << " the allow_race_conditions() method. Use this"
+                    << " the allow_race_conditions() method, or make the"
+                    << " update safe to parallelize with atomic(). Use"
+                    << " allow_race_conditions()"
                     << " with great caution, and only when you are willing"
                     << " to accept non-deterministic output, or you can prove"
                     << " that any race conditions in this code do not change"
@@ -1026,9 +1029,9 @@ void Stage::split(const string &old, const string &outer, const string &inner, E
     }
 
     if (exact) {
-        user_assert(tail == TailStrategy::GuardWithIf)
+        user_assert(tail == TailStrategy::GuardWithIf || tail == TailStrategy::Predicate)
             << "When splitting Var " << old_name
-            << " the tail strategy must be GuardWithIf or Auto. "
+            << " the tail strategy must be GuardWithIf, Predicate, or Auto. "
             << "Anything else may change the meaning of the algorithm\n";
     }
 
@@ -1403,6 +1406,26 @@ Stage &Stage::allow_race_conditions() {
     return *this;
 }
 
+Stage &Stage::atomic(bool override_associativity_test) {
+    user_assert(!definition.is_init())
+        << "In schedule for " << name()
+        << ", atomic() may only be used on update definitions.\n";
+    user_assert(definition.values().size() == 1)
+        << "In schedule for " << name()
+        << ", atomic() does not support Tuple-valued updates.\n";
+    if (!override_associativity_test) {
+        const auto &prover_result = prove_associativity(function.name(), definition.args(), definition.values());
+        user_assert(prover_result.associative() && prover_result.commutative())
+            << "In schedule for " << name()
+            << ", can't make the update atomic because it can't prove"
+            << " that the update is associative and commutative. If"
+            << " you know it to be, pass true to atomic() to skip the"
+            << " check.\n";
+    }
+    definition.schedule().atomic() = true;
+    return *this;
+}
+
 Stage &Stage::serial(VarOrRVar var) {
     set_dim_type(var, ForType::Serial);
     return *this;
@@ -2419,6 +2442,14 @@ Func &Func::fold_storage(Var dim, Expr factor, bool fold_forward) {
     return *this;
 }
 
+Func &Func::ring_buffer(Expr extent) {
+    invalidate_cache();
+    user_assert(extent.defined() && extent.type().is_int() && extent.type().is_scalar())
+        << "The extent of the ring buffer of " << name() << " must be a scalar integer.\n";
+    func.schedule().ring_buffer() = extent;
+    return *this;
+}
+
 Func &Func::compute_at(LoopLevel loop_level) {
     invalidate_cache();
     func.schedule().compute_level() = loop_level;
@@ -2484,6 +2515,24 @@ Func &Func::store_root() {
     return store_at(LoopLevel::root());
 }
 
+Func &Func::hoist_storage(LoopLevel loop_level) {
+    invalidate_cache();
+    func.schedule().hoist_storage_level() = loop_level;
+    return *this;
+}
+
+Func &Func::hoist_storage(Func f, RVar var) {
+    return hoist_storage(LoopLevel(f, var));
+}
+
+Func &Func::hoist_storage(Func f, Var var) {
+    return hoist_storage(LoopLevel(f, var));
+}
+
+Func &Func::hoist_storage_root() {
+    return hoist_storage(LoopLevel::root());
+}
+
 Func &Func::compute_inline() {
     return compute_at(LoopLevel::inlined());
 }
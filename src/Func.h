@@ -411,6 +411,25 @@ public:
 
     Stage &allow_race_conditions();
 
+    /** Make the stores of this update definition atomic, which
+     * permits marking its RVars as parallel or vectorized without
+     * allow_race_conditions(). This must be called before the RVars
+     * are marked as such. Each update of a site is done as a single
+     * atomic read-modify-write (or compare-and-swap loop) with respect
+     * to other updates, so concurrent updates of the same site (for
+     * example, the bins of a histogram) are not lost. When every
+     * iteration of a parallel loop updates the same site, or a small
+     * range of sites with a constant size such as those bins, each
+     * thread instead accumulates into a private copy which is
+     * atomically merged into the sites once at the end.
+     *
+     * Updates can be applied in any order, so the update must be
+     * associative and commutative, which Halide tries to prove; pass
+     * true for override_associativity_test to skip the proof if it
+     * fails but you know it to be the case. Only single-valued
+     * updates are supported. */
+    Stage &atomic(bool override_associativity_test = false);
+
     Stage &hexagon(VarOrRVar x = Var::outermost());
     Stage &prefetch(const Func &f, VarOrRVar var, Expr offset = 1,
                            PrefetchBoundStrategy strategy = PrefetchBoundStrategy::GuardWithIf);
@@ -1953,6 +1972,31 @@ public:
      */
     Func &fold_storage(Var dim, Expr extent, bool fold_forward = true);
 
+    /** Store this Func in a circular buffer with the given number of
+     * slots, each of which holds the values computed in one
+     * iteration of the loop it is computed at. The Func must be
+     * stored outside the loop it's computed at, and each iteration
+     * must not reuse values computed by earlier ones (e.g. due to
+     * sliding window). Iteration i of the loop uses slot i % extent,
+     * but the slot is tracked with a counter, so unlike
+     * fold_storage, accesses don't need any modulo arithmetic, and
+     * the number of slots needn't be a power of two.
+     *
+     * This is most useful with \ref Func::async, where it lets the
+     * producer run up to extent iterations ahead of the consumer
+     * while only storing extent iterations' worth of values. For
+     * example:
+     *
+     \code
+     g.compute_at(f, y).store_root().async().ring_buffer(3);
+     \endcode
+     *
+     * computes each row of g on a separate thread up to three rows
+     * ahead of the row of f that uses it, in a buffer three rows
+     * tall.
+     */
+    Func &ring_buffer(Expr extent);
+
     /** Compute this function as needed for each unique value of the
      * given var for the given calling function f.
      *
@@ -2213,6 +2257,39 @@ public:
      * outside the outermost loop. */
     Func &store_root();
 
+    /** Hoist the allocation of this function's storage out to f's
+     * loop over var, while keeping the semantics of where it is
+     * stored and computed unchanged. The hoisted allocation is large
+     * enough for any iteration of the loops between the hoist level
+     * and the store level, so it is made once instead of once per
+     * iteration. This is useful when the store level is inside a
+     * loop with many iterations, and the allocation is too large to
+     * go on the stack. For example:
+     *
+     \code
+     g.compute_at(f, x).hoist_storage(f, y);
+     \endcode
+     *
+     * allocates g once per row of f, rather than once per pixel.
+     * The hoist level must be at or outside the store level, there
+     * must be no parallel or vectorized loops between the two, and
+     * the size of the allocation must have an upper bound that
+     * doesn't depend on the loops it is hoisted out of. */
+    Func &hoist_storage(Func f, Var var);
+
+    /** Equivalent to the version of hoist_storage that takes a Var,
+     * but hoists storage to the loop over a dimension of a reduction
+     * domain */
+    Func &hoist_storage(Func f, RVar var);
+
+    /** Equivalent to the version of hoist_storage that takes a Var,
+     * but hoists storage to a given LoopLevel. */
+    Func &hoist_storage(LoopLevel loop_level);
+
+    /** Equivalent to \ref Func::hoist_storage, but hoists storage
+     * outside the outermost loop. */
+    Func &hoist_storage_root();
+
     /** Aggressively inline all uses of this function. This is the
      * default schedule, so you're unlikely to need to call this. For
      * a Func with an update definition, that means it gets computed
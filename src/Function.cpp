@@ -927,6 +927,12 @@ void Function::lock_loop_levels() {
     if (schedule.store_level().is_inlined()) {
         schedule.store_level() = schedule.compute_level();
     }
+    // Similarly, storage is hoisted no further than the store_level
+    // by default.
+    schedule.hoist_storage_level().lock();
+    if (schedule.hoist_storage_level().is_inlined()) {
+        schedule.hoist_storage_level() = schedule.store_level();
+    }
     if (contents->init_def.defined()) {
         contents->init_def.schedule().fuse_level().level.lock();
     }
@@ -1,5 +1,6 @@
 #include <cmath>
 #include <fstream>
+#include <sstream>
 #include <unordered_map>
 
 #if defined(_MSC_VER) && !defined(NOMINMAX)
@@ -811,6 +812,7 @@ int generate_filter_main_inner(int argc, char **argv, std::ostream &cerr) {
         "gengen \n"
         "  [-g GENERATOR_NAME] [-f FUNCTION_NAME] [-o OUTPUT_DIR] [-r RUNTIME_NAME]\n"
         "  [-e EMIT_OPTIONS] [-x EXTENSION_OPTIONS] [-n FILE_BASE_NAME] [-p PLUGIN_NAME]\n"
+        "  [-j JOBS]\n"
         "       target=target-string[,target-string...] [generator_arg=value [...]]\n"
         "\n"
         " -e  A comma separated list of files to emit. Accepted values are:\n"
@@ -826,6 +828,11 @@ int generate_filter_main_inner(int argc, char **argv, std::ostream &cerr) {
         "     either be linked against a shared libHalide or compiled with -rdynamic\n"
         "     so that references in the shared library to libHalide can resolve.\n"
         "\n"
+        " -j  The maximum number of targets to generate code for concurrently when\n"
+        "     multiple targets are specified. Defaults to 1, which generates them one\n"
+        "     at a time; 0 means the number of host cores. The output is the same for\n"
+        "     any number of jobs.\n"
+        "\n"
         "-r   The name of a standalone runtime to generate. Only honors EMIT_OPTIONS 'o'\n"
         "     and 'static_library'. When multiple targets are specified, it picks a\n"
         "     runtime that is compatible with all of the targets, or fails if it cannot\n"
@@ -840,7 +847,8 @@ int generate_filter_main_inner(int argc, char **argv, std::ostream &cerr) {
                                                       { "-n", "" },
                                                       { "-x", "" },
                                                       { "-r", "" },
-                                                      { "-p", "" }};
+                                                      { "-p", "" },
+                                                      { "-j", "" }};
     GeneratorParamsMap generator_args;
 
     for (int i = 1; i < argc; ++i) {
@@ -1015,6 +1023,16 @@ int generate_filter_main_inner(int argc, char **argv, std::ostream &cerr) {
         emit_options.substitutions[subst_pair[0]] = subst_pair[1];
     }
 
+    int jobs = 1;
+    if (!flags_info["-j"].empty()) {
+        std::istringstream iss(flags_info["-j"]);
+        if (!(iss >> jobs) || !iss.eof() || jobs < 0) {
+            cerr << "Malformed -j option: " << flags_info["-j"] << "\n";
+            cerr << kUsage;
+            return 1;
+        }
+    }
+
     auto target_strings = split_string(generator_args["target"].string_value, ",");
     std::vector<Target> targets;
     for (const auto &s : target_strings) {
@@ -1065,7 +1083,7 @@ int generate_filter_main_inner(int argc, char **argv, std::ostream &cerr) {
                     return gen->build_module(name);
                 };
             if (targets.size() > 1 || !emit_options.substitutions.empty()) {
-                compile_multitarget(function_name, output_files, targets, module_producer, emit_options.substitutions);
+                compile_multitarget(function_name, output_files, targets, module_producer, emit_options.substitutions, jobs);
             } else {
                 user_assert(emit_options.substitutions.empty()) << "substitutions not supported for single-target";
                 // compile_multitarget() will fail if we request anything but library and/or header,
@@ -954,6 +954,12 @@ Stmt inject_hexagon_rpc(Stmt s, const Target &host_target,
             target = target.with_feature(i);
         }
     }
+    // The device has no hardware counters to read, but profile_hw
+    // still profiles the pipeline, including the device code, so the
+    // device runtime needs the profiler.
+    if (host_target.has_feature(Target::ProfileHW)) {
+        target = target.with_feature(Target::Profile);
+    }
 
     Module shared_runtime(runtime_module_name, target);
     Module hexagon_module(pipeline_module_name, target.with_feature(Target::NoRuntime));
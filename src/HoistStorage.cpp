@@ -0,0 +1,273 @@
+#include "HoistStorage.h"
+#include "Bounds.h"
+#include "ExprUsesVar.h"
+#include "Function.h"
+#include "IRMutator.h"
+#include "IROperator.h"
+#include "Scope.h"
+#include "Simplify.h"
+
+#include <set>
+
+namespace Halide {
+namespace Internal {
+
+using std::map;
+using std::set;
+using std::string;
+using std::vector;
+
+namespace {
+
+// The type and bounded size of an allocation that has been removed
+// from a loop body and needs to be reinjected further out.
+struct HoistedAllocation {
+    Type type;
+    MemoryType memory_type;
+    vector<Expr> extents;
+    string free_function;
+    // If defined, a check that the allocation isn't too large, to be
+    // made before it.
+    Stmt size_check;
+};
+
+// Remove the named allocations from a Stmt, recording an upper bound
+// on their sizes over every iteration of the loops enclosing them
+// within that Stmt.
+class ExtractAllocations : public IRMutator {
+    using IRMutator::visit;
+
+    const set<string> &names;
+
+    // The bounds of the loop variables and lets defined inside the
+    // Stmt, in terms of the variables defined outside it.
+    Scope<Interval> scope;
+
+    // The innermost loop that isn't serial, if any.
+    string non_serial_loop;
+
+    Interval bounds_of(const Expr &e) {
+        if (e.type().is_handle()) {
+            return Interval::everything();
+        }
+        return bounds_of_expr_in_scope(e, scope);
+    }
+
+    template<typename T, typename Body>
+    Body visit_let(const T *op) {
+        // Visit an entire chain of lets in a single method to conserve stack space.
+        struct Frame {
+            const T *op;
+            ScopedBinding<Interval> binding;
+            Frame(const T *op, Scope<Interval> &scope, const Interval &b) :
+                op(op),
+                binding(scope, op->name, b) {}
+        };
+        std::vector<Frame> frames;
+        Body result;
+
+        do {
+            result = op->body;
+            frames.emplace_back(op, scope, bounds_of(op->value));
+        } while ((op = result.template as<T>()));
+
+        result = mutate(result);
+
+        for (auto it = frames.rbegin(); it != frames.rend(); it++) {
+            result = T::make(it->op->name, it->op->value, result);
+        }
+
+        return result;
+    }
+
+    Stmt visit(const LetStmt *op) override {
+        return visit_let<LetStmt, Stmt>(op);
+    }
+
+    Expr visit(const Let *op) override {
+        return visit_let<Let, Expr>(op);
+    }
+
+    Stmt visit(const For *op) override {
+        Interval min_bounds = bounds_of(op->min);
+        Interval max_bounds = bounds_of(op->min + op->extent - 1);
+        ScopedBinding<Interval> bind(scope, op->name, Interval::make_union(min_bounds, max_bounds));
+        bool serial = (op->for_type == ForType::Serial ||
+                       op->for_type == ForType::Unrolled);
+        ScopedValue<string> old_non_serial_loop(non_serial_loop,
+                                                serial ? non_serial_loop : op->name);
+        return IRMutator::visit(op);
+    }
+
+    Stmt visit(const Allocate *op) override {
+        if (!names.count(op->name)) {
+            return IRMutator::visit(op);
+        }
+
+        user_assert(non_serial_loop.empty())
+            << "Can't hoist the storage of " << op->name
+            << " out of the loop " << non_serial_loop
+            << ", because it is not serial.\n";
+        user_assert(!op->new_expr.defined())
+            << "Can't hoist the storage of " << op->name
+            << ", because it uses a custom allocation. "
+            << "Storage of memoized Funcs can't be hoisted.\n";
+
+        vector<Expr> extents;
+        for (const Expr &e : op->extents) {
+            Interval b = bounds_of(e);
+            user_assert(b.has_upper_bound() && !expr_uses_vars(b.max, scope))
+                << "Can't hoist the storage of " << op->name
+                << ", because its extent " << e
+                << " has no upper bound outside the loops it is hoisted out of.\n";
+            extents.push_back(simplify(b.max));
+        }
+
+        auto it = allocations.find(op->name);
+        if (it == allocations.end()) {
+            allocations[op->name] = {op->type, op->memory_type, extents, op->free_function, Stmt()};
+        } else {
+            // The Func has more than one allocation inside the loop,
+            // e.g. one per specialization. Make a flat allocation
+            // large enough for any of them.
+            Expr old_size = make_const(Int(64), 1), new_size = make_const(Int(64), 1);
+            for (const Expr &e : it->second.extents) {
+                old_size *= cast<int64_t>(e);
+            }
+            for (const Expr &e : extents) {
+                new_size *= cast<int64_t>(e);
+            }
+            // The size must fit in the single int32 extent.
+            Expr size = simplify(max(old_size, new_size));
+            if (const int64_t *c = as_const_int(size)) {
+                user_assert(*c >= 0 && *c < (int64_t)1 << 31)
+                    << "Allocation " << op->name << " has a size greater than 2^31: " << size << "\n";
+                it->second.size_check = Stmt();
+            } else {
+                Expr max_size = make_const(Int(64), ((int64_t)1 << 31) - 1);
+                Expr error = Call::make(Int(32), "halide_error_buffer_allocation_too_large",
+                                        {op->name, cast<uint64_t>(size), cast<uint64_t>(max_size)},
+                                        Call::Extern);
+                it->second.size_check = AssertStmt::make(size <= max_size, error);
+            }
+            it->second.extents = {cast<int32_t>(size)};
+        }
+
+        return mutate(op->body);
+    }
+
+public:
+    map<string, HoistedAllocation> allocations;
+
+    ExtractAllocations(const set<string> &names) : names(names) {}
+};
+
+// Find the loop level each allocation is hoisted to, and move the
+// allocations there.
+class HoistStorage : public IRMutator {
+    using IRMutator::visit;
+
+    // The allocations of each Func with a hoist level outside its
+    // store level.
+    const map<string, vector<string>> &allocation_names;
+
+    const map<string, Function> &env;
+
+    Stmt visit(const For *op) override {
+        Stmt body = mutate(op->body);
+
+        set<string> names;
+        for (const auto &p : allocation_names) {
+            const LoopLevel &level = env.find(p.first)->second.schedule().hoist_storage_level();
+            if (!level.is_root() && level.match(op->name)) {
+                names.insert(p.second.begin(), p.second.end());
+            }
+        }
+
+        if (!names.empty()) {
+            body = hoist_into(body, names);
+        }
+
+        if (body.same_as(op->body)) {
+            return op;
+        } else {
+            return For::make(op->name, op->min, op->extent, op->for_type, op->device_api, body);
+        }
+    }
+
+public:
+    set<string> hoisted;
+
+    Stmt hoist_into(const Stmt &s, const set<string> &names) {
+        ExtractAllocations extractor(names);
+        Stmt result = extractor.mutate(s);
+        for (const auto &p : extractor.allocations) {
+            const HoistedAllocation &a = p.second;
+            result = Allocate::make(p.first, a.type, a.memory_type, a.extents, const_true(),
+                                    result, Expr(), a.free_function);
+            if (a.size_check.defined()) {
+                result = Block::make(a.size_check, result);
+            }
+            hoisted.insert(p.first);
+        }
+        return result;
+    }
+
+    HoistStorage(const map<string, vector<string>> &allocation_names,
+                 const map<string, Function> &env)
+        : allocation_names(allocation_names), env(env) {}
+};
+
+}  // namespace
+
+Stmt hoist_storage(const Stmt &s, const map<string, Function> &env) {
+    // Find the Funcs whose storage should be hoisted, and the names
+    // of their allocations after tuples have been split.
+    map<string, vector<string>> allocation_names;
+    set<string> root_names;
+    for (const auto &p : env) {
+        const Function &f = p.second;
+        const FuncSchedule &sched = f.schedule();
+        if (sched.hoist_storage_level() == sched.store_level()) {
+            continue;
+        }
+        vector<string> &names = allocation_names[f.name()];
+        if (f.outputs() == 1) {
+            names.push_back(f.name());
+        } else {
+            for (int i = 0; i < f.outputs(); i++) {
+                names.push_back(f.name() + "." + std::to_string(i));
+            }
+        }
+        if (sched.hoist_storage_level().is_root()) {
+            root_names.insert(names.begin(), names.end());
+        }
+    }
+
+    if (allocation_names.empty()) {
+        return s;
+    }
+
+    HoistStorage hoister(allocation_names, env);
+    Stmt result = hoister.mutate(s);
+    if (!root_names.empty()) {
+        result = hoister.hoist_into(result, root_names);
+    }
+
+    for (const auto &p : allocation_names) {
+        for (const string &name : p.second) {
+            if (!hoister.hoisted.count(name)) {
+                const FuncSchedule &sched = env.find(p.first)->second.schedule();
+                user_error << "Func " << p.first << " has its storage hoisted to "
+                           << sched.hoist_storage_level().to_string()
+                           << ", which is not at or outside its store level "
+                           << sched.store_level().to_string() << ".\n";
+            }
+        }
+    }
+
+    return result;
+}
+
+}  // namespace Internal
+}  // namespace Halide
@@ -0,0 +1,27 @@
+#ifndef HALIDE_HOIST_STORAGE_H
+#define HALIDE_HOIST_STORAGE_H
+
+/** \file
+ * Defines the lowering pass that hoists allocations out to the loop
+ * level given by Func::hoist_storage
+ */
+
+#include <map>
+
+#include "IR.h"
+
+namespace Halide {
+namespace Internal {
+
+class Function;
+
+/** Move each allocation of a Func with a hoist_storage level out to
+ * that loop level, replacing its size with an upper bound over all
+ * iterations of the loops between the two. Should be run after
+ * storage flattening. */
+Stmt hoist_storage(const Stmt &s, const std::map<std::string, Function> &env);
+
+}  // namespace Internal
+}  // namespace Halide
+
+#endif
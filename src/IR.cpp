@@ -1,4 +1,5 @@
 #include "IR.h"
+#include "IRHashConsing.h"
 #include "IRMutator.h"
 #include "IRPrinter.h"
 #include "IRVisitor.h"
@@ -13,7 +14,7 @@ Expr Cast::make(Type t, Expr v) {
     Cast *node = new Cast;
     node->type = t;
     node->value = std::move(v);
-    return node;
+    return hash_cons(node);
 }
 
 Expr Add::make(Expr a, Expr b) {
@@ -25,7 +26,7 @@ Expr Add::make(Expr a, Expr b) {
     node->type = a.type();
     node->a = std::move(a);
     node->b = std::move(b);
-    return node;
+    return hash_cons(node);
 }
 
 Expr Sub::make(Expr a, Expr b) {
@@ -37,7 +38,7 @@ Expr Sub::make(Expr a, Expr b) {
     node->type = a.type();
     node->a = std::move(a);
     node->b = std::move(b);
-    return node;
+    return hash_cons(node);
 }
 
 Expr Mul::make(Expr a, Expr b) {
@@ -49,7 +50,7 @@ Expr Mul::make(Expr a, Expr b) {
     node->type = a.type();
     node->a = std::move(a);
     node->b = std::move(b);
-    return node;
+    return hash_cons(node);
 }
 
 Expr Div::make(Expr a, Expr b) {
@@ -61,7 +62,7 @@ Expr Div::make(Expr a, Expr b) {
     node->type = a.type();
     node->a = std::move(a);
     node->b = std::move(b);
-    return node;
+    return hash_cons(node);
 }
 
 Expr Mod::make(Expr a, Expr b) {
@@ -73,7 +74,7 @@ Expr Mod::make(Expr a, Expr b) {
     node->type = a.type();
     node->a = std::move(a);
     node->b = std::move(b);
-    return node;
+    return hash_cons(node);
 }
 
 Expr Min::make(Expr a, Expr b) {
@@ -85,7 +86,7 @@ Expr Min::make(Expr a, Expr b) {
     node->type = a.type();
     node->a = std::move(a);
     node->b = std::move(b);
-    return node;
+    return hash_cons(node);
 }
 
 Expr Max::make(Expr a, Expr b) {
@@ -97,7 +98,7 @@ Expr Max::make(Expr a, Expr b) {
     node->type = a.type();
     node->a = std::move(a);
     node->b = std::move(b);
-    return node;
+    return hash_cons(node);
 }
 
 Expr EQ::make(Expr a, Expr b) {
@@ -109,7 +110,7 @@ Expr EQ::make(Expr a, Expr b) {
     node->type = Bool(a.type().lanes());
     node->a = std::move(a);
     node->b = std::move(b);
-    return node;
+    return hash_cons(node);
 }
 
 Expr NE::make(Expr a, Expr b) {
@@ -121,7 +122,7 @@ Expr NE::make(Expr a, Expr b) {
     node->type = Bool(a.type().lanes());
     node->a = std::move(a);
     node->b = std::move(b);
-    return node;
+    return hash_cons(node);
 }
 
 Expr LT::make(Expr a, Expr b) {
@@ -133,7 +134,7 @@ Expr LT::make(Expr a, Expr b) {
     node->type = Bool(a.type().lanes());
     node->a = std::move(a);
     node->b = std::move(b);
-    return node;
+    return hash_cons(node);
 }
 
 
@@ -146,7 +147,7 @@ Expr LE::make(Expr a, Expr b) {
     node->type = Bool(a.type().lanes());
     node->a = std::move(a);
     node->b = std::move(b);
-    return node;
+    return hash_cons(node);
 }
 
 Expr GT::make(Expr a, Expr b) {
@@ -158,7 +159,7 @@ Expr GT::make(Expr a, Expr b) {
     node->type = Bool(a.type().lanes());
     node->a = std::move(a);
     node->b = std::move(b);
-    return node;
+    return hash_cons(node);
 }
 
 
@@ -171,7 +172,7 @@ Expr GE::make(Expr a, Expr b) {
     node->type = Bool(a.type().lanes());
     node->a = std::move(a);
     node->b = std::move(b);
-    return node;
+    return hash_cons(node);
 }
 
 Expr And::make(Expr a, Expr b) {
@@ -185,7 +186,7 @@ Expr And::make(Expr a, Expr b) {
     node->type = Bool(a.type().lanes());
     node->a = std::move(a);
     node->b = std::move(b);
-    return node;
+    return hash_cons(node);
 }
 
 Expr Or::make(Expr a, Expr b) {
@@ -199,7 +200,7 @@ Expr Or::make(Expr a, Expr b) {
     node->type = Bool(a.type().lanes());
     node->a = std::move(a);
     node->b = std::move(b);
-    return node;
+    return hash_cons(node);
 }
 
 Expr Not::make(Expr a) {
@@ -209,7 +210,7 @@ Expr Not::make(Expr a) {
     Not *node = new Not;
     node->type = Bool(a.type().lanes());
     node->a = std::move(a);
-    return node;
+    return hash_cons(node);
 }
 
 Expr Select::make(Expr condition, Expr true_value, Expr false_value) {
@@ -227,7 +228,7 @@ Expr Select::make(Expr condition, Expr true_value, Expr false_value) {
     node->condition = std::move(condition);
     node->true_value = std::move(true_value);
     node->false_value = std::move(false_value);
-    return node;
+    return hash_cons(node);
 }
 
 Expr Load::make(Type type, const std::string &name, Expr index, Buffer<> image, Parameter param, Expr predicate, ModulusRemainder alignment) {
@@ -245,7 +246,7 @@ Expr Load::make(Type type, const std::string &name, Expr index, Buffer<> image,
     node->image = std::move(image);
     node->param = std::move(param);
     node->alignment = alignment;
-    return node;
+    return hash_cons(node);
 }
 
 Expr Ramp::make(Expr base, Expr stride, int lanes) {
@@ -261,7 +262,7 @@ Expr Ramp::make(Expr base, Expr stride, int lanes) {
     node->base = std::move(base);
     node->stride = std::move(stride);
     node->lanes = std::move(lanes);
-    return node;
+    return hash_cons(node);
 }
 
 Expr Broadcast::make(Expr value, int lanes) {
@@ -273,7 +274,7 @@ Expr Broadcast::make(Expr value, int lanes) {
     node->type = value.type().with_lanes(lanes);
     node->value = std::move(value);
     node->lanes = lanes;
-    return node;
+    return hash_cons(node);
 }
 
 Expr Let::make(const std::string &name, Expr value, Expr body) {
@@ -285,7 +286,7 @@ Expr Let::make(const std::string &name, Expr value, Expr body) {
     node->name = name;
     node->value = std::move(value);
     node->body = std::move(body);
-    return node;
+    return hash_cons(node);
 }
 
 Stmt LetStmt::make(const std::string &name, Expr value, Stmt body) {
@@ -501,6 +502,14 @@ Stmt Prefetch::make(const std::string &name, const std::vector<Type> &types,
     return node;
 }
 
+Stmt Atomic::make(const std::string &producer_name, Stmt body) {
+    internal_assert(body.defined()) << "Atomic must have a body statement.\n";
+    Atomic *node = new Atomic;
+    node->producer_name = producer_name;
+    node->body = std::move(body);
+    return node;
+}
+
 Stmt Block::make(Stmt first, Stmt rest) {
     internal_assert(first.defined()) << "Block of undefined\n";
     internal_assert(rest.defined()) << "Block of undefined\n";
@@ -690,7 +699,7 @@ Expr Call::make(Type type, const std::string &name, const std::vector<Expr> &arg
     node->value_index = value_index;
     node->image = std::move(image);
     node->param = std::move(param);
-    return node;
+    return hash_cons(node);
 }
 
 Expr Variable::make(Type type, const std::string &name, Buffer<> image, Parameter param, ReductionDomain reduction_domain) {
@@ -701,7 +710,7 @@ Expr Variable::make(Type type, const std::string &name, Buffer<> image, Paramete
     node->image = std::move(image);
     node->param = std::move(param);
     node->reduction_domain = std::move(reduction_domain);
-    return node;
+    return hash_cons(node);
 }
 
 Expr Shuffle::make(const std::vector<Expr> &vectors,
@@ -722,7 +731,7 @@ Expr Shuffle::make(const std::vector<Expr> &vectors,
     node->type = element_ty.with_lanes((int)indices.size());
     node->vectors = vectors;
     node->indices = indices;
-    return node;
+    return hash_cons(node);
 }
 
 Expr Shuffle::make_interleave(const std::vector<Expr> &vectors) {
@@ -855,6 +864,24 @@ bool Shuffle::is_extract_element() const {
     return indices.size() == 1;
 }
 
+Expr VectorReduce::make(VectorReduce::Operator op,
+                        Expr value,
+                        int lanes) {
+    internal_assert(value.defined()) << "VectorReduce of undefined value\n";
+    internal_assert(lanes > 0) << "VectorReduce to zero lanes\n";
+    internal_assert(value.type().lanes() % lanes == 0)
+        << "VectorReduce of " << value.type().lanes() << " lanes to "
+        << lanes << " lanes, which is not a divisor\n";
+    internal_assert(value.type().is_bool() == (op == VectorReduce::And || op == VectorReduce::Or))
+        << "VectorReduce with And or Or must be of boolean vectors, and vice versa\n";
+
+    VectorReduce *node = new VectorReduce;
+    node->type = value.type().with_lanes(lanes);
+    node->op = op;
+    node->value = std::move(value);
+    return hash_cons(node);
+}
+
 template<> void ExprNode<IntImm>::accept(IRVisitor *v) const { v->visit((const IntImm *)this); }
 template<> void ExprNode<UIntImm>::accept(IRVisitor *v) const { v->visit((const UIntImm *)this); }
 template<> void ExprNode<FloatImm>::accept(IRVisitor *v) const { v->visit((const FloatImm *)this); }
@@ -883,6 +910,7 @@ template<> void ExprNode<Ramp>::accept(IRVisitor *v) const { v->visit((const Ram
 template<> void ExprNode<Broadcast>::accept(IRVisitor *v) const { v->visit((const Broadcast *)this); }
 template<> void ExprNode<Call>::accept(IRVisitor *v) const { v->visit((const Call *)this); }
 template<> void ExprNode<Shuffle>::accept(IRVisitor *v) const { v->visit((const Shuffle *)this); }
+template<> void ExprNode<VectorReduce>::accept(IRVisitor *v) const { v->visit((const VectorReduce *)this); }
 template<> void ExprNode<Let>::accept(IRVisitor *v) const { v->visit((const Let *)this); }
 template<> void StmtNode<LetStmt>::accept(IRVisitor *v) const { v->visit((const LetStmt *)this); }
 template<> void StmtNode<AssertStmt>::accept(IRVisitor *v) const { v->visit((const AssertStmt *)this); }
@@ -897,6 +925,7 @@ template<> void StmtNode<Block>::accept(IRVisitor *v) const { v->visit((const Bl
 template<> void StmtNode<IfThenElse>::accept(IRVisitor *v) const { v->visit((const IfThenElse *)this); }
 template<> void StmtNode<Evaluate>::accept(IRVisitor *v) const { v->visit((const Evaluate *)this); }
 template<> void StmtNode<Prefetch>::accept(IRVisitor *v) const { v->visit((const Prefetch *)this); }
+template<> void StmtNode<Atomic>::accept(IRVisitor *v) const { v->visit((const Atomic *)this); }
 template<> void StmtNode<Acquire>::accept(IRVisitor *v) const { v->visit((const Acquire *)this); }
 template<> void StmtNode<Fork>::accept(IRVisitor *v) const { v->visit((const Fork *)this); }
 
@@ -928,6 +957,7 @@ template<> Expr ExprNode<Ramp>::mutate_expr(IRMutator *v) const { return v->visi
 template<> Expr ExprNode<Broadcast>::mutate_expr(IRMutator *v) const { return v->visit((const Broadcast *)this); }
 template<> Expr ExprNode<Call>::mutate_expr(IRMutator *v) const { return v->visit((const Call *)this); }
 template<> Expr ExprNode<Shuffle>::mutate_expr(IRMutator *v) const { return v->visit((const Shuffle *)this); }
+template<> Expr ExprNode<VectorReduce>::mutate_expr(IRMutator *v) const { return v->visit((const VectorReduce *)this); }
 template<> Expr ExprNode<Let>::mutate_expr(IRMutator *v) const { return v->visit((const Let *)this); }
 
 template<> Stmt StmtNode<LetStmt>::mutate_stmt(IRMutator *v) const { return v->visit((const LetStmt *)this); }
@@ -943,6 +973,7 @@ template<> Stmt StmtNode<Block>::mutate_stmt(IRMutator *v) const { return v->vis
 template<> Stmt StmtNode<IfThenElse>::mutate_stmt(IRMutator *v) const { return v->visit((const IfThenElse *)this); }
 template<> Stmt StmtNode<Evaluate>::mutate_stmt(IRMutator *v) const { return v->visit((const Evaluate *)this); }
 template<> Stmt StmtNode<Prefetch>::mutate_stmt(IRMutator *v) const { return v->visit((const Prefetch *)this); }
+template<> Stmt StmtNode<Atomic>::mutate_stmt(IRMutator *v) const { return v->visit((const Atomic *)this); }
 template<> Stmt StmtNode<Acquire>::mutate_stmt(IRMutator *v) const { return v->visit((const Acquire *)this); }
 template<> Stmt StmtNode<Fork>::mutate_stmt(IRMutator *v) const { return v->visit((const Fork *)this); }
 
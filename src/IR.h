@@ -791,6 +791,30 @@ struct Shuffle : public ExprNode<Shuffle> {
     static const IRNodeType _node_type = IRNodeType::Shuffle;
 };
 
+/** Horizontally reduce a vector to a scalar or a narrower vector
+ * using the given commutative and associative operator. Lane i of the
+ * result is the reduction of the i'th contiguous group of
+ * value.lanes() / lanes input lanes. The order in which the lanes of
+ * a group are combined is unspecified, so floating point reductions
+ * may round differently than a serial loop. */
+struct VectorReduce : public ExprNode<VectorReduce> {
+    typedef enum {
+        Add,
+        Mul,
+        Min,
+        Max,
+        And,
+        Or,
+    } Operator;
+
+    Expr value;
+    Operator op;
+
+    static Expr make(Operator op, Expr value, int lanes);
+
+    static const IRNodeType _node_type = IRNodeType::VectorReduce;
+};
+
 /** Represent a multi-dimensional region of a Func or an ImageParam that
  * needs to be prefetched. */
 struct Prefetch : public StmtNode<Prefetch> {
@@ -810,6 +834,20 @@ struct Prefetch : public StmtNode<Prefetch> {
     static const IRNodeType _node_type = IRNodeType::Prefetch;
 };
 
+/** Lock all the Store nodes in the body statement. Each Store inside
+ * is an update of the site it stores to, and is done atomically with
+ * respect to the other stores to that buffer, e.g. with an atomic
+ * read-modify-write instruction or a compare-and-swap loop. The
+ * producer_name is the Func whose stores are being made atomic. */
+struct Atomic : public StmtNode<Atomic> {
+    std::string producer_name;
+    Stmt body;
+
+    static Stmt make(const std::string &producer_name, Stmt body);
+
+    static const IRNodeType _node_type = IRNodeType::Atomic;
+};
+
 }  // namespace Internal
 }  // namespace Halide
 
@@ -81,6 +81,7 @@ private:
     void visit(const ProducerConsumer *) override;
     void visit(const For *) override;
     void visit(const Acquire *) override;
+    void visit(const Atomic *) override;
     void visit(const Store *) override;
     void visit(const Provide *) override;
     void visit(const Allocate *) override;
@@ -91,6 +92,7 @@ private:
     void visit(const IfThenElse *) override;
     void visit(const Evaluate *) override;
     void visit(const Shuffle *) override;
+    void visit(const VectorReduce *) override;
     void visit(const Prefetch *) override;
 };
 
@@ -439,6 +441,13 @@ void IRComparer::visit(const Acquire *op) {
     compare_stmt(s->body, op->body);
 }
 
+void IRComparer::visit(const Atomic *op) {
+    const Atomic *s = stmt.as<Atomic>();
+
+    compare_names(s->producer_name, op->producer_name);
+    compare_stmt(s->body, op->body);
+}
+
 void IRComparer::visit(const Store *op) {
     const Store *s = stmt.as<Store>();
 
@@ -532,6 +541,13 @@ void IRComparer::visit(const Shuffle *op) {
     }
 }
 
+void IRComparer::visit(const VectorReduce *op) {
+    const VectorReduce *e = expr.as<VectorReduce>();
+
+    compare_scalar(e->op, op->op);
+    compare_expr(e->value, op->value);
+}
+
 void IRComparer::visit(const Prefetch *op) {
     const Prefetch *s = stmt.as<Prefetch>();
 
@@ -0,0 +1,504 @@
+#include "IRHashConsing.h"
+
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <unordered_set>
+
+#include "Debug.h"
+#include "IR.h"
+#include "IREquality.h"
+#include "IROperator.h"
+#include "Util.h"
+
+namespace Halide {
+namespace Internal {
+
+namespace {
+
+size_t combine(size_t h, size_t v) {
+    return h ^ (v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2));
+}
+
+size_t hash_type(const Type &t) {
+    return combine(combine((size_t)t.code(), (size_t)t.bits()), (size_t)t.lanes());
+}
+
+size_t hash_ptr(const Expr &e) {
+    return std::hash<const void *>()(e.get());
+}
+
+// Hash and equality that look at the fields of a node, and at the
+// identity of its children.
+struct ShallowHash {
+    size_t operator()(const BaseExprNode *e) const {
+        size_t h = combine((size_t)e->node_type, hash_type(e->type));
+        switch (e->node_type) {
+        case IRNodeType::IntImm:
+            return combine(h, (size_t)((const IntImm *)e)->value);
+        case IRNodeType::UIntImm:
+            return combine(h, (size_t)((const UIntImm *)e)->value);
+        case IRNodeType::FloatImm: {
+            uint64_t bits;
+            double value = ((const FloatImm *)e)->value;
+            memcpy(&bits, &value, sizeof(bits));
+            return combine(h, (size_t)bits);
+        }
+        case IRNodeType::StringImm:
+            return combine(h, std::hash<std::string>()(((const StringImm *)e)->value));
+        case IRNodeType::Broadcast:
+            return combine(h, hash_ptr(((const Broadcast *)e)->value));
+        case IRNodeType::Cast:
+            return combine(h, hash_ptr(((const Cast *)e)->value));
+        case IRNodeType::Variable:
+            return combine(h, std::hash<std::string>()(((const Variable *)e)->name));
+        case IRNodeType::Add:
+            return combine(combine(h, hash_ptr(((const Add *)e)->a)), hash_ptr(((const Add *)e)->b));
+        case IRNodeType::Sub:
+            return combine(combine(h, hash_ptr(((const Sub *)e)->a)), hash_ptr(((const Sub *)e)->b));
+        case IRNodeType::Mod:
+            return combine(combine(h, hash_ptr(((const Mod *)e)->a)), hash_ptr(((const Mod *)e)->b));
+        case IRNodeType::Mul:
+            return combine(combine(h, hash_ptr(((const Mul *)e)->a)), hash_ptr(((const Mul *)e)->b));
+        case IRNodeType::Div:
+            return combine(combine(h, hash_ptr(((const Div *)e)->a)), hash_ptr(((const Div *)e)->b));
+        case IRNodeType::Min:
+            return combine(combine(h, hash_ptr(((const Min *)e)->a)), hash_ptr(((const Min *)e)->b));
+        case IRNodeType::Max:
+            return combine(combine(h, hash_ptr(((const Max *)e)->a)), hash_ptr(((const Max *)e)->b));
+        case IRNodeType::EQ:
+            return combine(combine(h, hash_ptr(((const EQ *)e)->a)), hash_ptr(((const EQ *)e)->b));
+        case IRNodeType::NE:
+            return combine(combine(h, hash_ptr(((const NE *)e)->a)), hash_ptr(((const NE *)e)->b));
+        case IRNodeType::LT:
+            return combine(combine(h, hash_ptr(((const LT *)e)->a)), hash_ptr(((const LT *)e)->b));
+        case IRNodeType::LE:
+            return combine(combine(h, hash_ptr(((const LE *)e)->a)), hash_ptr(((const LE *)e)->b));
+        case IRNodeType::GT:
+            return combine(combine(h, hash_ptr(((const GT *)e)->a)), hash_ptr(((const GT *)e)->b));
+        case IRNodeType::GE:
+            return combine(combine(h, hash_ptr(((const GE *)e)->a)), hash_ptr(((const GE *)e)->b));
+        case IRNodeType::And:
+            return combine(combine(h, hash_ptr(((const And *)e)->a)), hash_ptr(((const And *)e)->b));
+        case IRNodeType::Or:
+            return combine(combine(h, hash_ptr(((const Or *)e)->a)), hash_ptr(((const Or *)e)->b));
+        case IRNodeType::Not:
+            return combine(h, hash_ptr(((const Not *)e)->a));
+        case IRNodeType::Select: {
+            const Select *op = (const Select *)e;
+            return combine(combine(combine(h, hash_ptr(op->condition)), hash_ptr(op->true_value)), hash_ptr(op->false_value));
+        }
+        case IRNodeType::Load: {
+            const Load *op = (const Load *)e;
+            h = combine(h, std::hash<std::string>()(op->name));
+            return combine(combine(h, hash_ptr(op->index)), hash_ptr(op->predicate));
+        }
+        case IRNodeType::Ramp:
+            return combine(combine(h, hash_ptr(((const Ramp *)e)->base)), hash_ptr(((const Ramp *)e)->stride));
+        case IRNodeType::Call: {
+            const Call *op = (const Call *)e;
+            h = combine(combine(h, std::hash<std::string>()(op->name)), (size_t)op->call_type);
+            for (const Expr &arg : op->args) {
+                h = combine(h, hash_ptr(arg));
+            }
+            return h;
+        }
+        case IRNodeType::Let: {
+            const Let *op = (const Let *)e;
+            h = combine(h, std::hash<std::string>()(op->name));
+            return combine(combine(h, hash_ptr(op->value)), hash_ptr(op->body));
+        }
+        case IRNodeType::Shuffle: {
+            const Shuffle *op = (const Shuffle *)e;
+            for (const Expr &v : op->vectors) {
+                h = combine(h, hash_ptr(v));
+            }
+            for (int i : op->indices) {
+                h = combine(h, (size_t)i);
+            }
+            return h;
+        }
+        case IRNodeType::VectorReduce:
+            return combine(combine(h, (size_t)((const VectorReduce *)e)->op), hash_ptr(((const VectorReduce *)e)->value));
+        default:
+            internal_error << "Unexpected node type in hash-consing\n";
+            return h;
+        }
+    }
+};
+
+template<typename T>
+bool shallow_equal_binary(const BaseExprNode *a, const BaseExprNode *b) {
+    const T *x = (const T *)a, *y = (const T *)b;
+    return x->a.same_as(y->a) && x->b.same_as(y->b);
+}
+
+bool same_exprs(const std::vector<Expr> &a, const std::vector<Expr> &b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+        if (!a[i].same_as(b[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+struct ShallowEqual {
+    bool operator()(const BaseExprNode *a, const BaseExprNode *b) const {
+        if (a == b) {
+            return true;
+        }
+        if (a->node_type != b->node_type || a->type != b->type) {
+            return false;
+        }
+        switch (a->node_type) {
+        case IRNodeType::IntImm:
+            return ((const IntImm *)a)->value == ((const IntImm *)b)->value;
+        case IRNodeType::UIntImm:
+            return ((const UIntImm *)a)->value == ((const UIntImm *)b)->value;
+        case IRNodeType::FloatImm: {
+            // Compare bit patterns, so that 0.0 and -0.0 (and NaNs)
+            // aren't mixed up.
+            double x = ((const FloatImm *)a)->value, y = ((const FloatImm *)b)->value;
+            return memcmp(&x, &y, sizeof(double)) == 0;
+        }
+        case IRNodeType::StringImm:
+            return ((const StringImm *)a)->value == ((const StringImm *)b)->value;
+        case IRNodeType::Broadcast:
+            return ((const Broadcast *)a)->value.same_as(((const Broadcast *)b)->value);
+        case IRNodeType::Cast:
+            return ((const Cast *)a)->value.same_as(((const Cast *)b)->value);
+        case IRNodeType::Variable: {
+            const Variable *x = (const Variable *)a, *y = (const Variable *)b;
+            Buffer<> x_image = x->image, y_image = y->image;
+            return (x->name == y->name &&
+                    x->param.same_as(y->param) &&
+                    x_image.same_as(y_image) &&
+                    x->reduction_domain.same_as(y->reduction_domain));
+        }
+        case IRNodeType::Add:
+            return shallow_equal_binary<Add>(a, b);
+        case IRNodeType::Sub:
+            return shallow_equal_binary<Sub>(a, b);
+        case IRNodeType::Mod:
+            return shallow_equal_binary<Mod>(a, b);
+        case IRNodeType::Mul:
+            return shallow_equal_binary<Mul>(a, b);
+        case IRNodeType::Div:
+            return shallow_equal_binary<Div>(a, b);
+        case IRNodeType::Min:
+            return shallow_equal_binary<Min>(a, b);
+        case IRNodeType::Max:
+            return shallow_equal_binary<Max>(a, b);
+        case IRNodeType::EQ:
+            return shallow_equal_binary<EQ>(a, b);
+        case IRNodeType::NE:
+            return shallow_equal_binary<NE>(a, b);
+        case IRNodeType::LT:
+            return shallow_equal_binary<LT>(a, b);
+        case IRNodeType::LE:
+            return shallow_equal_binary<LE>(a, b);
+        case IRNodeType::GT:
+            return shallow_equal_binary<GT>(a, b);
+        case IRNodeType::GE:
+            return shallow_equal_binary<GE>(a, b);
+        case IRNodeType::And:
+            return shallow_equal_binary<And>(a, b);
+        case IRNodeType::Or:
+            return shallow_equal_binary<Or>(a, b);
+        case IRNodeType::Not:
+            return ((const Not *)a)->a.same_as(((const Not *)b)->a);
+        case IRNodeType::Select: {
+            const Select *x = (const Select *)a, *y = (const Select *)b;
+            return (x->condition.same_as(y->condition) &&
+                    x->true_value.same_as(y->true_value) &&
+                    x->false_value.same_as(y->false_value));
+        }
+        case IRNodeType::Load: {
+            const Load *x = (const Load *)a, *y = (const Load *)b;
+            Buffer<> x_image = x->image, y_image = y->image;
+            return (x->name == y->name &&
+                    x->index.same_as(y->index) &&
+                    x->predicate.same_as(y->predicate) &&
+                    x->param.same_as(y->param) &&
+                    x_image.same_as(y_image) &&
+                    x->alignment.modulus == y->alignment.modulus &&
+                    x->alignment.remainder == y->alignment.remainder);
+        }
+        case IRNodeType::Ramp: {
+            const Ramp *x = (const Ramp *)a, *y = (const Ramp *)b;
+            return x->base.same_as(y->base) && x->stride.same_as(y->stride);
+        }
+        case IRNodeType::Call: {
+            const Call *x = (const Call *)a, *y = (const Call *)b;
+            Buffer<> x_image = x->image, y_image = y->image;
+            return (x->name == y->name &&
+                    x->call_type == y->call_type &&
+                    x->value_index == y->value_index &&
+                    x->param.same_as(y->param) &&
+                    x_image.same_as(y_image) &&
+                    same_exprs(x->args, y->args));
+        }
+        case IRNodeType::Let: {
+            const Let *x = (const Let *)a, *y = (const Let *)b;
+            return x->name == y->name && x->value.same_as(y->value) && x->body.same_as(y->body);
+        }
+        case IRNodeType::Shuffle: {
+            const Shuffle *x = (const Shuffle *)a, *y = (const Shuffle *)b;
+            return x->indices == y->indices && same_exprs(x->vectors, y->vectors);
+        }
+        case IRNodeType::VectorReduce: {
+            const VectorReduce *x = (const VectorReduce *)a, *y = (const VectorReduce *)b;
+            return x->op == y->op && x->value.same_as(y->value);
+        }
+        default:
+            internal_error << "Unexpected node type in hash-consing\n";
+            return false;
+        }
+    }
+};
+
+bool is_leaf(const BaseExprNode *e) {
+    return (e->node_type == IRNodeType::IntImm ||
+            e->node_type == IRNodeType::UIntImm ||
+            e->node_type == IRNodeType::FloatImm ||
+            e->node_type == IRNodeType::StringImm);
+}
+
+}  // namespace
+
+// There is a single table, shared by every thread in a hash-consing
+// scope, which holds non-owning pointers to the canonical nodes. A
+// canonical node removes itself from the table when it's destroyed
+// (see destroy<IRNode>), so a node is only shared while something
+// still refers to it. Constants are the exception: they are few,
+// small, and often made as raw pointers (e.g. IntImm::make) that
+// aren't owned by anything yet, so the table owns them until the last
+// scope closes.
+//
+// The table is split into shards by hash, each with its own lock, so
+// that threads lowering in parallel rarely wait on each other.
+struct HashConsTable {
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_set<const BaseExprNode *, ShallowHash, ShallowEqual> nodes;
+        std::vector<Expr> constants;
+    };
+    static const int num_shards = 64;
+    Shard shards[num_shards];
+
+    Shard &shard_for(const BaseExprNode *node) {
+        return shards[ShallowHash()(node) % num_shards];
+    }
+
+    // Guards opening and closing scopes.
+    std::mutex scopes_mutex;
+    int scopes = 0;
+
+    // Whether any scope is open. Only cleared once the shards have
+    // been emptied, so a node destroyed while it's false can't still
+    // be in the table.
+    std::atomic<bool> active{false};
+};
+
+namespace {
+
+HashConsTable &the_table() {
+    static HashConsTable *table = new HashConsTable;
+    return *table;
+}
+
+// The number of hash-consing scopes open on this thread.
+thread_local int scopes_on_this_thread = 0;
+
+}  // namespace
+
+namespace {
+
+// Return the canonical node structurally equal to the given new node,
+// adding the new node to the shard if there isn't one. Must hold the
+// shard's mutex, and the caller must own a reference to the new node.
+const BaseExprNode *find_or_insert(HashConsTable::Shard &shard, const BaseExprNode *node) {
+    auto it = shard.nodes.find(node);
+    if (it != shard.nodes.end()) {
+        const BaseExprNode *existing = *it;
+        // The existing node may be in the middle of being destroyed
+        // on another thread, in which case its reference count has
+        // already reached zero. Only reuse it if it's still alive.
+        if (is_leaf(existing) || existing->ref_count.increment_if_nonzero()) {
+            return existing;
+        }
+        shard.nodes.erase(it);
+    }
+    shard.nodes.insert(node);
+    if (is_leaf(node)) {
+        shard.constants.emplace_back(node);
+    } else {
+        node->hash_consed = true;
+        node->ref_count.increment();
+    }
+    return node;
+}
+
+}  // namespace
+
+Expr hash_cons(const BaseExprNode *node) {
+    if (scopes_on_this_thread == 0) {
+        return Expr(node);
+    }
+    if (node->node_type == IRNodeType::Call) {
+        const Call *c = (const Call *)node;
+        if (!c->is_pure() || c->func.defined()) {
+            return Expr(node);
+        }
+    }
+
+    // Take ownership of the new node, so that it's freed if an
+    // existing one is used instead.
+    Expr fresh(node);
+    HashConsTable::Shard &shard = the_table().shard_for(node);
+    const BaseExprNode *result;
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        result = find_or_insert(shard, node);
+    }
+    if (is_leaf(result)) {
+        return Expr(result);
+    }
+    // find_or_insert took a reference to keep the result alive
+    // outside the lock. Hand it over to the Expr.
+    Expr e(result);
+    result->ref_count.decrement();
+    return e;
+}
+
+const BaseExprNode *hash_cons_constant(const BaseExprNode *node) {
+    if (scopes_on_this_thread == 0) {
+        return node;
+    }
+    // Constants are owned by the table until the last scope closes,
+    // so the raw pointer returned stays valid until the caller wraps
+    // it.
+    Expr fresh(node);
+    HashConsTable::Shard &shard = the_table().shard_for(node);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return find_or_insert(shard, node);
+}
+
+void forget_hash_consed_node(const IRNode *node) {
+    HashConsTable &table = the_table();
+    // Nodes keep their flag after the last scope closes, but the table
+    // was emptied then, so there's nothing to remove.
+    if (!table.active.load(std::memory_order_acquire)) {
+        return;
+    }
+    const BaseExprNode *e = (const BaseExprNode *)node;
+    HashConsTable::Shard &shard = table.shard_for(e);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.nodes.find(e);
+    if (it != shard.nodes.end() && *it == e) {
+        shard.nodes.erase(it);
+    }
+}
+
+ScopedHashConsing::ScopedHashConsing(bool enabled) {
+    if (!enabled) {
+        return;
+    }
+    table = &the_table();
+    std::lock_guard<std::mutex> lock(table->scopes_mutex);
+    if (table->scopes++ == 0) {
+        table->active.store(true, std::memory_order_release);
+    }
+    scopes_on_this_thread++;
+}
+
+ScopedHashConsing::~ScopedHashConsing() {
+    if (!table) {
+        return;
+    }
+    std::vector<Expr> constants;
+    {
+        std::lock_guard<std::mutex> lock(table->scopes_mutex);
+        scopes_on_this_thread--;
+        if (--table->scopes == 0) {
+            // Nodes still flagged as hash-consed will find that the
+            // table is inactive when they're destroyed.
+            for (HashConsTable::Shard &shard : table->shards) {
+                std::lock_guard<std::mutex> shard_lock(shard.mutex);
+                shard.nodes.clear();
+                constants.insert(constants.end(), shard.constants.begin(), shard.constants.end());
+                shard.constants.clear();
+            }
+            table->active.store(false, std::memory_order_release);
+        }
+    }
+    // Release the constants outside the locks.
+}
+
+bool hash_consing_requested() {
+    return get_env_variable("HL_HASH_CONS_IR") == "1";
+}
+
+size_t hash_consed_node_count() {
+    if (scopes_on_this_thread == 0) {
+        return 0;
+    }
+    HashConsTable &table = the_table();
+    size_t count = 0;
+    for (HashConsTable::Shard &shard : table.shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        count += shard.nodes.size();
+    }
+    return count;
+}
+
+void hash_consing_test() {
+    Expr x = Variable::make(Int(32), "x");
+    Expr e1, e2, e3;
+    {
+        ScopedHashConsing hash_consing;
+        Expr y = Variable::make(Int(32), "x");
+        internal_assert(!x.same_as(y)) << "Node made outside the scope was hash-consed\n";
+
+        e1 = (y * 2 + 3) * (y * 2 + 3);
+        e2 = (y * 2 + 3) * (y * 2 + 3);
+        internal_assert(e1.same_as(e2)) << "Identical Exprs were not shared: " << e1 << " " << e2 << "\n";
+        const Mul *m = e1.as<Mul>();
+        internal_assert(m && m->a.same_as(m->b)) << "Identical subexpressions were not shared\n";
+
+        // Different types, different constants.
+        internal_assert(!make_const(Int(16), 3).same_as(make_const(Int(32), 3)));
+        internal_assert(!Expr(0.0f).same_as(Expr(-0.0f)));
+
+        // Impure calls stay distinct.
+        Expr r1 = Call::make(Int(32), "an_impure_extern", {y}, Call::Extern);
+        Expr r2 = Call::make(Int(32), "an_impure_extern", {y}, Call::Extern);
+        internal_assert(!r1.same_as(r2)) << "Impure calls were shared\n";
+
+        // A node that is no longer referred to leaves the table, and
+        // making it again gives a fresh node.
+        Expr k = 12345;
+        size_t before = hash_consed_node_count();
+        {
+            Expr tmp = y * k;
+        }
+        internal_assert(hash_consed_node_count() == before) << "Dead node stayed in the table\n";
+
+        e3 = y * 2 + 3;
+    }
+    // Still valid and still shared after the scope closes.
+    internal_assert(equal(e1, (x * 2 + 3) * (x * 2 + 3)));
+    internal_assert(e1.as<Mul>()->a.same_as(e3));
+    internal_assert(hash_consed_node_count() == 0);
+
+    // Outside the scope, identical Exprs are distinct nodes again.
+    internal_assert(!(x + 1).same_as(x + 1));
+
+    debug(0) << "hash_consing_test passed\n";
+}
+
+}  // namespace Internal
+}  // namespace Halide
@@ -0,0 +1,62 @@
+#ifndef HALIDE_IR_HASH_CONSING_H
+#define HALIDE_IR_HASH_CONSING_H
+
+/** \file
+ * Defines a mode in which structurally identical Exprs share a single
+ * IR node.
+ */
+
+#include "Expr.h"
+
+namespace Halide {
+namespace Internal {
+
+struct HashConsTable;
+
+/** While an object of this type with enabled set to true is alive,
+ * the ::make functions of Expr nodes on this thread return an
+ * existing node when one with the same type, fields, and children
+ * (compared by pointer) has already been made. Since children are
+ * hash-consed first, structurally equal Exprs made in this mode are
+ * the same node, so comparing them is a pointer comparison, and
+ * passes that number Exprs by identity, such as CSE, see the sharing
+ * for free.
+ *
+ * Calls that are not pure, and calls to Halide Funcs, are never
+ * shared. There is one table, shared by all threads with a scope
+ * open, and it holds non-owning pointers: a node is only shared while
+ * something else still refers to it, and removes itself from the
+ * table when it is destroyed (see destroy<IRNode>). Only constants
+ * are owned by the table, until the last open scope closes.
+ * Constructing one with enabled set to false does nothing. */
+class ScopedHashConsing {
+    HashConsTable *table = nullptr;
+
+public:
+    ScopedHashConsing(bool enabled = true);
+    ~ScopedHashConsing();
+
+    ScopedHashConsing(const ScopedHashConsing &) = delete;
+    ScopedHashConsing &operator=(const ScopedHashConsing &) = delete;
+};
+
+/** Called by the ::make functions of Expr nodes other than constants
+ * with the node they just made. Returns the canonical node for its
+ * structure if hash-consing is enabled on this thread, deleting the
+ * new node if it isn't it, and otherwise returns the new node. */
+Expr hash_cons(const BaseExprNode *node);
+
+/** Whether the environment variable HL_HASH_CONS_IR asks for lowering
+ * to be done with hash-consing enabled. */
+bool hash_consing_requested();
+
+/** The number of nodes in the hash-consing table, or zero if
+ * hash-consing isn't enabled on this thread. */
+size_t hash_consed_node_count();
+
+void hash_consing_test();
+
+}  // namespace Internal
+}  // namespace Halide
+
+#endif
@@ -330,6 +330,14 @@ Expr IRMutator::visit(const Shuffle *op) {
     return Shuffle::make(new_vectors, op->indices);
 }
 
+Expr IRMutator::visit(const VectorReduce *op) {
+    Expr value = mutate(op->value);
+    if (value.same_as(op->value)) {
+        return op;
+    }
+    return VectorReduce::make(op->op, std::move(value), op->type.lanes());
+}
+
 Stmt IRMutator::visit(const Fork *op) {
     Stmt first = mutate(op->first);
     Stmt rest = mutate(op->rest);
@@ -354,6 +362,15 @@ Stmt IRMutator::visit(const Acquire *op) {
     }
 }
 
+Stmt IRMutator::visit(const Atomic *op) {
+    Stmt body = mutate(op->body);
+    if (body.same_as(op->body)) {
+        return op;
+    } else {
+        return Atomic::make(op->producer_name, std::move(body));
+    }
+}
+
 Stmt IRGraphMutator::mutate(const Stmt &s) {
     auto p = stmt_replacements.emplace(s, Stmt());
     if (p.second) {
@@ -844,6 +844,117 @@ Stmt remove_likelies(Stmt s) {
     return RemoveLikelies().mutate(s);
 }
 
+Expr vector_reduce_binop(VectorReduce::Operator op, Expr a, Expr b) {
+    switch (op) {
+    case VectorReduce::Add:
+        return Add::make(std::move(a), std::move(b));
+    case VectorReduce::Mul:
+        return Mul::make(std::move(a), std::move(b));
+    case VectorReduce::Min:
+        return Min::make(std::move(a), std::move(b));
+    case VectorReduce::Max:
+        return Max::make(std::move(a), std::move(b));
+    case VectorReduce::And:
+        return And::make(std::move(a), std::move(b));
+    case VectorReduce::Or:
+        return Or::make(std::move(a), std::move(b));
+    }
+    return Expr();
+}
+
+Expr vector_reduce_identity(VectorReduce::Operator op, Type t) {
+    switch (op) {
+    case VectorReduce::Add:
+        return make_zero(t);
+    case VectorReduce::Mul:
+        return make_one(t);
+    case VectorReduce::Min:
+        return t.max();
+    case VectorReduce::Max:
+        return t.min();
+    case VectorReduce::And:
+        return make_const(t, 1);
+    case VectorReduce::Or:
+        return make_const(t, 0);
+    }
+    return Expr();
+}
+
+namespace {
+
+class LoadsFromBuffer : public IRVisitor {
+    using IRVisitor::visit;
+
+    void visit(const Load *op) override {
+        if (op->name == buffer) {
+            result = true;
+        } else {
+            IRVisitor::visit(op);
+        }
+    }
+
+    const std::string &buffer;
+public:
+    bool result = false;
+    LoadsFromBuffer(const std::string &b) : buffer(b) {}
+};
+
+bool loads_from_buffer(Expr e, const std::string &buf) {
+    LoadsFromBuffer l(buf);
+    e.accept(&l);
+    return l.result;
+}
+
+}  // namespace
+
+bool match_reduction(const Store *op, VectorReduce::Operator *reduce_op, Expr *current, Expr *rest) {
+    Expr a, b;
+    if (const Add *add = op->value.as<Add>()) {
+        *reduce_op = VectorReduce::Add;
+        a = add->a;
+        b = add->b;
+    } else if (const Mul *mul = op->value.as<Mul>()) {
+        *reduce_op = VectorReduce::Mul;
+        a = mul->a;
+        b = mul->b;
+    } else if (const Min *min = op->value.as<Min>()) {
+        *reduce_op = VectorReduce::Min;
+        a = min->a;
+        b = min->b;
+    } else if (const Max *max = op->value.as<Max>()) {
+        *reduce_op = VectorReduce::Max;
+        a = max->a;
+        b = max->b;
+    } else if (const And *and_op = op->value.as<And>()) {
+        *reduce_op = VectorReduce::And;
+        a = and_op->a;
+        b = and_op->b;
+    } else if (const Or *or_op = op->value.as<Or>()) {
+        *reduce_op = VectorReduce::Or;
+        a = or_op->a;
+        b = or_op->b;
+    } else {
+        return false;
+    }
+
+    const Load *load = b.as<Load>();
+    if (!load || load->name != op->name) {
+        std::swap(a, b);
+        load = b.as<Load>();
+    }
+    if (!load ||
+        load->name != op->name ||
+        !is_one(load->predicate) ||
+        !equal(load->index, op->index) ||
+        loads_from_buffer(a, op->name)) {
+        return false;
+    }
+
+    *current = b;
+    *rest = a;
+    return true;
+}
+
 }  // namespace Internal
 
 Expr fast_log(Expr x) {
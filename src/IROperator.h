@@ -278,6 +278,21 @@ Expr remove_likelies(Expr e);
  * all calls to likely() and likely_if_innermost() removed. */
 Stmt remove_likelies(Stmt s);
 
+/** Combine two Exprs with the binary operator that a VectorReduce
+ * with the given operator uses to combine lanes. */
+Expr vector_reduce_binop(VectorReduce::Operator op, Expr a, Expr b);
+
+/** The identity of the binary operator that a VectorReduce with the
+ * given operator uses, for the given type. */
+Expr vector_reduce_identity(VectorReduce::Operator op, Type t);
+
+/** If the value stored by a Store is the value already at the site
+ * it stores to combined with something else by one of the operators
+ * a VectorReduce can use, return true, and set reduce_op to the
+ * operator, current to the load of the site, and rest to the
+ * something else. */
+bool match_reduction(const Store *op, VectorReduce::Operator *reduce_op, Expr *current, Expr *rest);
+
 } // namespace Internal
 
 /** Cast an expression to the halide type corresponding to the C++ type T. */
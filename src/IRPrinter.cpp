@@ -151,6 +151,9 @@ std::ostream &operator<<(std::ostream &out, const TailStrategy &t) {
     case TailStrategy::RoundUp:
         out << "RoundUp";
         break;
+    case TailStrategy::Predicate:
+        out << "Predicate";
+        break;
     }
     return out;
 }
@@ -272,6 +275,30 @@ ostream &operator<<(ostream &out, const ForType &type) {
     return out;
 }
 
+ostream &operator<<(ostream &out, const VectorReduce::Operator &op) {
+    switch (op) {
+    case VectorReduce::Add:
+        out << "Add";
+        break;
+    case VectorReduce::Mul:
+        out << "Mul";
+        break;
+    case VectorReduce::Min:
+        out << "Min";
+        break;
+    case VectorReduce::Max:
+        out << "Max";
+        break;
+    case VectorReduce::And:
+        out << "And";
+        break;
+    case VectorReduce::Or:
+        out << "Or";
+        break;
+    }
+    return out;
+}
+
 ostream &operator<<(ostream &out, const NameMangling &m) {
     switch(m) {
     case NameMangling::Default:
@@ -783,6 +810,17 @@ void IRPrinter::visit(const Realize *op) {
     stream << "}\n";
 }
 
+void IRPrinter::visit(const Atomic *op) {
+    do_indent();
+    stream << "atomic (" << op->producer_name << ") {\n";
+    indent += 2;
+    print(op->body);
+    indent -= 2;
+
+    do_indent();
+    stream << "}\n";
+}
+
 void IRPrinter::visit(const Prefetch *op) {
     do_indent();
     const bool has_cond = !is_one(op->condition);
@@ -907,5 +945,15 @@ void IRPrinter::visit(const Shuffle *op) {
     }
 }
 
+void IRPrinter::visit(const VectorReduce *op) {
+    stream << "("
+           << op->type
+           << ")vector_reduce("
+           << op->op
+           << ", ";
+    print(op->value);
+    stream << ")";
+}
+
 }  // namespace Internal
 }  // namespace Halide
@@ -70,6 +70,10 @@ std::ostream &operator<<(std::ostream &stream, const Stmt &);
  * readable form */
 std::ostream &operator<<(std::ostream &stream, const ForType &);
 
+/** Emit a horizontal vector reduction operator in a human readable
+ * form */
+std::ostream &operator<<(std::ostream &stream, const VectorReduce::Operator &);
+
 /** Emit a halide name mangling value in a human readable format */
 std::ostream &operator<<(std::ostream &stream, const NameMangling &);
 
@@ -147,6 +151,7 @@ protected:
     void visit(const ProducerConsumer *) override;
     void visit(const For *) override;
     void visit(const Acquire *) override;
+    void visit(const Atomic *) override;
     void visit(const Store *) override;
     void visit(const Provide *) override;
     void visit(const Allocate *) override;
@@ -157,6 +162,7 @@ protected:
     void visit(const IfThenElse *) override;
     void visit(const Evaluate *) override;
     void visit(const Shuffle *) override;
+    void visit(const VectorReduce *) override;
     void visit(const Prefetch *) override;
 };
 }  // namespace Internal
@@ -177,6 +177,10 @@ void IRVisitor::visit(const Acquire *op) {
     op->body.accept(this);
 }
 
+void IRVisitor::visit(const Atomic *op) {
+    op->body.accept(this);
+}
+
 void IRVisitor::visit(const Store *op) {
     op->predicate.accept(this);
     op->value.accept(this);
@@ -256,6 +260,10 @@ void IRVisitor::visit(const Shuffle *op) {
     }
 }
 
+void IRVisitor::visit(const VectorReduce *op) {
+    op->value.accept(this);
+}
+
 void IRGraphVisitor::include(const Expr &e) {
     auto r = visited.insert(e.get());
     if (r.second) {
@@ -427,6 +435,10 @@ void IRGraphVisitor::visit(const Acquire *op) {
     include(op->body);
 }
 
+void IRGraphVisitor::visit(const Atomic *op) {
+    include(op->body);
+}
+
 void IRGraphVisitor::visit(const Store *op) {
     include(op->predicate);
     include(op->value);
@@ -502,5 +514,9 @@ void IRGraphVisitor::visit(const Shuffle *op) {
     }
 }
 
+void IRGraphVisitor::visit(const VectorReduce *op) {
+    include(op->value);
+}
+
 }  // namespace Internal
 }  // namespace Halide
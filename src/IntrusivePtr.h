@@ -23,6 +23,16 @@ public:
     int increment() {return ++count;} // Increment and return new value
     int decrement() {return --count;} // Decrement and return new value
     bool is_zero() const {return count == 0;}
+    // Increment unless the count is zero, returning whether it was incremented.
+    bool increment_if_nonzero() {
+        int c = count;
+        while (c != 0) {
+            if (count.compare_exchange_weak(c, c + 1)) {
+                return true;
+            }
+        }
+        return false;
+    }
 };
 
 /**
@@ -16,6 +16,8 @@
 #include "CodeGen_Internal.h"
 #include "CodeGen_LLVM.h"
 #include "Debug.h"
+#include "IR.h"
+#include "IRVisitor.h"
 #include "JITModule.h"
 #include "LLVM_Headers.h"
 #include "LLVM_Output.h"
@@ -124,6 +126,604 @@ void load_metal() {
 #endif
 }
 
+// The JIT can keep the object code it produces in a directory named
+// by HL_JIT_CACHE_DIR, so that later processes compiling the same
+// pipeline or runtime for the same target skip LLVM's code
+// generator. Entries are named by a hash of everything the object
+// code depends on: the lowered Halide Module for pipelines, or the
+// llvm bitcode for runtime modules, plus the LLVM version and the
+// identity of the Halide library doing the compiling.
+
+// Two independent 64-bit hashes, giving a 128-bit key.
+class JITCacheHasher {
+    uint64_t h0 = 0xcbf29ce484222325ULL;
+    uint64_t h1 = 0x6a09e667f3bcc909ULL;
+
+public:
+    void add(const void *data, size_t size) {
+        const uint8_t *bytes = (const uint8_t *)data;
+        for (size_t i = 0; i < size; i++) {
+            // FNV-1a
+            h0 = (h0 ^ bytes[i]) * 0x100000001b3ULL;
+            h1 = (h1 ^ bytes[i]) * 0x9e3779b97f4a7c15ULL;
+            h1 ^= h1 >> 29;
+        }
+    }
+
+    void add(const std::string &str) {
+        uint64_t size = str.size();
+        add(&size, sizeof(size));
+        add(str.data(), str.size());
+    }
+
+    std::string digest() const {
+        static const char digits[] = "0123456789abcdef";
+        std::string result;
+        for (uint64_t h : {h0, h1}) {
+            for (int i = 60; i >= 0; i -= 4) {
+                result += digits[(h >> i) & 0xf];
+            }
+        }
+        return result;
+    }
+};
+
+// Identifies the build of Halide doing the compiling, so that cached
+// object code is not reused across Halide versions. Returns an empty
+// string if the library can't be found.
+std::string halide_library_identity() {
+    std::string path;
+#ifdef _WIN32
+    HMODULE module = nullptr;
+    char buf[MAX_PATH];
+    if (GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS |
+                           GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+                           (LPCSTR)&halide_library_identity, &module) &&
+        GetModuleFileNameA(module, buf, sizeof(buf))) {
+        path = buf;
+    }
+#else
+    Dl_info info;
+    if (dladdr((void *)&halide_library_identity, &info) && info.dli_fname) {
+        path = info.dli_fname;
+    }
+#endif
+    llvm::sys::fs::file_status status;
+    if (path.empty() || llvm::sys::fs::status(path, status)) {
+        return "";
+    }
+    return path + ":" + std::to_string(status.getSize()) + ":" +
+           std::to_string(status.getLastModificationTime().time_since_epoch().count());
+}
+
+// Returns a hasher primed with everything a cache key depends on
+// besides the code itself, or false if the cache is disabled.
+bool start_jit_cache_key(JITCacheHasher &hasher) {
+    if (get_env_variable("HL_JIT_CACHE_DIR").empty()) {
+        return false;
+    }
+    static const std::string identity = halide_library_identity();
+    if (identity.empty()) {
+        debug(1) << "Not using the JIT cache, because the Halide library could not be found\n";
+        return false;
+    }
+    hasher.add(identity);
+    hasher.add(std::to_string(LLVM_VERSION));
+    return true;
+}
+
+// Feeds the IR of a Module into a JITCacheHasher. Every field of every
+// node is hashed exactly (floats by their bits), so two modules only
+// share a key if codegen can't tell them apart. Codegen also uses the
+// alignment of the host pointers of buffers embedded in a JIT
+// pipeline, so that is part of the key too.
+class HashIR : public IRVisitor {
+    using IRVisitor::visit;
+
+    JITCacheHasher &hasher;
+
+    void add_int(int64_t x) {
+        hasher.add(&x, sizeof(x));
+    }
+
+    void add(const std::string &str) {
+        hasher.add(str);
+    }
+
+    void add(const Type &t) {
+        add_int(t.code());
+        add_int(t.bits());
+        add_int(t.lanes());
+    }
+
+    void add(const ModulusRemainder &alignment) {
+        add_int(alignment.modulus);
+        add_int(alignment.remainder);
+    }
+
+    void add(const Expr &e) {
+        add_int(e.defined());
+        if (e.defined()) {
+            e.accept(this);
+        }
+    }
+
+    void add(const Stmt &s) {
+        add_int(s.defined());
+        if (s.defined()) {
+            s.accept(this);
+        }
+    }
+
+    void add(const std::vector<Expr> &exprs) {
+        add_int(exprs.size());
+        for (const Expr &e : exprs) {
+            add(e);
+        }
+    }
+
+    void add(const std::vector<Type> &types) {
+        add_int(types.size());
+        for (const Type &t : types) {
+            add(t);
+        }
+    }
+
+    void add(const Region &bounds) {
+        add_int(bounds.size());
+        for (const Range &r : bounds) {
+            add(r.min);
+            add(r.extent);
+        }
+    }
+
+    void add(const Parameter &p) {
+        add_int(p.defined());
+        if (p.defined()) {
+            add(p.name());
+            add(p.type());
+            add_int(p.is_buffer());
+            if (p.is_buffer()) {
+                add_int(p.dimensions());
+                add_int(p.host_alignment());
+            }
+        }
+    }
+
+    void add(const Buffer<> &b) {
+        add_int(b.defined());
+        if (b.defined()) {
+            uintptr_t ptr = (uintptr_t)b.data();
+            add(b.name());
+            add_int(ptr & (~ptr + 1));
+        }
+    }
+
+    void node(const IRNode *op) {
+        add_int((int64_t)op->node_type);
+    }
+
+    void node(const BaseExprNode *op) {
+        add_int((int64_t)op->node_type);
+        add(op->type);
+    }
+
+    template<typename T>
+    void binary(const T *op) {
+        node(op);
+        add(op->a);
+        add(op->b);
+    }
+
+    void visit(const IntImm *op) override {
+        node(op);
+        add_int(op->value);
+    }
+
+    void visit(const UIntImm *op) override {
+        node(op);
+        hasher.add(&op->value, sizeof(op->value));
+    }
+
+    void visit(const FloatImm *op) override {
+        node(op);
+        hasher.add(&op->value, sizeof(op->value));
+    }
+
+    void visit(const StringImm *op) override {
+        node(op);
+        add(op->value);
+    }
+
+    void visit(const Cast *op) override {
+        node(op);
+        add(op->value);
+    }
+
+    void visit(const Variable *op) override {
+        node(op);
+        add(op->name);
+        add(op->param);
+        add(op->image);
+    }
+
+    void visit(const Add *op) override {
+        binary(op);
+    }
+
+    void visit(const Sub *op) override {
+        binary(op);
+    }
+
+    void visit(const Mul *op) override {
+        binary(op);
+    }
+
+    void visit(const Div *op) override {
+        binary(op);
+    }
+
+    void visit(const Mod *op) override {
+        binary(op);
+    }
+
+    void visit(const Min *op) override {
+        binary(op);
+    }
+
+    void visit(const Max *op) override {
+        binary(op);
+    }
+
+    void visit(const EQ *op) override {
+        binary(op);
+    }
+
+    void visit(const NE *op) override {
+        binary(op);
+    }
+
+    void visit(const LT *op) override {
+        binary(op);
+    }
+
+    void visit(const LE *op) override {
+        binary(op);
+    }
+
+    void visit(const GT *op) override {
+        binary(op);
+    }
+
+    void visit(const GE *op) override {
+        binary(op);
+    }
+
+    void visit(const And *op) override {
+        binary(op);
+    }
+
+    void visit(const Or *op) override {
+        binary(op);
+    }
+
+    void visit(const Not *op) override {
+        node(op);
+        add(op->a);
+    }
+
+    void visit(const Select *op) override {
+        node(op);
+        add(op->condition);
+        add(op->true_value);
+        add(op->false_value);
+    }
+
+    void visit(const Load *op) override {
+        node(op);
+        add(op->name);
+        add(op->predicate);
+        add(op->index);
+        add(op->image);
+        add(op->param);
+        add(op->alignment);
+    }
+
+    void visit(const Ramp *op) override {
+        node(op);
+        add(op->base);
+        add(op->stride);
+        add_int(op->lanes);
+    }
+
+    void visit(const Broadcast *op) override {
+        node(op);
+        add(op->value);
+        add_int(op->lanes);
+    }
+
+    void visit(const Call *op) override {
+        node(op);
+        add(op->name);
+        add(op->args);
+        add_int(op->call_type);
+        add_int(op->value_index);
+        add(op->image);
+        add(op->param);
+    }
+
+    void visit(const Let *op) override {
+        node(op);
+        add(op->name);
+        add(op->value);
+        add(op->body);
+    }
+
+    void visit(const LetStmt *op) override {
+        node(op);
+        add(op->name);
+        add(op->value);
+        add(op->body);
+    }
+
+    void visit(const AssertStmt *op) override {
+        node(op);
+        add(op->condition);
+        add(op->message);
+    }
+
+    void visit(const ProducerConsumer *op) override {
+        node(op);
+        add(op->name);
+        add_int(op->is_producer);
+        add(op->body);
+    }
+
+    void visit(const For *op) override {
+        node(op);
+        add(op->name);
+        add(op->min);
+        add(op->extent);
+        add_int((int64_t)op->for_type);
+        add_int((int64_t)op->device_api);
+        add(op->body);
+    }
+
+    void visit(const Store *op) override {
+        node(op);
+        add(op->name);
+        add(op->predicate);
+        add(op->value);
+        add(op->index);
+        add(op->param);
+        add(op->alignment);
+    }
+
+    void visit(const Provide *op) override {
+        node(op);
+        add(op->name);
+        add(op->values);
+        add(op->args);
+    }
+
+    void visit(const Allocate *op) override {
+        node(op);
+        add(op->name);
+        add(op->type);
+        add_int((int64_t)op->memory_type);
+        add(op->extents);
+        add(op->condition);
+        add(op->new_expr);
+        add(op->free_function);
+        add(op->body);
+    }
+
+    void visit(const Free *op) override {
+        node(op);
+        add(op->name);
+    }
+
+    void visit(const Realize *op) override {
+        node(op);
+        add(op->name);
+        add(op->types);
+        add_int((int64_t)op->memory_type);
+        add(op->bounds);
+        add(op->condition);
+        add(op->body);
+    }
+
+    void visit(const Block *op) override {
+        node(op);
+        add(op->first);
+        add(op->rest);
+    }
+
+    void visit(const IfThenElse *op) override {
+        node(op);
+        add(op->condition);
+        add(op->then_case);
+        add(op->else_case);
+    }
+
+    void visit(const Evaluate *op) override {
+        node(op);
+        add(op->value);
+    }
+
+    void visit(const Shuffle *op) override {
+        node(op);
+        add(op->vectors);
+        add_int(op->indices.size());
+        for (int i : op->indices) {
+            add_int(i);
+        }
+    }
+
+    void visit(const VectorReduce *op) override {
+        node(op);
+        add_int((int64_t)op->op);
+        add(op->value);
+    }
+
+    void visit(const Prefetch *op) override {
+        node(op);
+        add(op->name);
+        add(op->types);
+        add(op->bounds);
+        add(op->prefetch.name);
+        add(op->prefetch.var);
+        add(op->prefetch.offset);
+        add_int((int64_t)op->prefetch.strategy);
+        add(op->prefetch.param);
+        add(op->condition);
+        add(op->body);
+    }
+
+    void visit(const Fork *op) override {
+        node(op);
+        add(op->first);
+        add(op->rest);
+    }
+
+    void visit(const Acquire *op) override {
+        node(op);
+        add(op->semaphore);
+        add(op->count);
+        add(op->body);
+    }
+
+    void visit(const Atomic *op) override {
+        node(op);
+        add(op->producer_name);
+        add(op->body);
+    }
+
+public:
+    HashIR(JITCacheHasher &hasher) : hasher(hasher) {}
+
+    void add(const Module &m) {
+        add(m.name());
+        add(m.target().to_string());
+        add_int(m.submodules().size());
+        for (const Module &sub : m.submodules()) {
+            add(sub);
+        }
+        add_int(m.functions().size());
+        for (const LoweredFunc &f : m.functions()) {
+            add(f.name);
+            add_int((int64_t)f.linkage);
+            add_int((int64_t)f.name_mangling);
+            add_int(f.args.size());
+            for (const LoweredArgument &arg : f.args) {
+                add(arg.name);
+                add_int(arg.kind);
+                add_int(arg.dimensions);
+                add(arg.type);
+                add(arg.alignment);
+            }
+            add(f.body);
+        }
+        for (const Buffer<> &b : m.buffers()) {
+            add(b.name());
+            hasher.add(b.raw_buffer()->dim, b.dimensions() * sizeof(halide_dimension_t));
+            if (b.data()) {
+                hasher.add(b.data(), b.size_in_bytes());
+            }
+        }
+        for (const ExternalCode &code : m.external_code()) {
+            add(code.name());
+            hasher.add(code.contents().data(), code.contents().size());
+        }
+    }
+};
+
+// The JIT cache key for a lowered Module, or an empty string if the
+// cache is disabled.
+std::string jit_cache_key(const Module &m) {
+    JITCacheHasher hasher;
+    if (!start_jit_cache_key(hasher)) {
+        return "";
+    }
+    HashIR(hasher).add(m);
+    return hasher.digest();
+}
+
+// The JIT cache key for an llvm module, or an empty string if the
+// cache is disabled.
+std::string jit_cache_key(const llvm::Module &m) {
+    JITCacheHasher hasher;
+    if (!start_jit_cache_key(hasher)) {
+        return "";
+    }
+    std::string bitcode;
+    llvm::raw_string_ostream stream(bitcode);
+    llvm::WriteBitcodeToFile(m, stream);
+    stream.flush();
+    hasher.add(bitcode);
+    return hasher.digest();
+}
+
+// Hands MCJIT the object code for a module if it is in the cache, and
+// stores the object code into the cache if it isn't. The cached file
+// is read up front, so that whether it is present can't change during
+// compilation. Failures to read or write the cache are not errors.
+class JITObjectCache : public llvm::ObjectCache {
+    std::string path;
+    std::unique_ptr<llvm::MemoryBuffer> object;
+
+public:
+    JITObjectCache(const std::string &key) {
+        std::string dir = get_env_variable("HL_JIT_CACHE_DIR");
+        llvm::sys::fs::create_directories(dir);
+        path = dir + "/" + key + ".o";
+        llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> buf = llvm::MemoryBuffer::getFile(path);
+        if (buf) {
+            object = std::move(*buf);
+        }
+    }
+
+    bool has_object() const {
+        return object != nullptr;
+    }
+
+    void notifyObjectCompiled(const llvm::Module *, llvm::MemoryBufferRef obj) override {
+        if (has_object()) {
+            return;
+        }
+        // Write to a temporary file and rename it into place, so that
+        // other processes never see a partially written object.
+        int fd;
+        llvm::SmallString<128> temp_path;
+        if (llvm::sys::fs::createUniqueFile(path + "-%%%%%%%%.tmp", fd, temp_path)) {
+            debug(1) << "Could not create a temporary file for " << path << "\n";
+            return;
+        }
+        bool ok;
+        {
+            llvm::raw_fd_ostream out(fd, /* shouldClose */ true);
+            out << obj.getBuffer();
+            out.close();
+            ok = !out.has_error();
+            out.clear_error();
+        }
+        if (!ok || llvm::sys::fs::rename(temp_path, path)) {
+            debug(1) << "Could not write " << path << " to the JIT cache\n";
+            llvm::sys::fs::remove(temp_path);
+            return;
+        }
+        debug(1) << "Added " << path << " to the JIT cache\n";
+    }
+
+    std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module *) override {
+        if (!object) {
+            return nullptr;
+        }
+        debug(1) << "Loading object code from " << path << "\n";
+        return llvm::MemoryBuffer::getMemBufferCopy(object->getBuffer(), object->getBufferIdentifier());
+    }
+};
+
 }  // namespace
 
 using namespace llvm;
@@ -146,6 +746,8 @@ public:
     std::map<std::string, JITModule::Symbol> exports;
     llvm::LLVMContext context;
     ExecutionEngine *execution_engine;
+    // Must outlive the execution engine.
+    std::unique_ptr<JITObjectCache> object_cache;
     std::vector<JITModule> dependencies;
     JITModule::Symbol entrypoint;
     JITModule::Symbol argv_entrypoint;
@@ -165,7 +767,9 @@ namespace {
 JITModule::Symbol compile_and_get_function(ExecutionEngine &ee, const string &name) {
     debug(2) << "JIT Compiling " << name << "\n";
     llvm::Function *fn = ee.FindFunctionNamed(name.c_str());
-    internal_assert(fn->getName() == name);
+    // The function won't be in the module if the object code came
+    // from the JIT cache.
+    internal_assert(!fn || fn->getName() == name);
     void *f = (void *) ee.getFunctionAddress(name);
     if (!f) {
         internal_error << "Compiling " << name << " returned nullptr\n";
@@ -258,11 +862,25 @@ JITModule::JITModule() {
 JITModule::JITModule(const Module &m, const LoweredFunc &fn,
                      const std::vector<JITModule> &dependencies) {
     jit_module = new JITModuleContents();
-    std::unique_ptr<llvm::Module> llvm_module(compile_module_to_llvm_module(m, jit_module->context));
+    std::string cache_key = jit_cache_key(m);
+    if (!cache_key.empty()) {
+        jit_module->object_cache.reset(new JITObjectCache(cache_key));
+    }
+    std::unique_ptr<llvm::Module> llvm_module;
+    if (jit_module->object_cache && jit_module->object_cache->has_object()) {
+        // Skip generating and optimizing llvm IR entirely. The
+        // execution engine just needs a module with the right target
+        // options to load the cached object code into.
+        debug(1) << "Found " << fn.name << " in the JIT cache\n";
+        llvm_module = CodeGen_LLVM::compile_empty_module(m.target(), jit_module->context, m.name());
+    } else {
+        llvm_module = compile_module_to_llvm_module(m, jit_module->context);
+    }
     std::vector<JITModule> deps_with_runtime = dependencies;
     std::vector<JITModule> shared_runtime = JITSharedRuntime::get(llvm_module.get(), m.target());
     deps_with_runtime.insert(deps_with_runtime.end(), shared_runtime.begin(), shared_runtime.end());
-    compile_module(std::move(llvm_module), fn.name, m.target(), deps_with_runtime);
+    compile_module(std::move(llvm_module), fn.name, m.target(), deps_with_runtime,
+                   std::vector<std::string>(), cache_key);
     // If -time-passes is in HL_LLVM_ARGS, this will print llvm passes time statstics otherwise its no-op.
 #if LLVM_VERSION >= 80
     llvm::reportAndResetTimings();
@@ -271,7 +889,8 @@ JITModule::JITModule(const Module &m, const LoweredFunc &fn,
 
 void JITModule::compile_module(std::unique_ptr<llvm::Module> m, const string &function_name, const Target &target,
                                const std::vector<JITModule> &dependencies,
-                               const std::vector<std::string> &requested_exports) {
+                               const std::vector<std::string> &requested_exports,
+                               const std::string &object_cache_key) {
 
     // Ensure that LLVM is initialized
     CodeGen_LLVM::initialize_llvm();
@@ -330,6 +949,18 @@ void JITModule::compile_module(std::unique_ptr<llvm::Module> m, const string &fu
         ee->RegisterJITEventListener(listeners[i]);
     }
 
+    if (!object_cache_key.empty() && !jit_module->object_cache) {
+        jit_module->object_cache.reset(new JITObjectCache(object_cache_key));
+    }
+    if (jit_module->object_cache) {
+        ee->setObjectCache(jit_module->object_cache.get());
+        if (jit_module->object_cache->has_object()) {
+            // Load the cached object now, so that symbols which are
+            // not in the llvm module can be found.
+            ee->finalizeObject();
+        }
+    }
+
     // Retrieve function pointers from the compiled module (which also
     // triggers compilation)
     debug(1) << "JIT compiling " << module_name
@@ -485,6 +1116,22 @@ void JITModule::reuse_device_allocations(bool b) const {
     }
 }
 
+void JITModule::reuse_host_allocations(bool b) const {
+    std::map<std::string, Symbol>::const_iterator f =
+        exports().find("halide_reuse_host_allocations");
+    if (f != exports().end()) {
+        (reinterpret_bits<int (*)(void *, bool)>(f->second.address))(nullptr, b);
+    }
+}
+
+void JITModule::host_allocation_cache_set_size(int64_t size) const {
+    std::map<std::string, Symbol>::const_iterator f =
+        exports().find("halide_host_allocation_cache_set_size");
+    if (f != exports().end()) {
+        (reinterpret_bits<void (*)(int64_t)>(f->second.address))(size);
+    }
+}
+
 bool JITModule::compiled() const {
   return jit_module->execution_engine != nullptr;
 }
@@ -495,6 +1142,9 @@ JITHandlers runtime_internal_handlers;
 JITHandlers default_handlers;
 JITHandlers active_handlers;
 int64_t default_cache_size;
+bool default_reuse_host_allocations = true;
+// Negative means the runtime's default.
+int64_t default_host_allocation_cache_size = -1;
 
 void merge_handlers(JITHandlers &base, const JITHandlers &addins) {
     if (addins.custom_print) {
@@ -791,7 +1441,8 @@ JITModule &make_module(llvm::Module *for_module, Target target,
 
         std::vector<std::string> halide_exports(halide_exports_unique.begin(), halide_exports_unique.end());
 
-        runtime.compile_module(std::move(module), "", target, deps, halide_exports);
+        std::string cache_key = jit_cache_key(*module);
+        runtime.compile_module(std::move(module), "", target, deps, halide_exports, cache_key);
 
         if (runtime_kind == MainShared) {
             runtime_internal_handlers.custom_print =
@@ -831,6 +1482,11 @@ JITModule &make_module(llvm::Module *for_module, Target target,
                 runtime.memoization_cache_set_size(default_cache_size);
             }
 
+            runtime.reuse_host_allocations(default_reuse_host_allocations);
+            if (default_host_allocation_cache_size >= 0) {
+                runtime.host_allocation_cache_set_size(default_host_allocation_cache_size);
+            }
+
             runtime.jit_module->name = "MainShared";
         } else {
             runtime.jit_module->name = "GPU";
@@ -966,5 +1622,17 @@ void JITSharedRuntime::reuse_device_allocations(bool b) {
     shared_runtimes(MainShared).reuse_device_allocations(b);
 }
 
+void JITSharedRuntime::reuse_host_allocations(bool b) {
+    std::lock_guard<std::mutex> lock(shared_runtimes_mutex);
+    default_reuse_host_allocations = b;
+    shared_runtimes(MainShared).reuse_host_allocations(b);
+}
+
+void JITSharedRuntime::host_allocation_cache_set_size(int64_t size) {
+    std::lock_guard<std::mutex> lock(shared_runtimes_mutex);
+    default_host_allocation_cache_size = size;
+    shared_runtimes(MainShared).host_allocation_cache_set_size(size);
+}
+
 }  // namespace Internal
 }  // namespace Halide
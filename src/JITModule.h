@@ -117,11 +117,16 @@ struct JITModule {
     Symbol find_symbol_by_name(const std::string &) const;
 
     /** Take an llvm module and compile it. The requested exports will
-        be available via the exports method. */
+        be available via the exports method. If the HL_JIT_CACHE_DIR
+        environment variable names a directory and an object cache key
+        is given, the object code is saved there under that key, and
+        later compilations with the same key load it instead of
+        running LLVM's code generator. */
     void compile_module(std::unique_ptr<llvm::Module> mod,
                         const std::string &function_name, const Target &target,
                         const std::vector<JITModule> &dependencies = std::vector<JITModule>(),
-                        const std::vector<std::string> &requested_exports = std::vector<std::string>());
+                        const std::vector<std::string> &requested_exports = std::vector<std::string>(),
+                        const std::string &object_cache_key = std::string());
 
     /** See JITSharedRuntime::memoization_cache_set_size */
     void memoization_cache_set_size(int64_t size) const;
@@ -129,6 +134,12 @@ struct JITModule {
     /** See JITSharedRuntime::reuse_device_allocations */
     void reuse_device_allocations(bool) const;
 
+    /** See JITSharedRuntime::reuse_host_allocations */
+    void reuse_host_allocations(bool) const;
+
+    /** See JITSharedRuntime::host_allocation_cache_set_size */
+    void host_allocation_cache_set_size(int64_t size) const;
+
     /** Return true if compile_module has been called on this module. */
     bool compiled() const;
 };
@@ -173,6 +184,21 @@ public:
      * instead. */
     static void reuse_device_allocations(bool);
 
+    /** Set whether or not Halide may hold onto freed host allocations
+     * made by the default allocator, binned by size class, to service
+     * future allocations. This is on by default for JIT-compiled
+     * code. If you are compiling statically, you should include
+     * HalideRuntime.h and call halide_reuse_host_allocations
+     * instead. */
+    static void reuse_host_allocations(bool);
+
+    /** Set the maximum number of bytes of freed host allocations the
+     * default allocator may hold onto. Reducing it releases everything
+     * held. If you are compiling statically, you should include
+     * HalideRuntime.h and call halide_host_allocation_cache_set_size
+     * instead. */
+    static void host_allocation_cache_set_size(int64_t size);
+
     static void release_all();
 };
 
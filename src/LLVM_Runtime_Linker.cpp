@@ -1,6 +1,9 @@
 #include "LLVM_Runtime_Linker.h"
 #include "LLVM_Headers.h"
 
+#include <map>
+#include <mutex>
+
 namespace Halide {
 
 using std::string;
@@ -25,44 +28,71 @@ std::unique_ptr<llvm::Module> parse_bitcode_file(llvm::StringRef buf, llvm::LLVM
     return result;
 }
 
+// The embedded bitcode for one of the runtime modules.
+struct RuntimeBitcode {
+    const char *name;
+    llvm::StringRef bitcode;
+    // True if the module was compiled from one of the C++ runtime
+    // files, false if it is one of the hand-written .ll files.
+    bool from_cpp;
+};
+
+std::unique_ptr<llvm::Module> parse_runtime_bitcode(const RuntimeBitcode &b, llvm::LLVMContext *context) {
+    return parse_bitcode_file(b.bitcode, context, b.name);
+}
+
 }  // namespace
 
-#define DECLARE_INITMOD(mod)                                                              \
+#define DECLARE_INITMOD(mod, from_cpp)                                                    \
     extern "C" unsigned char halide_internal_initmod_##mod[];                             \
     extern "C" int halide_internal_initmod_##mod##_length;                                \
-    std::unique_ptr<llvm::Module> get_initmod_##mod(llvm::LLVMContext *context) {         \
+    RuntimeBitcode initmod_##mod() {                                                      \
         llvm::StringRef sb = llvm::StringRef((const char *)halide_internal_initmod_##mod, \
                                              halide_internal_initmod_##mod##_length);     \
-        return parse_bitcode_file(sb, context, #mod);                                    \
+        return {#mod, sb, from_cpp};                                                      \
+    }                                                                                     \
+    std::unique_ptr<llvm::Module> get_initmod_##mod(llvm::LLVMContext *context) {         \
+        return parse_runtime_bitcode(initmod_##mod(), context);                           \
     }
 
-#define DECLARE_NO_INITMOD(mod)                                                      \
-  std::unique_ptr<llvm::Module> get_initmod_##mod(llvm::LLVMContext *, bool, bool) { \
-        user_error << "Halide was compiled without support for this target\n";       \
-        return std::unique_ptr<llvm::Module>();                                      \
-    }                                                                                \
-  std::unique_ptr<llvm::Module> get_initmod_##mod##_ll(llvm::LLVMContext *) {        \
-        user_error << "Halide was compiled without support for this target\n";       \
-        return std::unique_ptr<llvm::Module>();                                      \
+#define DECLARE_NO_INITMOD(mod)                                                        \
+    RuntimeBitcode initmod_##mod(bool, bool) {                                         \
+        user_error << "Halide was compiled without support for this target\n";         \
+        return RuntimeBitcode();                                                       \
+    }                                                                                  \
+    RuntimeBitcode initmod_##mod##_ll() {                                              \
+        user_error << "Halide was compiled without support for this target\n";         \
+        return RuntimeBitcode();                                                       \
+    }                                                                                  \
+    std::unique_ptr<llvm::Module> get_initmod_##mod(llvm::LLVMContext *, bool, bool) { \
+        user_error << "Halide was compiled without support for this target\n";         \
+        return std::unique_ptr<llvm::Module>();                                        \
+    }                                                                                  \
+    std::unique_ptr<llvm::Module> get_initmod_##mod##_ll(llvm::LLVMContext *) {        \
+        user_error << "Halide was compiled without support for this target\n";         \
+        return std::unique_ptr<llvm::Module>();                                        \
     }
 
 #define DECLARE_CPP_INITMOD(mod) \
-    DECLARE_INITMOD(mod ## _32_debug) \
-    DECLARE_INITMOD(mod ## _64_debug) \
-    DECLARE_INITMOD(mod ## _32) \
-    DECLARE_INITMOD(mod ## _64) \
-    std::unique_ptr<llvm::Module> get_initmod_##mod(llvm::LLVMContext *context, bool bits_64, bool debug) { \
+    DECLARE_INITMOD(mod ## _32_debug, true) \
+    DECLARE_INITMOD(mod ## _64_debug, true) \
+    DECLARE_INITMOD(mod ## _32, true) \
+    DECLARE_INITMOD(mod ## _64, true) \
+    RuntimeBitcode initmod_##mod(bool bits_64, bool debug) {                                \
         if (bits_64) {                                                                      \
-            if (debug) return get_initmod_##mod##_64_debug(context);                        \
-            else return get_initmod_##mod##_64(context);                                    \
+            if (debug) return initmod_##mod##_64_debug();                                   \
+            else return initmod_##mod##_64();                                               \
         } else {                                                                            \
-            if (debug) return get_initmod_##mod##_32_debug(context);                        \
-            else return get_initmod_##mod##_32(context);                                    \
+            if (debug) return initmod_##mod##_32_debug();                                   \
+            else return initmod_##mod##_32();                                               \
         }                                                                                   \
+    }                                                                                       \
+    std::unique_ptr<llvm::Module> get_initmod_##mod(llvm::LLVMContext *context, bool bits_64, bool debug) { \
+        return parse_runtime_bitcode(initmod_##mod(bits_64, debug), context);               \
     }
 
 #define DECLARE_LL_INITMOD(mod) \
-    DECLARE_INITMOD(mod ## _ll)
+    DECLARE_INITMOD(mod ## _ll, false)
 
 // Universal CPP Initmods. Please keep sorted alphabetically.
 DECLARE_CPP_INITMOD(alignment_128)
@@ -87,6 +117,7 @@ DECLARE_CPP_INITMOD(destructors)
 DECLARE_CPP_INITMOD(device_interface)
 DECLARE_CPP_INITMOD(errors)
 DECLARE_CPP_INITMOD(fake_get_symbol)
+DECLARE_CPP_INITMOD(fake_numa)
 DECLARE_CPP_INITMOD(fake_thread_pool)
 DECLARE_CPP_INITMOD(float16_t)
 DECLARE_CPP_INITMOD(fuchsia_clock)
@@ -98,6 +129,8 @@ DECLARE_CPP_INITMOD(hexagon_host)
 DECLARE_CPP_INITMOD(ios_io)
 DECLARE_CPP_INITMOD(linux_clock)
 DECLARE_CPP_INITMOD(linux_host_cpu_count)
+DECLARE_CPP_INITMOD(linux_numa)
+DECLARE_CPP_INITMOD(linux_profiler_hw)
 DECLARE_CPP_INITMOD(linux_yield)
 DECLARE_CPP_INITMOD(matlab)
 DECLARE_CPP_INITMOD(metadata)
@@ -193,9 +226,11 @@ DECLARE_NO_INITMOD(arm_cpu_features)
 #ifdef WITH_AARCH64
 DECLARE_LL_INITMOD(aarch64)
 DECLARE_CPP_INITMOD(aarch64_cpu_features)
+DECLARE_CPP_INITMOD(linux_aarch64_cpu_features)
 #else
 DECLARE_NO_INITMOD(aarch64)
 DECLARE_NO_INITMOD(aarch64_cpu_features)
+DECLARE_NO_INITMOD(linux_aarch64_cpu_features)
 #endif  // WITH_AARCH64
 
 #ifdef WITH_PTX
@@ -633,6 +668,92 @@ void link_modules(std::vector<std::unique_ptr<llvm::Module>> &modules, Target t,
 
 }
 
+// Parsing and linking the C++ runtime modules is a large part of the
+// cost of setting up each compilation, and many compilations in a
+// process (e.g. the targets of a multitarget library) need the same
+// ones. A parsed module belongs to a single LLVMContext, so what is
+// kept is the bitcode of the C++ modules already linked together,
+// keyed by which modules they are and the target layout. Each new
+// context then parses that once. The hand-written .ll modules are
+// small and vary with individual target features (e.g. x86_avx2_ll),
+// so they are parsed and linked in afresh each time. Only runs of
+// consecutive C++ modules are combined, so that every module is still
+// linked in the order it was listed: when two modules define the same
+// weak symbol, the one linked first wins.
+std::mutex linked_runtime_cache_mutex;
+std::map<std::string, std::string> linked_runtime_cache;
+
+std::unique_ptr<llvm::Module> link_cpp_runtime_modules(const vector<RuntimeBitcode> &cpp_modules,
+                                                       const Target &t, llvm::LLVMContext *c) {
+    llvm::DataLayout data_layout = get_data_layout_for_target(t);
+    llvm::Triple triple = Internal::get_triple_for_target(t);
+
+    string key = triple.str() + " " + data_layout.getStringRepresentation();
+    for (const RuntimeBitcode &b : cpp_modules) {
+        key += " ";
+        key += b.name;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(linked_runtime_cache_mutex);
+        auto it = linked_runtime_cache.find(key);
+        if (it != linked_runtime_cache.end()) {
+            // Entries are never removed, so the string outlives the lock.
+            llvm::StringRef bitcode(it->second);
+            return parse_bitcode_file(bitcode, c, cpp_modules[0].name);
+        }
+    }
+
+    vector<std::unique_ptr<llvm::Module>> modules;
+    for (const RuntimeBitcode &b : cpp_modules) {
+        modules.push_back(parse_runtime_bitcode(b, c));
+        modules.back()->setDataLayout(data_layout);
+        modules.back()->setTargetTriple(triple.str());
+    }
+    for (size_t i = 1; i < modules.size(); i++) {
+        bool failed = llvm::Linker::linkModules(*modules[0], std::move(modules[i]));
+        if (failed) {
+            internal_error << "Failure linking initial modules\n";
+        }
+    }
+
+    string bitcode;
+    llvm::raw_string_ostream stream(bitcode);
+    llvm::WriteBitcodeToFile(*modules[0], stream);
+    stream.flush();
+
+    std::lock_guard<std::mutex> lock(linked_runtime_cache_mutex);
+    linked_runtime_cache.emplace(key, std::move(bitcode));
+    return std::move(modules[0]);
+}
+
+// Parse the given runtime modules into a context, ready for
+// link_modules. Each run of consecutive C++ modules comes back already
+// linked together as a single module.
+vector<std::unique_ptr<llvm::Module>> parse_runtime_modules(const vector<RuntimeBitcode> &bitcodes,
+                                                            const Target &t, llvm::LLVMContext *c) {
+    vector<std::unique_ptr<llvm::Module>> result;
+    vector<RuntimeBitcode> cpp_modules;
+    auto flush_cpp_modules = [&]() {
+        if (cpp_modules.size() == 1) {
+            result.push_back(parse_runtime_bitcode(cpp_modules[0], c));
+        } else if (!cpp_modules.empty()) {
+            result.push_back(link_cpp_runtime_modules(cpp_modules, t, c));
+        }
+        cpp_modules.clear();
+    };
+    for (const RuntimeBitcode &b : bitcodes) {
+        if (b.from_cpp) {
+            cpp_modules.push_back(b);
+        } else {
+            flush_cpp_modules();
+            result.push_back(parse_runtime_bitcode(b, c));
+        }
+    }
+    flush_cpp_modules();
+    return result;
+}
+
 }  // namespace
 
 namespace Internal {
@@ -728,6 +849,7 @@ std::unique_ptr<llvm::Module> link_with_wasm_jit_runtime(llvm::LLVMContext *c, c
     vector<std::unique_ptr<llvm::Module>> modules;
     modules.push_back(std::move(extra_module));
     modules.push_back(get_initmod_fake_thread_pool(c, bits_64, debug));
+    modules.push_back(get_initmod_fake_numa(c, bits_64, debug));
     modules.push_back(get_initmod_posix_allocator(c, bits_64, debug));
     modules.push_back(get_initmod_buffer_t(c, bits_64, debug));
     modules.push_back(get_initmod_destructors(c, bits_64, debug));
@@ -783,110 +905,117 @@ std::unique_ptr<llvm::Module> get_initial_module_for_target(Target t, llvm::LLVM
     bool debug = t.has_feature(Target::Debug);
     bool tsan = t.has_feature(Target::TSAN);
 
-    vector<std::unique_ptr<llvm::Module>> modules;
+    vector<RuntimeBitcode> modules;
 
     if (module_type != ModuleGPU) {
         if (module_type != ModuleJITInlined && module_type != ModuleAOTNoRuntime) {
             // OS-dependent modules
             if (t.os == Target::Linux) {
-                modules.push_back(get_initmod_posix_allocator(c, bits_64, debug));
-                modules.push_back(get_initmod_posix_error_handler(c, bits_64, debug));
-                modules.push_back(get_initmod_posix_print(c, bits_64, debug));
+                modules.push_back(initmod_posix_allocator(bits_64, debug));
+                modules.push_back(initmod_posix_error_handler(bits_64, debug));
+                modules.push_back(initmod_posix_print(bits_64, debug));
                 if (t.arch == Target::X86) {
-                    modules.push_back(get_initmod_linux_clock(c, bits_64, debug));
+                    modules.push_back(initmod_linux_clock(bits_64, debug));
                 } else {
-                    modules.push_back(get_initmod_posix_clock(c, bits_64, debug));
+                    modules.push_back(initmod_posix_clock(bits_64, debug));
                 }
-                modules.push_back(get_initmod_posix_io(c, bits_64, debug));
-                modules.push_back(get_initmod_linux_host_cpu_count(c, bits_64, debug));
-                modules.push_back(get_initmod_linux_yield(c, bits_64, debug));
+                modules.push_back(initmod_posix_io(bits_64, debug));
+                modules.push_back(initmod_linux_host_cpu_count(bits_64, debug));
+                modules.push_back(initmod_linux_numa(bits_64, debug));
+                modules.push_back(initmod_linux_yield(bits_64, debug));
                 if (tsan) {
-                    modules.push_back(get_initmod_posix_threads_tsan(c, bits_64, debug));
+                    modules.push_back(initmod_posix_threads_tsan(bits_64, debug));
                 } else {
-                    modules.push_back(get_initmod_posix_threads(c, bits_64, debug));
+                    modules.push_back(initmod_posix_threads(bits_64, debug));
                 }
-                modules.push_back(get_initmod_posix_get_symbol(c, bits_64, debug));
+                modules.push_back(initmod_posix_get_symbol(bits_64, debug));
             } else if (t.os == Target::WebAssemblyRuntime) {
-                modules.push_back(get_initmod_posix_allocator(c, bits_64, debug));
-                modules.push_back(get_initmod_posix_error_handler(c, bits_64, debug));
-                modules.push_back(get_initmod_posix_print(c, bits_64, debug));
-                modules.push_back(get_initmod_posix_clock(c, bits_64, debug));
-                modules.push_back(get_initmod_posix_io(c, bits_64, debug));
-                modules.push_back(get_initmod_linux_host_cpu_count(c, bits_64, debug));
-                modules.push_back(get_initmod_linux_yield(c, bits_64, debug));
-                modules.push_back(get_initmod_fake_thread_pool(c, bits_64, debug));
-                modules.push_back(get_initmod_fake_get_symbol(c, bits_64, debug));
+                modules.push_back(initmod_posix_allocator(bits_64, debug));
+                modules.push_back(initmod_posix_error_handler(bits_64, debug));
+                modules.push_back(initmod_posix_print(bits_64, debug));
+                modules.push_back(initmod_posix_clock(bits_64, debug));
+                modules.push_back(initmod_posix_io(bits_64, debug));
+                modules.push_back(initmod_linux_host_cpu_count(bits_64, debug));
+                modules.push_back(initmod_linux_yield(bits_64, debug));
+                modules.push_back(initmod_fake_numa(bits_64, debug));
+                modules.push_back(initmod_fake_thread_pool(bits_64, debug));
+                modules.push_back(initmod_fake_get_symbol(bits_64, debug));
             } else if (t.os == Target::OSX) {
-                modules.push_back(get_initmod_posix_allocator(c, bits_64, debug));
-                modules.push_back(get_initmod_posix_error_handler(c, bits_64, debug));
-                modules.push_back(get_initmod_posix_print(c, bits_64, debug));
-                modules.push_back(get_initmod_osx_clock(c, bits_64, debug));
-                modules.push_back(get_initmod_posix_io(c, bits_64, debug));
-                modules.push_back(get_initmod_osx_host_cpu_count(c, bits_64, debug));
-                modules.push_back(get_initmod_osx_yield(c, bits_64, debug));
+                modules.push_back(initmod_posix_allocator(bits_64, debug));
+                modules.push_back(initmod_posix_error_handler(bits_64, debug));
+                modules.push_back(initmod_posix_print(bits_64, debug));
+                modules.push_back(initmod_osx_clock(bits_64, debug));
+                modules.push_back(initmod_posix_io(bits_64, debug));
+                modules.push_back(initmod_osx_host_cpu_count(bits_64, debug));
+                modules.push_back(initmod_osx_yield(bits_64, debug));
+                modules.push_back(initmod_fake_numa(bits_64, debug));
                 if (tsan) {
-                    modules.push_back(get_initmod_posix_threads_tsan(c, bits_64, debug));
+                    modules.push_back(initmod_posix_threads_tsan(bits_64, debug));
                 } else {
-                    modules.push_back(get_initmod_posix_threads(c, bits_64, debug));
+                    modules.push_back(initmod_posix_threads(bits_64, debug));
                 }
-                modules.push_back(get_initmod_osx_get_symbol(c, bits_64, debug));
-                modules.push_back(get_initmod_osx_host_cpu_count(c, bits_64, debug));
+                modules.push_back(initmod_osx_get_symbol(bits_64, debug));
+                modules.push_back(initmod_osx_host_cpu_count(bits_64, debug));
             } else if (t.os == Target::Android) {
-                modules.push_back(get_initmod_posix_allocator(c, bits_64, debug));
-                modules.push_back(get_initmod_posix_error_handler(c, bits_64, debug));
-                modules.push_back(get_initmod_posix_print(c, bits_64, debug));
+                modules.push_back(initmod_posix_allocator(bits_64, debug));
+                modules.push_back(initmod_posix_error_handler(bits_64, debug));
+                modules.push_back(initmod_posix_print(bits_64, debug));
                 if (t.arch == Target::ARM) {
-                    modules.push_back(get_initmod_android_clock(c, bits_64, debug));
+                    modules.push_back(initmod_android_clock(bits_64, debug));
                 } else {
-                    modules.push_back(get_initmod_posix_clock(c, bits_64, debug));
+                    modules.push_back(initmod_posix_clock(bits_64, debug));
                 }
-                modules.push_back(get_initmod_android_io(c, bits_64, debug));
-                modules.push_back(get_initmod_android_host_cpu_count(c, bits_64, debug));
-                modules.push_back(get_initmod_linux_yield(c, bits_64, debug)); // TODO: verify
+                modules.push_back(initmod_android_io(bits_64, debug));
+                modules.push_back(initmod_android_host_cpu_count(bits_64, debug));
+                modules.push_back(initmod_linux_yield(bits_64, debug)); // TODO: verify
+                modules.push_back(initmod_fake_numa(bits_64, debug));
                 if (tsan) {
-                    modules.push_back(get_initmod_posix_threads_tsan(c, bits_64, debug));
+                    modules.push_back(initmod_posix_threads_tsan(bits_64, debug));
                 } else {
-                    modules.push_back(get_initmod_posix_threads(c, bits_64, debug));
+                    modules.push_back(initmod_posix_threads(bits_64, debug));
                 }
-                modules.push_back(get_initmod_posix_get_symbol(c, bits_64, debug));
+                modules.push_back(initmod_posix_get_symbol(bits_64, debug));
             } else if (t.os == Target::Windows) {
-                modules.push_back(get_initmod_posix_allocator(c, bits_64, debug));
-                modules.push_back(get_initmod_posix_error_handler(c, bits_64, debug));
-                modules.push_back(get_initmod_posix_print(c, bits_64, debug));
-                modules.push_back(get_initmod_windows_clock(c, bits_64, debug));
-                modules.push_back(get_initmod_windows_io(c, bits_64, debug));
-                modules.push_back(get_initmod_windows_yield(c, bits_64, debug));
+                modules.push_back(initmod_posix_allocator(bits_64, debug));
+                modules.push_back(initmod_posix_error_handler(bits_64, debug));
+                modules.push_back(initmod_posix_print(bits_64, debug));
+                modules.push_back(initmod_windows_clock(bits_64, debug));
+                modules.push_back(initmod_windows_io(bits_64, debug));
+                modules.push_back(initmod_windows_yield(bits_64, debug));
+                modules.push_back(initmod_fake_numa(bits_64, debug));
                 if (tsan) {
-                    modules.push_back(get_initmod_windows_threads_tsan(c, bits_64, debug));
+                    modules.push_back(initmod_windows_threads_tsan(bits_64, debug));
                 } else {
-                    modules.push_back(get_initmod_windows_threads(c, bits_64, debug));
+                    modules.push_back(initmod_windows_threads(bits_64, debug));
                 }
-                modules.push_back(get_initmod_windows_get_symbol(c, bits_64, debug));
+                modules.push_back(initmod_windows_get_symbol(bits_64, debug));
                 if (t.has_feature(Target::MinGW)) {
-                    modules.push_back(get_initmod_mingw_math(c, bits_64, debug));
+                    modules.push_back(initmod_mingw_math(bits_64, debug));
                 }
             } else if (t.os == Target::IOS) {
-                modules.push_back(get_initmod_posix_allocator(c, bits_64, debug));
-                modules.push_back(get_initmod_posix_error_handler(c, bits_64, debug));
-                modules.push_back(get_initmod_posix_print(c, bits_64, debug));
-                modules.push_back(get_initmod_posix_clock(c, bits_64, debug));
-                modules.push_back(get_initmod_ios_io(c, bits_64, debug));
-                modules.push_back(get_initmod_osx_host_cpu_count(c, bits_64, debug));
-                modules.push_back(get_initmod_osx_yield(c, bits_64, debug));
+                modules.push_back(initmod_posix_allocator(bits_64, debug));
+                modules.push_back(initmod_posix_error_handler(bits_64, debug));
+                modules.push_back(initmod_posix_print(bits_64, debug));
+                modules.push_back(initmod_posix_clock(bits_64, debug));
+                modules.push_back(initmod_ios_io(bits_64, debug));
+                modules.push_back(initmod_osx_host_cpu_count(bits_64, debug));
+                modules.push_back(initmod_osx_yield(bits_64, debug));
+                modules.push_back(initmod_fake_numa(bits_64, debug));
                 if (tsan) {
-                    modules.push_back(get_initmod_posix_threads_tsan(c, bits_64, debug));
+                    modules.push_back(initmod_posix_threads_tsan(bits_64, debug));
                 } else {
-                    modules.push_back(get_initmod_posix_threads(c, bits_64, debug));
+                    modules.push_back(initmod_posix_threads(bits_64, debug));
                 }
             } else if (t.os == Target::QuRT) {
-                modules.push_back(get_initmod_qurt_allocator(c, bits_64, debug));
-                modules.push_back(get_initmod_qurt_yield(c, bits_64, debug));
+                modules.push_back(initmod_qurt_allocator(bits_64, debug));
+                modules.push_back(initmod_qurt_yield(bits_64, debug));
+                modules.push_back(initmod_fake_numa(bits_64, debug));
                 if (tsan) {
-                    modules.push_back(get_initmod_qurt_threads_tsan(c, bits_64, debug));
+                    modules.push_back(initmod_qurt_threads_tsan(bits_64, debug));
                 } else {
-                    modules.push_back(get_initmod_qurt_threads(c, bits_64, debug));
+                    modules.push_back(initmod_qurt_threads(bits_64, debug));
                 }
-                modules.push_back(get_initmod_qurt_init_fini(c, bits_64, debug));
+                modules.push_back(initmod_qurt_init_fini(bits_64, debug));
             } else if (t.os == Target::NoOS) {
                 // The OS-specific symbols provided by the modules
                 // above are expected to be provided by the containing
@@ -894,65 +1023,66 @@ std::unique_ptr<llvm::Module> get_initial_module_for_target(Target t, llvm::LLVM
                 // NoRuntime, as OS-agnostic modules like tracing are
                 // still included below.
                 if (t.arch == Target::Hexagon) {
-                    modules.push_back(get_initmod_qurt_allocator(c, bits_64, debug));
+                    modules.push_back(initmod_qurt_allocator(bits_64, debug));
                 }
-                modules.push_back(get_initmod_fake_thread_pool(c, bits_64, debug));
+                modules.push_back(initmod_fake_thread_pool(bits_64, debug));
             } else if (t.os == Target::Fuchsia) {
-                modules.push_back(get_initmod_posix_allocator(c, bits_64, debug));
-                modules.push_back(get_initmod_posix_error_handler(c, bits_64, debug));
-                modules.push_back(get_initmod_posix_print(c, bits_64, debug));
-                modules.push_back(get_initmod_fuchsia_clock(c, bits_64, debug));
-                modules.push_back(get_initmod_posix_io(c, bits_64, debug));
-                modules.push_back(get_initmod_fuchsia_host_cpu_count(c, bits_64, debug));
-                modules.push_back(get_initmod_fuchsia_yield(c, bits_64, debug));
+                modules.push_back(initmod_posix_allocator(bits_64, debug));
+                modules.push_back(initmod_posix_error_handler(bits_64, debug));
+                modules.push_back(initmod_posix_print(bits_64, debug));
+                modules.push_back(initmod_fuchsia_clock(bits_64, debug));
+                modules.push_back(initmod_posix_io(bits_64, debug));
+                modules.push_back(initmod_fuchsia_host_cpu_count(bits_64, debug));
+                modules.push_back(initmod_fuchsia_yield(bits_64, debug));
+                modules.push_back(initmod_fake_numa(bits_64, debug));
                 if (tsan) {
-                    modules.push_back(get_initmod_posix_threads_tsan(c, bits_64, debug));
+                    modules.push_back(initmod_posix_threads_tsan(bits_64, debug));
                 } else {
-                    modules.push_back(get_initmod_posix_threads(c, bits_64, debug));
+                    modules.push_back(initmod_posix_threads(bits_64, debug));
                 }
-                modules.push_back(get_initmod_posix_get_symbol(c, bits_64, debug));
+                modules.push_back(initmod_posix_get_symbol(bits_64, debug));
             }
         }
 
         if (module_type != ModuleJITShared) {
             // The first module for inline only case has to be C/C++ compiled otherwise the
             // datalayout is not properly setup.
-            modules.push_back(get_initmod_buffer_t(c, bits_64, debug));
-            modules.push_back(get_initmod_destructors(c, bits_64, debug));
-            modules.push_back(get_initmod_pseudostack(c, bits_64, debug));
+            modules.push_back(initmod_buffer_t(bits_64, debug));
+            modules.push_back(initmod_destructors(bits_64, debug));
+            modules.push_back(initmod_pseudostack(bits_64, debug));
             // Math intrinsics vary slightly across platforms
             if (t.os == Target::Windows) {
                 if (t.bits == 32) {
-                    modules.push_back(get_initmod_win32_math_ll(c));
+                    modules.push_back(initmod_win32_math_ll());
                 } else {
-                    modules.push_back(get_initmod_posix_math_ll(c));
+                    modules.push_back(initmod_posix_math_ll());
                 }
             } else {
-                modules.push_back(get_initmod_posix_math_ll(c));
+                modules.push_back(initmod_posix_math_ll());
             }
         }
 
         if (module_type != ModuleJITInlined && module_type != ModuleAOTNoRuntime) {
             // These modules are always used and shared
-            modules.push_back(get_initmod_gpu_device_selection(c, bits_64, debug));
+            modules.push_back(initmod_gpu_device_selection(bits_64, debug));
             if (t.arch != Target::Hexagon) {
                 // These modules don't behave correctly on a real
                 // Hexagon device (they do work in the simulator
                 // though...).
-                modules.push_back(get_initmod_tracing(c, bits_64, debug));
-                modules.push_back(get_initmod_trace_helper(c, bits_64, debug));
-                modules.push_back(get_initmod_write_debug_image(c, bits_64, debug));
+                modules.push_back(initmod_tracing(bits_64, debug));
+                modules.push_back(initmod_trace_helper(bits_64, debug));
+                modules.push_back(initmod_write_debug_image(bits_64, debug));
 
                 // TODO: Support this module in the Hexagon backend,
                 // currently generates assert at src/HexagonOffload.cpp:279
-                modules.push_back(get_initmod_cache(c, bits_64, debug));
+                modules.push_back(initmod_cache(bits_64, debug));
             }
-            modules.push_back(get_initmod_to_string(c, bits_64, debug));
+            modules.push_back(initmod_to_string(bits_64, debug));
 
             if (t.arch == Target::Hexagon ||
                 t.has_feature(Target::HVX_64) ||
                 t.has_feature(Target::HVX_128)) {
-                modules.push_back(get_initmod_alignment_128(c, bits_64, debug));
+                modules.push_back(initmod_alignment_128(bits_64, debug));
             } else if (t.arch == Target::X86) {
                 // AVX-512 requires 64-byte alignment. Could only increase alignment
                 // if AVX-512 is in the target, but that falls afoul of linking
@@ -962,194 +1092,201 @@ std::unique_ptr<llvm::Module> get_initial_module_for_target(Target t, llvm::LLVM
                 // 64 oonly if the procesor has AVX-512.
                 // The choice to go 64 all the time is for simplicity and on the idea
                 // that it won't be a noticeable cost in the majority of x86 usage.
-                modules.push_back(get_initmod_alignment_64(c, bits_64, debug));
+                modules.push_back(initmod_alignment_64(bits_64, debug));
             } else {
-                modules.push_back(get_initmod_alignment_32(c, bits_64, debug));
+                modules.push_back(initmod_alignment_32(bits_64, debug));
             }
 
-            modules.push_back(get_initmod_allocation_cache(c, bits_64, debug));
-            modules.push_back(get_initmod_device_interface(c, bits_64, debug));
-            modules.push_back(get_initmod_metadata(c, bits_64, debug));
-            modules.push_back(get_initmod_float16_t(c, bits_64, debug));
-            modules.push_back(get_initmod_errors(c, bits_64, debug));
+            modules.push_back(initmod_allocation_cache(bits_64, debug));
+            modules.push_back(initmod_device_interface(bits_64, debug));
+            modules.push_back(initmod_metadata(bits_64, debug));
+            modules.push_back(initmod_float16_t(bits_64, debug));
+            modules.push_back(initmod_errors(bits_64, debug));
 
 
             // Note that we deliberately include this module, even if Target::LegacyBufferWrappers
             // isn't enabled: it isn't much code, and it makes it much easier to
             // intermingle code that is built with this flag with code that is
             // built without.
-            modules.push_back(get_initmod_old_buffer_t(c, bits_64, debug));
+            modules.push_back(initmod_old_buffer_t(bits_64, debug));
 
             // Some environments don't support the atomics the profiler requires.
             if (t.arch != Target::MIPS && t.os != Target::NoOS && t.os != Target::QuRT) {
                 if (t.os == Target::Windows) {
-                    modules.push_back(get_initmod_windows_profiler(c, bits_64, debug));
+                    modules.push_back(initmod_windows_profiler(bits_64, debug));
                 } else {
-                    modules.push_back(get_initmod_profiler(c, bits_64, debug));
+                    modules.push_back(initmod_profiler(bits_64, debug));
                 }
             }
 
             if (t.has_feature(Target::MSAN)) {
-                modules.push_back(get_initmod_msan(c, bits_64, debug));
+                modules.push_back(initmod_msan(bits_64, debug));
             } else {
-                modules.push_back(get_initmod_msan_stubs(c, bits_64, debug));
+                modules.push_back(initmod_msan_stubs(bits_64, debug));
             }
         }
 
         if (module_type != ModuleJITShared) {
             // These modules are optional
             if (t.arch == Target::X86) {
-                modules.push_back(get_initmod_x86_ll(c));
+                modules.push_back(initmod_x86_ll());
             }
             if (t.arch == Target::ARM) {
                 if (t.bits == 64) {
-                  modules.push_back(get_initmod_aarch64_ll(c));
+                  modules.push_back(initmod_aarch64_ll());
                 } else if (t.has_feature(Target::ARMv7s)) {
-                    modules.push_back(get_initmod_arm_ll(c));
+                    modules.push_back(initmod_arm_ll());
                 } else if (!t.has_feature(Target::NoNEON)) {
-                    modules.push_back(get_initmod_arm_ll(c));
+                    modules.push_back(initmod_arm_ll());
                 } else {
-                    modules.push_back(get_initmod_arm_no_neon_ll(c));
+                    modules.push_back(initmod_arm_no_neon_ll());
                 }
             }
             if (t.arch == Target::MIPS) {
-                modules.push_back(get_initmod_mips_ll(c));
+                modules.push_back(initmod_mips_ll());
             }
             if (t.arch == Target::POWERPC) {
-                modules.push_back(get_initmod_powerpc_ll(c));
+                modules.push_back(initmod_powerpc_ll());
             }
             if (t.arch == Target::Hexagon) {
-                modules.push_back(get_initmod_qurt_hvx(c, bits_64, debug));
+                modules.push_back(initmod_qurt_hvx(bits_64, debug));
                 if (t.has_feature(Target::HVX_64)) {
-                    modules.push_back(get_initmod_hvx_64_ll(c));
+                    modules.push_back(initmod_hvx_64_ll());
                 } else if (t.has_feature(Target::HVX_128)) {
-                    modules.push_back(get_initmod_hvx_128_ll(c));
+                    modules.push_back(initmod_hvx_128_ll());
                 }
                 if (t.has_feature(Target::HVX_v65)) {
-                    modules.push_back(get_initmod_qurt_hvx_vtcm(c, bits_64,
-                                                                debug));
+                    modules.push_back(initmod_qurt_hvx_vtcm(bits_64, debug));
                 }
 
             } else {
-                modules.push_back(get_initmod_prefetch(c, bits_64, debug));
+                modules.push_back(initmod_prefetch(bits_64, debug));
             }
             if (t.has_feature(Target::SSE41)) {
-                modules.push_back(get_initmod_x86_sse41_ll(c));
+                modules.push_back(initmod_x86_sse41_ll());
             }
             if (t.has_feature(Target::AVX)) {
-                modules.push_back(get_initmod_x86_avx_ll(c));
+                modules.push_back(initmod_x86_avx_ll());
             }
             if (t.has_feature(Target::AVX2)) {
-                modules.push_back(get_initmod_x86_avx2_ll(c));
+                modules.push_back(initmod_x86_avx2_ll());
             }
-            if (t.has_feature(Target::Profile)) {
+            if (t.has_feature(Target::Profile) || t.has_feature(Target::ProfileHW)) {
                 user_assert(t.os != Target::WebAssemblyRuntime) << "The profiler cannot be used in a threadless environment.";
-                modules.push_back(get_initmod_profiler_inlined(c, bits_64, debug));
+                modules.push_back(initmod_profiler_inlined(bits_64, debug));
+            }
+            if (t.has_feature(Target::ProfileHW)) {
+                user_assert(t.os == Target::Linux) << "Hardware counter profiling (profile_hw) is only supported on Linux.";
+                modules.push_back(initmod_linux_profiler_hw(bits_64, debug));
             }
             if (t.arch == Target::WebAssembly) {
-                modules.push_back(get_initmod_wasm_math_ll(c));
+                modules.push_back(initmod_wasm_math_ll());
             }
         }
 
         if (module_type == ModuleAOT) {
             // These modules are only used for AOT compilation
-            modules.push_back(get_initmod_can_use_target(c, bits_64, debug));
+            modules.push_back(initmod_can_use_target(bits_64, debug));
             if (t.arch == Target::X86) {
-                modules.push_back(get_initmod_x86_cpu_features(c, bits_64, debug));
+                modules.push_back(initmod_x86_cpu_features(bits_64, debug));
             }
             if (t.arch == Target::ARM) {
-                if (t.bits == 64) {
-                    modules.push_back(get_initmod_aarch64_cpu_features(c, bits_64, debug));
+                if (t.bits == 64 && (t.os == Target::Linux || t.os == Target::Android)) {
+                    // Linux and Android describe the optional ARMv8.2
+                    // features in the aux vector.
+                    modules.push_back(initmod_linux_aarch64_cpu_features(bits_64, debug));
+                } else if (t.bits == 64) {
+                    modules.push_back(initmod_aarch64_cpu_features(bits_64, debug));
                 } else {
-                    modules.push_back(get_initmod_arm_cpu_features(c, bits_64, debug));
+                    modules.push_back(initmod_arm_cpu_features(bits_64, debug));
                 }
             }
             if (t.arch == Target::MIPS) {
-                modules.push_back(get_initmod_mips_cpu_features(c, bits_64, debug));
+                modules.push_back(initmod_mips_cpu_features(bits_64, debug));
             }
             if (t.arch == Target::POWERPC) {
-                modules.push_back(get_initmod_powerpc_cpu_features(c, bits_64, debug));
+                modules.push_back(initmod_powerpc_cpu_features(bits_64, debug));
             }
             if (t.arch == Target::Hexagon) {
-                modules.push_back(get_initmod_hexagon_cpu_features(c, bits_64, debug));
+                modules.push_back(initmod_hexagon_cpu_features(bits_64, debug));
             }
             if (t.arch == Target::RISCV) {
-                modules.push_back(get_initmod_riscv_cpu_features(c, bits_64, debug));
+                modules.push_back(initmod_riscv_cpu_features(bits_64, debug));
             }
             if (t.arch == Target::WebAssembly) {
-                modules.push_back(get_initmod_wasm_cpu_features(c, bits_64, debug));
+                modules.push_back(initmod_wasm_cpu_features(bits_64, debug));
             }
         }
 
     }
 
     if (module_type == ModuleJITShared || module_type == ModuleGPU) {
-        modules.push_back(get_initmod_module_jit_ref_count(c, bits_64, debug));
+        modules.push_back(initmod_module_jit_ref_count(bits_64, debug));
     } else if (module_type == ModuleAOT) {
-        modules.push_back(get_initmod_module_aot_ref_count(c, bits_64, debug));
+        modules.push_back(initmod_module_aot_ref_count(bits_64, debug));
     }
 
     if (t.os == Target::Windows) {
-        modules.push_back(get_initmod_windows_abort(c, bits_64, debug));
+        modules.push_back(initmod_windows_abort(bits_64, debug));
     } else {
-        modules.push_back(get_initmod_posix_abort(c, bits_64, debug));
+        modules.push_back(initmod_posix_abort(bits_64, debug));
     }
 
     if (module_type == ModuleAOT || module_type == ModuleGPU) {
         if (t.has_feature(Target::CUDA)) {
             if (t.os == Target::Windows) {
-                modules.push_back(get_initmod_windows_cuda(c, bits_64, debug));
+                modules.push_back(initmod_windows_cuda(bits_64, debug));
             } else {
-                modules.push_back(get_initmod_cuda(c, bits_64, debug));
+                modules.push_back(initmod_cuda(bits_64, debug));
             }
         }
         if (t.has_feature(Target::OpenCL)) {
             if (t.os == Target::Windows) {
-                modules.push_back(get_initmod_windows_opencl(c, bits_64, debug));
+                modules.push_back(initmod_windows_opencl(bits_64, debug));
             } else {
-                modules.push_back(get_initmod_opencl(c, bits_64, debug));
+                modules.push_back(initmod_opencl(bits_64, debug));
             }
         }
         if (t.has_feature(Target::OpenGL)) {
-            modules.push_back(get_initmod_opengl(c, bits_64, debug));
+            modules.push_back(initmod_opengl(bits_64, debug));
             if (t.os == Target::Linux) {
                 if (t.has_feature(Target::EGL)) {
-                    modules.push_back(get_initmod_opengl_egl_context(c, bits_64, debug));
+                    modules.push_back(initmod_opengl_egl_context(bits_64, debug));
                 } else {
-                    modules.push_back(get_initmod_opengl_glx_context(c, bits_64, debug));
+                    modules.push_back(initmod_opengl_glx_context(bits_64, debug));
                 }
             } else if (t.os == Target::OSX) {
-                modules.push_back(get_initmod_osx_opengl_context(c, bits_64, debug));
+                modules.push_back(initmod_osx_opengl_context(bits_64, debug));
             } else if (t.os == Target::Android) {
-              modules.push_back(get_initmod_opengl_egl_context(c, bits_64, debug));
+              modules.push_back(initmod_opengl_egl_context(bits_64, debug));
             } else {
                 // You're on your own to provide definitions of halide_opengl_get_proc_address and halide_opengl_create_context
             }
         }
         if (t.has_feature(Target::OpenGLCompute)) {
-            modules.push_back(get_initmod_openglcompute(c, bits_64, debug));
+            modules.push_back(initmod_openglcompute(bits_64, debug));
             if (t.os == Target::Android) {
                 // Only platform that supports OpenGL Compute for now.
-                modules.push_back(get_initmod_opengl_egl_context(c, bits_64, debug));
+                modules.push_back(initmod_opengl_egl_context(bits_64, debug));
             } else if (t.os == Target::Linux) {
                 if (t.has_feature(Target::EGL)) {
-                    modules.push_back(get_initmod_opengl_egl_context(c, bits_64, debug));
+                    modules.push_back(initmod_opengl_egl_context(bits_64, debug));
                 } else {
-                    modules.push_back(get_initmod_opengl_glx_context(c, bits_64, debug));
+                    modules.push_back(initmod_opengl_glx_context(bits_64, debug));
                 }
             } else if (t.os == Target::OSX) {
-                modules.push_back(get_initmod_osx_opengl_context(c, bits_64, debug));
+                modules.push_back(initmod_osx_opengl_context(bits_64, debug));
             } else {
                 // You're on your own to provide definitions of halide_opengl_get_proc_address and halide_opengl_create_context
             }
 
         }
         if (t.has_feature(Target::Metal)) {
-            modules.push_back(get_initmod_metal(c, bits_64, debug));
+            modules.push_back(initmod_metal(bits_64, debug));
             if (t.arch == Target::ARM) {
-                modules.push_back(get_initmod_metal_objc_arm(c, bits_64, debug));
+                modules.push_back(initmod_metal_objc_arm(bits_64, debug));
             } else if (t.arch == Target::X86) {
-                modules.push_back(get_initmod_metal_objc_x86(c, bits_64, debug));
+                modules.push_back(initmod_metal_objc_x86(bits_64, debug));
             } else {
                 user_error << "Metal can only be used on ARM or X86 architectures.\n";
             }
@@ -1157,43 +1294,44 @@ std::unique_ptr<llvm::Module> get_initial_module_for_target(Target t, llvm::LLVM
         if (t.has_feature(Target::D3D12Compute)) {
             user_assert(bits_64) << "D3D12Compute target only available on 64-bit targets for now.\n";
             user_assert(t.os == Target::Windows) << "D3D12Compute target only available on Windows targets.\n";
-            modules.push_back(get_initmod_d3d12_abi_patch_64_ll(c));
-            modules.push_back(get_initmod_d3d12compute(c, bits_64, debug));
+            modules.push_back(initmod_d3d12_abi_patch_64_ll());
+            modules.push_back(initmod_d3d12compute(bits_64, debug));
         }
         if (t.arch != Target::Hexagon && t.features_any_of({Target::HVX_64, Target::HVX_128})) {
-            modules.push_back(get_initmod_module_jit_ref_count(c, bits_64, debug));
-            modules.push_back(get_initmod_hexagon_host(c, bits_64, debug));
+            modules.push_back(initmod_module_jit_ref_count(bits_64, debug));
+            modules.push_back(initmod_hexagon_host(bits_64, debug));
         }
         if (t.has_feature(Target::HexagonDma)) {
-            modules.push_back(get_initmod_hexagon_cache_allocator(c, bits_64, debug));
-            modules.push_back(get_initmod_hexagon_dma(c, bits_64, debug));
-            modules.push_back(get_initmod_hexagon_dma_pool(c, bits_64, debug));
+            modules.push_back(initmod_hexagon_cache_allocator(bits_64, debug));
+            modules.push_back(initmod_hexagon_dma(bits_64, debug));
+            modules.push_back(initmod_hexagon_dma_pool(bits_64, debug));
         }
     }
 
     if (module_type == ModuleAOT && t.has_feature(Target::Matlab)) {
-        modules.push_back(get_initmod_matlab(c, bits_64, debug));
+        modules.push_back(initmod_matlab(bits_64, debug));
     }
 
     if (module_type == ModuleAOTNoRuntime ||
         module_type == ModuleJITInlined ||
         t.os == Target::NoOS) {
-        modules.push_back(get_initmod_runtime_api(c, bits_64, debug));
+        modules.push_back(initmod_runtime_api(bits_64, debug));
     }
 
-    link_modules(modules, t);
+    vector<std::unique_ptr<llvm::Module>> parsed = parse_runtime_modules(modules, t, c);
+    link_modules(parsed, t);
 
     if (t.os == Target::Windows &&
         t.bits == 32 &&
         (t.has_feature(Target::JIT))) {
-        undo_win32_name_mangling(modules[0].get());
+        undo_win32_name_mangling(parsed[0].get());
     }
 
     if (t.os == Target::Windows) {
-        add_underscores_to_posix_calls_on_windows(modules[0].get());
+        add_underscores_to_posix_calls_on_windows(parsed[0].get());
     }
 
-    return std::move(modules[0]);
+    return std::move(parsed[0]);
 }
 
 #ifdef WITH_PTX
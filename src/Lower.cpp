@@ -25,6 +25,8 @@
 #include "FuseGPUThreadLoops.h"
 #include "FuzzFloatStores.h"
 #include "HexagonOffload.h"
+#include "HoistStorage.h"
+#include "IRHashConsing.h"
 #include "IRMutator.h"
 #include "IROperator.h"
 #include "IRPrinter.h"
@@ -35,10 +37,13 @@
 #include "LICM.h"
 #include "LoopCarry.h"
 #include "LowerWarpShuffles.h"
+#include "LoweringProfiler.h"
 #include "Memoization.h"
 #include "PartitionLoops.h"
+#include "PlanMemory.h"
 #include "PurifyIndexMath.h"
 #include "Prefetch.h"
+#include "PrivatizeAtomicUpdates.h"
 #include "Profiling.h"
 #include "Qualify.h"
 #include "RealizationOrder.h"
@@ -84,7 +89,11 @@ Module lower(const vector<Function> &output_funcs,
              const LinkageType linkage_type,
              const vector<Stmt> &requirements,
              bool trace_pipeline,
-             const vector<IRMutator *> &custom_passes) {
+             const vector<IRMutator *> &custom_passes,
+             const string &lowering_profile) {
+    LoweringProfiler profiler(pipeline_name, t, lowering_profile);
+    ScopedHashConsing hash_consing(hash_consing_requested());
+
     std::vector<std::string> namespaces;
     std::string simple_pipeline_name = extract_namespaces(pipeline_name, namespaces);
 
@@ -125,16 +134,19 @@ Module lower(const vector<Function> &output_funcs,
     // Try to simplify the RHS/LHS of a function definition by propagating its
     // specializations' conditions
     simplify_specializations(env);
+    profiler.pass_done("Preparing functions", Stmt());
 
     debug(1) << "Creating initial loop nests...\n";
     bool any_memoized = false;
     Stmt s = schedule_functions(outputs, fused_groups, env, t, any_memoized);
     debug(2) << "Lowering after creating initial loop nests:\n" << s << '\n';
+    profiler.pass_done("Creating initial loop nests", s);
 
     if (any_memoized) {
         debug(1) << "Injecting memoization...\n";
         s = inject_memoization(s, env, pipeline_name, outputs);
         debug(2) << "Lowering after injecting memoization:\n" << s << '\n';
+        profiler.pass_done("Injecting memoization", s);
     } else {
         debug(1) << "Skipping injecting memoization...\n";
     }
@@ -142,10 +154,12 @@ Module lower(const vector<Function> &output_funcs,
     debug(1) << "Injecting tracing...\n";
     s = inject_tracing(s, pipeline_name, trace_pipeline, env, outputs, t);
     debug(2) << "Lowering after injecting tracing:\n" << s << '\n';
+    profiler.pass_done("Injecting tracing", s);
 
     debug(1) << "Adding checks for parameters\n";
     s = add_parameter_checks(requirements, s, t);
     debug(2) << "Lowering after injecting parameter checks:\n" << s << '\n';
+    profiler.pass_done("Adding checks for parameters", s);
 
     // Compute the maximum and minimum possible value of each
     // function. Used in later bounds inference passes.
@@ -157,6 +171,7 @@ Module lower(const vector<Function> &output_funcs,
     debug(1) << "Adding checks for images\n";
     s = add_image_checks(s, outputs, t, order, env, func_bounds);
     debug(2) << "Lowering after injecting image checks:\n" << s << '\n';
+    profiler.pass_done("Adding checks for images", s);
 
     // This pass injects nested definitions of variable names, so we
     // can't simplify statements from here until we fix them up. (We
@@ -164,26 +179,32 @@ Module lower(const vector<Function> &output_funcs,
     debug(1) << "Performing computation bounds inference...\n";
     s = bounds_inference(s, outputs, order, fused_groups, env, func_bounds, t);
     debug(2) << "Lowering after computation bounds inference:\n" << s << '\n';
+    profiler.pass_done("Performing computation bounds inference", s);
 
     debug(1) << "Removing extern loops...\n";
     s = remove_extern_loops(s);
     debug(2) << "Lowering after removing extern loops:\n" << s << '\n';
+    profiler.pass_done("Removing extern loops", s);
 
     debug(1) << "Performing sliding window optimization...\n";
     s = sliding_window(s, env);
     debug(2) << "Lowering after sliding window:\n" << s << '\n';
+    profiler.pass_done("Performing sliding window optimization", s);
 
     debug(1) << "Simplifying correlated differences...\n";
     s = simplify_correlated_differences(s);
     debug(2) << "Lowering after simplifying correlated differences:\n" << s << '\n';
+    profiler.pass_done("Simplifying correlated differences", s);
 
     debug(1) << "Performing allocation bounds inference...\n";
     s = allocation_bounds_inference(s, env, func_bounds);
     debug(2) << "Lowering after allocation bounds inference:\n" << s << '\n';
+    profiler.pass_done("Performing allocation bounds inference", s);
 
     debug(1) << "Removing code that depends on undef values...\n";
     s = remove_undef(s);
     debug(2) << "Lowering after removing code that depends on undef values:\n" << s << "\n\n";
+    profiler.pass_done("Removing code that depends on undef values", s);
 
     // This uniquifies the variable names, so we're good to simplify
     // after this point. This lets later passes assume syntactic
@@ -191,34 +212,42 @@ Module lower(const vector<Function> &output_funcs,
     debug(1) << "Uniquifying variable names...\n";
     s = uniquify_variable_names(s);
     debug(2) << "Lowering after uniquifying variable names:\n" << s << "\n\n";
+    profiler.pass_done("Uniquifying variable names", s);
 
     debug(1) << "Simplifying...\n";
     s = simplify(s, false); // Storage folding needs .loop_max symbols
     debug(2) << "Lowering after first simplification:\n" << s << "\n\n";
+    profiler.pass_done("Simplifying", s);
 
     debug(1) << "Performing storage folding optimization...\n";
     s = storage_folding(s, env);
     debug(2) << "Lowering after storage folding:\n" << s << '\n';
+    profiler.pass_done("Performing storage folding optimization", s);
 
     debug(1) << "Injecting debug_to_file calls...\n";
     s = debug_to_file(s, outputs, env);
     debug(2) << "Lowering after injecting debug_to_file calls:\n" << s << '\n';
+    profiler.pass_done("Injecting debug_to_file calls", s);
 
     debug(1) << "Injecting prefetches...\n";
     s = inject_prefetch(s, env);
     debug(2) << "Lowering after injecting prefetches:\n" << s << "\n\n";
+    profiler.pass_done("Injecting prefetches", s);
 
     debug(1) << "Dynamically skipping stages...\n";
     s = skip_stages(s, order);
     debug(2) << "Lowering after dynamically skipping stages:\n" << s << "\n\n";
+    profiler.pass_done("Dynamically skipping stages", s);
 
     debug(1) << "Forking asynchronous producers...\n";
     s = fork_async_producers(s, env);
     debug(2) << "Lowering after forking asynchronous producers:\n" << s << '\n';
+    profiler.pass_done("Forking asynchronous producers", s);
 
     debug(1) << "Destructuring tuple-valued realizations...\n";
     s = split_tuples(s, env);
     debug(2) << "Lowering after destructuring tuple-valued realizations:\n" << s << "\n\n";
+    profiler.pass_done("Destructuring tuple-valued realizations", s);
 
     // OpenGL relies on GPU var canonicalization occurring before
     // storage flattening.
@@ -229,24 +258,40 @@ Module lower(const vector<Function> &output_funcs,
         s = canonicalize_gpu_vars(s);
         debug(2) << "Lowering after canonicalizing GPU var names:\n"
                  << s << '\n';
+        profiler.pass_done("Canonicalizing GPU var names", s);
     }
 
     debug(1) << "Performing storage flattening...\n";
     s = storage_flattening(s, outputs, env, t);
     debug(2) << "Lowering after storage flattening:\n" << s << "\n\n";
+    profiler.pass_done("Performing storage flattening", s);
 
     debug(1) << "Unpacking buffer arguments...\n";
     s = unpack_buffers(s);
     debug(2) << "Lowering after unpacking buffer arguments...\n" << s << "\n\n";
+    profiler.pass_done("Unpacking buffer arguments", s);
 
     if (any_memoized) {
         debug(1) << "Rewriting memoized allocations...\n";
         s = rewrite_memoized_allocations(s, env);
         debug(2) << "Lowering after rewriting memoized allocations:\n" << s << "\n\n";
+        profiler.pass_done("Rewriting memoized allocations", s);
     } else {
         debug(1) << "Skipping rewriting memoized allocations...\n";
     }
 
+    debug(1) << "Hoisting storage...\n";
+    s = hoist_storage(s, env);
+    debug(2) << "Lowering after hoisting storage:\n" << s << "\n\n";
+    profiler.pass_done("Hoisting storage", s);
+
+    if (t.has_feature(Target::PlanMemory)) {
+        debug(1) << "Planning memory...\n";
+        s = plan_memory(s, t);
+        debug(2) << "Lowering after planning memory:\n" << s << "\n\n";
+        profiler.pass_done("Planning memory", s);
+    }
+
     if (t.has_gpu_feature() ||
         t.has_feature(Target::OpenGLCompute) ||
         t.has_feature(Target::OpenGL) ||
@@ -255,122 +300,152 @@ Module lower(const vector<Function> &output_funcs,
         debug(1) << "Selecting a GPU API for GPU loops...\n";
         s = select_gpu_api(s, t);
         debug(2) << "Lowering after selecting a GPU API:\n" << s << "\n\n";
+        profiler.pass_done("Selecting a GPU API for GPU loops", s);
 
         debug(1) << "Injecting host <-> dev buffer copies...\n";
         s = inject_host_dev_buffer_copies(s, t);
         debug(2) << "Lowering after injecting host <-> dev buffer copies:\n" << s << "\n\n";
+        profiler.pass_done("Injecting host <-> dev buffer copies", s);
 
         debug(1) << "Selecting a GPU API for extern stages...\n";
         s = select_gpu_api(s, t);
         debug(2) << "Lowering after selecting a GPU API for extern stages:\n" << s << "\n\n";
+        profiler.pass_done("Selecting a GPU API for extern stages", s);
     }
 
     if (t.has_feature(Target::OpenGL)) {
         debug(1) << "Injecting OpenGL texture intrinsics...\n";
         s = inject_opengl_intrinsics(s);
         debug(2) << "Lowering after OpenGL intrinsics:\n" << s << "\n\n";
+        profiler.pass_done("Injecting OpenGL texture intrinsics", s);
     }
 
     debug(1) << "Simplifying...\n";
     s = simplify(s);
     s = unify_duplicate_lets(s);
     debug(2) << "Lowering after second simplifcation:\n" << s << "\n\n";
+    profiler.pass_done("Simplifying", s);
 
     debug(1) << "Reduce prefetch dimension...\n";
     s = reduce_prefetch_dimension(s, t);
     debug(2) << "Lowering after reduce prefetch dimension:\n" << s << "\n";
+    profiler.pass_done("Reduce prefetch dimension", s);
 
     debug(1) << "Simplifying correlated differences...\n";
     s = simplify_correlated_differences(s);
     debug(2) << "Lowering after simplifying correlated differences:\n" << s << '\n';
+    profiler.pass_done("Simplifying correlated differences", s);
 
     debug(1) << "Unrolling...\n";
     s = unroll_loops(s);
     s = simplify(s);
     debug(2) << "Lowering after unrolling:\n" << s << "\n\n";
+    profiler.pass_done("Unrolling", s);
+
+    debug(1) << "Privatizing atomic updates...\n";
+    s = privatize_atomic_updates(s);
+    debug(2) << "Lowering after privatizing atomic updates:\n" << s << "\n\n";
+    profiler.pass_done("Privatizing atomic updates", s);
 
     debug(1) << "Vectorizing...\n";
-    s = vectorize_loops(s, t);
+    s = vectorize_loops(s, env, t);
     s = simplify(s);
     debug(2) << "Lowering after vectorizing:\n" << s << "\n\n";
+    profiler.pass_done("Vectorizing", s);
 
     if (t.has_gpu_feature() ||
         t.has_feature(Target::OpenGLCompute)) {
         debug(1) << "Injecting per-block gpu synchronization...\n";
         s = fuse_gpu_thread_loops(s);
         debug(2) << "Lowering after injecting per-block gpu synchronization:\n" << s << "\n\n";
+        profiler.pass_done("Injecting per-block gpu synchronization", s);
     }
 
     debug(1) << "Detecting vector interleavings...\n";
     s = rewrite_interleavings(s);
     s = simplify(s);
     debug(2) << "Lowering after rewriting vector interleavings:\n" << s << "\n\n";
+    profiler.pass_done("Detecting vector interleavings", s);
 
     debug(1) << "Partitioning loops to simplify boundary conditions...\n";
     s = partition_loops(s);
     s = simplify(s);
     debug(2) << "Lowering after partitioning loops:\n" << s << "\n\n";
+    profiler.pass_done("Partitioning loops to simplify boundary conditions", s);
 
     debug(1) << "Trimming loops to the region over which they do something...\n";
     s = trim_no_ops(s);
     debug(2) << "Lowering after loop trimming:\n" << s << "\n\n";
+    profiler.pass_done("Trimming loops to the region over which they do something", s);
 
     debug(1) << "Injecting early frees...\n";
     s = inject_early_frees(s);
     debug(2) << "Lowering after injecting early frees:\n" << s << "\n\n";
+    profiler.pass_done("Injecting early frees", s);
 
     if (t.has_feature(Target::FuzzFloatStores)) {
         debug(1) << "Fuzzing floating point stores...\n";
         s = fuzz_float_stores(s);
         debug(2) << "Lowering after fuzzing floating point stores:\n" << s << "\n\n";
+        profiler.pass_done("Fuzzing floating point stores", s);
     }
 
     debug(1) << "Simplifying correlated differences...\n";
     s = simplify_correlated_differences(s);
     debug(2) << "Lowering after simplifying correlated differences:\n" << s << '\n';
+    profiler.pass_done("Simplifying correlated differences", s);
 
     debug(1) << "Bounding small allocations...\n";
-    s = bound_small_allocations(s);
+    s = bound_small_allocations(s, t);
     debug(2) << "Lowering after bounding small allocations:\n" << s << "\n\n";
+    profiler.pass_done("Bounding small allocations", s);
 
-    if (t.has_feature(Target::Profile)) {
+    if (t.has_feature(Target::Profile) || t.has_feature(Target::ProfileHW)) {
         debug(1) << "Injecting profiling...\n";
-        s = inject_profiling(s, pipeline_name);
+        s = inject_profiling(s, pipeline_name, t);
         debug(2) << "Lowering after injecting profiling:\n" << s << "\n\n";
+        profiler.pass_done("Injecting profiling", s);
     }
 
     if (t.has_feature(Target::CUDA)) {
         debug(1) << "Injecting warp shuffles...\n";
         s = lower_warp_shuffles(s);
         debug(2) << "Lowering after injecting warp shuffles:\n" << s << "\n\n";
+        profiler.pass_done("Injecting warp shuffles", s);
     }
 
     debug(1) << "Simplifying...\n";
     s = common_subexpression_elimination(s);
+    profiler.pass_done("Common subexpression elimination", s);
 
     if (t.has_feature(Target::OpenGL)) {
         debug(1) << "Detecting varying attributes...\n";
         s = find_linear_expressions(s);
         debug(2) << "Lowering after detecting varying attributes:\n" << s << "\n\n";
+        profiler.pass_done("Detecting varying attributes", s);
 
         debug(1) << "Moving varying attribute expressions out of the shader...\n";
         s = setup_gpu_vertex_buffer(s);
         debug(2) << "Lowering after removing varying attributes:\n" << s << "\n\n";
+        profiler.pass_done("Moving varying attribute expressions out of the shader", s);
     }
 
     debug(1) << "Lowering unsafe promises...\n";
     s = lower_unsafe_promises(s, t);
     debug(2) << "Lowering after lowering unsafe promises:\n" << s << "\n\n";
+    profiler.pass_done("Lowering unsafe promises", s);
 
     s = remove_dead_allocations(s);
     s = simplify(s);
     s = loop_invariant_code_motion(s);
     debug(1) << "Lowering after final simplification:\n" << s << "\n\n";
+    profiler.pass_done("Final simplification", s);
 
     if (t.arch != Target::Hexagon && (t.features_any_of({Target::HVX_64, Target::HVX_128}))) {
         debug(1) << "Splitting off Hexagon offload...\n";
         s = inject_hexagon_rpc(s, t, result_module);
         debug(2) << "Lowering after splitting off Hexagon offload:\n" << s << '\n';
+        profiler.pass_done("Splitting off Hexagon offload", s);
     } else {
         debug(1) << "Skipping Hexagon offload...\n";
     }
@@ -380,6 +455,7 @@ Module lower(const vector<Function> &output_funcs,
             debug(1) << "Running custom lowering pass " << i << "...\n";
             s = custom_passes[i]->mutate(s);
             debug(1) << "Lowering after custom pass " << i << ":\n" << s << "\n\n";
+            profiler.pass_done("Running custom lowering pass " + std::to_string(i), s);
         }
     }
 
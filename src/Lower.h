@@ -25,7 +25,9 @@ class IRMutator;
  * contain submodules for computation offloaded to another execution
  * engine or API as well as buffers that are used in the passed in
  * Stmt. Multiple LoweredFuncs are added to support legacy buffer_t
- * calling convention. */
+ * calling convention. If lowering_profile names a file, a profile of
+ * the time taken by each lowering pass is written to it (see
+ * LoweringProfiler). */
 Module lower(const std::vector<Function> &output_funcs,
              const std::string &pipeline_name,
              const Target &t,
@@ -33,7 +35,8 @@ Module lower(const std::vector<Function> &output_funcs,
              const LinkageType linkage_type,
              const std::vector<Stmt> &requirements = std::vector<Stmt>(),
              bool trace_pipeline = false,
-             const std::vector<IRMutator *> &custom_passes = std::vector<IRMutator *>());
+             const std::vector<IRMutator *> &custom_passes = std::vector<IRMutator *>(),
+             const std::string &lowering_profile = std::string());
 
 /** Given a halide function with a schedule, create a statement that
  * evaluates it. Automatically pulls in all the functions f depends
@@ -0,0 +1,199 @@
+#include "LoweringProfiler.h"
+
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_set>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#include "Debug.h"
+#include "Error.h"
+#include "IRVisitor.h"
+#include "Util.h"
+
+namespace Halide {
+namespace Internal {
+
+namespace {
+
+class CountIRNodes : public IRGraphVisitor {
+    std::unordered_set<const IRNode *> nodes;
+
+    using IRGraphVisitor::visit;
+
+    void include(const Expr &e) override {
+        if (nodes.insert(e.get()).second) {
+            e.accept(this);
+        }
+    }
+
+    void include(const Stmt &s) override {
+        if (nodes.insert(s.get()).second) {
+            s.accept(this);
+        }
+    }
+
+public:
+    int64_t count(const Stmt &s) {
+        if (s.defined()) {
+            include(s);
+        }
+        return (int64_t)nodes.size();
+    }
+};
+
+// All profiles are timed relative to the first one, so that profiles
+// of different calls to lower() line up in the trace.
+std::chrono::steady_clock::time_point profile_epoch() {
+    static std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    return epoch;
+}
+
+// The trace events written so far to each profile file.
+std::mutex profile_files_mutex;
+std::map<std::string, std::vector<std::string>> profile_files;
+
+// Chrome traces lay out events by thread id. Give each thread that
+// lowers something a small, stable one. Must hold profile_files_mutex.
+int profile_thread_id() {
+    static std::map<std::thread::id, int> ids;
+    auto it = ids.find(std::this_thread::get_id());
+    if (it == ids.end()) {
+        it = ids.emplace(std::this_thread::get_id(), (int)ids.size()).first;
+    }
+    return it->second;
+}
+
+std::string json_escape(const std::string &s) {
+    std::string result;
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            result += '\\';
+            result += c;
+        } else if ((unsigned char)c < 0x20) {
+            result += ' ';
+        } else {
+            result += c;
+        }
+    }
+    return result;
+}
+
+}  // namespace
+
+int64_t count_ir_nodes(const Stmt &s) {
+    return CountIRNodes().count(s);
+}
+
+int64_t peak_resident_set_size() {
+#ifdef _WIN32
+    return -1;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return -1;
+    }
+#ifdef __APPLE__
+    // Reported in bytes.
+    return (int64_t)usage.ru_maxrss;
+#else
+    // Reported in kilobytes.
+    return (int64_t)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+LoweringProfiler::LoweringProfiler(const std::string &pipeline_name, const Target &t,
+                                   const std::string &filename)
+    : filename(filename), pipeline_name(pipeline_name), target(t.to_string()) {
+    if (this->filename.empty()) {
+        this->filename = get_env_variable("HL_LOWERING_PROFILE");
+    }
+    profile_epoch();
+    start = last = std::chrono::steady_clock::now();
+}
+
+double LoweringProfiler::microseconds_since_epoch(std::chrono::steady_clock::time_point t) const {
+    return std::chrono::duration<double, std::micro>(t - profile_epoch()).count();
+}
+
+void LoweringProfiler::pass_done(const std::string &pass_name, const Stmt &s) {
+    if (!enabled()) {
+        return;
+    }
+    auto now = std::chrono::steady_clock::now();
+    PassRecord record;
+    record.name = pass_name;
+    record.start_us = microseconds_since_epoch(last);
+    record.duration_us = std::chrono::duration<double, std::micro>(now - last).count();
+    record.nodes_before = last_nodes;
+    record.nodes_after = count_ir_nodes(s);
+    record.peak_rss = peak_resident_set_size();
+    passes.push_back(record);
+
+    last_nodes = record.nodes_after;
+    // Don't charge the time spent counting nodes to the next pass.
+    last = std::chrono::steady_clock::now();
+}
+
+LoweringProfiler::~LoweringProfiler() {
+    if (!enabled()) {
+        return;
+    }
+    auto end = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(profile_files_mutex);
+    const int tid = profile_thread_id();
+    const std::string pipeline = json_escape(pipeline_name);
+
+    std::vector<std::string> events;
+    {
+        std::ostringstream event;
+        event << std::fixed << std::setprecision(3);
+        event << "{\"name\": \"lower " << pipeline << "\", \"cat\": \"lower\", \"ph\": \"X\""
+              << ", \"ts\": " << microseconds_since_epoch(start)
+              << ", \"dur\": " << std::chrono::duration<double, std::micro>(end - start).count()
+              << ", \"pid\": 0, \"tid\": " << tid
+              << ", \"args\": {\"pipeline\": \"" << pipeline << "\""
+              << ", \"target\": \"" << json_escape(target) << "\""
+              << ", \"ir_nodes\": " << last_nodes
+              << ", \"peak_rss_bytes\": " << peak_resident_set_size() << "}}";
+        events.push_back(event.str());
+    }
+    for (const PassRecord &p : passes) {
+        std::ostringstream event;
+        event << std::fixed << std::setprecision(3);
+        event << "{\"name\": \"" << json_escape(p.name) << "\", \"cat\": \"lowering_pass\", \"ph\": \"X\""
+              << ", \"ts\": " << p.start_us
+              << ", \"dur\": " << p.duration_us
+              << ", \"pid\": 0, \"tid\": " << tid
+              << ", \"args\": {\"pipeline\": \"" << pipeline << "\""
+              << ", \"ir_nodes_before\": " << p.nodes_before
+              << ", \"ir_nodes_after\": " << p.nodes_after
+              << ", \"peak_rss_bytes\": " << p.peak_rss << "}}";
+        events.push_back(event.str());
+    }
+
+    std::vector<std::string> &all_events = profile_files[filename];
+    all_events.insert(all_events.end(), events.begin(), events.end());
+
+    std::ofstream file(filename);
+    if (!file) {
+        user_warning << "Could not open lowering profile " << filename << " for writing\n";
+        return;
+    }
+    file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    for (size_t i = 0; i < all_events.size(); i++) {
+        file << all_events[i] << (i + 1 < all_events.size() ? ",\n" : "\n");
+    }
+    file << "]}\n";
+    debug(1) << "Wrote lowering profile for " << pipeline_name << " to " << filename << "\n";
+}
+
+}  // namespace Internal
+}  // namespace Halide
@@ -0,0 +1,70 @@
+#ifndef HALIDE_LOWERING_PROFILER_H
+#define HALIDE_LOWERING_PROFILER_H
+
+/** \file
+ * Defines a class that records how long each lowering pass takes, and
+ * how it changes the size of the IR.
+ */
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "Expr.h"
+#include "Target.h"
+
+namespace Halide {
+namespace Internal {
+
+/** The count of distinct IR nodes reachable from a Stmt. Shared
+ * subexpressions are only counted once. */
+int64_t count_ir_nodes(const Stmt &s);
+
+/** The peak resident set size of this process so far, in bytes, or -1
+ * if it isn't known on this platform. */
+int64_t peak_resident_set_size();
+
+/** Records the wall time, IR node counts before and after, and peak
+ * resident set size of each pass in a single call to lower(), and
+ * appends them to a Chrome trace-format JSON file (readable with
+ * chrome://tracing or Perfetto) when done. The file used is the one
+ * passed to the constructor, or if that's empty, the one named by the
+ * environment variable HL_LOWERING_PROFILE. If neither names a file,
+ * the profiler does nothing. A file collects the profiles of every
+ * call to lower() made by this process, and is rewritten in full each
+ * time one finishes. */
+class LoweringProfiler {
+public:
+    LoweringProfiler(const std::string &pipeline_name, const Target &t,
+                     const std::string &filename);
+    ~LoweringProfiler();
+
+    /** Whether passes are being recorded. */
+    bool enabled() const {
+        return !filename.empty();
+    }
+
+    /** Record that a pass named pass_name just finished, producing s. Its
+     * start is the end of the previous pass. */
+    void pass_done(const std::string &pass_name, const Stmt &s);
+
+private:
+    struct PassRecord {
+        std::string name;
+        double start_us, duration_us;
+        int64_t nodes_before, nodes_after;
+        int64_t peak_rss;
+    };
+
+    std::string filename, pipeline_name, target;
+    std::chrono::steady_clock::time_point start, last;
+    int64_t last_nodes = 0;
+    std::vector<PassRecord> passes;
+
+    double microseconds_since_epoch(std::chrono::steady_clock::time_point t) const;
+};
+
+}  // namespace Internal
+}  // namespace Halide
+
+#endif
@@ -1,8 +1,10 @@
 #include "Module.h"
 
 #include <array>
+#include <deque>
 #include <fstream>
 #include <future>
+#include <thread>
 
 #include "CodeGen_C.h"
 #include "CodeGen_PyTorch.h"
@@ -118,6 +120,32 @@ Outputs add_suffixes(const Outputs &in, const std::string &suffix) {
     return out;
 }
 
+// Write the outputs that LLVM produces from an already-generated LLVM
+// module. This doesn't touch any Halide state, so it's safe to do
+// concurrently for modules in different LLVMContexts.
+void emit_llvm_outputs(llvm::Module &llvm_module, const Outputs &output_files) {
+    if (!output_files.object_name.empty()) {
+        debug(1) << "Module.compile(): object_name " << output_files.object_name << "\n";
+        auto out = make_raw_fd_ostream(output_files.object_name);
+        compile_llvm_module_to_object(llvm_module, *out);
+    }
+    if (!output_files.assembly_name.empty()) {
+        debug(1) << "Module.compile(): assembly_name " << output_files.assembly_name << "\n";
+        auto out = make_raw_fd_ostream(output_files.assembly_name);
+        compile_llvm_module_to_assembly(llvm_module, *out);
+    }
+    if (!output_files.bitcode_name.empty()) {
+        debug(1) << "Module.compile(): bitcode_name " << output_files.bitcode_name << "\n";
+        auto out = make_raw_fd_ostream(output_files.bitcode_name);
+        compile_llvm_module_to_llvm_bitcode(llvm_module, *out);
+    }
+    if (!output_files.llvm_assembly_name.empty()) {
+        debug(1) << "Module.compile(): llvm_assembly_name " << output_files.llvm_assembly_name << "\n";
+        auto out = make_raw_fd_ostream(output_files.llvm_assembly_name);
+        compile_llvm_module_to_llvm_assembly(llvm_module, *out);
+    }
+}
+
 void emit_registration(const Module &m, std::ostream &stream) {
     /*
         This relies on the filter library being linked in a way that doesn't
@@ -546,11 +574,7 @@ void Module::compile(const Outputs &output_files_arg) const {
         llvm::LLVMContext context;
         std::unique_ptr<llvm::Module> llvm_module(compile_module_to_llvm_module(*this, context));
 
-        if (!output_files.object_name.empty()) {
-            debug(1) << "Module.compile(): object_name " << output_files.object_name << "\n";
-            auto out = make_raw_fd_ostream(output_files.object_name);
-            compile_llvm_module_to_object(*llvm_module, *out);
-        }
+        Internal::emit_llvm_outputs(*llvm_module, output_files);
         if (!output_files.static_library_name.empty()) {
             // To simplify the code, we always create a temporary object output
             // here, even if output_files.object_name was also set: in practice,
@@ -569,21 +593,6 @@ void Module::compile(const Outputs &output_files_arg) const {
             Target base_target(target().os, target().arch, target().bits);
             create_static_library(temp_dir.files(), base_target, output_files.static_library_name);
         }
-        if (!output_files.assembly_name.empty()) {
-            debug(1) << "Module.compile(): assembly_name " << output_files.assembly_name << "\n";
-            auto out = make_raw_fd_ostream(output_files.assembly_name);
-            compile_llvm_module_to_assembly(*llvm_module, *out);
-        }
-        if (!output_files.bitcode_name.empty()) {
-            debug(1) << "Module.compile(): bitcode_name " << output_files.bitcode_name << "\n";
-            auto out = make_raw_fd_ostream(output_files.bitcode_name);
-            compile_llvm_module_to_llvm_bitcode(*llvm_module, *out);
-        }
-        if (!output_files.llvm_assembly_name.empty()) {
-            debug(1) << "Module.compile(): llvm_assembly_name " << output_files.llvm_assembly_name << "\n";
-            auto out = make_raw_fd_ostream(output_files.llvm_assembly_name);
-            compile_llvm_module_to_llvm_assembly(*llvm_module, *out);
-        }
     }
     if (!output_files.c_header_name.empty()) {
         debug(1) << "Module.compile(): c_header_name " << output_files.c_header_name << "\n";
@@ -670,8 +679,10 @@ void compile_multitarget(const std::string &fn_name,
                          const Outputs &output_files,
                          const std::vector<Target> &targets,
                          ModuleProducer module_producer,
-                         const std::map<std::string, std::string> &suffixes) {
+                         const std::map<std::string, std::string> &suffixes,
+                         int jobs) {
     user_assert(!fn_name.empty()) << "Function name must be specified.\n";
+    user_assert(jobs >= 0) << "The number of jobs for compile_multitarget must not be negative.\n";
     user_assert(!targets.empty()) << "Must specify at least one target.\n";
 
     // You can't ask for .o files when doing this; it's not really useful,
@@ -712,7 +723,29 @@ void compile_multitarget(const std::string &fn_name,
     constexpr int kFeaturesWordCount = (Target::FeatureEnd + 63) / (sizeof(uint64_t) * 8);
     uint64_t runtime_features[kFeaturesWordCount] = {(uint64_t)-1LL};
 
+    // Lowering a sub-target and converting it to LLVM IR must happen
+    // one target at a time, in order: both make up names using
+    // process-wide counters, and the module producer may not be safe to
+    // call concurrently (e.g. it may re-lower the same Pipeline). Each
+    // sub-target gets its own LLVMContext though, so with more than one
+    // job the backend work of turning its LLVM IR into object code,
+    // which is usually the bulk of the compile time, runs on a separate
+    // thread while the next target is lowered. Outputs are only ever written to their own files, and
+    // the archive is assembled in target order afterwards, so the result
+    // is the same as a serial build.
+    struct SubTargetBackend {
+        std::unique_ptr<llvm::LLVMContext> context;
+        std::unique_ptr<llvm::Module> module;
+        Outputs outputs;
+    };
+    if (jobs == 0) {
+        jobs = std::max(1, (int)std::thread::hardware_concurrency());
+    }
+
     TemporaryObjectFileDir temp_dir;
+    // Declared after temp_dir so that, if something throws, the jobs
+    // are finished before their output files are cleaned up.
+    std::deque<std::future<void>> backends;
     std::vector<Expr> wrapper_args;
     std::vector<LoweredArgument> base_target_args;
     std::vector<AutoSchedulerResults> auto_scheduler_results;
@@ -769,7 +802,36 @@ void compile_multitarget(const std::string &fn_name,
         sub_out.registration_name.clear();
         sub_out.schedule_name.clear();
         debug(1) << "compile_multitarget: compile_sub_target " << sub_out.object_name << "\n";
+
+        // Produce everything that doesn't come out of LLVM right away,
+        // and set up the rest to be emitted by a backend job.
+        std::shared_ptr<SubTargetBackend> backend = std::make_shared<SubTargetBackend>();
+        backend->outputs = Outputs()
+            .object(sub_out.object_name)
+            .assembly(sub_out.assembly_name)
+            .bitcode(sub_out.bitcode_name)
+            .llvm_assembly(sub_out.llvm_assembly_name);
+        sub_out.object_name.clear();
+        sub_out.assembly_name.clear();
+        sub_out.bitcode_name.clear();
+        sub_out.llvm_assembly_name.clear();
         sub_module.compile(sub_out);
+
+        const Module &resolved = sub_module.submodules().empty() ? sub_module : sub_module.resolve_submodules();
+        backend->context.reset(new llvm::LLVMContext());
+        backend->module = compile_module_to_llvm_module(resolved, *backend->context);
+
+        if (jobs == 1) {
+            emit_llvm_outputs(*backend->module, backend->outputs);
+        } else {
+            if ((int)backends.size() >= jobs - 1) {
+                backends.front().get();
+                backends.pop_front();
+            }
+            backends.push_back(std::async(std::launch::async, [backend]() {
+                emit_llvm_outputs(*backend->module, backend->outputs);
+            }));
+        }
         auto *r = sub_module.get_auto_scheduler_results();
         auto_scheduler_results.push_back(r ? *r : AutoSchedulerResults());
 
@@ -933,6 +995,12 @@ void compile_multitarget(const std::string &fn_name,
         emit_schedule_file(fn_name, targets, scheduler, machine_params, body.str(), file);
     }
 
+    // Wait for the remaining backend jobs (and rethrow any errors they hit).
+    while (!backends.empty()) {
+        backends.front().get();
+        backends.pop_front();
+    }
+
     if (!output_files.static_library_name.empty()) {
         debug(1) << "compile_multitarget: static_library_name " << output_files.static_library_name << "\n";
         create_static_library(temp_dir.files(), base_target, output_files.static_library_name);
@@ -169,11 +169,19 @@ Outputs compile_standalone_runtime(const Outputs &output_files, Target t);
 
 typedef std::function<Module(const std::string &, const Target &)> ModuleProducer;
 
+/** Compile a pipeline for several targets into a single static library
+ * that picks the best variant at runtime. Each target is lowered in
+ * order. By default each is also turned into object code before the
+ * next is lowered; with 'jobs' greater than one, up to that many
+ * targets are turned into object code concurrently on separate
+ * threads (zero means one per host core). The output does not depend
+ * on the number of jobs. */
 void compile_multitarget(const std::string &fn_name,
                          const Outputs &output_files,
                          const std::vector<Target> &targets,
                          ModuleProducer module_producer,
-                         const std::map<std::string, std::string> &suffixes = {});
+                         const std::map<std::string, std::string> &suffixes = {},
+                         int jobs = 1);
 
 }  // namespace Halide
 
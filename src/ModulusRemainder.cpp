@@ -59,6 +59,7 @@ public:
     void visit(const ProducerConsumer *) override;
     void visit(const For *) override;
     void visit(const Acquire *) override;
+    void visit(const Atomic *) override;
     void visit(const Store *) override;
     void visit(const Provide *) override;
     void visit(const Allocate *) override;
@@ -69,6 +70,7 @@ public:
     void visit(const Free *) override;
     void visit(const Evaluate *) override;
     void visit(const Shuffle *) override;
+    void visit(const VectorReduce *) override;
     void visit(const Prefetch *) override;
 };
 
@@ -477,6 +479,11 @@ void ComputeModulusRemainder::visit(const Shuffle *op) {
     result = ModulusRemainder{};
 }
 
+void ComputeModulusRemainder::visit(const VectorReduce *op) {
+    internal_assert(op->type.is_scalar()) << "modulus_remainder of vector\n";
+    result = ModulusRemainder{};
+}
+
 void ComputeModulusRemainder::visit(const LetStmt *) {
     internal_assert(false) << "modulus_remainder of statement\n";
 }
@@ -497,6 +504,10 @@ void ComputeModulusRemainder::visit(const Acquire *) {
     internal_assert(false) << "modulus_remainder of statement\n";
 }
 
+void ComputeModulusRemainder::visit(const Atomic *) {
+    internal_assert(false) << "modulus_remainder of statement\n";
+}
+
 void ComputeModulusRemainder::visit(const Store *) {
     internal_assert(false) << "modulus_remainder of statement\n";
 }
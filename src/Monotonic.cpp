@@ -338,6 +338,24 @@ class MonotonicVisitor : public IRVisitor {
         result = Monotonic::Constant;
     }
 
+    void visit(const VectorReduce *op) override {
+        op->value.accept(this);
+        switch (op->op) {
+        case VectorReduce::Add:
+        case VectorReduce::Min:
+        case VectorReduce::Max:
+        case VectorReduce::And:
+        case VectorReduce::Or:
+            // These preserve the monotonicity of the lanes.
+            break;
+        case VectorReduce::Mul:
+            if (result != Monotonic::Constant) {
+                result = Monotonic::Unknown;
+            }
+            break;
+        }
+    }
+
     void visit(const LetStmt *op) override {
         internal_error << "Monotonic of statement\n";
     }
@@ -358,6 +376,10 @@ class MonotonicVisitor : public IRVisitor {
         internal_error << "Monotonic of statement\n";
     }
 
+    void visit(const Atomic *op) override {
+        internal_error << "Monotonic of statement\n";
+    }
+
     void visit(const Store *op) override {
         internal_error << "Monotonic of statement\n";
     }
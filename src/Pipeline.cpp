@@ -98,6 +98,10 @@ struct PipelineContents {
 
     bool trace_pipeline;
 
+    /** A file to write a profile of lowering to, if any. See
+     * Pipeline::profile_lowering. */
+    std::string lowering_profile;
+
     PipelineContents() :
         module("", Target()), trace_pipeline(false) {
         user_context_arg.arg = Argument("__user_context", Argument::InputScalar, type_of<const void*>(), 0, ArgumentEstimates{});
@@ -466,7 +470,7 @@ Module Pipeline::compile_to_module(const vector<Argument> &args,
 
         contents->module = lower(contents->outputs, new_fn_name, target, lowering_args,
                                  linkage_type, contents->requirements, contents->trace_pipeline,
-                                 custom_passes);
+                                 custom_passes, contents->lowering_profile);
     }
 
     return contents->module;
@@ -755,6 +759,14 @@ void Pipeline::trace_pipeline() {
     contents->trace_pipeline = true;
 }
 
+void Pipeline::profile_lowering(const std::string &filename) {
+    user_assert(defined()) << "Pipeline is undefined\n";
+    // Make sure the next compilation lowers again, so there is
+    // something to profile.
+    contents->invalidate_cache();
+    contents->lowering_profile = filename;
+}
+
 namespace {
 
 struct ErrorBuffer {
@@ -1103,7 +1115,7 @@ void Pipeline::realize(RealizationArg outputs, const Target &t,
     debug(2) << "Back from jitted function. Exit status was " << exit_status << "\n";
 
     // If we're profiling, report runtimes and reset profiler stats.
-    if (target.has_feature(Target::Profile)) {
+    if (target.has_feature(Target::Profile) || target.has_feature(Target::ProfileHW)) {
         JITModule::Symbol report_sym =
             contents->jit_module.find_symbol_by_name("halide_profiler_report");
         JITModule::Symbol reset_sym =
@@ -482,6 +482,16 @@ public:
     /** Generate begin_pipeline and end_pipeline tracing calls for this pipeline. */
     void trace_pipeline();
 
+    /** Write a profile of the wall time, peak resident set size, and
+     * IR node counts before and after each lowering pass to the given
+     * file every time this pipeline is lowered. The file is in Chrome
+     * trace-format JSON, so it can be loaded into chrome://tracing or
+     * Perfetto. Setting the environment variable HL_LOWERING_PROFILE to
+     * a filename does the same for every pipeline that doesn't name its
+     * own file, which is the default, or what passing an empty string
+     * restores. */
+    void profile_lowering(const std::string &filename);
+
     template<typename ...Args>
     inline HALIDE_NO_USER_CODE_INLINE void add_requirement(Expr condition, Args&&... args) {
         std::vector<Expr> collected_args;
@@ -0,0 +1,461 @@
+#include <algorithm>
+#include <climits>
+#include <set>
+
+#include "PlanMemory.h"
+#include "CodeGen_GPU_Dev.h"
+#include "CodeGen_Internal.h"
+#include "Debug.h"
+#include "ExprUsesVar.h"
+#include "IRMutator.h"
+#include "IROperator.h"
+#include "IRVisitor.h"
+#include "Scope.h"
+#include "Simplify.h"
+
+namespace Halide {
+namespace Internal {
+
+using std::map;
+using std::pair;
+using std::set;
+using std::string;
+using std::vector;
+
+namespace {
+
+// Each slot of an arena starts at a multiple of this many bytes: at
+// least a cache line, and at least the target's widest native vector.
+int arena_alignment(const Target &target) {
+    return std::max(64, target.natural_vector_size(UInt(8)));
+}
+
+// Find the allocations that are used other than by loads and stores
+// on the host, e.g. by extern stages, device code, or prefetches.
+// Those must keep an allocation of their own.
+class FindUnplannableAllocations : public IRVisitor {
+    using IRVisitor::visit;
+
+    bool in_device_code = false;
+
+    void visit(const Variable *op) override {
+        result.insert(op->name);
+    }
+
+    void visit(const Load *op) override {
+        if (in_device_code) {
+            result.insert(op->name);
+        }
+        IRVisitor::visit(op);
+    }
+
+    void visit(const Store *op) override {
+        if (in_device_code) {
+            result.insert(op->name);
+        }
+        IRVisitor::visit(op);
+    }
+
+    void visit(const For *op) override {
+        bool device_loop = ((op->device_api != DeviceAPI::None &&
+                             op->device_api != DeviceAPI::Host) ||
+                            CodeGen_GPU_Dev::is_gpu_var(op->name));
+        ScopedValue<bool> old_in_device_code(in_device_code, in_device_code || device_loop);
+        IRVisitor::visit(op);
+    }
+
+public:
+    set<string> result;
+};
+
+// Compute the lifetime of each of a set of allocations, in terms of a
+// clock that ticks once per statement executed in program order. A
+// use inside a loop (or a fork) keeps the allocation alive for the
+// entire loop.
+class LiveRanges : public IRVisitor {
+    using IRVisitor::visit;
+
+    const set<string> &names;
+
+    int clock = 0;
+
+    // The allocations used inside the outermost loop or fork being
+    // visited, if any.
+    set<string> *used_in_loop = nullptr;
+
+    void extend(const string &name, int first, int last) {
+        auto it = ranges.find(name);
+        if (it == ranges.end()) {
+            ranges[name] = {first, last};
+        } else {
+            it->second.first = std::min(it->second.first, first);
+            it->second.second = std::max(it->second.second, last);
+        }
+    }
+
+    void use(const string &name) {
+        if (!names.count(name)) {
+            return;
+        }
+        if (used_in_loop) {
+            used_in_loop->insert(name);
+        } else {
+            extend(name, clock, clock);
+        }
+    }
+
+    template<typename T>
+    void visit_span(const T *op) {
+        if (used_in_loop) {
+            IRVisitor::visit(op);
+            return;
+        }
+        int first = ++clock;
+        set<string> used;
+        {
+            ScopedValue<set<string> *> old_used_in_loop(used_in_loop, &used);
+            IRVisitor::visit(op);
+        }
+        int last = ++clock;
+        for (const string &name : used) {
+            extend(name, first, last);
+        }
+    }
+
+    void visit(const For *op) override {
+        visit_span(op);
+    }
+
+    void visit(const Fork *op) override {
+        visit_span(op);
+    }
+
+    void visit(const Load *op) override {
+        use(op->name);
+        IRVisitor::visit(op);
+    }
+
+    void visit(const Store *op) override {
+        clock++;
+        use(op->name);
+        IRVisitor::visit(op);
+    }
+
+    void visit(const LetStmt *op) override {
+        clock++;
+        IRVisitor::visit(op);
+    }
+
+    void visit(const AssertStmt *op) override {
+        clock++;
+        IRVisitor::visit(op);
+    }
+
+    void visit(const Evaluate *op) override {
+        clock++;
+        IRVisitor::visit(op);
+    }
+
+    void visit(const IfThenElse *op) override {
+        clock++;
+        IRVisitor::visit(op);
+    }
+
+public:
+    // The first and last clock tick at which each allocation is used.
+    map<string, pair<int, int>> ranges;
+
+    LiveRanges(const set<string> &names) : names(names) {}
+};
+
+// Remove the plannable allocations made at the same site as the
+// outermost one, i.e. without crossing a loop, fork, or branch, and
+// whose sizes don't depend on anything defined in between.
+class ExtractAllocations : public IRMutator {
+    using IRMutator::visit;
+
+    const set<string> &unplannable;
+    const Target &target;
+
+    // Names defined since the outermost allocation.
+    Scope<> defined;
+
+    Stmt visit(const LetStmt *op) override {
+        ScopedBinding<> bind(defined, op->name);
+        Stmt body = mutate(op->body);
+        return LetStmt::make(op->name, op->value, body);
+    }
+
+    Stmt visit(const Allocate *op) override {
+        bool depends_on_inner_lets = false;
+        for (const Expr &e : op->extents) {
+            depends_on_inner_lets |= expr_uses_vars(e, defined);
+        }
+        if (depends_on_inner_lets ||
+            !is_plannable(op, unplannable, target) ||
+            names.count(op->name)) {
+            return IRMutator::visit(op);
+        }
+        allocations.push_back(op);
+        names.insert(op->name);
+        return mutate(op->body);
+    }
+
+    Stmt visit(const Free *op) override {
+        if (names.count(op->name)) {
+            return Evaluate::make(0);
+        }
+        return op;
+    }
+
+    Stmt visit(const For *op) override {
+        return op;
+    }
+
+    Stmt visit(const Fork *op) override {
+        return op;
+    }
+
+    Stmt visit(const IfThenElse *op) override {
+        return op;
+    }
+
+    Stmt visit(const Acquire *op) override {
+        return op;
+    }
+
+    Stmt visit(const Atomic *op) override {
+        return op;
+    }
+
+public:
+    vector<const Allocate *> allocations;
+    set<string> names;
+
+    static bool is_plannable(const Allocate *op, const set<string> &unplannable, const Target &target) {
+        if (unplannable.count(op->name) ||
+            op->new_expr.defined() ||
+            !op->free_function.empty() ||
+            !is_one(op->condition) ||
+            op->type.is_handle()) {
+            return false;
+        }
+        if (op->memory_type == MemoryType::Heap) {
+            return true;
+        } else if (op->memory_type == MemoryType::Auto) {
+            // Small constant-sized allocations go on the stack.
+            int32_t size = op->constant_allocation_size();
+            return size == 0 || !can_allocation_fit_on_stack((int64_t)size * op->type.bytes(), target);
+        } else {
+            return false;
+        }
+    }
+
+    ExtractAllocations(const set<string> &unplannable, const Target &target)
+        : unplannable(unplannable), target(target) {}
+};
+
+// Redirect the loads and stores of allocations that have been packed
+// into an arena to their offset within it.
+class RedirectToArena : public IRMutator {
+    using IRMutator::visit;
+
+    const string &arena;
+    const map<string, Expr> &offsets;
+    const int alignment;
+
+    Expr offset_index(const string &name, const Expr &index) {
+        Expr offset = offsets.find(name)->second;
+        if (index.type().is_vector()) {
+            offset = Broadcast::make(offset, index.type().lanes());
+        }
+        return index + offset;
+    }
+
+    // Slots start at a multiple of the arena alignment from the start
+    // of the arena, so an access keeps the part of its alignment that
+    // the slot's offset preserves. Indices are in elements, even for
+    // vector accesses.
+    ModulusRemainder offset_alignment(const ModulusRemainder &a, const Type &t) {
+        return a + ModulusRemainder(alignment / t.element_of().bytes(), 0);
+    }
+
+    Expr visit(const Load *op) override {
+        if (!offsets.count(op->name)) {
+            return IRMutator::visit(op);
+        }
+        Expr predicate = mutate(op->predicate);
+        Expr index = offset_index(op->name, mutate(op->index));
+        return Load::make(op->type, arena, index, Buffer<>(), Parameter(),
+                          predicate, offset_alignment(op->alignment, op->type));
+    }
+
+    Stmt visit(const Store *op) override {
+        if (!offsets.count(op->name)) {
+            return IRMutator::visit(op);
+        }
+        Expr predicate = mutate(op->predicate);
+        Expr value = mutate(op->value);
+        Expr index = offset_index(op->name, mutate(op->index));
+        return Store::make(arena, value, index, Parameter(), predicate,
+                           offset_alignment(op->alignment, op->value.type()));
+    }
+
+public:
+    RedirectToArena(const string &arena, const map<string, Expr> &offsets, int alignment)
+        : arena(arena), offsets(offsets), alignment(alignment) {}
+};
+
+class PlanMemory : public IRMutator {
+    using IRMutator::visit;
+
+    const set<string> &unplannable;
+    const Target &target;
+
+    Stmt visit(const Allocate *op) override {
+        if (!ExtractAllocations::is_plannable(op, unplannable, target)) {
+            return IRMutator::visit(op);
+        }
+
+        ExtractAllocations extractor(unplannable, target);
+        Stmt body = extractor.mutate(op);
+        const vector<const Allocate *> &allocations = extractor.allocations;
+        if (allocations.size() < 2) {
+            return IRMutator::visit(op);
+        }
+
+        LiveRanges live(extractor.names);
+        body.accept(&live);
+
+        // Assign each allocation to the first slot that's free for
+        // its whole lifetime and holds elements of the same size, in
+        // order of first use. Allocations that are never used are
+        // dropped.
+        vector<const Allocate *> order;
+        for (const Allocate *a : allocations) {
+            if (live.ranges.count(a->name)) {
+                order.push_back(a);
+            }
+        }
+        std::stable_sort(order.begin(), order.end(),
+                         [&](const Allocate *a, const Allocate *b) {
+                             return live.ranges[a->name].first < live.ranges[b->name].first;
+                         });
+
+        // Indices into the arena are in units of each allocation's
+        // own element size, and codegen's TBAA metadata for constant
+        // indices assumes that different indices into the same buffer
+        // don't alias. That only holds if all the tenants of a slot
+        // use the same units.
+        struct Slot {
+            int last_use;
+            Expr size;
+            int element_bytes;
+        };
+        const int alignment = arena_alignment(target);
+        vector<Slot> slots;
+        map<string, int> slot_of;
+        Expr naive_size = make_zero(Int(64));
+        for (const Allocate *a : order) {
+            // Codegen pads heap allocations by one scalar, so that
+            // vector loads may read past the end.
+            Expr size = make_const(Int(64), a->type.bytes());
+            for (const Expr &e : a->extents) {
+                size *= cast<int64_t>(e);
+            }
+            size += a->type.bytes() + alignment - 1;
+            size = simplify((size / alignment) * alignment);
+            naive_size += size;
+
+            const pair<int, int> &range = live.ranges[a->name];
+            size_t i = 0;
+            while (i < slots.size() &&
+                   (slots[i].last_use >= range.first ||
+                    slots[i].element_bytes != a->type.bytes())) {
+                i++;
+            }
+            if (i == slots.size()) {
+                slots.push_back({range.second, size, a->type.bytes()});
+            } else {
+                slots[i].last_use = range.second;
+                slots[i].size = simplify(max(slots[i].size, size));
+            }
+            slot_of[a->name] = (int)i;
+        }
+
+        if (slots.size() == order.size()) {
+            // Nothing shares a slot, so there's no point in an arena.
+            return IRMutator::visit(op);
+        }
+
+        // Name the arena after the outermost allocation, so that the
+        // profiler attributes it to that Func.
+        string arena = op->name + ".arena";
+        map<string, Expr> offsets;
+        vector<pair<string, Expr>> lets;
+        Expr offset = make_zero(Int(64));
+        vector<Expr> slot_offsets;
+        for (size_t i = 0; i < slots.size(); i++) {
+            slot_offsets.push_back(offset);
+            string size_name = arena + ".slot." + std::to_string(i) + ".size";
+            lets.push_back({size_name, slots[i].size});
+            offset = simplify(offset + Variable::make(Int(64), size_name));
+        }
+        Expr arena_size = Variable::make(Int(64), arena + ".size");
+        lets.push_back({arena + ".size", offset});
+        for (const Allocate *a : order) {
+            string offset_name = a->name + ".arena_offset";
+            Expr slot_offset = slot_offsets[slot_of[a->name]];
+            lets.push_back({offset_name, cast<int32_t>(slot_offset / a->type.bytes())});
+            offsets[a->name] = Variable::make(Int(32), offset_name);
+        }
+
+        naive_size = simplify(naive_size);
+        debug(1) << "Packing " << order.size() << " allocations into "
+                 << slots.size() << " slots of arena " << arena << "\n"
+                 << "  Naive size: " << naive_size << "\n"
+                 << "  Planned size: " << offset << "\n";
+
+        body = RedirectToArena(arena, offsets, alignment).mutate(body);
+        body = mutate(body);
+        body = Allocate::make(arena, UInt(8), MemoryType::Heap, {cast<int32_t>(arena_size)},
+                              const_true(), body);
+
+        // Offsets into the arena are 32-bit, like all other indices.
+        Expr max_size = make_const(Int(64), INT_MAX);
+        Expr error = Call::make(Int(32), "halide_error_buffer_allocation_too_large",
+                                {arena, cast<uint64_t>(arena_size), cast<uint64_t>(max_size)},
+                                Call::Extern);
+        body = Block::make(AssertStmt::make(arena_size <= max_size, error), body);
+
+        if (target.has_feature(Target::Profile) || target.has_feature(Target::ProfileHW)) {
+            // Let the profiler's memory accounting report the peak
+            // without planning too. inject_profiling fills in the
+            // pipeline state, and undoes this when the arena is freed.
+            Expr saved = cast<int64_t>(naive_size) - arena_size;
+            Expr note = Call::make(Int(32), "halide_profiler_memory_unplanned",
+                                   {arena, saved}, Call::Extern);
+            body = Block::make(Evaluate::make(note), body);
+        }
+
+        for (auto it = lets.rbegin(); it != lets.rend(); it++) {
+            body = LetStmt::make(it->first, it->second, body);
+        }
+        return body;
+    }
+
+public:
+    PlanMemory(const set<string> &unplannable, const Target &target)
+        : unplannable(unplannable), target(target) {}
+};
+
+}  // namespace
+
+Stmt plan_memory(const Stmt &s, const Target &t) {
+    FindUnplannableAllocations finder;
+    s.accept(&finder);
+    return PlanMemory(finder.result, t).mutate(s);
+}
+
+}  // namespace Internal
+}  // namespace Halide
@@ -0,0 +1,29 @@
+#ifndef HALIDE_PLAN_MEMORY_H
+#define HALIDE_PLAN_MEMORY_H
+
+/** \file
+ * Defines the lowering pass that packs heap allocations with
+ * disjoint lifetimes into shared arenas.
+ */
+
+#include "IR.h"
+#include "Target.h"
+
+namespace Halide {
+namespace Internal {
+
+/** Find sets of heap allocations made at the same site (i.e. not
+ * separated by any loop) and compute the lifetime of each, from its
+ * first use to its last use. Allocations whose lifetimes don't overlap
+ * and whose elements are the same size are assigned the same slot in
+ * a single arena allocation, and their
+ * loads and stores are redirected to their offset within it. This
+ * reduces the peak memory usage of deep pipelines to something closer
+ * to their live working set. Should be run after storage flattening,
+ * and before early frees are injected. */
+Stmt plan_memory(const Stmt &s, const Target &t);
+
+}  // namespace Internal
+}  // namespace Halide
+
+#endif
@@ -0,0 +1,327 @@
+#include <set>
+
+#include "PrivatizeAtomicUpdates.h"
+#include "Bounds.h"
+#include "ExprUsesVar.h"
+#include "IRMutator.h"
+#include "IROperator.h"
+#include "IRPrinter.h"
+#include "Scope.h"
+#include "Simplify.h"
+
+namespace Halide {
+namespace Internal {
+
+using std::set;
+using std::string;
+using std::vector;
+
+namespace {
+
+// The number of tasks a privatized loop is split into. Enough to keep
+// the thread pool busy, and few enough that the merges of the private
+// copies are negligible.
+const int privatized_tasks = 64;
+
+// The most elements an update that touches many sites (e.g. the bins
+// of a histogram) may touch for each task to get a private copy of
+// them.
+const int privatized_max_elements = 1024;
+
+// Collect the names of the variables defined inside a Stmt, and the
+// bounds of their values, with loop variables unbounded.
+class DefinedVars : public IRVisitor {
+    using IRVisitor::visit;
+
+    void visit(const For *op) override {
+        names.push(op->name);
+        bounds.push(op->name, Interval::everything());
+        IRVisitor::visit(op);
+    }
+
+    void visit(const LetStmt *op) override {
+        names.push(op->name);
+        bounds.push(op->name, bounds_of_expr_in_scope(op->value, bounds));
+        IRVisitor::visit(op);
+    }
+
+    void visit(const Let *op) override {
+        names.push(op->name);
+        bounds.push(op->name, bounds_of_expr_in_scope(op->value, bounds));
+        IRVisitor::visit(op);
+    }
+
+public:
+    Scope<> names;
+    Scope<Interval> bounds;
+};
+
+// Collect the names of the buffers stored to by atomic updates.
+class AtomicStores : public IRVisitor {
+    using IRVisitor::visit;
+
+    void visit(const Atomic *op) override {
+        if (const Store *store = op->body.as<Store>()) {
+            names.insert(store->name);
+        }
+        IRVisitor::visit(op);
+    }
+
+public:
+    set<string> names;
+};
+
+// Count the accesses to a buffer, and find the atomic updates of it.
+class FindAtomicUpdates : public IRVisitor {
+    using IRVisitor::visit;
+
+    const string &buffer;
+
+    int vectorized_loops = 0;
+
+    void visit(const For *op) override {
+        ScopedValue<int> old_vectorized_loops(vectorized_loops,
+                                              vectorized_loops + (op->for_type == ForType::Vectorized));
+        IRVisitor::visit(op);
+    }
+
+    void visit(const Atomic *op) override {
+        const Store *store = op->body.as<Store>();
+        if (store && store->name == buffer) {
+            updates.push_back(op);
+            in_vectorized_loop.push_back(vectorized_loops > 0);
+        }
+        IRVisitor::visit(op);
+    }
+
+    void visit(const Load *op) override {
+        if (op->name == buffer) {
+            accesses++;
+        }
+        IRVisitor::visit(op);
+    }
+
+    void visit(const Store *op) override {
+        if (op->name == buffer) {
+            accesses++;
+        }
+        IRVisitor::visit(op);
+    }
+
+    void visit(const Variable *op) override {
+        if (op->name == buffer + ".buffer") {
+            accesses++;
+        }
+    }
+
+public:
+    int accesses = 0;
+    vector<const Atomic *> updates;
+    // Whether each update is inside a loop yet to be vectorized.
+    vector<bool> in_vectorized_loop;
+
+    FindAtomicUpdates(const string &b) : buffer(b) {}
+};
+
+class ReplaceAtomic : public IRMutator {
+    using IRMutator::visit;
+
+    const Atomic *target;
+    Stmt replacement;
+
+    Stmt visit(const Atomic *op) override {
+        if (op == target) {
+            return replacement;
+        } else {
+            return IRMutator::visit(op);
+        }
+    }
+
+public:
+    ReplaceAtomic(const Atomic *t, Stmt r) : target(t), replacement(std::move(r)) {}
+};
+
+class PrivatizeAtomicUpdates : public IRMutator {
+    using IRMutator::visit;
+
+    DeviceAPI device_api = DeviceAPI::Host;
+
+    Stmt visit(const Atomic *op) override {
+        user_assert(device_api != DeviceAPI::GLSL &&
+                    device_api != DeviceAPI::OpenGLCompute &&
+                    device_api != DeviceAPI::Metal &&
+                    device_api != DeviceAPI::D3D12Compute)
+            << "Func " << op->producer_name << " is scheduled with atomic(), "
+            << "which is not supported on " << device_api << ".\n";
+        return IRMutator::visit(op);
+    }
+
+    Stmt visit(const For *op) override {
+        ScopedValue<DeviceAPI> old_device_api(device_api, device_api);
+        if (op->device_api != DeviceAPI::None) {
+            device_api = op->device_api;
+        }
+
+        Stmt body = mutate(op->body);
+        if (op->for_type == ForType::Parallel) {
+            Stmt privatized = privatize(op, body);
+            if (privatized.defined()) {
+                return privatized;
+            }
+        }
+
+        if (body.same_as(op->body)) {
+            return op;
+        } else {
+            return For::make(op->name, op->min, op->extent, op->for_type, op->device_api, body);
+        }
+    }
+
+    // Returns an undefined Stmt if there's nothing to privatize.
+    Stmt privatize(const For *op, Stmt body) {
+        AtomicStores stores;
+        body.accept(&stores);
+        if (stores.names.empty()) {
+            return Stmt();
+        }
+
+        DefinedVars defined;
+        defined.names.push(op->name);
+        defined.bounds.push(op->name, Interval::everything());
+        body.accept(&defined);
+
+        vector<Stmt> inits, merges;
+        vector<std::pair<string, Type>> copies;
+        vector<Expr> copy_sizes;
+        for (const string &buffer : stores.names) {
+            FindAtomicUpdates find(buffer);
+            body.accept(&find);
+            // The update must be the only access to the buffer in the
+            // loop, so the load in its value and the store.
+            if (find.updates.size() != 1 || find.accesses != 2) {
+                continue;
+            }
+            const Atomic *update = find.updates[0];
+            const Store *store = update->body.as<Store>();
+            VectorReduce::Operator reduce_op;
+            Expr current, rest;
+            if (!store->value.type().is_scalar() ||
+                !is_one(store->predicate) ||
+                !match_reduction(store, &reduce_op, &current, &rest)) {
+                continue;
+            }
+
+            Type t = store->value.type();
+            Expr identity = vector_reduce_identity(reduce_op, t);
+            string copy_name = unique_name(buffer + ".private");
+
+            if (!expr_uses_vars(store->index, defined.names)) {
+                // Every iteration updates the same site, so each task
+                // accumulates into a single private value.
+                Expr copy = Load::make(t, copy_name, 0, Buffer<>(), Parameter(), const_true(), ModulusRemainder());
+                Stmt accumulate = Store::make(copy_name, vector_reduce_binop(reduce_op, copy, rest), 0,
+                                              Parameter(), const_true(), ModulusRemainder());
+                body = ReplaceAtomic(update, accumulate).mutate(body);
+
+                inits.push_back(Store::make(copy_name, identity, 0, Parameter(), const_true(), ModulusRemainder()));
+                merges.push_back(Atomic::make(update->producer_name,
+                                              Store::make(buffer, vector_reduce_binop(reduce_op, current, copy),
+                                                          store->index, store->param, store->predicate, store->alignment)));
+                copies.emplace_back(copy_name, t);
+                copy_sizes.push_back(Expr());
+                continue;
+            }
+
+            // Otherwise the update must touch a small range of sites
+            // that starts at the same place in every iteration, such
+            // as the bins of a histogram. Each task accumulates into a
+            // private copy of the range, and then merges the sites it
+            // touched.
+            Interval range = bounds_of_expr_in_scope(store->index, defined.bounds);
+            if (!range.is_bounded()) {
+                continue;
+            }
+            Expr range_min = simplify(range.min);
+            Expr range_size = simplify(range.max - range.min + 1);
+            const int64_t *size = as_const_int(range_size);
+            if (!size || *size <= 0 || *size > privatized_max_elements ||
+                expr_uses_vars(range_min, defined.names)) {
+                continue;
+            }
+
+            Expr private_index = store->index - range_min;
+            Expr copy = Load::make(t, copy_name, private_index, Buffer<>(), Parameter(), const_true(), ModulusRemainder());
+            Stmt accumulate = Store::make(copy_name, vector_reduce_binop(reduce_op, copy, rest), private_index,
+                                          Parameter(), const_true(), ModulusRemainder());
+            if (find.in_vectorized_loop[0]) {
+                // Once vectorized, lanes of the update may hit the
+                // same site of the private copy. Keep it atomic so
+                // that the vectorizer scalarizes it.
+                accumulate = Atomic::make(update->producer_name, accumulate);
+            }
+            body = ReplaceAtomic(update, accumulate).mutate(body);
+
+            string init_var = unique_name('i');
+            inits.push_back(For::make(init_var, 0, range_size, ForType::Serial, op->device_api,
+                                      Store::make(copy_name, identity, Variable::make(Int(32), init_var),
+                                                  Parameter(), const_true(), ModulusRemainder())));
+
+            // Sites the task didn't change are skipped, so the merge
+            // neither touches sites the loop never did nor contends on
+            // them.
+            string merge_var = unique_name('i');
+            Expr i = Variable::make(Int(32), merge_var);
+            Expr copy_i = Load::make(t, copy_name, i, Buffer<>(), Parameter(), const_true(), ModulusRemainder());
+            const Load *current_load = current.as<Load>();
+            internal_assert(current_load);
+            Expr site = range_min + i;
+            Expr current_i = Load::make(t, buffer, site, current_load->image, current_load->param,
+                                        const_true(), ModulusRemainder());
+            Stmt merge = Atomic::make(update->producer_name,
+                                      Store::make(buffer, vector_reduce_binop(reduce_op, current_i, copy_i),
+                                                  site, store->param, const_true(), ModulusRemainder()));
+            merge = IfThenElse::make(copy_i != identity, merge);
+            merges.push_back(For::make(merge_var, 0, range_size, ForType::Serial, op->device_api, merge));
+            copies.emplace_back(copy_name, t);
+            copy_sizes.push_back(range_size);
+        }
+
+        if (copies.empty()) {
+            return Stmt();
+        }
+
+        debug(3) << "Privatizing atomic updates in parallel loop " << op->name << "\n";
+
+        string task_name = unique_name(op->name + ".task");
+        Expr task = Variable::make(Int(32), task_name);
+        // There are no tasks if the loop is empty, but the division
+        // must not be by zero.
+        Expr num_tasks = min(op->extent, privatized_tasks);
+        Expr task_size = (op->extent + num_tasks - 1) / max(num_tasks, 1);
+        Expr task_min = task * task_size;
+        Stmt loop = For::make(op->name, op->min + task_min, min(task_size, op->extent - task_min),
+                              ForType::Serial, op->device_api, body);
+
+        vector<Stmt> stmts = inits;
+        stmts.push_back(loop);
+        stmts.insert(stmts.end(), merges.begin(), merges.end());
+        Stmt s = Block::make(stmts);
+        for (size_t i = 0; i < copies.size(); i++) {
+            vector<Expr> extents;
+            if (copy_sizes[i].defined()) {
+                extents.push_back(copy_sizes[i]);
+            }
+            s = Allocate::make(copies[i].first, copies[i].second, MemoryType::Stack, extents, const_true(), s);
+        }
+        return For::make(task_name, 0, num_tasks, ForType::Parallel, op->device_api, s);
+    }
+};
+
+}  // namespace
+
+Stmt privatize_atomic_updates(Stmt s) {
+    return PrivatizeAtomicUpdates().mutate(s);
+}
+
+}  // namespace Internal
+}  // namespace Halide
@@ -0,0 +1,29 @@
+#ifndef HALIDE_PRIVATIZE_ATOMIC_UPDATES_H
+#define HALIDE_PRIVATIZE_ATOMIC_UPDATES_H
+
+/** \file
+ * Defines the lowering pass that gives each thread of a parallel loop
+ * its own copy of the sites its iterations update atomically.
+ */
+
+#include "IR.h"
+
+namespace Halide {
+namespace Internal {
+
+/** Find parallel loops whose only accesses to some buffer are atomic
+ * updates of either a single site that doesn't depend on the loop,
+ * such as a sum over a parallel RVar, or a small range of sites with
+ * a constant size, such as the bins of a histogram. The iterations of
+ * such a loop contend for the same few sites, so instead split the
+ * loop into a fixed number of tasks, each of which accumulates into a
+ * private copy of the sites on its stack, and then atomically merges
+ * the sites it changed. Also rejects atomic updates on device APIs
+ * that can't do them. Must be called after storage flattening and
+ * before vectorization. */
+Stmt privatize_atomic_updates(Stmt s);
+
+}  // namespace Internal
+}  // namespace Halide
+
+#endif
@@ -27,7 +27,10 @@ public:
 
     string pipeline_name;
 
-    InjectProfiling(const string &pipeline_name) : pipeline_name(pipeline_name) {
+    const Target &target;
+
+    InjectProfiling(const string &pipeline_name, const Target &target)
+        : pipeline_name(pipeline_name), target(target) {
         indices["overhead"] = 0;
         stack.push_back(0);
     }
@@ -45,8 +48,20 @@ private:
 
     Scope<AllocSize> func_alloc_sizes;
 
+    // The bytes memory planning saved for each planned arena, to be
+    // handed back to the profiler when the arena is freed.
+    map<string, Expr> unplanned_sizes;
+
     bool profiling_memory = true;
 
+    // Whether we're inside code offloaded to a remote device, which
+    // only tracks a single current func and a count of active threads.
+    bool in_remote = false;
+
+    // The variable holding the profiler thread slot of the
+    // innermost enclosing parallel task, if any.
+    string thread_slot;
+
     // Strip down the tuple name, e.g. f.0 into f
     string normalize_name(const string &name) {
         vector<string> v = split_string(name, ".");
@@ -70,6 +85,7 @@ private:
     Expr compute_allocation_size(const vector<Expr> &extents,
                                  const Expr &condition,
                                  const Type &type,
+                                 MemoryType memory_type,
                                  const std::string &name,
                                  bool &on_stack) {
         on_stack = true;
@@ -80,9 +96,10 @@ private:
         }
 
         int32_t constant_size = Allocate::constant_allocation_size(extents, name);
-        if (constant_size > 0) {
+        if (constant_size > 0 && memory_type != MemoryType::Heap) {
             int64_t stack_bytes = constant_size * type.bytes();
-            if (can_allocation_fit_on_stack(stack_bytes)) { // Allocation on stack
+            if (memory_type == MemoryType::Register ||
+                can_allocation_fit_on_stack(stack_bytes, target)) { // Allocation on stack
                 return make_const(UInt(64), stack_bytes);
             }
         }
@@ -112,7 +129,7 @@ private:
         Expr condition = mutate(op->condition);
 
         bool on_stack;
-        Expr size = compute_allocation_size(new_extents, condition, op->type, op->name, on_stack);
+        Expr size = compute_allocation_size(new_extents, condition, op->type, op->memory_type, op->name, on_stack);
         internal_assert(size.type() == UInt(64));
         func_alloc_sizes.push(op->name, {on_stack, size});
 
@@ -163,6 +180,15 @@ private:
 
         Stmt stmt = IRMutator::visit(op);
 
+        auto unplanned = unplanned_sizes.find(op->name);
+        if (unplanned != unplanned_sizes.end()) {
+            Expr profiler_pipeline_state = Variable::make(Handle(), "profiler_pipeline_state");
+            Expr set_task = Call::make(Int(32), "halide_profiler_memory_unplanned",
+                                       {profiler_pipeline_state, -unplanned->second}, Call::Extern);
+            stmt = Block::make(Evaluate::make(set_task), stmt);
+            unplanned_sizes.erase(unplanned);
+        }
+
         if (!is_zero(alloc.size)) {
             Expr profiler_pipeline_state = Variable::make(Handle(), "profiler_pipeline_state");
 
@@ -185,6 +211,26 @@ private:
         return stmt;
     }
 
+    Stmt visit(const Evaluate *op) override {
+        // plan_memory leaves a note of how much smaller it made each
+        // arena, naming the arena rather than the pipeline state.
+        const Call *call = op->value.as<Call>();
+        if (call && call->name == "halide_profiler_memory_unplanned") {
+            internal_assert(call->args.size() == 2);
+            const StringImm *arena = call->args[0].as<StringImm>();
+            internal_assert(arena);
+            if (!profiling_memory) {
+                return Evaluate::make(0);
+            }
+            Expr delta = mutate(call->args[1]);
+            unplanned_sizes[arena->value] = delta;
+            Expr profiler_pipeline_state = Variable::make(Handle(), "profiler_pipeline_state");
+            return Evaluate::make(Call::make(Int(32), call->name,
+                                             {profiler_pipeline_state, delta}, Call::Extern));
+        }
+        return IRMutator::visit(op);
+    }
+
     Stmt visit(const ProducerConsumer *op) override {
         int idx;
         Stmt body;
@@ -200,18 +246,27 @@ private:
             idx = stack.back();
         }
 
-        Expr profiler_token = Variable::make(Int(32), "profiler_token");
-        Expr profiler_state = Variable::make(Handle(), "profiler_state");
-
-        // This call gets inlined and becomes a single store instruction.
-        Expr set_task = Call::make(Int(32), "halide_profiler_set_current_func",
-                                   {profiler_state, profiler_token, idx}, Call::Extern);
-
-        body = Block::make(Evaluate::make(set_task), body);
+        body = Block::make(set_current_func(idx), body);
 
         return ProducerConsumer::make(op->name, op->is_producer, body);
     }
 
+    Stmt set_current_func(int idx) {
+        Expr profiler_token = Variable::make(Int(32), "profiler_token");
+        // These calls get inlined and become a single store instruction.
+        Expr set_task;
+        if (thread_slot.empty()) {
+            Expr profiler_state = Variable::make(Handle(), "profiler_state");
+            set_task = Call::make(Int(32), "halide_profiler_set_current_func",
+                                  {profiler_state, profiler_token, idx}, Call::Extern);
+        } else {
+            Expr slot = Variable::make(Handle(), thread_slot);
+            set_task = Call::make(Int(32), "halide_profiler_set_thread_func",
+                                  {slot, profiler_token, idx}, Call::Extern);
+        }
+        return Evaluate::make(set_task);
+    }
+
     Stmt incr_active_threads() {
         Expr state = Variable::make(Handle(), "profiler_state");
         return Evaluate::make(Call::make(Int(32), "halide_profiler_incr_active_threads",
@@ -224,50 +279,80 @@ private:
                                          {state}, Call::Extern));
     }
 
+    // Wrap the body of a parallel task so that it bills its time to
+    // the funcs it computes, on a thread slot of its own.
+    Stmt parallel_task_body(Stmt s) {
+        if (in_remote) {
+            return Block::make({incr_active_threads(), mutate(s), decr_active_threads()});
+        }
+        string slot = unique_name("profiler_thread_slot");
+        {
+            ScopedValue<string> old_thread_slot(thread_slot, slot);
+            s = mutate(s);
+        }
+        Expr profiler_token = Variable::make(Int(32), "profiler_token");
+        Expr profiler_state = Variable::make(Handle(), "profiler_state");
+        Expr acquire = Call::make(Handle(), "halide_profiler_acquire_thread_slot",
+                                  {profiler_state, profiler_token, stack.back()}, Call::Extern);
+        Expr release = Call::make(Int(32), "halide_profiler_release_thread_slot",
+                                  {profiler_state, Variable::make(Handle(), slot)}, Call::Extern);
+        s = Block::make(s, Evaluate::make(release));
+        if (target.has_feature(Target::ProfileHW)) {
+            // Make sure the hardware counters of this thread are read
+            // with those of the thread that runs the pipeline.
+            Expr enter_hw = Call::make(Int(32), "halide_profiler_hw_enter_thread", {}, Call::Extern);
+            s = Block::make(Evaluate::make(enter_hw), s);
+        }
+        return LetStmt::make(slot, acquire, s);
+    }
+
+    // Wrap the launch of parallel tasks. While the launching thread
+    // waits for them it's only overhead, unless it's the remote
+    // device's count of active threads we're tracking.
+    Stmt parallel_launch(Stmt s) {
+        if (in_remote) {
+            return Block::make({decr_active_threads(), s, incr_active_threads()});
+        }
+        return Block::make({set_current_func(0), s, set_current_func(stack.back())});
+    }
+
     Stmt visit_parallel_task(Stmt s) {
         if (const Fork *f = s.as<Fork>()) {
             return Fork::make(visit_parallel_task(f->first), visit_parallel_task(f->rest));
         } else if (const Acquire *a = s.as<Acquire>()) {
             return Acquire::make(a->semaphore, a->count, visit_parallel_task(a->body));
         } else {
-            return Block::make({incr_active_threads(), mutate(s), decr_active_threads()});
+            return parallel_task_body(s);
         }
     }
 
     Stmt visit(const Acquire *op) override {
-        Stmt s = visit_parallel_task(op);
-        return Block::make({decr_active_threads(), s, incr_active_threads()});
+        return parallel_launch(visit_parallel_task(op));
     }
 
     Stmt visit(const Fork *op) override {
-        Stmt s = visit_parallel_task(op);
-        return Block::make({decr_active_threads(), s, incr_active_threads()});
+        return parallel_launch(visit_parallel_task(op));
     }
 
     Stmt visit(const For *op) override {
         Stmt body = op->body;
 
-        // The for loop indicates a device transition or a
-        // parallel job launch. Decrement the number of active
-        // threads outside the loop, and increment it inside the
-        // body.
-        bool update_active_threads = (op->device_api == DeviceAPI::Hexagon ||
-                                      op->is_unordered_parallel());
-
-        if (update_active_threads) {
-            body = Block::make({incr_active_threads(), body, decr_active_threads()});
-        }
+        // A parallel loop on the host launches a task per iteration.
+        bool parallel_launch_on_host = (op->is_unordered_parallel() &&
+                                        (op->device_api == DeviceAPI::None ||
+                                         op->device_api == DeviceAPI::Host));
 
         // We profile by storing a token to global memory, so don't enter GPU loops
         if (op->device_api == DeviceAPI::Hexagon) {
             // TODO: This is for all offload targets that support
             // limited internal profiling, which is currently just
             // hexagon. We don't support per-func stats remotely,
-            // which means we can't do memory accounting.
-            bool old_profiling_memory = profiling_memory;
-            profiling_memory = false;
-            body = mutate(body);
-            profiling_memory = old_profiling_memory;
+            // which means we can't do memory accounting, or track the
+            // func of each thread.
+            ScopedValue<bool> old_profiling_memory(profiling_memory, false);
+            ScopedValue<bool> old_in_remote(in_remote, true);
+            ScopedValue<string> old_thread_slot(thread_slot, "");
+            body = Block::make({incr_active_threads(), mutate(body), decr_active_threads()});
 
             // Get the profiler state pointer from scratch inside the
             // kernel. There will be a separate copy of the state on
@@ -275,6 +360,8 @@ private:
             Expr get_state = Call::make(Handle(), "halide_profiler_get_state", {}, Call::Extern);
             body = substitute("profiler_state", Variable::make(Handle(), "hvx_profiler_state"), body);
             body = LetStmt::make("hvx_profiler_state", get_state, body);
+        } else if (parallel_launch_on_host) {
+            body = parallel_task_body(body);
         } else if (op->device_api == DeviceAPI::None ||
                    op->device_api == DeviceAPI::Host) {
             body = mutate(body);
@@ -284,15 +371,15 @@ private:
 
         Stmt stmt = For::make(op->name, op->min, op->extent, op->for_type, op->device_api, body);
 
-        if (update_active_threads) {
-            stmt = Block::make({decr_active_threads(), stmt, incr_active_threads()});
+        if (parallel_launch_on_host) {
+            stmt = parallel_launch(stmt);
         }
         return stmt;
     }
 };
 
-Stmt inject_profiling(Stmt s, string pipeline_name) {
-    InjectProfiling profiling(pipeline_name);
+Stmt inject_profiling(Stmt s, string pipeline_name, const Target &t) {
+    InjectProfiling profiling(pipeline_name, t);
     s = profiling.mutate(s);
 
     int num_funcs = (int)(profiling.indices.size());
@@ -321,14 +408,29 @@ Stmt inject_profiling(Stmt s, string pipeline_name) {
         s = Block::make(update_stack, s);
     }
 
-    Expr profiler_state = Variable::make(Handle(), "profiler_state");
-    Stmt incr_active_threads =
-        Evaluate::make(Call::make(Int(32), "halide_profiler_incr_active_threads",
-                                  {profiler_state}, Call::Extern));
-    Stmt decr_active_threads =
-        Evaluate::make(Call::make(Int(32), "halide_profiler_decr_active_threads",
-                                  {profiler_state}, Call::Extern));
-    s = Block::make({incr_active_threads, s, decr_active_threads});
+    if (t.has_feature(Target::ProfileHW)) {
+        // Read the hardware counters when the pipeline starts, and
+        // again when it exits, even if it fails. They're not read
+        // when switching funcs, because the syscall would disturb the
+        // events being counted.
+        Expr profiler_pipeline_state = Variable::make(Handle(), "profiler_pipeline_state");
+        Expr start_hw = Call::make(Int(32), "halide_profiler_hw_pipeline_start",
+                                   {profiler_pipeline_state}, Call::Extern);
+        Expr stop_hw = Call::make(Handle(), Call::register_destructor,
+                                  {Expr("halide_profiler_hw_pipeline_end"), profiler_pipeline_state}, Call::Intrinsic);
+        s = Block::make({Evaluate::make(stop_hw), Evaluate::make(start_hw), s});
+    }
+
+    {
+        // In per-call mode, the runtime snapshots and resets the
+        // stats of this pipeline once the call is done. Destructors
+        // run in reverse order, so this goes after the hardware
+        // counters have been read.
+        Expr profiler_pipeline_state = Variable::make(Handle(), "profiler_pipeline_state");
+        Expr end_call = Call::make(Handle(), Call::register_destructor,
+                                   {Expr("halide_profiler_pipeline_call_end"), profiler_pipeline_state}, Call::Intrinsic);
+        s = Block::make(Evaluate::make(end_call), s);
+    }
 
     s = LetStmt::make("profiler_pipeline_state", get_pipeline_state, s);
     s = LetStmt::make("profiler_state", get_state, s);
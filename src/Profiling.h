@@ -25,6 +25,7 @@
  */
 
 #include "IR.h"
+#include "Target.h"
 
 namespace Halide {
 namespace Internal {
@@ -36,7 +37,7 @@ namespace Internal {
  * storage flattening, but after all bounds inference.
  *
  */
-Stmt inject_profiling(Stmt, std::string);
+Stmt inject_profiling(Stmt, std::string, const Target &);
 
 }  // namespace Internal
 }  // namespace Halide
@@ -207,20 +207,25 @@ typedef std::map<FunctionPtr, FunctionPtr> DeepCopyMap;
 struct FuncScheduleContents {
     mutable RefCount ref_count;
 
-    LoopLevel store_level, compute_level;
+    LoopLevel store_level, compute_level, hoist_storage_level;
     std::vector<StorageDim> storage_dims;
     std::vector<Bound> bounds;
     std::vector<Bound> estimates;
     std::map<std::string, Internal::FunctionPtr> wrappers;
     MemoryType memory_type;
     bool memoized, async;
+    Expr ring_buffer;
 
     FuncScheduleContents() :
         store_level(LoopLevel::inlined()), compute_level(LoopLevel::inlined()),
+        hoist_storage_level(LoopLevel::inlined()),
         memory_type(MemoryType::Auto), memoized(false), async(false) {};
 
     // Pass an IRMutator through to all Exprs referenced in the FuncScheduleContents
     void mutate(IRMutator *mutator) {
+        if (ring_buffer.defined()) {
+            ring_buffer = mutator->mutate(ring_buffer);
+        }
         for (Bound &b : bounds) {
             if (b.min.defined()) {
                 b.min = mutator->mutate(b.min);
@@ -276,9 +281,10 @@ struct StageScheduleContents {
     std::vector<FusedPair> fused_pairs;
     bool touched;
     bool allow_race_conditions;
+    bool atomic;
 
     StageScheduleContents() : fuse_level(FuseLoopLevel()), touched(false),
-                              allow_race_conditions(false) {};
+                              allow_race_conditions(false), atomic(false) {};
 
     // Pass an IRMutator through to all Exprs referenced in the StageScheduleContents
     void mutate(IRMutator *mutator) {
@@ -323,12 +329,14 @@ FuncSchedule FuncSchedule::deep_copy(
     FuncSchedule copy;
     copy.contents->store_level = contents->store_level;
     copy.contents->compute_level = contents->compute_level;
+    copy.contents->hoist_storage_level = contents->hoist_storage_level;
     copy.contents->storage_dims = contents->storage_dims;
     copy.contents->bounds = contents->bounds;
     copy.contents->estimates = contents->estimates;
     copy.contents->memory_type = contents->memory_type;
     copy.contents->memoized = contents->memoized;
     copy.contents->async = contents->async;
+    copy.contents->ring_buffer = contents->ring_buffer;
 
     // Deep-copy wrapper functions.
     for (const auto &iter : contents->wrappers) {
@@ -364,6 +372,14 @@ bool FuncSchedule::async() const {
     return contents->async;
 }
 
+Expr &FuncSchedule::ring_buffer() {
+    return contents->ring_buffer;
+}
+
+Expr FuncSchedule::ring_buffer() const {
+    return contents->ring_buffer;
+}
+
 std::vector<StorageDim> &FuncSchedule::storage_dims() {
     return contents->storage_dims;
 }
@@ -425,7 +441,18 @@ const LoopLevel &FuncSchedule::compute_level() const {
     return contents->compute_level;
 }
 
+LoopLevel &FuncSchedule::hoist_storage_level() {
+    return contents->hoist_storage_level;
+}
+
+const LoopLevel &FuncSchedule::hoist_storage_level() const {
+    return contents->hoist_storage_level;
+}
+
 void FuncSchedule::accept(IRVisitor *visitor) const {
+    if (ring_buffer().defined()) {
+        ring_buffer().accept(visitor);
+    }
     for (const Bound &b : bounds()) {
         if (b.min.defined()) {
             b.min.accept(visitor);
@@ -476,6 +503,7 @@ StageSchedule StageSchedule::get_copy() const {
     copy.contents->fused_pairs = contents->fused_pairs;
     copy.contents->touched = contents->touched;
     copy.contents->allow_race_conditions = contents->allow_race_conditions;
+    copy.contents->atomic = contents->atomic;
     return copy;
 }
 
@@ -543,6 +571,14 @@ bool StageSchedule::allow_race_conditions() const {
     return contents->allow_race_conditions;
 }
 
+bool &StageSchedule::atomic() {
+    return contents->atomic;
+}
+
+bool StageSchedule::atomic() const {
+    return contents->atomic;
+}
+
 void StageSchedule::accept(IRVisitor *visitor) const {
     for (const ReductionVariable &r : rvars()) {
         if (r.min.defined()) {
@@ -61,6 +61,18 @@ enum class TailStrategy {
      * instead of a multiple of the split factor as with RoundUp. */
     ShiftInwards,
 
+    /** Guard the inner loop with an if statement like GuardWithIf,
+     * but if the inner loop is vectorized, handle the tail case
+     * with a single vector iteration that uses predicated
+     * (masked) loads and stores, instead of scalarizing it. Always
+     * legal. Pros: no redundant re-evaluation; does not constrain
+     * input or output sizes; the tail costs about as much as one
+     * vector iteration, which matters when the extent is small
+     * relative to the vector width. Cons: masked loads and stores
+     * are slow or unavailable on some targets, and are not
+     * supported by the C backend or GPU backends. */
+    Predicate,
+
     /** For pure definitions use ShiftInwards. For pure vars in
      * update definitions use RoundUp. For RVars in update
      * definitions use GuardWithIf. */
@@ -398,6 +410,14 @@ public:
     bool &async();
     bool async() const;
 
+    /** The number of slots in the circular buffer used to store this
+     * Function, or undefined if it isn't ring-buffered. See
+     * \ref Func::ring_buffer */
+    // @{
+    Expr &ring_buffer();
+    Expr ring_buffer() const;
+    // @}
+
     /** The list and order of dimensions used to store this
      * function. The first dimension in the vector corresponds to the
      * innermost dimension for storage (i.e. which dimension is
@@ -452,6 +472,17 @@ public:
     LoopLevel &compute_level();
     // @}
 
+    /** At what site should the allocation be hoisted to? The
+     * hoist_storage_level must be outside of or equal to the
+     * store_level. The allocation made there is large enough for any
+     * iteration of the loops between the two. Defaults to the
+     * store_level once loop levels are locked. See \ref
+     * Func::hoist_storage */
+    // @{
+    const LoopLevel &hoist_storage_level() const;
+    LoopLevel &hoist_storage_level();
+    // @}
+
     /** Pass an IRVisitor through to all Exprs referenced in the
      * Schedule. */
     void accept(IRVisitor *) const;
@@ -543,6 +574,13 @@ public:
     bool &allow_race_conditions();
     // @}
 
+    /** Are the stores of this stage done atomically? See
+     * \ref Stage::atomic */
+    // @{
+    bool atomic() const;
+    bool &atomic();
+    // @}
+
     /** Pass an IRVisitor through to all Exprs referenced in the
      * Schedule. */
     void accept(IRVisitor *) const;
@@ -348,6 +348,9 @@ Stmt build_provide_loop_nest(const map<string, Function> &env,
 
     // Make the (multi-dimensional multi-valued) store node.
     Stmt body = Provide::make(func.name(), values, site);
+    if (def.schedule().atomic()) {
+        body = Atomic::make(func.name(), body);
+    }
 
     // Default schedule/values if there is no specialization
     Stmt stmt = build_loop_nest(body, prefix, start_fuse, func, def, is_update);
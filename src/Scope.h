@@ -1,11 +1,13 @@
 #ifndef HALIDE_SCOPE_H
 #define HALIDE_SCOPE_H
 
+#include <algorithm>
 #include <iostream>
-#include <map>
 #include <stack>
 #include <string>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "Debug.h"
 #include "Error.h"
@@ -85,11 +87,19 @@ public:
 /** A common pattern when traversing Halide IR is that you need to
  * keep track of stuff when you find a Let or a LetStmt, and that it
  * should hide previous values with the same name until you leave the
- * Let or LetStmt nodes This class helps with that. */
+ * Let or LetStmt nodes This class helps with that.
+ *
+ * Names are looked up in a hash table, so the cost of a lookup is one
+ * hash of the name rather than a string comparison per level of a
+ * tree. Popping the last value of a name leaves its (empty) entry in
+ * place, so that the common pattern of repeatedly pushing and popping
+ * the same name while walking IR doesn't allocate. Iteration visits
+ * the names in no particular order. */
 template<typename T = void>
 class Scope {
 private:
-    std::map<std::string, SmallStack<T>> table;
+    typedef std::unordered_map<std::string, SmallStack<T>> Table;
+    Table table;
 
     // Copying a scope object copies a large table full of strings and
     // stacks. Bad idea.
@@ -120,7 +130,7 @@ public:
     template<typename T2 = T,
              typename = typename std::enable_if<!std::is_same<T2, void>::value>::type>
     T2 get(const std::string &name) const {
-        typename std::map<std::string, SmallStack<T>>::const_iterator iter = table.find(name);
+        typename Table::const_iterator iter = table.find(name);
         if (iter == table.end() || iter->second.empty()) {
             if (containing_scope) {
                 return containing_scope->get(name);
@@ -135,7 +145,7 @@ public:
     template<typename T2 = T,
              typename = typename std::enable_if<!std::is_same<T2, void>::value>::type>
     T2 &ref(const std::string &name) {
-        typename std::map<std::string, SmallStack<T>>::iterator iter = table.find(name);
+        typename Table::iterator iter = table.find(name);
         if (iter == table.end() || iter->second.empty()) {
             internal_error << "Name not in Scope: " << name << "\n" << *this << "\n";
         }
@@ -144,7 +154,7 @@ public:
 
     /** Tests if a name is in scope */
     bool contains(const std::string &name) const {
-        typename std::map<std::string, SmallStack<T>>::const_iterator iter = table.find(name);
+        typename Table::const_iterator iter = table.find(name);
         if (iter == table.end() || iter->second.empty()) {
             if (containing_scope) {
                 return containing_scope->contains(name);
@@ -174,20 +184,28 @@ public:
      * was (or remove it entirely if there was nothing else of the
      * same name in an outer scope) */
     void pop(const std::string &name) {
-        typename std::map<std::string, SmallStack<T>>::iterator iter = table.find(name);
-        internal_assert(iter != table.end()) << "Name not in Scope: " << name << "\n" << *this << "\n";
+        typename Table::iterator iter = table.find(name);
+        internal_assert(iter != table.end() && !iter->second.empty())
+            << "Name not in Scope: " << name << "\n" << *this << "\n";
         iter->second.pop();
-        if (iter->second.empty()) {
-            table.erase(iter);
-        }
     }
 
-    /** Iterate through the scope. Does not capture any containing scope. */
+    /** Iterate through the names currently in the scope, in no
+     * particular order. Does not capture any containing scope. */
     class const_iterator {
-        typename std::map<std::string, SmallStack<T>>::const_iterator iter;
+        typename Table::const_iterator iter, end;
+
+        void skip_empty() {
+            while (iter != end && iter->second.empty()) {
+                ++iter;
+            }
+        }
+
     public:
-        explicit const_iterator(const typename std::map<std::string, SmallStack<T>>::const_iterator &i) :
-            iter(i) {
+        const_iterator(const typename Table::const_iterator &i,
+                       const typename Table::const_iterator &e) :
+            iter(i), end(e) {
+            skip_empty();
         }
 
         const_iterator() {}
@@ -198,6 +216,7 @@ public:
 
         void operator++() {
             ++iter;
+            skip_empty();
         }
 
         const std::string &name() {
@@ -216,11 +235,11 @@ public:
     };
 
     const_iterator cbegin() const {
-        return const_iterator(table.begin());
+        return const_iterator(table.begin(), table.end());
     }
 
     const_iterator cend() const {
-        return const_iterator(table.end());
+        return const_iterator(table.end(), table.end());
     }
 
     void swap(Scope<T> &other) {
@@ -231,10 +250,15 @@ public:
 
 template<typename T>
 std::ostream &operator<<(std::ostream &stream, const Scope<T>& s) {
+    // Sort the names so that the output doesn't depend on the hash table.
+    std::vector<std::string> names;
+    for (typename Scope<T>::const_iterator iter = s.cbegin(); iter != s.cend(); ++iter) {
+        names.push_back(iter.name());
+    }
+    std::sort(names.begin(), names.end());
     stream << "{\n";
-    typename Scope<T>::const_iterator iter;
-    for (iter = s.cbegin(); iter != s.cend(); ++iter) {
-        stream << "  " << iter.name() << "\n";
+    for (const std::string &name : names) {
+        stream << "  " << name << "\n";
     }
     stream << "}";
     return stream;
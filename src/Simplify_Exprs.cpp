@@ -43,6 +43,92 @@ Expr Simplify::visit(const Broadcast *op, ExprInfo *bounds) {
     }
 }
 
+Expr Simplify::visit(const VectorReduce *op, ExprInfo *bounds) {
+    Expr value = mutate(op->value, bounds);
+
+    const int lanes = op->type.lanes();
+    const int factor = op->value.type().lanes() / lanes;
+    if (factor == 1) {
+        return value;
+    }
+
+    if (bounds) {
+        switch (op->op) {
+        case VectorReduce::Add: {
+            if (!no_overflow_int(op->type)) {
+                // The sum may wrap, so the bounds of the argument say
+                // nothing about it.
+                *bounds = ExprInfo();
+                break;
+            }
+            // The sum of factor values within the bounds of the
+            // argument.
+            if (bounds->min_defined && mul_would_overflow(64, bounds->min, factor)) {
+                bounds->min_defined = false;
+                bounds->min = 0;
+            } else {
+                bounds->min *= factor;
+            }
+            if (bounds->max_defined && mul_would_overflow(64, bounds->max, factor)) {
+                bounds->max_defined = false;
+                bounds->max = 0;
+            } else {
+                bounds->max *= factor;
+            }
+            ModulusRemainder alignment = bounds->alignment;
+            for (int i = 1; i < factor; i++) {
+                bounds->alignment = bounds->alignment + alignment;
+            }
+            bounds->trim_bounds_using_alignment();
+            break;
+        }
+        case VectorReduce::Min:
+        case VectorReduce::Max:
+            // The result is one of the lanes, so the bounds of the
+            // argument still apply.
+            break;
+        default:
+            *bounds = ExprInfo();
+        }
+    }
+
+    if (const Broadcast *b = value.as<Broadcast>()) {
+        // Reducing a broadcast combines a single value with itself.
+        Expr v = b->value;
+        switch (op->op) {
+        case VectorReduce::Add:
+            v = mutate(v * make_const(v.type(), factor), nullptr);
+            break;
+        case VectorReduce::Mul:
+            // Leave it alone. The result would have to be a power.
+            v = Expr();
+            break;
+        case VectorReduce::Min:
+        case VectorReduce::Max:
+        case VectorReduce::And:
+        case VectorReduce::Or:
+            break;
+        }
+        if (v.defined()) {
+            return lanes == 1 ? v : Broadcast::make(v, lanes);
+        }
+    }
+
+    if (const VectorReduce *inner = value.as<VectorReduce>()) {
+        // Reductions of reductions with the same operator can be
+        // done in one go.
+        if (inner->op == op->op) {
+            return VectorReduce::make(op->op, inner->value, lanes);
+        }
+    }
+
+    if (value.same_as(op->value)) {
+        return op;
+    } else {
+        return VectorReduce::make(op->op, value, lanes);
+    }
+}
+
 Expr Simplify::visit(const Variable *op, ExprInfo *bounds) {
     if (bounds_and_alignment_info.contains(op->name)) {
         const ExprInfo &b = bounds_and_alignment_info.get(op->name);
@@ -506,6 +506,22 @@ private:
         scope.pop(op->name);
     }
 
+    void visit(const Atomic *op) override {
+        stream << open_div("Atomic");
+        int id = unique_id();
+        stream << open_span("Matched");
+        stream << open_expand_button(id);
+        stream << keyword("atomic") << " ";
+        stream << var(op->producer_name);
+        stream << close_expand_button() << " {";
+        stream << close_span();
+        stream << open_div("AtomicBody Indent", id);
+        print(op->body);
+        stream << close_div();
+        stream << matched("}");
+        stream << close_div();
+    }
+
     void visit(const Prefetch *op) override {
         stream << open_span("Prefetch");
         stream << keyword("prefetch") << " ";
@@ -653,6 +669,15 @@ private:
         stream << close_span();
     }
 
+    void visit(const VectorReduce *op) override {
+        stream << open_span("VectorReduce");
+        stream << open_span("Type") << op->type << close_span();
+        stream << symbol("vector_reduce") << "(" << op->op << ", ";
+        print(op->value);
+        stream << ")";
+        stream << close_span();
+    }
+
 public:
     void print(Expr ir) {
         ir.accept(this);
@@ -818,6 +818,312 @@ public:
         : func(f), explicit_only(explicit_only) {}
 };
 
+namespace {
+
+// Count the references to a func: its produce and consume nodes, calls
+// to it, provides to it, and uses of its buffer.
+class CountFuncReferences : public IRVisitor {
+    const string &func;
+
+    using IRVisitor::visit;
+
+    void visit(const ProducerConsumer *op) override {
+        if (op->name == func) {
+            count++;
+        }
+        IRVisitor::visit(op);
+    }
+
+    void visit(const Provide *op) override {
+        if (op->name == func) {
+            count++;
+        }
+        IRVisitor::visit(op);
+    }
+
+    void visit(const Call *op) override {
+        if (op->name == func && op->call_type == Call::Halide) {
+            count++;
+        }
+        IRVisitor::visit(op);
+    }
+
+    void visit(const Variable *op) override {
+        if (starts_with(op->name, func + ".") && ends_with(op->name, ".buffer")) {
+            count++;
+        }
+    }
+
+public:
+    int count = 0;
+
+    CountFuncReferences(const string &f) : func(f) {}
+};
+
+int count_func_references(const Stmt &s, const string &func) {
+    CountFuncReferences counter(func);
+    s.accept(&counter);
+    return counter.count;
+}
+
+// Find the innermost loop containing every reference to a func, which
+// is the loop it is computed at.
+class FindComputeLoop : public IRVisitor {
+    const string &func;
+    int references;
+
+    using IRVisitor::visit;
+
+    void visit(const For *op) override {
+        // If this loop doesn't contain every reference, no loop
+        // inside it does either.
+        if (count_func_references(op, func) == references) {
+            loop = op;
+            IRVisitor::visit(op);
+        }
+    }
+
+    void visit(const ProducerConsumer *op) override {
+        // The loop must contain the produce and consume nodes.
+        if (op->name != func) {
+            IRVisitor::visit(op);
+        }
+    }
+
+public:
+    const For *loop = nullptr;
+
+    FindComputeLoop(const string &f, int r) : func(f), references(r) {}
+};
+
+// Offset the accesses to a ring-buffered func in one dimension, to
+// move them into the slot for the current loop iteration. The
+// producer and consumer may be on different threads, and so may be
+// using different slots.
+class OffsetRingBufferAccesses : public IRMutator {
+    const string &func;
+    int dim;
+    Expr producer_offset, consumer_offset;
+    bool in_producer = false;
+
+    using IRMutator::visit;
+
+    Expr offset() const {
+        return in_producer ? producer_offset : consumer_offset;
+    }
+
+    Stmt visit(const ProducerConsumer *op) override {
+        ScopedValue<bool> old_in_producer(in_producer, in_producer || (op->name == func && op->is_producer));
+        return IRMutator::visit(op);
+    }
+
+    Stmt visit(const Provide *op) override {
+        Stmt stmt = IRMutator::visit(op);
+        op = stmt.as<Provide>();
+        internal_assert(op);
+        if (op->name == func) {
+            vector<Expr> args = op->args;
+            internal_assert(dim < (int)args.size());
+            args[dim] += offset();
+            stmt = Provide::make(op->name, op->values, args);
+        }
+        return stmt;
+    }
+
+    Expr visit(const Call *op) override {
+        Expr expr = IRMutator::visit(op);
+        op = expr.as<Call>();
+        internal_assert(op);
+        if (op->name == func && op->call_type == Call::Halide) {
+            vector<Expr> args = op->args;
+            internal_assert(dim < (int)args.size());
+            args[dim] += offset();
+            expr = Call::make(op->type, op->name, args, op->call_type,
+                              op->func, op->value_index, op->image, op->param);
+        } else if (op->name == Call::buffer_crop) {
+            const Variable *buf_var = op->args[2].as<Variable>();
+            if (buf_var &&
+                starts_with(buf_var->name, func + ".") &&
+                ends_with(buf_var->name, ".buffer")) {
+                // Take the crop in the slot's coordinates, and then
+                // restore the original min, as for folded storage.
+                internal_assert(op->args.size() >= 5);
+                const Call *mins_call = op->args[3].as<Call>();
+                const Call *extents_call = op->args[4].as<Call>();
+                internal_assert(mins_call && extents_call);
+                vector<Expr> mins = mins_call->args;
+                internal_assert(dim < (int)mins.size() && dim < (int)extents_call->args.size());
+                Expr old_min = mins[dim];
+                Expr old_extent = extents_call->args[dim];
+
+                mins[dim] += offset();
+                vector<Expr> new_args = op->args;
+                new_args[3] = Call::make(type_of<int *>(), Call::make_struct, mins, Call::Intrinsic);
+                expr = Call::make(op->type, op->name, new_args, op->call_type);
+                expr = Call::make(op->type, Call::buffer_set_bounds,
+                                  {expr, dim, old_min, old_extent}, Call::Extern);
+            }
+        }
+        return expr;
+    }
+
+public:
+    OffsetRingBufferAccesses(const string &f, int d, Expr p, Expr c) :
+        func(f), dim(d), producer_offset(std::move(p)), consumer_offset(std::move(c)) {}
+};
+
+class ReplaceStmt : public IRMutator {
+    Stmt old_stmt, new_stmt;
+
+public:
+    using IRMutator::mutate;
+
+    Stmt mutate(const Stmt &s) override {
+        if (s.same_as(old_stmt)) {
+            return new_stmt;
+        } else {
+            return IRMutator::mutate(s);
+        }
+    }
+
+    ReplaceStmt(Stmt o, Stmt n) : old_stmt(std::move(o)), new_stmt(std::move(n)) {}
+};
+
+// Store a func scheduled with ring_buffer in a circular buffer with a
+// slot per iteration of the loop it is computed at. The slots are
+// stacked along one dimension of the func, and which one an iteration
+// uses is tracked with a counter, so the index math is one offset per
+// iteration rather than a modulo per access. If the func is async, a
+// semaphore initialized to the number of slots stops the producer
+// from overwriting a slot the consumer hasn't finished with.
+Stmt inject_ring_buffer(const Realize *op, Stmt body, const Function &func) {
+    const string &name = op->name;
+    const FuncSchedule &sched = func.schedule();
+
+    Expr slots = simplify(sched.ring_buffer());
+    const int64_t *const_slots = as_const_int(slots);
+    user_assert(const_slots && *const_slots > 0)
+        << "The extent of the ring buffer of " << name
+        << " must be a positive constant, not " << sched.ring_buffer() << "\n";
+
+    for (const StorageDim &d : sched.storage_dims()) {
+        user_assert(!d.fold_factor.defined())
+            << "Can't both fold the storage of " << name
+            << " and store it in a ring buffer.\n";
+    }
+
+    FindComputeLoop finder(name, count_func_references(body, name));
+    body.accept(&finder);
+    const For *loop = finder.loop;
+    user_assert(loop)
+        << "Can't store " << name << " in a ring buffer, because "
+        << "it is stored at the same loop level it is computed at.\n";
+    user_assert(loop->for_type == ForType::Serial || loop->for_type == ForType::Unrolled)
+        << "Can't store " << name << " in a ring buffer, because "
+        << "the loop over " << loop->name << " it is computed at is not serial.\n";
+
+    Box provided = box_provided(loop->body, name);
+    Box required = box_required(loop->body, name);
+    user_assert(provided.empty() || box_contains(provided, required))
+        << "Can't store " << name << " in a ring buffer, because iterations of "
+        << "the loop over " << loop->name << " use values of it computed by earlier iterations.\n";
+    Box box = box_union(provided, required);
+
+    // Stack the slots along the outermost storage dimension in which
+    // the footprint of an iteration has a constant size, so that each
+    // slot is as contiguous as possible.
+    Scope<Interval> scope;
+    scope.push(loop->name, Interval(loop->min, simplify(loop->min + loop->extent - 1)));
+    int dim = -1;
+    Expr slot_extent;
+    const vector<StorageDim> &storage_dims = sched.storage_dims();
+    for (size_t i = storage_dims.size(); i > 0 && dim < 0; i--) {
+        const vector<string> &args = func.args();
+        int d = (int)(std::find(args.begin(), args.end(), storage_dims[i - 1].var) - args.begin());
+        if (d >= (int)box.size() || !box[d].is_bounded()) {
+            continue;
+        }
+        Expr extent = simplify(box[d].max - box[d].min + 1);
+        Expr bound = find_constant_bound(extent, Direction::Upper, scope);
+        if (bound.defined() && is_const(bound) && can_prove(bound > 0)) {
+            dim = d;
+            slot_extent = bound;
+        }
+    }
+    user_assert(dim >= 0)
+        << "Can't store " << name << " in a ring buffer, because the region of it used by "
+        << "each iteration of the loop over " << loop->name
+        << " isn't bounded by a constant in any dimension.\n";
+
+    debug(3) << "Storing " << name << " in a ring buffer of " << slots
+             << " slots of extent " << slot_extent << " in dimension " << dim
+             << " over loop " << loop->name << "\n";
+
+    // The producer's slot counter and the semaphore use the names of
+    // storage folding's, so that fork_async_producers keeps them on
+    // the producer side of the fork, and the consumer's counter on
+    // the consumer side.
+    bool async = sched.async();
+    string sema_name = name + ".folding_semaphore.ring_buffer" + unique_name('_');
+    Expr sema_var = Variable::make(type_of<halide_semaphore_t *>(), sema_name);
+    string producer_slot = async ? sema_name + ".head" : name + ".ring_buffer_slot" + unique_name('_');
+    string consumer_slot = async ? sema_name + ".tail" : producer_slot;
+    vector<string> counters = {producer_slot};
+    if (async) {
+        counters.push_back(consumer_slot);
+    }
+
+    string min_name = name + ".ring_buffer_min" + unique_name('_');
+    string producer_offset_name = name + ".ring_buffer_offset" + unique_name('_');
+    string consumer_offset_name = async ? name + ".ring_buffer_offset" + unique_name('_') : producer_offset_name;
+    Expr min_var = Variable::make(Int(32), min_name);
+    Expr producer_offset = Variable::make(Int(32), producer_offset_name);
+    Expr consumer_offset = Variable::make(Int(32), consumer_offset_name);
+
+    auto load_counter = [](const string &counter) {
+        return Load::make(Int(32), counter, 0, Buffer<>(), Parameter(), const_true(), ModulusRemainder());
+    };
+
+    vector<Stmt> stmts;
+    stmts.push_back(OffsetRingBufferAccesses(name, dim, producer_offset, consumer_offset).mutate(loop->body));
+    if (async) {
+        Expr release = Call::make(Int(32), "halide_semaphore_release", {sema_var, 1}, Call::Extern);
+        stmts.push_back(Evaluate::make(release));
+    }
+    for (const string &counter : counters) {
+        Expr next = load_counter(counter) + 1;
+        stmts.push_back(Store::make(counter, select(next == slots, 0, next), 0,
+                                    Parameter(), const_true(), ModulusRemainder()));
+    }
+    Stmt loop_body = Block::make(stmts);
+    if (async) {
+        loop_body = Acquire::make(sema_var, 1, loop_body);
+        loop_body = LetStmt::make(consumer_offset_name, load_counter(consumer_slot) * slot_extent - min_var, loop_body);
+    }
+    loop_body = LetStmt::make(producer_offset_name, load_counter(producer_slot) * slot_extent - min_var, loop_body);
+    loop_body = LetStmt::make(min_name, simplify(box[dim].min), loop_body);
+
+    Stmt new_loop = For::make(loop->name, loop->min, loop->extent, loop->for_type, loop->device_api, loop_body);
+    body = ReplaceStmt(loop, new_loop).mutate(body);
+
+    Region bounds = op->bounds;
+    bounds[dim] = Range(0, simplify(slot_extent * slots));
+    Stmt stmt = Realize::make(name, op->types, op->memory_type, bounds, op->condition, body);
+
+    if (async) {
+        Expr sema_space = Call::make(type_of<halide_semaphore_t *>(), "halide_make_semaphore",
+                                     {slots}, Call::Extern);
+        stmt = LetStmt::make(sema_name, sema_space, stmt);
+    }
+    for (const string &counter : counters) {
+        stmt = Block::make(Store::make(counter, 0, 0, Parameter(), const_true(), ModulusRemainder()), stmt);
+        stmt = Allocate::make(counter, Int(32), MemoryType::Stack, {}, const_true(), stmt);
+    }
+    return stmt;
+}
+
+}  // namespace
+
 // Look for opportunities for storage folding in a statement
 class StorageFolding : public IRMutator {
     const map<string, Function> &env;
@@ -832,6 +1138,10 @@ class StorageFolding : public IRMutator {
         auto func_it = env.find(op->name);
         Function func = func_it != env.end() ? func_it->second : Function();
 
+        if (func_it != env.end() && func.schedule().ring_buffer().defined()) {
+            return inject_ring_buffer(op, body, func);
+        }
+
         // Don't attempt automatic storage folding if there is
         // more than one produce node for this func.
         bool explicit_only = count_producers(body, op->name) != 1;
@@ -23,6 +23,10 @@ namespace Internal {
  *
  * We can store f as a circular buffer of size two, instead of
  * allocating space for all of it.
+ *
+ * Also stores functions scheduled with Func::ring_buffer in a
+ * circular buffer with a slot per iteration of the loop they are
+ * computed at.
  */
 Stmt storage_folding(Stmt s, const std::map<std::string, Function> &env);
 
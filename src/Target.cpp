@@ -11,12 +11,16 @@
 #include "Util.h"
 #include "WasmExecutor.h"
 
-#if defined(__powerpc__) && defined(__linux__)
+#if (defined(__powerpc__) || defined(__aarch64__)) && defined(__linux__)
 // This uses elf.h and must be included after "LLVM_Headers.h", which
 // uses llvm/support/Elf.h.
 #include <sys/auxv.h>
 #endif
 
+#if defined(__aarch64__) && defined(__linux__)
+#include <sys/prctl.h>
+#endif
+
 #ifdef  _MSC_VER
 #include <intrin.h>
 #endif  // _MSC_VER
@@ -59,6 +63,18 @@ static void cpuid(int info[4], int infoType, int extra) {
 #endif
 #endif
 
+// Whether LLVM can generate SVE code for fixed-width vectors of a known
+// vector length. That needs the vscale_range function attribute (see
+// set_function_attributes_for_target); without it, wide vectors are
+// split into NEON registers, so vector_bits is rejected.
+bool sve_vector_bits_supported() {
+#if LLVM_VERSION >= 130
+    return true;
+#else
+    return false;
+#endif
+}
+
 Target calculate_host_target() {
     Target::OS os = Target::OSUnknown;
 #ifdef __linux__
@@ -73,6 +89,7 @@ Target calculate_host_target() {
 
     bool use_64_bits = (sizeof(size_t) == 8);
     int bits = use_64_bits ? 64 : 32;
+    int vector_bits = 0;
     std::vector<Target::Feature> initial_features;
 
 #if __riscv__
@@ -83,6 +100,35 @@ Target calculate_host_target() {
 #else
 #if defined(__arm__) || defined(__aarch64__)
     Target::Arch arch = Target::ARM;
+
+#if defined(__aarch64__) && defined(__linux__)
+    // These are the AT_HWCAP and AT_HWCAP2 bits from asm/hwcap.h
+    const unsigned long hwcap_asimdhp = 1UL << 10;
+    const unsigned long hwcap_asimddp = 1UL << 20;
+    const unsigned long hwcap_sve = 1UL << 22;
+    const unsigned long hwcap2_sve2 = 1UL << 1;
+    unsigned long hwcap = getauxval(AT_HWCAP);
+    unsigned long hwcap2 = getauxval(AT_HWCAP2);
+    if (hwcap & hwcap_asimddp) initial_features.push_back(Target::ARMDotProd);
+    if (hwcap & hwcap_asimdhp) initial_features.push_back(Target::ARMFp16);
+    if (hwcap & hwcap_sve) {
+        initial_features.push_back(Target::SVE);
+        if (hwcap2 & hwcap2_sve2) initial_features.push_back(Target::SVE2);
+        // The vector length this thread runs with, in bytes. The
+        // constants are from linux/prctl.h.
+        const int pr_sve_get_vl = 51;
+        const int pr_sve_vl_len_mask = 0xffff;
+        int vl = prctl(pr_sve_get_vl);
+        if (vl > 0) {
+            vector_bits = (vl & pr_sve_vl_len_mask) * 8;
+        }
+        if (!sve_vector_bits_supported()) {
+            // LLVM can't generate SVE code for a known vector length,
+            // so leave the vectors at NEON width.
+            vector_bits = 0;
+        }
+    }
+#endif
 #else
 #if defined(__powerpc__) && defined(__linux__)
     Target::Arch arch = Target::POWERPC;
@@ -143,6 +189,8 @@ Target calculate_host_target() {
         const uint32_t avx512_knl = avx512 | avx512pf | avx512er;
         const uint32_t avx512_skylake = avx512 | avx512vl | avx512bw | avx512dq;
         const uint32_t avx512_cannonlake = avx512_skylake | avx512ifma; // Assume ifma => vbmi
+        const uint32_t avx512vnni = 1U << 11; // In ecx
+        const uint32_t avx512bf16 = 1U << 5;  // In eax, with ecx=1
         if ((info2[1] & avx2) == avx2) {
             initial_features.push_back(Target::AVX2);
         }
@@ -157,6 +205,17 @@ Target calculate_host_target() {
             if ((info2[1] & avx512_cannonlake) == avx512_cannonlake) {
                 initial_features.push_back(Target::AVX512_Cannonlake);
             }
+            if ((info2[1] & avx512_skylake) == avx512_skylake &&
+                (info2[2] & avx512vnni) == avx512vnni) {
+                initial_features.push_back(Target::AVX512_Cascadelake);
+                // Call cpuid with eax=7, ecx=1
+                int info3[4];
+                cpuid(info3, 7, 1);
+                if ((info2[1] & avx512_cannonlake) == avx512_cannonlake &&
+                    (info3[0] & avx512bf16) == avx512bf16) {
+                    initial_features.push_back(Target::AVX512_SapphireRapids);
+                }
+            }
         }
     }
 #ifdef _WIN32
@@ -170,7 +229,9 @@ Target calculate_host_target() {
 #endif
 #endif
 
-    return {os, arch, bits, initial_features};
+    Target t{os, arch, bits, initial_features};
+    t.vector_bits = vector_bits;
+    return t;
 }
 
 int get_cuda_capability_lower_bound(const Target &t) {
@@ -352,6 +413,10 @@ const std::map<std::string, Target::Feature> feature_name_map = {
     {"avx512_knl", Target::AVX512_KNL},
     {"avx512_skylake", Target::AVX512_Skylake},
     {"avx512_cannonlake", Target::AVX512_Cannonlake},
+    {"avx512_cascadelake", Target::AVX512_Cascadelake},
+    {"avx512_sapphirerapids", Target::AVX512_SapphireRapids},
+    {"arm_dot_prod", Target::ARMDotProd},
+    {"arm_fp16", Target::ARMFp16},
     {"trace_loads", Target::TraceLoads},
     {"trace_stores", Target::TraceStores},
     {"trace_realizations", Target::TraceRealizations},
@@ -370,6 +435,8 @@ const std::map<std::string, Target::Feature> feature_name_map = {
     {"wasm_signext", Target::WasmSignExt},
     {"sve", Target::SVE},
     {"sve2", Target::SVE2},
+    {"plan_memory", Target::PlanMemory},
+    {"profile_hw", Target::ProfileHW},
     // NOTE: When adding features to this map, be sure to update
     // PyEnums.cpp and halide.cmake as well.
 };
@@ -470,6 +537,30 @@ bool merge_string(Target &t, const std::string &target) {
         } else if (tok == "trace_all") {
             t.set_features({Target::TraceLoads, Target::TraceStores, Target::TraceRealizations});
             features_specified = true;
+        } else if (Internal::starts_with(tok, "vector_bits_")) {
+            string num = tok.substr(strlen("vector_bits_"));
+            if (num.empty() || num.size() > 4 || num.find_first_not_of("0123456789") != string::npos) {
+                return false;
+            }
+            t.vector_bits = std::stoi(num);
+            // SVE vectors are a multiple of 128 bits, up to 2048 bits.
+            if (t.vector_bits <= 0 || t.vector_bits % 128 != 0 || t.vector_bits > 2048) {
+                return false;
+            }
+            if (!sve_vector_bits_supported()) {
+                return false;
+            }
+            features_specified = true;
+        } else if (Internal::starts_with(tok, "stack_budget_")) {
+            string num = tok.substr(strlen("stack_budget_"));
+            if (num.empty() || num.size() > 9 || num.find_first_not_of("0123456789") != string::npos) {
+                return false;
+            }
+            t.stack_budget = std::stoi(num);
+            if (t.stack_budget <= 0) {
+                return false;
+            }
+            features_specified = true;
         } else {
             return false;
         }
@@ -544,7 +635,10 @@ void bad_target_string(const std::string &target) {
                << "host's architecture, os, and feature set, with the "
                << "exception of the GPU runtimes, which default to off.\n"
                << "\n"
-               << "On this platform, the host target is: " << get_host_target().to_string() << "\n";
+               << "On this platform, the host target is: " << get_host_target().to_string() << "\n"
+               << (target.find("vector_bits_") != std::string::npos && !sve_vector_bits_supported() ?
+                       "\nvector_bits requires Halide to be built with LLVM 13 or later.\n" :
+                       "");
 }
 
 }
@@ -620,6 +714,12 @@ std::string Target::to_string() const {
     if (has_feature(Target::TraceLoads) && has_feature(Target::TraceStores) && has_feature(Target::TraceRealizations)) {
         result = Internal::replace_all(result, "trace_loads-trace_realizations-trace_stores", "trace_all");
     }
+    if (vector_bits != 0) {
+        result += "-vector_bits_" + std::to_string(vector_bits);
+    }
+    if (stack_budget != 0) {
+        result += "-stack_budget_" + std::to_string(stack_budget);
+    }
     return result;
 }
 
@@ -814,13 +914,17 @@ int Target::natural_vector_size(const Halide::Type &t) const {
         }
     } else if (arch == Target::X86) {
         if (is_integer && (has_feature(Halide::Target::AVX512_Skylake) ||
-                           has_feature(Halide::Target::AVX512_Cannonlake))) {
-            // AVX512BW exists on Skylake and Cannonlake
+                           has_feature(Halide::Target::AVX512_Cannonlake) ||
+                           has_feature(Halide::Target::AVX512_Cascadelake) ||
+                           has_feature(Halide::Target::AVX512_SapphireRapids))) {
+            // AVX512BW exists on Skylake and everything after it
             return 64 / data_size;
         } else if (t.is_float() && (has_feature(Halide::Target::AVX512) ||
                                     has_feature(Halide::Target::AVX512_KNL) ||
                                     has_feature(Halide::Target::AVX512_Skylake) ||
-                                    has_feature(Halide::Target::AVX512_Cannonlake))) {
+                                    has_feature(Halide::Target::AVX512_Cannonlake) ||
+                                    has_feature(Halide::Target::AVX512_Cascadelake) ||
+                                    has_feature(Halide::Target::AVX512_SapphireRapids))) {
             // AVX512F is on all AVX512 architectures
             return 64 / data_size;
         } else if (has_feature(Halide::Target::AVX2)) {
@@ -846,6 +950,10 @@ int Target::natural_vector_size(const Halide::Type &t) const {
             // No vectors, sorry.
             return 1;
         }
+    } else if (arch == Target::ARM && vector_bits != 0 && sve_vector_bits_supported() &&
+               (has_feature(Halide::Target::SVE) || has_feature(Halide::Target::SVE2))) {
+        // SVE vectors are as wide as the hardware's vector length.
+        return vector_bits / (data_size * 8);
     } else {
         // Assume 128-bit vectors on other targets.
         return 16 / data_size;
@@ -867,8 +975,9 @@ bool Target::get_runtime_compatible_target(const Target& other, Target &result)
             HVX_v62, HVX_v65, HVX_v66
     }};
 
-    const std::array<Feature, 12> intersection_features = {{
-            SSE41, AVX, AVX2, FMA, FMA4, F16C, ARMv7s,VSX, AVX512, AVX512_KNL, AVX512_Skylake, AVX512_Cannonlake
+    const std::array<Feature, 16> intersection_features = {{
+            SSE41, AVX, AVX2, FMA, FMA4, F16C, ARMv7s,VSX, AVX512, AVX512_KNL, AVX512_Skylake, AVX512_Cannonlake,
+            AVX512_Cascadelake, AVX512_SapphireRapids, ARMDotProd, ARMFp16
     }};
 
     const std::array<Feature, 10> matching_features = {{
@@ -52,6 +52,22 @@ struct Target {
     /** The bit-width of the target machine. Must be 0 for unknown, or 32 or 64. */
     int bits;
 
+    /** The size of the vector registers in bits, for architectures
+     * that don't fix it, such as ARM with SVE. Zero means unknown, in
+     * which case the architecture's minimum is used. Corresponds to
+     * the "vector_bits_N" token in target strings, which is only
+     * accepted if Halide's LLVM is version 13 or later. */
+    int vector_bits = 0;
+
+    /** The number of bytes of stack each task of a pipeline may use
+     * for allocations. When nonzero, allocations that would otherwise
+     * go on the heap are placed on the stack while they fit in the
+     * budget, and the thread pool is asked to give its threads enough
+     * stack for them. Zero means only small constant-sized allocations
+     * go on the stack. Corresponds to the "stack_budget_N" token in
+     * target strings. */
+    int stack_budget = 0;
+
     /** Optional features a target can have.
      * Corresponds to feature_name_map in Target.cpp.
      * See definitions in HalideRuntime.h for full information.
@@ -105,6 +121,10 @@ struct Target {
         AVX512_KNL = halide_target_feature_avx512_knl,
         AVX512_Skylake = halide_target_feature_avx512_skylake,
         AVX512_Cannonlake = halide_target_feature_avx512_cannonlake,
+        AVX512_Cascadelake = halide_target_feature_avx512_cascadelake,
+        AVX512_SapphireRapids = halide_target_feature_avx512_sapphirerapids,
+        ARMDotProd = halide_target_feature_arm_dot_prod,
+        ARMFp16 = halide_target_feature_arm_fp16,
         TraceLoads = halide_target_feature_trace_loads,
         TraceStores = halide_target_feature_trace_stores,
         TraceRealizations = halide_target_feature_trace_realizations,
@@ -122,6 +142,8 @@ struct Target {
         WasmSignExt = halide_target_feature_wasm_signext,
         SVE = halide_target_feature_sve,
         SVE2 = halide_target_feature_sve2,
+        PlanMemory = halide_target_feature_plan_memory,
+        ProfileHW = halide_target_feature_profile_hw,
         FeatureEnd = halide_target_feature_end
     };
     Target() : os(OSUnknown), arch(ArchUnknown), bits(0) {}
@@ -205,6 +227,8 @@ struct Target {
       return os == other.os &&
           arch == other.arch &&
           bits == other.bits &&
+          vector_bits == other.vector_bits &&
+          stack_budget == other.stack_budget &&
           features == other.features;
     }
 
@@ -226,7 +250,7 @@ struct Target {
     /** Convert the Target into a string form that can be reconstituted
      * by merge_string(), which will always be of the form
      *
-     *   arch-bits-os-feature1-feature2...featureN.
+     *   arch-bits-os-feature1-feature2...featureN[-vector_bits_N][-stack_budget_N].
      *
      * Note that is guaranteed that Target(t1.to_string()) == t1,
      * but not that Target(s).to_string() == s (since there can be
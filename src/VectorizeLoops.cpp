@@ -1,9 +1,11 @@
 #include <algorithm>
+#include <set>
 
 #include "CSE.h"
 #include "CodeGen_GPU_Dev.h"
 #include "Deinterleave.h"
 #include "ExprUsesVar.h"
+#include "Function.h"
 #include "IREquality.h"
 #include "IRMutator.h"
 #include "IROperator.h"
@@ -17,7 +19,9 @@
 namespace Halide {
 namespace Internal {
 
+using std::map;
 using std::pair;
+using std::set;
 using std::string;
 using std::vector;
 
@@ -245,6 +249,23 @@ bool uses_gpu_vars(Expr s) {
     return uses.uses_gpu;
 }
 
+class HasVectorStore : public IRVisitor {
+    using IRVisitor::visit;
+    void visit(const Store *op) override {
+        if (op->index.type().is_vector()) {
+            result = true;
+        }
+    }
+public:
+    bool result = false;
+};
+
+bool has_vector_store(Stmt s) {
+    HasVectorStore has;
+    s.accept(&has);
+    return has.result;
+}
+
 // Wrap a vectorized predicate around a Load/Store node.
 class PredicateLoadStore : public IRMutator {
     string var;
@@ -254,11 +275,15 @@ class PredicateLoadStore : public IRMutator {
     int lanes;
     bool valid;
     bool vectorized;
+    bool predicate_tail;
 
     using IRMutator::visit;
 
     bool should_predicate_store_load(int bit_size) {
-        if (in_hexagon) {
+        if (predicate_tail) {
+            // The schedule asked for it with TailStrategy::Predicate.
+            return true;
+        } else if (in_hexagon) {
             internal_assert(target.features_any_of({Target::HVX_64, Target::HVX_128}))
                 << "We are inside a hexagon loop, but the target doesn't have hexagon's features\n";
             return true;
@@ -349,9 +374,10 @@ class PredicateLoadStore : public IRMutator {
     }
 
 public:
-    PredicateLoadStore(string v, Expr vpred, bool in_hexagon, const Target &t) :
+    PredicateLoadStore(string v, Expr vpred, bool in_hexagon, const Target &t, bool predicate_tail) :
             var(v), vector_predicate(vpred), in_hexagon(in_hexagon), target(t),
-            lanes(vpred.type().lanes()), valid(true), vectorized(false) {
+            lanes(vpred.type().lanes()), valid(true), vectorized(false),
+            predicate_tail(predicate_tail) {
         internal_assert(lanes > 1);
     }
 
@@ -373,6 +399,10 @@ class VectorSubs : public IRMutator {
 
     bool in_hexagon; // Are we inside the hexagon loop?
 
+    // Should if statements over the var become predicated loads and
+    // stores regardless of the target?
+    bool predicate_tail;
+
     // A suffix to attach to widened variables.
     string widening_suffix;
 
@@ -702,9 +732,25 @@ class VectorSubs : public IRMutator {
 
     Stmt visit(const Store *op) override {
         Expr predicate = mutate(op->predicate);
-        Expr value = mutate(op->value);
         Expr index = mutate(op->index);
 
+        VectorReduce::Operator reduce_op;
+        Expr current, rest;
+        if (predicate.type().is_scalar() &&
+            index.type().is_scalar() &&
+            match_reduction(op, &reduce_op, &current, &rest)) {
+            // Every lane updates the same site, e.g. because we're
+            // vectorizing a reduction over an RVar. Combine the
+            // lanes with a horizontal reduction and then update the
+            // site once.
+            int lanes = replacement.type().lanes();
+            Expr reduced = VectorReduce::make(reduce_op, widen(mutate(rest), lanes), 1);
+            Expr value = vector_reduce_binop(reduce_op, mutate(current), reduced);
+            return Store::make(op->name, value, index, op->param, predicate, op->alignment);
+        }
+
+        Expr value = mutate(op->value);
+
         if (predicate.same_as(op->predicate) && value.same_as(op->value) && index.same_as(op->index)) {
             return op;
         } else {
@@ -718,6 +764,20 @@ class VectorSubs : public IRMutator {
         return (op->condition.type().lanes() > 1) ? scalarize(op) : op;
     }
 
+    Stmt visit(const Atomic *op) override {
+        Stmt body = mutate(op->body);
+        if (has_vector_store(body)) {
+            // The lanes may update the same site, so each lane has to
+            // do its own atomic update. Updates to a single site from
+            // all the lanes were turned into a VectorReduce above.
+            return scalarize(op);
+        } else if (body.same_as(op->body)) {
+            return op;
+        } else {
+            return Atomic::make(op->producer_name, body);
+        }
+    }
+
     Stmt visit(const IfThenElse *op) override {
         Expr cond = mutate(op->condition);
         int lanes = cond.type().lanes();
@@ -736,12 +796,12 @@ class VectorSubs : public IRMutator {
             bool vectorize_predicate = !uses_gpu_vars(cond);
             Stmt predicated_stmt;
             if (vectorize_predicate) {
-                PredicateLoadStore p(var, cond, in_hexagon, target);
+                PredicateLoadStore p(var, cond, in_hexagon, target, predicate_tail);
                 predicated_stmt = p.mutate(then_case);
                 vectorize_predicate = p.is_vectorized();
             }
             if (vectorize_predicate && else_case.defined()) {
-                PredicateLoadStore p(var, !cond, in_hexagon, target);
+                PredicateLoadStore p(var, !cond, in_hexagon, target, predicate_tail);
                 predicated_stmt = Block::make(predicated_stmt, p.mutate(else_case));
                 vectorize_predicate = p.is_vectorized();
             }
@@ -952,8 +1012,8 @@ class VectorSubs : public IRMutator {
     }
 
 public:
-    VectorSubs(string v, Expr r, bool in_hexagon, const Target &t) :
-            var(v), replacement(r), target(t), in_hexagon(in_hexagon) {
+    VectorSubs(string v, Expr r, bool in_hexagon, const Target &t, bool predicate_tail) :
+            var(v), replacement(r), target(t), in_hexagon(in_hexagon), predicate_tail(predicate_tail) {
         widening_suffix = ".x" + std::to_string(replacement.type().lanes());
     }
 };
@@ -961,14 +1021,19 @@ public:
 // Vectorize all loops marked as such in a Stmt
 class VectorizeLoops : public IRMutator {
     const Target &target;
+    const set<string> &predicated_loops;
     bool in_hexagon;
+    bool in_gpu;
 
     using IRMutator::visit;
 
     Stmt visit(const For *for_loop) override {
         bool old_in_hexagon = in_hexagon;
+        bool old_in_gpu = in_gpu;
         if (for_loop->device_api == DeviceAPI::Hexagon) {
             in_hexagon = true;
+        } else if (CodeGen_GPU_Dev::is_gpu_var(for_loop->name)) {
+            in_gpu = true;
         }
 
         Stmt stmt;
@@ -984,26 +1049,51 @@ class VectorizeLoops : public IRMutator {
             // Replace the var with a ramp within the body
             Expr for_var = Variable::make(Int(32), for_loop->name);
             Expr replacement = Ramp::make(for_loop->min, 1, extent->value);
-            stmt = VectorSubs(for_loop->name, replacement, in_hexagon, target).mutate(for_loop->body);
+            // GPU backends can't do predicated loads and stores.
+            bool predicate_tail = !in_gpu && predicated_loops.count(for_loop->name);
+            stmt = VectorSubs(for_loop->name, replacement, in_hexagon, target, predicate_tail).mutate(for_loop->body);
         } else {
             stmt = IRMutator::visit(for_loop);
         }
 
-        if (for_loop->device_api == DeviceAPI::Hexagon) {
-            in_hexagon = old_in_hexagon;
-        }
+        in_hexagon = old_in_hexagon;
+        in_gpu = old_in_gpu;
 
         return stmt;
     }
 
 public:
-    VectorizeLoops(const Target &t) : target(t), in_hexagon(false) {}
+    VectorizeLoops(const Target &t, const set<string> &p) :
+        target(t), predicated_loops(p), in_hexagon(false), in_gpu(false) {}
 };
 
+// Find the names of the loops over the inner vars of splits that use
+// TailStrategy::Predicate.
+set<string> find_predicated_loops(const map<string, Function> &env) {
+    set<string> result;
+    for (const auto &p : env) {
+        const Function &f = p.second;
+        for (int stage = 0; stage <= (int)f.updates().size(); stage++) {
+            const Definition &def = stage == 0 ? f.definition() : f.update(stage - 1);
+            if (!def.defined()) {
+                continue;
+            }
+            string prefix = f.name() + ".s" + std::to_string(stage) + ".";
+            for (const Split &split : def.schedule().splits()) {
+                if (split.is_split() && split.tail == TailStrategy::Predicate) {
+                    result.insert(prefix + split.inner);
+                }
+            }
+        }
+    }
+    return result;
+}
+
 }  // Anonymous namespace
 
-Stmt vectorize_loops(Stmt s, const Target &t) {
-    return VectorizeLoops(t).mutate(s);
+Stmt vectorize_loops(Stmt s, const map<string, Function> &env, const Target &t) {
+    set<string> predicated_loops = find_predicated_loops(env);
+    return VectorizeLoops(t, predicated_loops).mutate(s);
 }
 
 }  // namespace Internal
@@ -5,17 +5,22 @@
  * Defines the lowering pass that vectorizes loops marked as such
  */
 
+#include <map>
+
 #include "IR.h"
 #include "Target.h"
 
 namespace Halide {
 namespace Internal {
 
+class Function;
+
 /** Take a statement with for loops marked for vectorization, and turn
  * them into single statements that operate on vectors. The loops in
- * question must have constant extent.
+ * question must have constant extent. The environment is used to find
+ * the loops whose splits use TailStrategy::Predicate.
  */
-Stmt vectorize_loops(Stmt s, const Target &t);
+Stmt vectorize_loops(Stmt s, const std::map<std::string, Function> &env, const Target &t);
 
 }  // namespace Internal
 }  // namespace Halide
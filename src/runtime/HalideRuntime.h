@@ -305,6 +305,17 @@ extern void halide_join_thread(struct halide_thread *);
  */
 extern int halide_set_num_threads(int n);
 
+/** Reserve this many bytes of stack, on top of the system default, in
+ * threads subsequently spawned by Halide's thread pool. The
+ * reservation only ever grows, and the calling thread is
+ * unaffected. Threads that already exist can't be given more stack, so
+ * once the pool has spawned any, a reservation larger than the extra
+ * stack they were spawned with is an error until
+ * halide_shutdown_thread_pool is called. Returns zero on success. Pipelines compiled with a
+ * stack_budget call this with the most stack any one of their parallel
+ * tasks may use, and fail if it returns an error. */
+extern int halide_reserve_thread_stack(int bytes);
+
 /** Halide calls these functions to allocate and free memory. To
  * replace in AOT code, use the halide_set_custom_malloc and
  * halide_set_custom_free, or (on platforms that support weak
@@ -333,6 +344,30 @@ extern halide_malloc_t halide_set_custom_malloc(halide_malloc_t user_malloc);
 extern halide_free_t halide_set_custom_free(halide_free_t user_free);
 //@}
 
+/** Tell Halide whether or not it is permitted to hold onto freed host
+ * allocations made by halide_default_malloc to service future
+ * requests, instead of returning them eagerly to the system
+ * allocator. Freed blocks are binned by size class, kept mostly
+ * per-thread, and bounded in total by
+ * halide_host_allocation_cache_set_size. The default is false in AOT
+ * code. JIT-compiled code enables it by default; see
+ * JITSharedRuntime::reuse_host_allocations.
+ *
+ * If set to false, releases all cached host allocations back to the
+ * system allocator. */
+extern int halide_reuse_host_allocations(void *user_context, bool);
+
+/** Determines whether halide_default_malloc and halide_default_free
+ * use the host allocation cache. Override and switch based on the
+ * user_context for finer-grained control. By default just returns the
+ * value most recently set by the method above. */
+extern bool halide_can_reuse_host_allocations(void *user_context);
+
+/** Set the maximum number of bytes of freed host allocations kept by
+ * the host allocation cache. The default is 64MB. Shrinking the
+ * limit releases all cached allocations. */
+extern void halide_host_allocation_cache_set_size(int64_t size);
+
 /** Halide calls these functions to interact with the underlying
  * system runtime functions. To replace in AOT code on platforms that
  * support weak linking, define these functions yourself, or use
@@ -520,7 +555,9 @@ struct halide_trace_event_t {
  * HL_TRACE_FILE is defined, dumps the trace to that file in a
  * sequence of trace packets. The header for a trace packet is defined
  * below. If the trace is going to be large, you may want to make the
- * file a named pipe, and then read from that pipe into gzip.
+ * file a named pipe, and then read from that pipe into gzip, or set
+ * HL_TRACE_SAMPLE_RATE to N to trace only every Nth load and store
+ * of each Func.
  *
  * halide_trace returns a unique ID which will be passed to future
  * events that "belong" to the earlier event as the parent id. The
@@ -636,7 +673,40 @@ struct halide_trace_packet_t {
     #endif
 };
 
+/** If HL_TRACE_COMPRESS is set to 1, binary traces are instead written
+ * as a sequence of compressed blocks. Each block starts with this
+ * header, followed by num_funcs halide_trace_block_func_t entries
+ * indexing the Funcs in the block, followed by compressed_size bytes
+ * of packets compressed in the LZ4 block format. The first word of a
+ * block is halide_trace_block_magic, which is never the size of a
+ * packet, so blocks and packets may be told apart in a file holding
+ * both. All fields are 32-bit. */
+struct halide_trace_block_header_t {
+    uint32_t magic;
+    uint32_t compressed_size;
+    uint32_t uncompressed_size;
+    uint32_t num_packets;
+
+    /** The ids of the first and last packets in the block. Packets
+     * are in id order within and across blocks. */
+    int32_t first_id, last_id;
+
+    /** Bit e is set if the block holds a packet of event e. */
+    uint32_t event_mask;
+    uint32_t num_funcs;
+};
+
+enum { halide_trace_block_magic = 0x4b4c4254 };
+
+/** An entry of the index of the Funcs in a compressed trace block. */
+struct halide_trace_block_func_t {
+    /** The 32-bit FNV-1a hash of the Func name. */
+    uint32_t func_hash;
 
+    /** Bit e is set if the block holds a packet of event e for this
+     * Func. */
+    uint32_t event_mask;
+};
 
 /** Set the file descriptor that Halide should write binary trace
  * events to. If called with 0 as the argument, Halide outputs trace
@@ -844,6 +914,40 @@ extern int halide_get_gpu_device(void *user_context);
  */
 extern void halide_memoization_cache_set_size(int64_t size);
 
+/** The policies the memoization cache can use to choose which entry
+ * to evict when it is over its size limit. */
+typedef enum halide_memoization_cache_eviction_policy_t {
+    /** Evict the least recently used entry. This is the default. */
+    halide_memoization_cache_evict_lru = 0,
+    /** Among the few least recently used entries, evict the one that
+     * took the least time to compute per byte it occupies. This
+     * requires a clock, and times calls to the memoized Funcs. */
+    halide_memoization_cache_evict_cost_aware = 1,
+} halide_memoization_cache_eviction_policy_t;
+
+/** Set the eviction policy of the memoization cache. */
+extern void halide_memoization_cache_set_eviction_policy(halide_memoization_cache_eviction_policy_t policy);
+
+/** Counters describing the behavior of the memoization cache since
+ * it was last cleaned up. */
+struct halide_memoization_cache_stats_t {
+    /** The number of lookups that found a stored result. */
+    uint64_t hits;
+    /** The number of lookups that did not. */
+    uint64_t misses;
+    /** The number of results added to the cache. */
+    uint64_t stores;
+    /** The number of results evicted to stay under the size limit. */
+    uint64_t evictions;
+    /** The number of bytes of results currently held, and the limit. */
+    int64_t current_size, max_size;
+    /** The number of results currently held. */
+    int32_t entries;
+};
+
+/** Get the current memoization cache counters. */
+extern void halide_memoization_cache_get_stats(struct halide_memoization_cache_stats_t *stats);
+
 /** Given a cache key for a memoized result, currently constructed
  *  from the Func name and top-level Func name plus the arguments of
  *  the computation, determine if the result is in the cache and
@@ -1276,6 +1380,12 @@ typedef enum halide_target_feature_t {
     halide_target_feature_sve, ///< Enable ARM Scalable Vector Extensions
     halide_target_feature_sve2, ///< Enable ARM Scalable Vector Extensions v2
     halide_target_feature_egl,            ///< Force use of EGL support.
+    halide_target_feature_avx512_cascadelake, ///< Enable the AVX512 features supported by Cascade Lake Xeon server processors. This includes all of the Skylake features, plus AVX512-VNNI.
+    halide_target_feature_avx512_sapphirerapids, ///< Enable the AVX512 features supported by Sapphire Rapids Xeon server processors. This includes all of the Cascade Lake and Cannonlake features, plus AVX512-BF16.
+    halide_target_feature_arm_dot_prod, ///< Enable ARMv8.2-a dot product instructions (sdot and udot). Only used on 64-bit ARM.
+    halide_target_feature_arm_fp16, ///< Enable ARMv8.2-a half-precision floating point arithmetic. Only used on 64-bit ARM.
+    halide_target_feature_plan_memory, ///< Pack heap allocations with disjoint lifetimes into shared arenas.
+    halide_target_feature_profile_hw, ///< Like profile, but also read hardware performance counters at the start and end of each pipeline. Linux only.
 
     halide_target_feature_end ///< A sentinel. Every target is considered to have this feature, and setting this feature does nothing.
 } halide_target_feature_t;
@@ -1679,7 +1789,8 @@ struct halide_profiler_func_stats {
     /** The peak stack allocation of this Func's threads. */
     uint64_t stack_peak;
 
-    /** The average number of thread pool worker threads active while computing this Func. */
+    /** The average number of threads computing this Func, over the
+     * samples in which any thread was computing it. */
     uint64_t active_threads_numerator, active_threads_denominator;
 
     /** The name of this Func. A global constant string. */
@@ -1687,6 +1798,20 @@ struct halide_profiler_func_stats {
 
     /** The total number of memory allocation of this Func. */
     int num_allocs;
+
+    // The fields below were added after the ones above, and are
+    // appended so that code reading the fields above keeps working.
+
+    /** Total time taken evaluating this Func, summed over all the
+     * threads computing it (in nanoseconds). */
+    uint64_t thread_time;
+
+    /** The time taken evaluating this Func on each thread (in
+     * nanoseconds). Entry zero is the thread that called the
+     * pipeline, and entry i > 0 is the parallel task that held thread
+     * slot i - 1 of the profiler state. Has
+     * halide_profiler_max_threads + 1 entries. */
+    uint64_t *thread_times;
 };
 
 /** Per-pipeline state tracked by the sampling profiler. These exist
@@ -1732,6 +1857,38 @@ struct halide_profiler_pipeline_stats {
 
     /** The total number of memory allocation of funcs in this pipeline. */
     int num_allocs;
+
+    // The fields below were added after the ones above, and are
+    // appended so that code reading the fields above keeps working.
+
+    /** The current and peak memory allocation of funcs in this
+     * pipeline, counting the allocations that the plan_memory target
+     * feature packed into shared arenas at their full separate
+     * sizes. Without plan_memory, the same as memory_current and
+     * memory_peak. */
+    uint64_t memory_unplanned_current, memory_unplanned_peak;
+
+    /** The most threads seen computing this pipeline at once. */
+    int peak_threads;
+
+    /** Hardware counters for this pipeline, summed over the threads
+     * that have computed any profiled pipeline, between the start and
+     * end of each run. They include anything else those threads did
+     * meanwhile, such as waiting for work or running other pipelines.
+     * Only counted with the profile_hw target flag on Linux, and zero
+     * otherwise. */
+    uint64_t cycles, instructions, llc_misses, branch_misses;
+
+    /** The number of runs of this pipeline whose hardware counters
+     * are still being counted. While non-zero, the counters above are
+     * incomplete. */
+    int hw_runs_active;
+};
+
+/** The number of parallel tasks whose current Func the sampling
+ * profiler can track at once. Tasks beyond this are not sampled. */
+enum {
+    halide_profiler_max_threads = 64
 };
 
 /** The global state of the profiler. */
@@ -1753,7 +1910,9 @@ struct halide_profiler_state {
      * periodically by the profiler thread. */
     int current_func;
 
-    /** The number of threads currently doing work. */
+    /** The number of threads currently doing work. Only maintained
+     * by code running remotely (see get_remote_profiler_state); on the
+     * host, the running threads are those with a thread slot below. */
     int active_threads;
 
     /** A linked list of stats gathered for each pipeline. */
@@ -1766,6 +1925,19 @@ struct halide_profiler_state {
 
     /** Sampling thread reference to be joined at shutdown. */
     struct halide_thread *sampling_thread;
+
+    /** The id of the Func being computed by each parallel task that
+     * holds a thread slot. Each task claims a slot on entry, publishes
+     * its current Func to it, and releases it on exit, so that time
+     * spent in parallel code is billed to the Funcs actually running
+     * rather than to the Func that launched the parallel loop. */
+    int thread_funcs[halide_profiler_max_threads];
+
+    /** Bitmasks of the thread slots currently claimed. */
+    uint32_t thread_slots_in_use[halide_profiler_max_threads / 32];
+
+    /** The number of profiled pipelines currently running. */
+    int running_pipelines;
 };
 
 /** Profiler func ids with special meanings. */
@@ -1802,9 +1974,55 @@ extern void halide_profiler_reset();
 void halide_profiler_shutdown();
 
 /** Print out timing statistics for everything run since the last
- * reset. Also happens at process exit. */
+ * reset. Also happens at process exit. If the environment variable
+ * HL_PROFILER_HW_FILE is set, the statistics, including any hardware
+ * counters collected (see profile_hw), are also appended to that file
+ * as CSV, as by halide_profiler_write_report. */
 extern void halide_profiler_report(void *user_context);
 
+/** Formats in which halide_profiler_write_report can write the
+ * profiler statistics. */
+typedef enum halide_profiler_report_format_t {
+    /** The same text printed by halide_profiler_report. */
+    halide_profiler_report_text,
+    /** One JSON object per line for each pipeline, with its Funcs in
+     * an array "funcs". */
+    halide_profiler_report_json,
+    /** One row per Func, preceded by a header row if the file is
+     * new. */
+    halide_profiler_report_csv
+} halide_profiler_report_format_t;
+
+/** Append the statistics for everything run since the last reset to
+ * the named file, in the given format. Returns zero on success, or an
+ * error code if the file couldn't be written. halide_profiler_report
+ * also does this if the environment variable HL_PROFILER_REPORT_FILE
+ * is set, in CSV if its name ends in ".csv", and JSON otherwise. */
+extern int halide_profiler_write_report(void *user_context, const char *filename,
+                                        halide_profiler_report_format_t format);
+
+/** A function to be called on the statistics of a pipeline. */
+typedef int (*halide_profiler_pipeline_visitor_t)(void *user_context,
+                                                  const struct halide_profiler_pipeline_stats *stats);
+
+/** Call a function on the statistics of each pipeline that has run
+ * since the last reset, while holding the profiler state's lock, so
+ * that statistics can be exported from AOT code without parsing the
+ * report. Stops at the first call that returns non-zero, and returns
+ * that value. The stats must not be retained after the call. */
+extern int halide_profiler_visit_pipelines(void *user_context,
+                                           halide_profiler_pipeline_visitor_t visitor);
+
+/** Set a function to be called at the end of every call to a profiled
+ * pipeline, with the statistics of that call only. The pipeline's
+ * statistics are reset after each call, so this can be used to build
+ * distributions of per-call latencies instead of only cumulative
+ * totals. Calls of the same pipeline that overlap will see each
+ * other's statistics. Times are still sampled, so are quantized to
+ * the profiler's sleep_time. Pass NULL to go back to accumulating
+ * statistics over all calls. Returns the old handler. */
+extern halide_profiler_pipeline_visitor_t halide_set_profiler_call_handler(halide_profiler_pipeline_visitor_t handler);
+
 /// \name "Float16" functions
 /// These functions operate of bits (``uint16_t``) representing a half
 /// precision floating point number (IEEE-754 2008 binary16).
@@ -80,6 +80,11 @@ struct CacheEntry {
     halide_dimension_t *computed_bounds;
     // The actual stored data.
     halide_buffer_t *buf;
+    // The total size of the tuple buffers, in bytes.
+    uint64_t size_in_bytes;
+    // How long the data took to compute, if known. Used by the
+    // cost-aware eviction policy.
+    int64_t compute_ns;
 
     bool init(const uint8_t *cache_key, size_t cache_key_size,
               uint32_t key_hash,
@@ -93,6 +98,9 @@ struct CacheEntry {
 struct CacheBlockHeader {
     CacheEntry *entry;
     uint32_t hash;
+    // The time of the cache miss that allocated this block, or zero
+    // if it wasn't recorded.
+    int64_t miss_time_ns;
 };
 
 // Each host block has extra space to store a header just before the
@@ -121,7 +129,8 @@ WEAK bool CacheEntry::init(const uint8_t *cache_key, size_t cache_key_size,
     in_use_count = 0;
     tuple_count = tuples;
     dimensions = computed_bounds_buf->dimensions;
-
+    size_in_bytes = 0;
+    compute_ns = 0;
     // Allocate all the necessary space (or die)
     size_t storage_bytes = 0;
 
@@ -165,6 +174,7 @@ WEAK bool CacheEntry::init(const uint8_t *cache_key, size_t cache_key_size,
         for (int j = 0; j < dimensions; j++) {
             buf[i].dim[j] = tuple_buffers[i]->dim[j];
         }
+        size_in_bytes += buf[i].size_in_bytes();
     }
     return true;
 }
@@ -177,42 +187,89 @@ WEAK void CacheEntry::destroy() {
     halide_free(NULL, metadata_storage);
 }
 
-WEAK uint32_t djb_hash(const uint8_t *key, size_t key_size)  {
-    uint32_t h = 5381;
-    for (size_t i = 0; i < key_size; i++) {
-        h = (h << 5) + h + key[i];
-    }
-    return h;
+
+// Hashes the key a word at a time. Keys are typically dozens to
+// hundreds of bytes, so this is considerably cheaper than a byte-wise
+// hash. The high bits select the shard and the low bits select the
+// bucket within it, so the result is mixed thoroughly.
+WEAK uint32_t key_hash(const uint8_t *key, size_t key_size) {
+    const uint64_t m = 0x9e3779b97f4a7c15ULL;
+    uint64_t h = (uint64_t)key_size * m;
+    size_t i = 0;
+    for (; i + 8 <= key_size; i += 8) {
+        uint64_t w;
+        memcpy(&w, key + i, 8);
+        h = (h ^ w) * m;
+        h ^= h >> 32;
+    }
+    uint64_t tail = 0;
+    for (; i < key_size; i++) {
+        tail = (tail << 8) | key[i];
+    }
+    h = (h ^ tail) * m;
+    h ^= h >> 29;
+    h *= m;
+    h ^= h >> 32;
+    return (uint32_t)h;
 }
 
-WEAK halide_mutex memoization_lock = { { 0 } };
+// The cache is split into shards, each with its own lock, hash table,
+// and recency list, so that threads looking up unrelated keys don't
+// contend. The size limit is global: a store prunes its own shard
+// first, and only visits the other shards if that wasn't enough.
+const size_t kCacheShards = 16;
+const size_t kHashTableSize = 64;  // Buckets per shard
+
+struct CacheShard {
+    halide_mutex lock;
+    CacheEntry *entries[kHashTableSize];
+    CacheEntry *most_recently_used;
+    CacheEntry *least_recently_used;
+    int32_t num_entries;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t stores;
+    uint64_t evictions;
+};
 
-const size_t kHashTableSize = 256;
+WEAK CacheShard cache_shards[kCacheShards];
 
-WEAK CacheEntry *cache_entries[kHashTableSize];
+WEAK __attribute((always_inline)) uint32_t shard_index(uint32_t h) {
+    return h >> 28;
+}
 
-WEAK CacheEntry *most_recently_used = NULL;
-WEAK CacheEntry *least_recently_used = NULL;
+WEAK __attribute((always_inline)) uint32_t bucket_index(uint32_t h) {
+    return h % kHashTableSize;
+}
 
 const uint64_t kDefaultCacheSize = 1 << 20;
 WEAK int64_t max_cache_size = kDefaultCacheSize;
 WEAK int64_t current_cache_size = 0;
 
+WEAK halide_memoization_cache_eviction_policy_t eviction_policy = halide_memoization_cache_evict_lru;
+
+// The number of unused entries at the least recently used end of a
+// shard that the cost-aware policy chooses between.
+const int kCostAwareCandidates = 8;
+
+// Not all runtimes link in a clock (e.g. NoOS), so compute times are
+// only recorded when the cost-aware policy is in use and one exists.
+WEAK bool memoization_clock_available() {
+    return &halide_current_time_ns != NULL;
+}
+
 #if CACHE_DEBUGGING
-WEAK void validate_cache() {
-    print(NULL) << "validating cache, "
-                << "current size " << current_cache_size
-                << " of maximum " << max_cache_size << "\n";
+WEAK void validate_shard(CacheShard *shard) {
     int entries_in_hash_table = 0;
     for (size_t i = 0; i < kHashTableSize; i++) {
-        CacheEntry *entry = cache_entries[i];
+        CacheEntry *entry = shard->entries[i];
         while (entry != NULL) {
             entries_in_hash_table++;
-            if (entry->more_recent == NULL && entry != most_recently_used) {
+            if (entry->more_recent == NULL && entry != shard->most_recently_used) {
                 halide_print(NULL, "cache invalid case 1\n");
                 __builtin_trap();
             }
-            if (entry->less_recent == NULL && entry != least_recently_used) {
+            if (entry->less_recent == NULL && entry != shard->least_recently_used) {
                 halide_print(NULL, "cache invalid case 2\n");
                 __builtin_trap();
             }
@@ -220,18 +277,19 @@ WEAK void validate_cache() {
         }
     }
     int entries_from_mru = 0;
-    CacheEntry *mru_chain = most_recently_used;
+    CacheEntry *mru_chain = shard->most_recently_used;
     while (mru_chain != NULL) {
         entries_from_mru++;
         mru_chain = mru_chain->less_recent;
     }
     int entries_from_lru = 0;
-    CacheEntry *lru_chain = least_recently_used;
+    CacheEntry *lru_chain = shard->least_recently_used;
     while (lru_chain != NULL) {
         entries_from_lru++;
         lru_chain = lru_chain->more_recent;
     }
-    print(NULL) << "hash entries " << entries_in_hash_table
+    print(NULL) << "shard " << (int)(shard - cache_shards)
+                << ": hash entries " << entries_in_hash_table
                 << ", mru entries " << entries_from_mru
                 << ", lru entries " << entries_from_lru << "\n";
     if (entries_in_hash_table != entries_from_mru) {
@@ -242,6 +300,10 @@ WEAK void validate_cache() {
         halide_print(NULL, "cache invalid case 4\n");
         __builtin_trap();
     }
+    if (entries_in_hash_table != shard->num_entries) {
+        halide_print(NULL, "cache invalid case 5\n");
+        __builtin_trap();
+    }
     if (current_cache_size < 0) {
         halide_print(NULL, "cache size is negative\n");
         __builtin_trap();
@@ -249,64 +311,130 @@ WEAK void validate_cache() {
 }
 #endif
 
-WEAK void prune_cache() {
-#if CACHE_DEBUGGING
-    validate_cache();
-#endif
-    CacheEntry *prune_candidate = least_recently_used;
-    while (current_cache_size > max_cache_size &&
-           prune_candidate != NULL) {
-        CacheEntry *more_recent = prune_candidate->more_recent;
-
-        if (prune_candidate->in_use_count == 0) {
-            uint32_t h = prune_candidate->hash;
-            uint32_t index = h % kHashTableSize;
-
-            // Remove from hash table
-            CacheEntry *prev_hash_entry = cache_entries[index];
-            if (prev_hash_entry == prune_candidate) {
-                cache_entries[index] = prune_candidate->next;
-            } else {
-                while (prev_hash_entry != NULL && prev_hash_entry->next != prune_candidate) {
-                    prev_hash_entry = prev_hash_entry->next;
-                }
-                halide_assert(NULL, prev_hash_entry != NULL);
-                prev_hash_entry->next = prune_candidate->next;
-            }
+// Unlink an entry from its shard's hash table and recency list. The
+// shard lock must be held.
+WEAK void remove_entry(CacheShard *shard, CacheEntry *entry) {
+    uint32_t index = bucket_index(entry->hash);
 
-            // Remove from less recent chain.
-            if (least_recently_used == prune_candidate) {
-                least_recently_used = more_recent;
-            }
-            if (more_recent != NULL) {
-                more_recent->less_recent = prune_candidate->less_recent;
-            }
+    // Remove from hash table
+    CacheEntry *prev_hash_entry = shard->entries[index];
+    if (prev_hash_entry == entry) {
+        shard->entries[index] = entry->next;
+    } else {
+        while (prev_hash_entry != NULL && prev_hash_entry->next != entry) {
+            prev_hash_entry = prev_hash_entry->next;
+        }
+        halide_assert(NULL, prev_hash_entry != NULL);
+        prev_hash_entry->next = entry->next;
+    }
 
-            // Remove from more recent chain.
-            if (most_recently_used == prune_candidate) {
-                most_recently_used = prune_candidate->less_recent;
-            }
-            if (prune_candidate->less_recent != NULL) {
-                prune_candidate->less_recent = more_recent;
-            }
+    // Remove from less recent chain.
+    if (shard->least_recently_used == entry) {
+        shard->least_recently_used = entry->more_recent;
+    }
+    if (entry->more_recent != NULL) {
+        entry->more_recent->less_recent = entry->less_recent;
+    }
 
-            // Decrease cache used amount.
-            for (uint32_t i = 0; i < prune_candidate->tuple_count; i++) {
-                current_cache_size -= prune_candidate->buf[i].size_in_bytes();
-            }
+    // Remove from more recent chain.
+    if (shard->most_recently_used == entry) {
+        shard->most_recently_used = entry->less_recent;
+    }
+    if (entry->less_recent != NULL) {
+        entry->less_recent->more_recent = entry->more_recent;
+    }
+
+    shard->num_entries--;
+}
 
-            // Deallocate the entry.
-            prune_candidate->destroy();
-            halide_free(NULL, prune_candidate);
+// Pick the entry to evict next from a shard, or NULL if every entry
+// is in use. The shard lock must be held.
+WEAK CacheEntry *choose_victim(CacheShard *shard) {
+    CacheEntry *victim = NULL;
+    double victim_cost = 0;
+    int candidates = 0;
+    for (CacheEntry *entry = shard->least_recently_used;
+         entry != NULL && candidates < kCostAwareCandidates;
+         entry = entry->more_recent) {
+        if (entry->in_use_count != 0) {
+            continue;
+        }
+        if (eviction_policy == halide_memoization_cache_evict_lru) {
+            return entry;
         }
+        // Evict whatever is cheapest to recompute per byte freed.
+        double cost = (double)entry->compute_ns / (double)(entry->size_in_bytes + 1);
+        if (victim == NULL || cost < victim_cost) {
+            victim = entry;
+            victim_cost = cost;
+        }
+        candidates++;
+    }
+    return victim;
+}
+
+// Evict entries from a shard until the cache fits within its maximum
+// size, or the shard has nothing left to evict. The shard lock must
+// be held.
+WEAK void prune_shard(CacheShard *shard) {
+#if CACHE_DEBUGGING
+    validate_shard(shard);
+#endif
+    while (__atomic_load_n(&current_cache_size, __ATOMIC_RELAXED) > max_cache_size) {
+        CacheEntry *victim = choose_victim(shard);
+        if (victim == NULL) {
+            break;
+        }
+        remove_entry(shard, victim);
+        __sync_fetch_and_sub(&current_cache_size, (int64_t)victim->size_in_bytes);
+        shard->evictions++;
 
-        prune_candidate = more_recent;
+        // Deallocate the entry.
+        victim->destroy();
+        halide_free(NULL, victim);
     }
 #if CACHE_DEBUGGING
-    validate_cache();
+    validate_shard(shard);
 #endif
 }
 
+// Prune the shards in turn, starting after the given one, until the
+// cache fits. Only one shard lock is held at a time.
+WEAK void prune_cache(uint32_t first) {
+    for (uint32_t i = 0; i < kCacheShards; i++) {
+        if (__atomic_load_n(&current_cache_size, __ATOMIC_RELAXED) <= max_cache_size) {
+            return;
+        }
+        CacheShard *shard = &cache_shards[(first + i) % kCacheShards];
+        ScopedMutexLock lock(&shard->lock);
+        prune_shard(shard);
+    }
+}
+
+WEAK CacheEntry *find_entry(CacheShard *shard, uint32_t h, const uint8_t *cache_key, int32_t size,
+                            const halide_buffer_t *computed_bounds,
+                            int32_t tuple_count, halide_buffer_t **tuple_buffers) {
+    CacheEntry *entry = shard->entries[bucket_index(h)];
+    while (entry != NULL) {
+        if (entry->hash == h && entry->key_size == (size_t)size &&
+            keys_equal(entry->key, cache_key, size) &&
+            buffer_has_shape(computed_bounds, entry->computed_bounds) &&
+            entry->tuple_count == (uint32_t)tuple_count) {
+
+            // Check all the tuple buffers have the same bounds (they should).
+            bool all_bounds_equal = true;
+            for (int32_t i = 0; all_bounds_equal && i < tuple_count; i++) {
+                all_bounds_equal = buffer_has_shape(tuple_buffers[i], entry->buf[i].dim);
+            }
+            if (all_bounds_equal) {
+                return entry;
+            }
+        }
+        entry = entry->next;
+    }
+    return NULL;
+}
+
 }}} // namespace Halide::Runtime::Internal
 
 extern "C" {
@@ -316,18 +444,40 @@ WEAK void halide_memoization_cache_set_size(int64_t size) {
         size = kDefaultCacheSize;
     }
 
-    ScopedMutexLock lock(&memoization_lock);
-
     max_cache_size = size;
-    prune_cache();
+    prune_cache(0);
+}
+
+WEAK void halide_memoization_cache_set_eviction_policy(halide_memoization_cache_eviction_policy_t policy) {
+    if (policy == halide_memoization_cache_evict_cost_aware && memoization_clock_available()) {
+        halide_start_clock(NULL);
+    }
+    eviction_policy = policy;
+}
+
+WEAK void halide_memoization_cache_get_stats(struct halide_memoization_cache_stats_t *stats) {
+    stats->hits = 0;
+    stats->misses = 0;
+    stats->stores = 0;
+    stats->evictions = 0;
+    stats->entries = 0;
+    for (size_t i = 0; i < kCacheShards; i++) {
+        CacheShard *shard = &cache_shards[i];
+        ScopedMutexLock lock(&shard->lock);
+        stats->hits += shard->hits;
+        stats->misses += shard->misses;
+        stats->stores += shard->stores;
+        stats->evictions += shard->evictions;
+        stats->entries += shard->num_entries;
+    }
+    stats->current_size = __atomic_load_n(&current_cache_size, __ATOMIC_RELAXED);
+    stats->max_size = max_cache_size;
 }
 
 WEAK int halide_memoization_cache_lookup(void *user_context, const uint8_t *cache_key, int32_t size,
                                          halide_buffer_t *computed_bounds, int32_t tuple_count, halide_buffer_t **tuple_buffers) {
-    uint32_t h = djb_hash(cache_key, size);
-    uint32_t index = h % kHashTableSize;
-
-    ScopedMutexLock lock(&memoization_lock);
+    uint32_t h = key_hash(cache_key, size);
+    CacheShard *shard = &cache_shards[shard_index(h)];
 
 #if CACHE_DEBUGGING
     debug_print_key(user_context, "halide_memoization_cache_lookup", cache_key, size);
@@ -342,50 +492,48 @@ WEAK int halide_memoization_cache_lookup(void *user_context, const uint8_t *cach
     }
 #endif
 
-    CacheEntry *entry = cache_entries[index];
-    while (entry != NULL) {
-        if (entry->hash == h && entry->key_size == (size_t)size &&
-            keys_equal(entry->key, cache_key, size) &&
-            buffer_has_shape(computed_bounds, entry->computed_bounds) &&
-            entry->tuple_count == (uint32_t)tuple_count) {
-
-            // Check all the tuple buffers have the same bounds (they should).
-            bool all_bounds_equal = true;
-            for (int32_t i = 0; all_bounds_equal && i < tuple_count; i++) {
-                all_bounds_equal = buffer_has_shape(tuple_buffers[i], entry->buf[i].dim);
-            }
-
-            if (all_bounds_equal) {
-                if (entry != most_recently_used) {
-                    halide_assert(user_context, entry->more_recent != NULL);
-                    if (entry->less_recent != NULL) {
-                        entry->less_recent->more_recent = entry->more_recent;
-                    } else {
-                        halide_assert(user_context, least_recently_used == entry);
-                        least_recently_used = entry->more_recent;
-                    }
-                    halide_assert(user_context, entry->more_recent != NULL);
-                    entry->more_recent->less_recent = entry->less_recent;
-
-                    entry->more_recent = NULL;
-                    entry->less_recent = most_recently_used;
-                    if (most_recently_used != NULL) {
-                        most_recently_used->more_recent = entry;
-                    }
-                    most_recently_used = entry;
+    {
+        ScopedMutexLock lock(&shard->lock);
+
+        CacheEntry *entry = find_entry(shard, h, cache_key, size, computed_bounds, tuple_count, tuple_buffers);
+        if (entry != NULL) {
+            if (entry != shard->most_recently_used) {
+                halide_assert(user_context, entry->more_recent != NULL);
+                if (entry->less_recent != NULL) {
+                    entry->less_recent->more_recent = entry->more_recent;
+                } else {
+                    halide_assert(user_context, shard->least_recently_used == entry);
+                    shard->least_recently_used = entry->more_recent;
                 }
+                halide_assert(user_context, entry->more_recent != NULL);
+                entry->more_recent->less_recent = entry->less_recent;
 
-                for (int32_t i = 0; i < tuple_count; i++) {
-                    halide_buffer_t *buf = tuple_buffers[i];
-                    *buf = entry->buf[i];
+                entry->more_recent = NULL;
+                entry->less_recent = shard->most_recently_used;
+                if (shard->most_recently_used != NULL) {
+                    shard->most_recently_used->more_recent = entry;
                 }
+                shard->most_recently_used = entry;
+            }
 
-                entry->in_use_count += tuple_count;
-
-                return 0;
+            for (int32_t i = 0; i < tuple_count; i++) {
+                halide_buffer_t *buf = tuple_buffers[i];
+                *buf = entry->buf[i];
             }
+
+            entry->in_use_count += tuple_count;
+            shard->hits++;
+
+            return 0;
         }
-        entry = entry->next;
+
+        shard->misses++;
+    }
+
+    int64_t miss_time_ns = 0;
+    if (eviction_policy == halide_memoization_cache_evict_cost_aware &&
+        memoization_clock_available()) {
+        miss_time_ns = halide_current_time_ns(user_context);
     }
 
     for (int32_t i = 0; i < tuple_count; i++) {
@@ -403,12 +551,9 @@ WEAK int halide_memoization_cache_lookup(void *user_context, const uint8_t *cach
         CacheBlockHeader *header = get_pointer_to_header(buf->host);
         header->hash = h;
         header->entry = NULL;
+        header->miss_time_ns = miss_time_ns;
     }
 
-#if CACHE_DEBUGGING
-    validate_cache();
-#endif
-
     return 1;
 }
 
@@ -417,11 +562,15 @@ WEAK int halide_memoization_cache_store(void *user_context, const uint8_t *cache
                                         int32_t tuple_count, halide_buffer_t **tuple_buffers) {
     debug(user_context) << "halide_memoization_cache_store\n";
 
-    uint32_t h = get_pointer_to_header(tuple_buffers[0]->host)->hash;
+    CacheBlockHeader *first_header = get_pointer_to_header(tuple_buffers[0]->host);
+    uint32_t h = first_header->hash;
+    uint32_t s = shard_index(h);
+    CacheShard *shard = &cache_shards[s];
 
-    uint32_t index = h % kHashTableSize;
-
-    ScopedMutexLock lock(&memoization_lock);
+    int64_t compute_ns = 0;
+    if (first_header->miss_time_ns != 0 && memoization_clock_available()) {
+        compute_ns = halide_current_time_ns(user_context) - first_header->miss_time_ns;
+    }
 
 #if CACHE_DEBUGGING
     debug_print_key(user_context, "halide_memoization_cache_store", cache_key, size);
@@ -436,88 +585,82 @@ WEAK int halide_memoization_cache_store(void *user_context, const uint8_t *cache
     }
 #endif
 
-    CacheEntry *entry = cache_entries[index];
-    while (entry != NULL) {
-        if (entry->hash == h && entry->key_size == (size_t)size &&
-            keys_equal(entry->key, cache_key, size) &&
-            buffer_has_shape(computed_bounds, entry->computed_bounds) &&
-            entry->tuple_count == (uint32_t)tuple_count) {
+    {
+        ScopedMutexLock lock(&shard->lock);
 
-            bool all_bounds_equal = true;
-            bool no_host_pointers_equal = true;
-            {
-                for (int32_t i = 0; all_bounds_equal && i < tuple_count; i++) {
-                    halide_buffer_t *buf = tuple_buffers[i];
-                    all_bounds_equal = buffer_has_shape(tuple_buffers[i], entry->buf[i].dim);
-                    if (entry->buf[i].host == buf->host) {
-                        no_host_pointers_equal = false;
-                    }
-                }
+        CacheEntry *entry = find_entry(shard, h, cache_key, size, computed_bounds, tuple_count, tuple_buffers);
+        if (entry != NULL) {
+            for (int32_t i = 0; i < tuple_count; i++) {
+                halide_assert(user_context, entry->buf[i].host != tuple_buffers[i]->host);
             }
-            if (all_bounds_equal) {
-                halide_assert(user_context, no_host_pointers_equal);
-                // This entry is still in use by the caller. Mark it as having no cache entry
-                // so halide_memoization_cache_release can free the buffer.
-                for (int32_t i = 0; i < tuple_count; i++) {
-                    get_pointer_to_header(tuple_buffers[i]->host)->entry = NULL;
+            // This entry is still in use by the caller. Mark it as having no cache entry
+            // so halide_memoization_cache_release can free the buffer.
+            for (int32_t i = 0; i < tuple_count; i++) {
+                get_pointer_to_header(tuple_buffers[i]->host)->entry = NULL;
+            }
+            return 0;
+        }
 
-                }
-                return 0;
+        uint64_t added_size = 0;
+        {
+            for (int32_t i = 0; i < tuple_count; i++) {
+                halide_buffer_t *buf = tuple_buffers[i];
+                added_size += buf->size_in_bytes();
             }
         }
-        entry = entry->next;
-    }
+        __sync_fetch_and_add(&current_cache_size, (int64_t)added_size);
+        prune_shard(shard);
 
-    uint64_t added_size = 0;
-    {
-        for (int32_t i = 0; i < tuple_count; i++) {
-            halide_buffer_t *buf = tuple_buffers[i];
-            added_size += buf->size_in_bytes();
+        CacheEntry *new_entry = (CacheEntry *)halide_malloc(NULL, sizeof(CacheEntry));
+        bool inited = false;
+        if (new_entry) {
+            inited = new_entry->init(cache_key, size, h, computed_bounds, tuple_count, tuple_buffers);
         }
-    }
-    current_cache_size += added_size;
-    prune_cache();
+        if (!inited) {
+            __sync_fetch_and_sub(&current_cache_size, (int64_t)added_size);
 
-    CacheEntry *new_entry = (CacheEntry *)halide_malloc(NULL, sizeof(CacheEntry));
-    bool inited = false;
-    if (new_entry) {
-        inited = new_entry->init(cache_key, size, h, computed_bounds, tuple_count, tuple_buffers);
-    }
-    if (!inited) {
-        current_cache_size -= added_size;
+            // This entry is still in use by the caller. Mark it as having no cache entry
+            // so halide_memoization_cache_release can free the buffer.
+            for (int32_t i = 0; i < tuple_count; i++) {
+                get_pointer_to_header(tuple_buffers[i]->host)->entry = NULL;
+            }
 
-        // This entry is still in use by the caller. Mark it as having no cache entry
-        // so halide_memoization_cache_release can free the buffer.
-        for (int32_t i = 0; i < tuple_count; i++) {
-            get_pointer_to_header(tuple_buffers[i]->host)->entry = NULL;
+            if (new_entry) {
+                halide_free(user_context, new_entry);
+            }
+            return 0;
         }
 
-        if (new_entry) {
-            halide_free(user_context, new_entry);
+        uint32_t index = bucket_index(h);
+        new_entry->compute_ns = compute_ns;
+        new_entry->next = shard->entries[index];
+        new_entry->less_recent = shard->most_recently_used;
+        if (shard->most_recently_used != NULL) {
+            shard->most_recently_used->more_recent = new_entry;
         }
-        return 0;
-    }
-
-    new_entry->next = cache_entries[index];
-    new_entry->less_recent = most_recently_used;
-    if (most_recently_used != NULL) {
-        most_recently_used->more_recent = new_entry;
-    }
-    most_recently_used = new_entry;
-    if (least_recently_used == NULL) {
-        least_recently_used = new_entry;
-    }
-    cache_entries[index] = new_entry;
+        shard->most_recently_used = new_entry;
+        if (shard->least_recently_used == NULL) {
+            shard->least_recently_used = new_entry;
+        }
+        shard->entries[index] = new_entry;
+        shard->num_entries++;
+        shard->stores++;
 
-    new_entry->in_use_count = tuple_count;
+        new_entry->in_use_count = tuple_count;
 
-    for (int32_t i = 0; i < tuple_count; i++) {
-        get_pointer_to_header(tuple_buffers[i]->host)->entry = new_entry;
-    }
+        for (int32_t i = 0; i < tuple_count; i++) {
+            get_pointer_to_header(tuple_buffers[i]->host)->entry = new_entry;
+        }
 
 #if CACHE_DEBUGGING
-    validate_cache();
+        validate_shard(shard);
 #endif
+    }
+
+    // If this shard couldn't free enough on its own, take the excess
+    // from the others.
+    prune_cache(s + 1);
+
     debug(user_context) << "Exiting halide_memoization_cache_store\n";
 
     return 0;
@@ -531,12 +674,13 @@ WEAK void halide_memoization_cache_release(void *user_context, void *host) {
     if (entry == NULL) {
         halide_free(user_context, header);
     } else {
-        ScopedMutexLock lock(&memoization_lock);
+        CacheShard *shard = &cache_shards[shard_index(entry->hash)];
+        ScopedMutexLock lock(&shard->lock);
 
         halide_assert(user_context, entry->in_use_count > 0);
         entry->in_use_count--;
 #if CACHE_DEBUGGING
-        validate_cache();
+        validate_shard(shard);
 #endif
     }
 
@@ -545,19 +689,27 @@ WEAK void halide_memoization_cache_release(void *user_context, void *host) {
 
 WEAK void halide_memoization_cache_cleanup() {
     debug(NULL) << "halide_memoization_cache_cleanup\n";
-    for (size_t i = 0; i < kHashTableSize; i++) {
-        CacheEntry *entry = cache_entries[i];
-        cache_entries[i] = NULL;
-        while (entry != NULL) {
-            CacheEntry *next = entry->next;
-            entry->destroy();
-            halide_free(NULL, entry);
-            entry = next;
+    for (size_t s = 0; s < kCacheShards; s++) {
+        CacheShard *shard = &cache_shards[s];
+        for (size_t i = 0; i < kHashTableSize; i++) {
+            CacheEntry *entry = shard->entries[i];
+            shard->entries[i] = NULL;
+            while (entry != NULL) {
+                CacheEntry *next = entry->next;
+                entry->destroy();
+                halide_free(NULL, entry);
+                entry = next;
+            }
         }
+        shard->most_recently_used = NULL;
+        shard->least_recently_used = NULL;
+        shard->num_entries = 0;
+        shard->hits = 0;
+        shard->misses = 0;
+        shard->stores = 0;
+        shard->evictions = 0;
     }
     current_cache_size = 0;
-    most_recently_used = NULL;
-    least_recently_used = NULL;
 }
 
 namespace {
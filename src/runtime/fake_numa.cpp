@@ -0,0 +1,26 @@
+#include "HalideRuntime.h"
+#include "runtime_internal.h"
+
+// NUMA placement is only implemented on Linux. Everywhere else the
+// machine is treated as a single node.
+
+extern "C" {
+
+WEAK int halide_numa_init(void *user_context) {
+    return 1;
+}
+
+WEAK int halide_numa_current_node() {
+    return 0;
+}
+
+WEAK void halide_numa_bind_current_thread(int node) {
+}
+
+WEAK void halide_numa_unbind_all_threads() {
+}
+
+WEAK void halide_numa_place_allocation(void *ptr, size_t size) {
+}
+
+}  // extern "C"
@@ -78,6 +78,17 @@ WEAK void halide_mutex_lock(halide_mutex *mutex) {
 WEAK void halide_mutex_unlock(halide_mutex *mutex) {
 }
 
+WEAK void halide_cond_signal(halide_cond *cond) {
+}
+
+WEAK void halide_cond_broadcast(halide_cond *cond) {
+}
+
+WEAK void halide_cond_wait(halide_cond *cond, halide_mutex *mutex) {
+    // Nothing else can be running to signal it.
+    halide_error(NULL, "halide_cond_wait not implemented on this platform.");
+}
+
 WEAK void halide_shutdown_thread_pool() {
 }
 
@@ -88,6 +99,15 @@ WEAK int halide_set_num_threads(int n) {
     return 1;
 }
 
+WEAK int halide_reserve_thread_stack(int bytes) {
+    // No threads are ever spawned.
+    return 0;
+}
+
+WEAK bool halide_can_spawn_threads() {
+    return false;
+}
+
 WEAK halide_do_task_t halide_set_custom_do_task(halide_do_task_t f) {
     halide_do_task_t result = custom_do_task;
     custom_do_task = f;
@@ -0,0 +1,66 @@
+#include "HalideRuntime.h"
+#include "cpu_features.h"
+
+namespace Halide { namespace Runtime { namespace Internal {
+
+namespace {
+
+// The aux vector entries and bits of them that describe the optional
+// ARMv8.2-a and SVE features, from elf.h and asm/hwcap.h.
+const uint64_t at_hwcap = 16;
+const uint64_t at_hwcap2 = 26;
+const uint64_t hwcap_asimdhp = 1ULL << 10;
+const uint64_t hwcap_asimddp = 1ULL << 20;
+const uint64_t hwcap_sve = 1ULL << 22;
+const uint64_t hwcap2_sve2 = 1ULL << 1;
+
+// Read AT_HWCAP and AT_HWCAP2 from the aux vector. Returns false if
+// it can't be read, e.g. because /proc isn't mounted.
+bool get_hwcaps(uint64_t *hwcap, uint64_t *hwcap2) {
+    void *f = fopen("/proc/self/auxv", "rb");
+    if (!f) {
+        return false;
+    }
+    bool found = false;
+    uint64_t entry[2];
+    while (fread(entry, sizeof(entry), 1, f) == 1 && entry[0] != 0) {
+        if (entry[0] == at_hwcap) {
+            *hwcap = entry[1];
+            found = true;
+        } else if (entry[0] == at_hwcap2) {
+            *hwcap2 = entry[1];
+        }
+    }
+    fclose(f);
+    return found;
+}
+
+}  // namespace
+
+WEAK CpuFeatures halide_get_cpu_features() {
+    CpuFeatures features;
+    // Only claim to know about the optional features if we can
+    // detect them, so that code using them still runs if we can't.
+    uint64_t hwcap = 0, hwcap2 = 0;
+    if (get_hwcaps(&hwcap, &hwcap2)) {
+        features.set_known(halide_target_feature_arm_dot_prod);
+        features.set_known(halide_target_feature_arm_fp16);
+        features.set_known(halide_target_feature_sve);
+        features.set_known(halide_target_feature_sve2);
+        if (hwcap & hwcap_asimddp) {
+            features.set_available(halide_target_feature_arm_dot_prod);
+        }
+        if (hwcap & hwcap_asimdhp) {
+            features.set_available(halide_target_feature_arm_fp16);
+        }
+        if (hwcap & hwcap_sve) {
+            features.set_available(halide_target_feature_sve);
+        }
+        if (hwcap2 & hwcap2_sve2) {
+            features.set_available(halide_target_feature_sve2);
+        }
+    }
+    return features;
+}
+
+}}} // namespace Halide::Runtime::Internal
@@ -0,0 +1,210 @@
+#include "HalideRuntime.h"
+#include "runtime_internal.h"
+#include "scoped_spin_lock.h"
+
+// NUMA support for the thread pool and host allocator on Linux. The
+// topology is read from /sys, so there is no dependency on libnuma.
+
+extern "C" {
+
+typedef unsigned int pthread_key_t;
+extern int pthread_key_create(pthread_key_t *key, void (*destructor)(void *));
+extern int pthread_setspecific(pthread_key_t key, const void *value);
+extern void *pthread_getspecific(pthread_key_t key);
+extern int sched_setaffinity(int pid, size_t cpusetsize, const void *mask);
+extern int sched_getcpu();
+extern size_t fread(void *ptr, size_t size, size_t nmemb, void *stream);
+
+}  // extern "C"
+
+namespace Halide { namespace Runtime { namespace Internal {
+
+#define MAX_NUMA_NODES 64
+#define MAX_NUMA_CPUS 1024
+#define NUMA_PAGE_SIZE 4096
+
+// Allocations smaller than this are left to the allocator. They are
+// usually carved out of pages that have already been touched.
+#define NUMA_PLACEMENT_MIN_BYTES (64 * 1024)
+
+struct numa_cpu_mask {
+    uint64_t bits[MAX_NUMA_CPUS / 64];
+};
+
+struct numa_state_t {
+    volatile int lock;
+    bool initialized;
+    int num_nodes;
+    numa_cpu_mask node_cpus[MAX_NUMA_NODES];
+    int8_t cpu_node[MAX_NUMA_CPUS];
+
+    // Each thread pinned with halide_numa_bind_current_thread stores
+    // its node under this key, so that looking it up doesn't need a
+    // search or a lock. halide_numa_unbind_all_threads bumps the
+    // generation, which invalidates the stored nodes of every thread.
+    pthread_key_t key;
+    volatile int generation;
+};
+
+WEAK numa_state_t numa_state = {};
+
+// Read a small text file from /sys into buf, NUL terminated. Returns
+// false if the file can't be read.
+WEAK bool read_sys_file(const char *path, char *buf, size_t size) {
+    void *f = fopen(path, "r");
+    if (!f) {
+        return false;
+    }
+    size_t n = fread(buf, 1, size - 1, f);
+    fclose(f);
+    buf[n] = 0;
+    return n > 0;
+}
+
+// Returns the node the calling thread is pinned to, or -1 if it isn't
+// pinned. The key's value packs the generation above the node plus
+// one, so that unset (NULL) means unpinned.
+WEAK int numa_pinned_node() {
+    uintptr_t v = (uintptr_t)pthread_getspecific(numa_state.key);
+    if (v == 0 || (int)(v >> 8) != numa_state.generation) {
+        return -1;
+    }
+    return (int)(v & 0xff) - 1;
+}
+
+// Parse a kernel cpu or node list such as "0-3,8,10-11" into out.
+// Returns the number of entries, at most max.
+WEAK int parse_sys_list(const char *str, int *out, int max) {
+    int count = 0;
+    while (*str >= '0' && *str <= '9') {
+        int first = 0, last = 0;
+        while (*str >= '0' && *str <= '9') {
+            first = first * 10 + (*str++ - '0');
+        }
+        last = first;
+        if (*str == '-') {
+            str++;
+            last = 0;
+            while (*str >= '0' && *str <= '9') {
+                last = last * 10 + (*str++ - '0');
+            }
+        }
+        for (int i = first; i <= last && count < max; i++) {
+            out[count++] = i;
+        }
+        if (*str == ',') {
+            str++;
+        }
+    }
+    return count;
+}
+
+WEAK void detect_numa_topology() {
+    memset(numa_state.cpu_node, 0, sizeof(numa_state.cpu_node));
+    numa_state.num_nodes = 1;
+
+    char buf[1024];
+    if (!read_sys_file("/sys/devices/system/node/online", buf, sizeof(buf))) {
+        return;
+    }
+
+    int nodes[MAX_NUMA_NODES];
+    int num_nodes = parse_sys_list(buf, nodes, MAX_NUMA_NODES);
+    if (num_nodes <= 1) {
+        return;
+    }
+
+    // Nodes are numbered densely from here on, in case the kernel's
+    // numbering has holes.
+    int cpus[MAX_NUMA_CPUS];
+    for (int i = 0; i < num_nodes; i++) {
+        char path[128];
+        char *end = path + sizeof(path);
+        char *dst = halide_string_to_string(path, end, "/sys/devices/system/node/node");
+        dst = halide_int64_to_string(dst, end, nodes[i], 1);
+        halide_string_to_string(dst, end, "/cpulist");
+        if (!read_sys_file(path, buf, sizeof(buf))) {
+            return;
+        }
+        numa_cpu_mask *mask = &numa_state.node_cpus[i];
+        memset(mask, 0, sizeof(numa_cpu_mask));
+        int num_cpus = parse_sys_list(buf, cpus, MAX_NUMA_CPUS);
+        for (int j = 0; j < num_cpus; j++) {
+            int cpu = cpus[j];
+            if (cpu < MAX_NUMA_CPUS) {
+                mask->bits[cpu / 64] |= (uint64_t)1 << (cpu % 64);
+                numa_state.cpu_node[cpu] = (int8_t)i;
+            }
+        }
+    }
+    numa_state.num_nodes = num_nodes;
+}
+
+}}}  // namespace Halide::Runtime::Internal
+
+using namespace Halide::Runtime::Internal;
+
+extern "C" {
+
+WEAK int halide_numa_init(void *user_context) {
+    ScopedSpinLock lock(&numa_state.lock);
+    if (!numa_state.initialized) {
+        detect_numa_topology();
+        pthread_key_create(&numa_state.key, NULL);
+        numa_state.initialized = true;
+    }
+    return numa_state.num_nodes;
+}
+
+WEAK int halide_numa_current_node() {
+    if (numa_state.num_nodes <= 1) {
+        return 0;
+    }
+    int node = numa_pinned_node();
+    if (node >= 0) {
+        return node;
+    }
+    int cpu = sched_getcpu();
+    if (cpu < 0 || cpu >= MAX_NUMA_CPUS) {
+        return 0;
+    }
+    return numa_state.cpu_node[cpu];
+}
+
+WEAK void halide_numa_bind_current_thread(int node) {
+    if (numa_state.num_nodes <= 1 || node < 0 || node >= numa_state.num_nodes) {
+        return;
+    }
+    sched_setaffinity(0, sizeof(numa_cpu_mask), &numa_state.node_cpus[node]);
+    uintptr_t v = ((uintptr_t)numa_state.generation << 8) | (uintptr_t)(node + 1);
+    pthread_setspecific(numa_state.key, (void *)v);
+}
+
+WEAK void halide_numa_unbind_all_threads() {
+    ScopedSpinLock lock(&numa_state.lock);
+    numa_state.generation = (numa_state.generation + 1) & 0xffffff;
+}
+
+WEAK void halide_numa_place_allocation(void *ptr, size_t size) {
+    if (numa_state.num_nodes <= 1 || size < NUMA_PLACEMENT_MIN_BYTES) {
+        return;
+    }
+    // Only threads pinned to a node fault pages in eagerly. They only
+    // allocate from inside a parallel loop, so the allocation belongs
+    // to the loop iteration that consumes it. Allocations made by
+    // other threads are placed by whichever pool thread writes them
+    // first, which is node-local once par_for ranges are split by
+    // node.
+    if (numa_pinned_node() < 0) {
+        return;
+    }
+    // Touch one byte per page. Linux places a page on the node of the
+    // thread that first faults it in. Pages recycled by malloc have
+    // already been placed, and writing them again is harmless.
+    volatile char *p = (volatile char *)ptr;
+    for (size_t i = 0; i < size; i += NUMA_PAGE_SIZE) {
+        p[i] = 0;
+    }
+}
+
+}  // extern "C"
@@ -0,0 +1,294 @@
+#include "HalideRuntime.h"
+#include "runtime_internal.h"
+#include "scoped_spin_lock.h"
+
+// Hardware performance counters for the profiler on Linux, read with
+// perf_event_open. Each thread opens its own group of counters the
+// first time it computes part of a pipeline. The thread that runs a
+// pipeline reads the counters of all of them when the pipeline starts
+// and ends, and bills the difference to the pipeline.
+
+extern "C" {
+
+typedef unsigned int pthread_key_t;
+extern int pthread_key_create(pthread_key_t *key, void (*destructor)(void *));
+extern int pthread_setspecific(pthread_key_t key, const void *value);
+extern void *pthread_getspecific(pthread_key_t key);
+
+extern int syscall(int num, ...);
+extern ssize_t read(int fd, void *buf, size_t count);
+extern int close(int fd);
+
+struct utsname {
+    char sysname[65];
+    char nodename[65];
+    char release[65];
+    char version[65];
+    char machine[65];
+    char domainname[65];
+};
+extern int uname(utsname *buf);
+
+}  // extern "C"
+
+namespace Halide { namespace Runtime { namespace Internal {
+
+// The subset of the kernel's struct perf_event_attr we use, up to
+// PERF_ATTR_SIZE_VER0.
+struct perf_event_attr {
+    uint32_t type;
+    uint32_t size;
+    uint64_t config;
+    uint64_t sample_period;
+    uint64_t sample_type;
+    uint64_t read_format;
+    uint64_t flags;
+    uint32_t wakeup_events;
+    uint32_t bp_type;
+    uint64_t config1;
+};
+
+#define PERF_TYPE_HARDWARE 0
+#define PERF_COUNT_HW_CPU_CYCLES 0
+#define PERF_COUNT_HW_INSTRUCTIONS 1
+#define PERF_COUNT_HW_CACHE_MISSES 3
+#define PERF_COUNT_HW_BRANCH_MISSES 5
+#define PERF_FORMAT_GROUP (1 << 3)
+#define PERF_ATTR_FLAG_EXCLUDE_KERNEL (1 << 5)
+#define PERF_ATTR_FLAG_EXCLUDE_HV (1 << 6)
+
+// The order of these matches the fields of halide_profiler_pipeline_stats.
+#define NUM_HW_COUNTERS 4
+const uint64_t hw_counter_configs[NUM_HW_COUNTERS] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES,
+};
+
+struct hw_counter_thread {
+    // The counters, in a group led by the first one, or -1 if they
+    // couldn't be opened.
+    int fds[NUM_HW_COUNTERS];
+
+    // The counter values when they were opened.
+    uint64_t base[NUM_HW_COUNTERS];
+
+    // The next thread with open counters. It's a void * because types
+    // in the Halide runtime may not currently be recursive.
+    void *next;
+};
+
+struct hw_counter_state_t {
+    // Guards the fields below, apart from the syscall number.
+    volatile int lock;
+    bool initialized;
+    pthread_key_t key;
+    // The syscall number of perf_event_open, or zero if we don't know
+    // it for this architecture.
+    int perf_event_open;
+    // The threads with open counters.
+    hw_counter_thread *threads;
+    // The counts of threads that have since exited.
+    uint64_t retired[NUM_HW_COUNTERS];
+};
+
+WEAK hw_counter_state_t hw_counter_state = {};
+
+// The syscall number depends on the architecture of the process, not
+// just the machine: a 32-bit process on a 64-bit kernel uses the
+// kernel's 32-bit syscall table. The runtime is compiled once per bit
+// width for all architectures, so the architecture family comes from
+// the machine we're running on and the width from the pointer size.
+WEAK int perf_event_open_syscall() {
+    utsname u;
+    if (uname(&u) != 0) {
+        return 0;
+    }
+    const char *m = u.machine;
+    const bool is_32_bit = sizeof(void *) == 4;
+    if (strstr(m, "x86_64") || (m[0] == 'i' && strstr(m, "86"))) {
+        return is_32_bit ? 336 : 298;
+    } else if (strstr(m, "aarch64") || strstr(m, "arm")) {
+        return is_32_bit ? 364 : 241;
+    } else if (strstr(m, "riscv")) {
+        return 241;
+    } else if (strstr(m, "ppc") || strstr(m, "powerpc")) {
+        return 319;
+    }
+    return 0;
+}
+
+// Read the counters of a thread's group. Returns false if they
+// aren't available. The counters of any thread in the process can be
+// read from any other.
+WEAK bool read_hw_counters(hw_counter_thread *t, uint64_t *values) {
+    if (t->fds[0] < 0) {
+        return false;
+    }
+    // With PERF_FORMAT_GROUP, the leader returns the number of
+    // counters followed by their values.
+    uint64_t buf[NUM_HW_COUNTERS + 1];
+    if (read(t->fds[0], buf, sizeof(buf)) != (ssize_t)sizeof(buf)) {
+        return false;
+    }
+    for (int i = 0; i < NUM_HW_COUNTERS; i++) {
+        values[i] = buf[i + 1];
+    }
+    return true;
+}
+
+WEAK void hw_counter_thread_exit(void *arg) {
+    hw_counter_thread *t = (hw_counter_thread *)arg;
+    if (t->fds[0] >= 0) {
+        // Keep what this thread counted, and stop reading it.
+        ScopedSpinLock lock(&hw_counter_state.lock);
+        uint64_t values[NUM_HW_COUNTERS];
+        if (read_hw_counters(t, values)) {
+            for (int i = 0; i < NUM_HW_COUNTERS; i++) {
+                hw_counter_state.retired[i] += values[i] - t->base[i];
+            }
+        }
+        hw_counter_thread **prev = &hw_counter_state.threads;
+        while (*prev && *prev != t) {
+            prev = (hw_counter_thread **)&((*prev)->next);
+        }
+        if (*prev) {
+            *prev = (hw_counter_thread *)t->next;
+        }
+    }
+    for (int i = 0; i < NUM_HW_COUNTERS; i++) {
+        if (t->fds[i] >= 0) {
+            close(t->fds[i]);
+        }
+    }
+    free(t);
+}
+
+WEAK hw_counter_thread *open_hw_counters() {
+    hw_counter_thread *t = (hw_counter_thread *)malloc(sizeof(hw_counter_thread));
+    if (!t) {
+        return NULL;
+    }
+    t->next = NULL;
+    for (int i = 0; i < NUM_HW_COUNTERS; i++) {
+        t->fds[i] = -1;
+        t->base[i] = 0;
+    }
+
+    int syscall_num = hw_counter_state.perf_event_open;
+    for (int i = 0; syscall_num && i < NUM_HW_COUNTERS; i++) {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = hw_counter_configs[i];
+        attr.read_format = PERF_FORMAT_GROUP;
+        // Only count user code, which is allowed at the default
+        // perf_event_paranoid level.
+        attr.flags = PERF_ATTR_FLAG_EXCLUDE_KERNEL | PERF_ATTR_FLAG_EXCLUDE_HV;
+        // Count this thread, on any cpu.
+        int fd = syscall(syscall_num, &attr, 0, -1, i == 0 ? -1 : t->fds[0], 0UL);
+        if (fd < 0) {
+            // The counters aren't available (e.g. inside a VM or a
+            // restricted container), or not all of them are.
+            for (int j = 0; j < i; j++) {
+                close(t->fds[j]);
+                t->fds[j] = -1;
+            }
+            break;
+        }
+        t->fds[i] = fd;
+    }
+    if (read_hw_counters(t, t->base)) {
+        ScopedSpinLock lock(&hw_counter_state.lock);
+        t->next = hw_counter_state.threads;
+        hw_counter_state.threads = t;
+    }
+
+    // Set even if the counters couldn't be opened, so that we don't
+    // try again on this thread.
+    pthread_setspecific(hw_counter_state.key, t);
+    return t;
+}
+
+// Make sure the calling thread has its counters open.
+WEAK void ensure_hw_counters() {
+    if (!hw_counter_state.initialized) {
+        ScopedSpinLock lock(&hw_counter_state.lock);
+        if (!hw_counter_state.initialized) {
+            pthread_key_create(&hw_counter_state.key, hw_counter_thread_exit);
+            hw_counter_state.perf_event_open = perf_event_open_syscall();
+            __sync_synchronize();
+            hw_counter_state.initialized = true;
+        }
+    }
+    if (!pthread_getspecific(hw_counter_state.key)) {
+        open_hw_counters();
+    }
+}
+
+// The counts of all threads since they opened their counters,
+// including those that have since exited.
+WEAK void read_all_hw_counters(uint64_t *totals) {
+    ScopedSpinLock lock(&hw_counter_state.lock);
+    for (int i = 0; i < NUM_HW_COUNTERS; i++) {
+        totals[i] = hw_counter_state.retired[i];
+    }
+    for (hw_counter_thread *t = hw_counter_state.threads; t; t = (hw_counter_thread *)t->next) {
+        uint64_t values[NUM_HW_COUNTERS];
+        if (read_hw_counters(t, values)) {
+            for (int i = 0; i < NUM_HW_COUNTERS; i++) {
+                totals[i] += values[i] - t->base[i];
+            }
+        }
+    }
+}
+
+}}}  // namespace Halide::Runtime::Internal
+
+extern "C" {
+
+// Called by each thread when it starts computing part of a pipeline,
+// so that its counters are read with the others. Only opens them the
+// first time; after that it makes no syscalls.
+WEAK int halide_profiler_hw_enter_thread() {
+    ensure_hw_counters();
+    return 0;
+}
+
+// Called by the thread that runs a pipeline when it starts. The
+// counters of all threads are read here and when the pipeline ends,
+// rather than whenever a thread switches Func, so that reading them
+// doesn't disturb what they count.
+WEAK int halide_profiler_hw_pipeline_start(void *pipeline_state) {
+    ensure_hw_counters();
+    halide_profiler_pipeline_stats *p = (halide_profiler_pipeline_stats *)pipeline_state;
+    uint64_t totals[NUM_HW_COUNTERS];
+    read_all_hw_counters(totals);
+    // Subtract the counts so far, and add the counts at the end, so
+    // that runs of the same pipeline on different threads can
+    // overlap. As with the memory stats, this is done without the
+    // profiler state lock to avoid contention.
+    __sync_add_and_fetch(&p->hw_runs_active, 1);
+    __sync_sub_and_fetch(&p->cycles, totals[0]);
+    __sync_sub_and_fetch(&p->instructions, totals[1]);
+    __sync_sub_and_fetch(&p->llc_misses, totals[2]);
+    __sync_sub_and_fetch(&p->branch_misses, totals[3]);
+    return 0;
+}
+
+// Registered as a destructor by each pipeline, so that the run is
+// counted even if it fails.
+WEAK void halide_profiler_hw_pipeline_end(void *user_context, void *pipeline_state) {
+    halide_profiler_pipeline_stats *p = (halide_profiler_pipeline_stats *)pipeline_state;
+    uint64_t totals[NUM_HW_COUNTERS];
+    read_all_hw_counters(totals);
+    __sync_add_and_fetch(&p->cycles, totals[0]);
+    __sync_add_and_fetch(&p->instructions, totals[1]);
+    __sync_add_and_fetch(&p->llc_misses, totals[2]);
+    __sync_add_and_fetch(&p->branch_misses, totals[3]);
+    __sync_sub_and_fetch(&p->hw_runs_active, 1);
+}
+
+}  // extern "C"
@@ -2,13 +2,152 @@
 #include "runtime_internal.h"
 
 #include "printer.h"
+#include "scoped_spin_lock.h"
 
 extern "C" {
 
 extern void *malloc(size_t);
 extern void free(void *);
 
+}
+
+namespace Halide { namespace Runtime { namespace Internal {
+
+// A cache of freed host allocations, binned by size class, so that
+// allocations inside hot loops (e.g. compute_at inside a parallel
+// loop) don't go to the system allocator every time. Each class bin
+// exists once per shard and once globally. A thread uses the shard
+// picked by its stack address, which in practice gives every thread
+// its own shard, and falls back to the global bins when its shard is
+// empty or full. The total number of bytes held is bounded by
+// host_cache_max_size.
+
+// Size classes go up in steps of a quarter of a power of two, from 64
+// bytes up to 4MB. Larger allocations are never cached.
+#define HOST_CACHE_MIN_CLASS_BITS 6
+#define HOST_CACHE_MAX_CLASS_BITS 22
+#define HOST_CACHE_NUM_CLASSES (1 + 4 * (HOST_CACHE_MAX_CLASS_BITS - HOST_CACHE_MIN_CLASS_BITS))
+#define HOST_CACHE_NUM_SHARDS 16
+// The number of blocks of each class a shard keeps before spilling to
+// the global bin.
+#define HOST_CACHE_SHARD_DEPTH 4
+
+struct host_cache_bin {
+    void *head;
+    int count;
+};
+
+struct host_cache_shard {
+    volatile int lock;
+    host_cache_bin bins[HOST_CACHE_NUM_CLASSES];
+};
+
+WEAK host_cache_shard host_cache_shards[HOST_CACHE_NUM_SHARDS];
+WEAK host_cache_shard host_cache_global;
+
+WEAK bool halide_reuse_host_allocations_flag = false;
+WEAK size_t host_cache_max_size = 64 * 1024 * 1024;
+WEAK size_t host_cache_current_size = 0;
+
+// Returns the size class for an allocation, or -1 if it is too large
+// to cache.
+WEAK int host_cache_size_class(size_t x) {
+    if (x <= ((size_t)1 << HOST_CACHE_MIN_CLASS_BITS)) {
+        return 0;
+    } else if (x > ((size_t)1 << HOST_CACHE_MAX_CLASS_BITS)) {
+        return -1;
+    }
+    // x is in (2^b, 2^(b+1)]
+    int b = (int)(sizeof(unsigned long long) * 8 - 1) - __builtin_clzll((unsigned long long)(x - 1));
+    size_t step = (size_t)1 << (b - 2);
+    int k = (int)((x + step - 1) / step);  // In [5, 8]
+    return 1 + (b - HOST_CACHE_MIN_CLASS_BITS) * 4 + (k - 5);
+}
+
+WEAK size_t host_cache_class_size(int c) {
+    if (c == 0) {
+        return (size_t)1 << HOST_CACHE_MIN_CLASS_BITS;
+    }
+    int b = HOST_CACHE_MIN_CLASS_BITS + (c - 1) / 4;
+    size_t k = 5 + (c - 1) % 4;
+    return k << (b - 2);
+}
+
+WEAK host_cache_shard *host_cache_this_shard() {
+    // Thread stacks are at least a megabyte apart on the platforms we
+    // care about, so this is a cheap stand-in for a thread id.
+    int local;
+    uintptr_t addr = ((uintptr_t)&local) >> 20;
+    return &host_cache_shards[(addr ^ (addr >> 4)) % HOST_CACHE_NUM_SHARDS];
+}
+
+WEAK void *host_cache_pop(host_cache_shard *shard, int c) {
+    ScopedSpinLock lock(&shard->lock);
+    host_cache_bin *bin = &shard->bins[c];
+    void *ptr = bin->head;
+    if (ptr) {
+        bin->head = *(void **)ptr;
+        bin->count--;
+    }
+    return ptr;
+}
+
+WEAK bool host_cache_push(host_cache_shard *shard, int c, void *ptr, int max_count) {
+    ScopedSpinLock lock(&shard->lock);
+    host_cache_bin *bin = &shard->bins[c];
+    if (max_count && bin->count >= max_count) {
+        return false;
+    }
+    *(void **)ptr = bin->head;
+    bin->head = ptr;
+    bin->count++;
+    return true;
+}
+
+WEAK void host_cache_release_shard(host_cache_shard *shard) {
+    ScopedSpinLock lock(&shard->lock);
+    for (int c = 0; c < HOST_CACHE_NUM_CLASSES; c++) {
+        host_cache_bin *bin = &shard->bins[c];
+        while (bin->head) {
+            void *ptr = bin->head;
+            bin->head = *(void **)ptr;
+            __sync_fetch_and_sub(&host_cache_current_size, host_cache_class_size(c));
+            free(((void **)ptr)[-1]);
+        }
+        bin->count = 0;
+    }
+}
+
+WEAK void host_cache_release_all() {
+    for (int i = 0; i < HOST_CACHE_NUM_SHARDS; i++) {
+        host_cache_release_shard(&host_cache_shards[i]);
+    }
+    host_cache_release_shard(&host_cache_global);
+}
+
+}}} // namespace Halide::Runtime::Internal
+
+extern "C" {
+
 WEAK void *halide_default_malloc(void *user_context, size_t x) {
+    // Blocks that may be cached are allocated at the full size of
+    // their class, so that any request in that class can reuse them.
+    int c = -1;
+    if (halide_can_reuse_host_allocations(user_context)) {
+        c = host_cache_size_class(x);
+    }
+    if (c >= 0) {
+        void *ptr = host_cache_pop(host_cache_this_shard(), c);
+        if (!ptr) {
+            ptr = host_cache_pop(&host_cache_global, c);
+        }
+        if (ptr) {
+            __sync_fetch_and_sub(&host_cache_current_size, host_cache_class_size(c));
+            return ptr;
+        }
+        x = host_cache_class_size(c);
+    }
+
     // Allocate enough space for aligning the pointer we return.
     const size_t alignment = halide_malloc_alignment();
     void *orig = malloc(x + alignment);
@@ -16,16 +155,54 @@ WEAK void *halide_default_malloc(void *user_context, size_t x) {
         // Will result in a failed assertion and a call to halide_error
         return NULL;
     }
-    // We want to store the original pointer prior to the pointer we return.
-    void *ptr = (void *)(((size_t)orig + alignment + sizeof(void*) - 1) & ~(alignment - 1));
+    // We want to store the original pointer and the size class (plus
+    // one, so that zero means uncached) prior to the pointer we
+    // return. malloc aligns to at least two pointers, so there is
+    // room for both.
+    void *ptr = (void *)(((size_t)orig + alignment + 2 * sizeof(void*) - 1) & ~(alignment - 1));
     ((void **)ptr)[-1] = orig;
+    ((void **)ptr)[-2] = (void *)(uintptr_t)(c + 1);
+    halide_numa_place_allocation(ptr, x);
     return ptr;
 }
 
 WEAK void halide_default_free(void *user_context, void *ptr) {
+    int c = (int)(uintptr_t)((void **)ptr)[-2] - 1;
+    if (c >= 0 && halide_can_reuse_host_allocations(user_context)) {
+        size_t size = host_cache_class_size(c);
+        if (__sync_add_and_fetch(&host_cache_current_size, size) <= host_cache_max_size) {
+            if (host_cache_push(host_cache_this_shard(), c, ptr, HOST_CACHE_SHARD_DEPTH) ||
+                host_cache_push(&host_cache_global, c, ptr, 0)) {
+                return;
+            }
+        }
+        __sync_fetch_and_sub(&host_cache_current_size, size);
+    }
     free(((void**)ptr)[-1]);
 }
 
+WEAK int halide_reuse_host_allocations(void *user_context, bool flag) {
+    halide_reuse_host_allocations_flag = flag;
+    if (!flag) {
+        host_cache_release_all();
+    }
+    return 0;
+}
+
+WEAK bool halide_can_reuse_host_allocations(void *user_context) {
+    return halide_reuse_host_allocations_flag;
+}
+
+WEAK void halide_host_allocation_cache_set_size(int64_t size) {
+    if (size < 0) {
+        size = 0;
+    }
+    if ((size_t)size < host_cache_max_size) {
+        host_cache_release_all();
+    }
+    host_cache_max_size = (size_t)size;
+}
+
 }
 
 namespace Halide { namespace Runtime { namespace Internal {
@@ -57,4 +234,13 @@ WEAK void halide_free(void *user_context, void *ptr) {
     custom_free(user_context, ptr);
 }
 
+namespace {
+
+__attribute__((destructor))
+WEAK void halide_host_allocation_cache_cleanup() {
+    host_cache_release_all();
+}
+
+}
+
 }
@@ -17,9 +17,17 @@ struct pthread_cond_t {
     uint64_t _private[8];
 };
 
+struct pthread_attr_t {
+    uint64_t _private[16];
+};
+
 typedef long pthread_t;
 extern int pthread_create(pthread_t *, const void * attr,
                           void *(*start_routine)(void *), void * arg);
+extern int pthread_attr_init(pthread_attr_t *attr);
+extern int pthread_attr_getstacksize(const pthread_attr_t *attr, size_t *stacksize);
+extern int pthread_attr_setstacksize(pthread_attr_t *attr, size_t stacksize);
+extern int pthread_attr_destroy(pthread_attr_t *attr);
 extern int pthread_join(pthread_t thread, void **retval);
 extern int pthread_cond_init(pthread_cond_t *cond, const void *attr);
 extern int pthread_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex);
@@ -51,6 +59,10 @@ WEAK void *spawn_thread_helper(void *arg) {
     return NULL;
 }
 
+// Extra stack space to give spawned threads, on top of the system
+// default. See halide_reserve_thread_stack.
+WEAK int thread_stack_reserve = 0;
+
 }}} // namespace Halide::Runtime::Internal
 
 extern "C" {
@@ -62,7 +74,17 @@ WEAK struct halide_thread *halide_spawn_thread(void (*f)(void *), void *closure)
     t->f = f;
     t->closure = closure;
     t->handle = 0;
-    pthread_create(&t->handle, NULL, spawn_thread_helper, t);
+    if (thread_stack_reserve > 0) {
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        size_t stack_size = 0;
+        pthread_attr_getstacksize(&attr, &stack_size);
+        pthread_attr_setstacksize(&attr, stack_size + thread_stack_reserve);
+        pthread_create(&t->handle, &attr, spawn_thread_helper, t);
+        pthread_attr_destroy(&attr);
+    } else {
+        pthread_create(&t->handle, NULL, spawn_thread_helper, t);
+    }
     return (halide_thread *)t;
 }
 
@@ -16,6 +16,45 @@ WEAK halide_profiler_state *halide_profiler_get_state() {
 
 namespace Halide { namespace Runtime { namespace Internal {
 
+// Called at the end of each call to a profiled pipeline, if set.
+WEAK halide_profiler_pipeline_visitor_t profiler_call_handler = NULL;
+
+// Zero all the statistics gathered for a pipeline.
+WEAK void reset_pipeline_stats(halide_profiler_pipeline_stats *p) {
+    p->runs = 0;
+    p->time = 0;
+    p->samples = 0;
+    p->memory_current = 0;
+    p->memory_peak = 0;
+    p->memory_total = 0;
+    p->memory_unplanned_current = 0;
+    p->memory_unplanned_peak = 0;
+    p->num_allocs = 0;
+    p->active_threads_numerator = 0;
+    p->active_threads_denominator = 0;
+    p->peak_threads = 0;
+    p->cycles = 0;
+    p->instructions = 0;
+    p->llc_misses = 0;
+    p->branch_misses = 0;
+    const int num_threads = halide_profiler_max_threads + 1;
+    for (int i = 0; i < p->num_funcs; i++) {
+        halide_profiler_func_stats *fs = p->funcs + i;
+        fs->time = 0;
+        fs->memory_current = 0;
+        fs->memory_peak = 0;
+        fs->memory_total = 0;
+        fs->num_allocs = 0;
+        fs->stack_peak = 0;
+        fs->active_threads_numerator = 0;
+        fs->active_threads_denominator = 0;
+        fs->thread_time = 0;
+        for (int j = 0; j < num_threads; j++) {
+            fs->thread_times[j] = 0;
+        }
+    }
+}
+
 WEAK halide_profiler_pipeline_stats *find_or_create_pipeline(const char *pipeline_name, int num_funcs, const uint64_t *func_names) {
     halide_profiler_state *s = halide_profiler_get_state();
 
@@ -36,37 +75,28 @@ WEAK halide_profiler_pipeline_stats *find_or_create_pipeline(const char *pipelin
     p->name = pipeline_name;
     p->first_func_id = s->first_free_id;
     p->num_funcs = num_funcs;
-    p->runs = 0;
-    p->time = 0;
-    p->samples = 0;
-    p->memory_current = 0;
-    p->memory_peak = 0;
-    p->memory_total = 0;
-    p->num_allocs = 0;
-    p->active_threads_numerator = 0;
-    p->active_threads_denominator = 0;
-    p->funcs = (halide_profiler_func_stats *)malloc(num_funcs * sizeof(halide_profiler_func_stats));
+    p->hw_runs_active = 0;
+    // The per-thread times of each func live after the func stats,
+    // in the same allocation.
+    const int num_threads = halide_profiler_max_threads + 1;
+    p->funcs = (halide_profiler_func_stats *)malloc(num_funcs * (sizeof(halide_profiler_func_stats) +
+                                                                 num_threads * sizeof(uint64_t)));
     if (!p->funcs) {
         free(p);
         return NULL;
     }
+    uint64_t *thread_times = (uint64_t *)(p->funcs + num_funcs);
     for (int i = 0; i < num_funcs; i++) {
-        p->funcs[i].time = 0;
         p->funcs[i].name = (const char *)(func_names[i]);
-        p->funcs[i].memory_current = 0;
-        p->funcs[i].memory_peak = 0;
-        p->funcs[i].memory_total = 0;
-        p->funcs[i].num_allocs = 0;
-        p->funcs[i].stack_peak = 0;
-        p->funcs[i].active_threads_numerator = 0;
-        p->funcs[i].active_threads_denominator = 0;
+        p->funcs[i].thread_times = thread_times + i * num_threads;
     }
+    reset_pipeline_stats(p);
     s->first_free_id += num_funcs;
     s->pipelines = p;
     return p;
 }
 
-WEAK void bill_func(halide_profiler_state *s, int func_id, uint64_t time, int active_threads) {
+WEAK halide_profiler_pipeline_stats *find_pipeline(halide_profiler_state *s, int func_id) {
     halide_profiler_pipeline_stats *p_prev = NULL;
     for (halide_profiler_pipeline_stats *p = s->pipelines; p;
          p = (halide_profiler_pipeline_stats *)(p->next)) {
@@ -77,19 +107,115 @@ WEAK void bill_func(halide_profiler_state *s, int func_id, uint64_t time, int ac
                 p->next = s->pipelines;
                 s->pipelines = p;
             }
-            halide_profiler_func_stats *f = p->funcs + func_id - p->first_func_id;
-            f->time += time;
-            f->active_threads_numerator += active_threads;
+            return p;
+        }
+        p_prev = p;
+    }
+    // Someone must have called reset_state while a kernel was running.
+    return NULL;
+}
+
+// Bill time to a func running remotely, where all we know is the
+// current func and the number of active threads.
+WEAK void bill_func(halide_profiler_state *s, int func_id, uint64_t time, int active_threads) {
+    halide_profiler_pipeline_stats *p = find_pipeline(s, func_id);
+    if (!p) {
+        return;
+    }
+    halide_profiler_func_stats *f = p->funcs + func_id - p->first_func_id;
+    f->time += time;
+    f->thread_time += time * active_threads;
+    f->thread_times[0] += time;
+    f->active_threads_numerator += active_threads;
+    f->active_threads_denominator += 1;
+    p->time += time;
+    p->samples++;
+    p->active_threads_numerator += active_threads;
+    p->active_threads_denominator += 1;
+    if (active_threads > p->peak_threads) {
+        p->peak_threads = active_threads;
+    }
+}
+
+// Bill time to the funcs running on each thread. Each thread gets an
+// equal share of the elapsed time, so that the times of the funcs
+// still add up to the time spent in the pipeline.
+WEAK void bill_threads(halide_profiler_state *s, int *funcs, const int *threads, int n, uint64_t time) {
+    halide_profiler_pipeline_stats *pipelines[halide_profiler_max_threads + 1];
+    for (int i = 0; i < n; i++) {
+        pipelines[i] = find_pipeline(s, funcs[i]);
+        if (pipelines[i]) {
+            funcs[i] -= pipelines[i]->first_func_id;
+        }
+    }
+
+    // A thread sits in the overhead func while it waits for parallel
+    // work it launched. That's only overhead if nothing else in the
+    // pipeline is running.
+    int active = 0;
+    for (int i = 0; i < n; i++) {
+        if (pipelines[i] && funcs[i] == 0) {
+            for (int j = 0; j < n; j++) {
+                if (pipelines[j] == pipelines[i] && funcs[j] != 0) {
+                    pipelines[i] = NULL;
+                    break;
+                }
+            }
+        }
+        if (pipelines[i]) {
+            active++;
+        }
+    }
+
+    for (int i = 0; i < n; i++) {
+        halide_profiler_pipeline_stats *p = pipelines[i];
+        if (!p) continue;
+        halide_profiler_func_stats *f = p->funcs + funcs[i];
+        uint64_t share = time / active;
+        f->time += share;
+        f->thread_time += time;
+        f->thread_times[threads[i]] += time;
+        p->time += share;
+
+        // Count the threads in the same func and pipeline, the first
+        // time we see each.
+        bool first_in_func = true, first_in_pipeline = true;
+        for (int j = 0; j < i; j++) {
+            if (pipelines[j] == p) {
+                first_in_pipeline = false;
+                first_in_func &= (funcs[j] != funcs[i]);
+            }
+        }
+        if (first_in_func) {
+            int func_threads = 0;
+            for (int j = i; j < n; j++) {
+                func_threads += (pipelines[j] == p && funcs[j] == funcs[i]);
+            }
+            f->active_threads_numerator += func_threads;
             f->active_threads_denominator += 1;
-            p->time += time;
+        }
+        if (first_in_pipeline) {
+            int pipeline_threads = 0;
+            for (int j = i; j < n; j++) {
+                pipeline_threads += (pipelines[j] == p);
+            }
             p->samples++;
-            p->active_threads_numerator += active_threads;
+            p->active_threads_numerator += pipeline_threads;
             p->active_threads_denominator += 1;
-            return;
+            if (pipeline_threads > p->peak_threads) {
+                p->peak_threads = pipeline_threads;
+            }
         }
-        p_prev = p;
     }
-    // Someone must have called reset_state while a kernel was running. Do nothing.
+}
+
+WEAK void reset_thread_slots(halide_profiler_state *s) {
+    for (int i = 0; i < halide_profiler_max_threads; i++) {
+        s->thread_funcs[i] = halide_profiler_outside_of_halide;
+    }
+    for (int i = 0; i < halide_profiler_max_threads / 32; i++) {
+        s->thread_slots_in_use[i] = 0;
+    }
 }
 
 WEAK void sampling_profiler_thread(void *) {
@@ -103,22 +229,51 @@ WEAK void sampling_profiler_thread(void *) {
         uint64_t t1 = halide_current_time_ns(NULL);
         uint64_t t = t1;
         while (1) {
-            int func, active_threads;
+            uint64_t t_now = halide_current_time_ns(NULL);
             if (s->get_remote_profiler_state) {
                 // Execution has disappeared into remote code running
                 // on an accelerator (e.g. Hexagon DSP)
+                int func, active_threads;
                 s->get_remote_profiler_state(&func, &active_threads);
+                if (func == halide_profiler_please_stop) {
+                    break;
+                } else if (func >= 0) {
+                    // Assume all time since I was last awake is due to
+                    // the currently running func.
+                    bill_func(s, func, t_now - t, active_threads);
+                }
             } else {
-                func = s->current_func;
-                active_threads = s->active_threads;
-            }
-            uint64_t t_now = halide_current_time_ns(NULL);
-            if (func == halide_profiler_please_stop) {
-                break;
-            } else if (func >= 0) {
-                // Assume all time since I was last awake is due to
-                // the currently running func.
-                bill_func(s, func, t_now - t, active_threads);
+                int func = s->current_func;
+                if (func == halide_profiler_please_stop) {
+                    break;
+                }
+                // Gather the func running on the calling thread and
+                // on each thread slot. Assume all time since I was
+                // last awake is due to them.
+                int funcs[halide_profiler_max_threads + 1];
+                int threads[halide_profiler_max_threads + 1];
+                int n = 0;
+                if (func >= 0) {
+                    funcs[n] = func;
+                    threads[n] = 0;
+                    n++;
+                }
+                for (int w = 0; w < halide_profiler_max_threads / 32; w++) {
+                    uint32_t in_use = ((volatile uint32_t *)s->thread_slots_in_use)[w];
+                    while (in_use) {
+                        int i = w * 32 + __builtin_ctz(in_use);
+                        in_use &= in_use - 1;
+                        int f = ((volatile int *)s->thread_funcs)[i];
+                        if (f >= 0) {
+                            funcs[n] = f;
+                            threads[n] = i + 1;
+                            n++;
+                        }
+                    }
+                }
+                if (n > 0) {
+                    bill_threads(s, funcs, threads, n, t_now - t);
+                }
             }
             t = t_now;
 
@@ -133,6 +288,122 @@ WEAK void sampling_profiler_thread(void *) {
     halide_mutex_unlock(&s->lock);
 }
 
+// Print a line of a report, or append it to a file if one is given.
+WEAK void print_report_line(void *user_context, void *f, const char *str, uint64_t size) {
+    if (f) {
+        fwrite(str, size, 1, f);
+    } else {
+        halide_print(user_context, str);
+    }
+}
+
+// Open a file to append a report to, noting whether it's a new one.
+WEAK void *open_report_file(void *user_context, const char *path, bool *is_new) {
+    void *existing = fopen(path, "r");
+    if (existing) {
+        fclose(existing);
+    }
+    *is_new = !existing;
+    void *f = fopen(path, "a");
+    if (!f) {
+        error(user_context) << "Could not open " << path << " to write profiler statistics\n";
+    }
+    return f;
+}
+
+// Get the hardware counters of a pipeline, or zeros if a run of it is
+// still counting them.
+WEAK void get_hw_counters(halide_profiler_pipeline_stats *p, uint64_t *counts) {
+    bool complete = !p->hw_runs_active;
+    counts[0] = complete ? p->cycles : 0;
+    counts[1] = complete ? p->instructions : 0;
+    counts[2] = complete ? p->llc_misses : 0;
+    counts[3] = complete ? p->branch_misses : 0;
+}
+
+WEAK void write_report_json(void *user_context, halide_profiler_state *s, void *f) {
+    char line_buf[1024];
+    Printer<StringStreamPrinter, sizeof(line_buf)> sstr(user_context, line_buf);
+
+    for (halide_profiler_pipeline_stats *p = s->pipelines; p;
+         p = (halide_profiler_pipeline_stats *)(p->next)) {
+        if (!p->runs) continue;
+        float threads = p->active_threads_numerator / (p->active_threads_denominator + 1e-10);
+        uint64_t hw[4];
+        get_hw_counters(p, hw);
+        sstr.clear();
+        sstr << "{\"pipeline\": \"" << p->name << "\""
+             << ", \"runs\": " << p->runs
+             << ", \"time_ns\": " << p->time
+             << ", \"samples\": " << p->samples
+             << ", \"average_threads\": " << threads
+             << ", \"peak_threads\": " << p->peak_threads
+             << ", \"memory_peak\": " << p->memory_peak
+             << ", \"memory_total\": " << p->memory_total
+             << ", \"memory_unplanned_peak\": " << p->memory_unplanned_peak
+             << ", \"num_allocs\": " << p->num_allocs
+             << ", \"cycles\": " << hw[0]
+             << ", \"instructions\": " << hw[1]
+             << ", \"llc_misses\": " << hw[2]
+             << ", \"branch_misses\": " << hw[3]
+             << ", \"funcs\": [";
+        fwrite(sstr.str(), sstr.size(), 1, f);
+        for (int i = 0; i < p->num_funcs; i++) {
+            halide_profiler_func_stats *fs = p->funcs + i;
+            float threads = fs->active_threads_numerator / (fs->active_threads_denominator + 1e-10);
+            sstr.clear();
+            sstr << (i ? ", " : "")
+                 << "{\"name\": \"" << fs->name << "\""
+                 << ", \"time_ns\": " << fs->time
+                 << ", \"thread_time_ns\": " << fs->thread_time
+                 << ", \"average_threads\": " << threads
+                 << ", \"memory_peak\": " << fs->memory_peak
+                 << ", \"memory_total\": " << fs->memory_total
+                 << ", \"num_allocs\": " << fs->num_allocs
+                 << ", \"stack_peak\": " << fs->stack_peak
+                 << "}";
+            fwrite(sstr.str(), sstr.size(), 1, f);
+        }
+        sstr.clear();
+        sstr << "]}\n";
+        fwrite(sstr.str(), sstr.size(), 1, f);
+    }
+}
+
+WEAK void write_report_csv(void *user_context, halide_profiler_state *s, void *f, bool header) {
+    char line_buf[1024];
+    Printer<StringStreamPrinter, sizeof(line_buf)> sstr(user_context, line_buf);
+
+    if (header) {
+        sstr << "pipeline,func,runs,time_ns,thread_time_ns,average_threads,"
+             << "memory_peak,memory_total,num_allocs,stack_peak,"
+             << "pipeline_cycles,pipeline_instructions,pipeline_ipc,"
+             << "pipeline_llc_misses,pipeline_branch_misses\n";
+        fwrite(sstr.str(), sstr.size(), 1, f);
+    }
+    for (halide_profiler_pipeline_stats *p = s->pipelines; p;
+         p = (halide_profiler_pipeline_stats *)(p->next)) {
+        if (!p->runs) continue;
+        // The hardware counters are only counted per pipeline, so
+        // each row of a pipeline repeats them, as it does the runs.
+        uint64_t hw[4];
+        get_hw_counters(p, hw);
+        double ipc = hw[0] ? hw[1] / (double)hw[0] : 0;
+        for (int i = 0; i < p->num_funcs; i++) {
+            halide_profiler_func_stats *fs = p->funcs + i;
+            float threads = fs->active_threads_numerator / (fs->active_threads_denominator + 1e-10);
+            sstr.clear();
+            sstr << p->name << "," << fs->name << "," << p->runs << ","
+                 << fs->time << "," << fs->thread_time << "," << threads << ","
+                 << fs->memory_peak << "," << fs->memory_total << ","
+                 << fs->num_allocs << "," << fs->stack_peak << ","
+                 << hw[0] << "," << hw[1] << "," << ipc << ","
+                 << hw[2] << "," << hw[3] << "\n";
+            fwrite(sstr.str(), sstr.size(), 1, f);
+        }
+    }
+}
+
 }}}
 
 namespace {
@@ -178,8 +449,13 @@ WEAK int halide_profiler_pipeline_start(void *user_context,
 
     ScopedMutexLock lock(&s->lock);
 
+    // Matched by halide_profiler_pipeline_end, which runs even if
+    // this fails.
+    __sync_add_and_fetch(&s->running_pipelines, 1);
+
     if (!s->sampling_thread) {
         halide_start_clock(user_context);
+        reset_thread_slots(s);
         s->sampling_thread = halide_spawn_thread(sampling_profiler_thread, NULL);
     }
 
@@ -242,6 +518,8 @@ WEAK void halide_profiler_memory_allocate(void *user_context,
     __sync_add_and_fetch(&p_stats->memory_total, incr);
     uint64_t p_mem_current = __sync_add_and_fetch(&p_stats->memory_current, incr);
     sync_compare_max_and_swap(&p_stats->memory_peak, p_mem_current);
+    uint64_t p_unplanned_current = __sync_add_and_fetch(&p_stats->memory_unplanned_current, incr);
+    sync_compare_max_and_swap(&p_stats->memory_unplanned_peak, p_unplanned_current);
 
     // Update per-func memory stats
     __sync_add_and_fetch(&f_stats->num_allocs, 1);
@@ -275,12 +553,28 @@ WEAK void halide_profiler_memory_free(void *user_context,
 
     // Update per-pipeline memory stats
     __sync_sub_and_fetch(&p_stats->memory_current, decr);
+    __sync_sub_and_fetch(&p_stats->memory_unplanned_current, decr);
 
     // Update per-func memory stats
     __sync_sub_and_fetch(&f_stats->memory_current, decr);
 }
 
-WEAK void halide_profiler_report_unlocked(void *user_context, halide_profiler_state *s) {
+// Called around an arena made by plan_memory with the difference
+// between the sizes of the allocations packed into it and the size
+// of the arena, positive when the arena is allocated and negative when
+// it is freed.
+WEAK void halide_profiler_memory_unplanned(void *user_context,
+                                           void *pipeline_state,
+                                           int64_t delta) {
+    halide_profiler_pipeline_stats *p_stats = (halide_profiler_pipeline_stats *) pipeline_state;
+    halide_assert(user_context, p_stats != NULL);
+
+    uint64_t current = __sync_add_and_fetch(&p_stats->memory_unplanned_current, (uint64_t)delta);
+    sync_compare_max_and_swap(&p_stats->memory_unplanned_peak, current);
+}
+
+// Print the report, or append it to a file if one is given.
+WEAK void halide_profiler_print_report(void *user_context, halide_profiler_state *s, void *f) {
 
     char line_buf[1024];
     Printer<StringStreamPrinter, sizeof(line_buf)> sstr(user_context, line_buf);
@@ -302,11 +596,26 @@ WEAK void halide_profiler_report_unlocked(void *user_context, halide_profiler_st
              << "  runs: " << p->runs
              << "  time/run: " << t / p->runs << " ms\n";
         if (!serial) {
-            sstr << " average threads used: " << threads << "\n";
+            sstr << " average threads used: " << threads
+                 << "  peak threads: " << p->peak_threads << "\n";
         }
         sstr << " heap allocations: " << p->num_allocs
-             << "  peak heap usage: " << p->memory_peak << " bytes\n";
-        halide_print(user_context, sstr.str());
+             << "  peak heap usage: " << p->memory_peak << " bytes";
+        if (p->memory_unplanned_peak != p->memory_peak) {
+            sstr << "  (" << p->memory_unplanned_peak << " bytes without memory planning)";
+        }
+        sstr << "\n";
+        uint64_t hw[4];
+        get_hw_counters(p, hw);
+        if (hw[0]) {
+            float ipc = hw[1] / (float)hw[0];
+            sstr << " hardware counters (per run): cycles: " << hw[0] / p->runs
+                 << "  IPC: " << ipc;
+            sstr.erase(4);
+            sstr << "  LLC misses: " << hw[2] / p->runs
+                 << "  branch misses: " << hw[3] / p->runs << "\n";
+        }
+        print_report_line(user_context, f, sstr.str(), sstr.size());
 
         bool print_f_states = p->time || p->memory_total;
         if (!print_f_states) {
@@ -374,20 +683,94 @@ WEAK void halide_profiler_report_unlocked(void *user_context, halide_profiler_st
                 if (fs->stack_peak > 0) {
                     sstr << " stack: " << fs->stack_peak;
                 }
+                if (!serial && fs->active_threads_denominator && p->peak_threads > 0) {
+                    // The fraction of the most threads the pipeline was
+                    // seen to use that this func kept busy.
+                    float threads = fs->active_threads_numerator / (float)fs->active_threads_denominator;
+                    int efficiency = (int)(100 * threads / p->peak_threads + 0.5f);
+                    sstr << " efficiency: " << efficiency << "%";
+                }
                 sstr << "\n";
 
-                halide_print(user_context, sstr.str());
+                print_report_line(user_context, f, sstr.str(), sstr.size());
             }
         }
     }
 }
 
+WEAK int halide_profiler_write_report_unlocked(void *user_context, halide_profiler_state *s,
+                                               const char *filename,
+                                               halide_profiler_report_format_t format) {
+    bool is_new = false;
+    void *f = open_report_file(user_context, filename, &is_new);
+    if (!f) {
+        return halide_error_code_generic_error;
+    }
+    if (format == halide_profiler_report_json) {
+        write_report_json(user_context, s, f);
+    } else if (format == halide_profiler_report_csv) {
+        write_report_csv(user_context, s, f, is_new);
+    } else {
+        halide_profiler_print_report(user_context, s, f);
+    }
+    fclose(f);
+    return halide_error_code_success;
+}
+
+WEAK void halide_profiler_report_unlocked(void *user_context, halide_profiler_state *s) {
+    halide_profiler_print_report(user_context, s, NULL);
+
+    // HL_PROFILER_HW_FILE predates HL_PROFILER_REPORT_FILE, and names
+    // a file for the same CSV, which has the hardware counters.
+    const char *hw_path = getenv("HL_PROFILER_HW_FILE");
+    if (hw_path && hw_path[0]) {
+        halide_profiler_write_report_unlocked(user_context, s, hw_path, halide_profiler_report_csv);
+    }
+
+    const char *path = getenv("HL_PROFILER_REPORT_FILE");
+    if (path && path[0]) {
+        const char *ext = path;
+        while (*ext) ext++;
+        bool csv = (ext - path >= 4) && !strncmp(ext - 4, ".csv", 4);
+        halide_profiler_write_report_unlocked(user_context, s, path,
+                                              csv ? halide_profiler_report_csv : halide_profiler_report_json);
+    }
+}
+
 WEAK void halide_profiler_report(void *user_context) {
     halide_profiler_state *s = halide_profiler_get_state();
     ScopedMutexLock lock(&s->lock);
     halide_profiler_report_unlocked(user_context, s);
 }
 
+WEAK int halide_profiler_write_report(void *user_context, const char *filename,
+                                      halide_profiler_report_format_t format) {
+    halide_profiler_state *s = halide_profiler_get_state();
+    ScopedMutexLock lock(&s->lock);
+    return halide_profiler_write_report_unlocked(user_context, s, filename, format);
+}
+
+WEAK int halide_profiler_visit_pipelines(void *user_context,
+                                         halide_profiler_pipeline_visitor_t visitor) {
+    halide_profiler_state *s = halide_profiler_get_state();
+    ScopedMutexLock lock(&s->lock);
+    for (halide_profiler_pipeline_stats *p = s->pipelines; p;
+         p = (halide_profiler_pipeline_stats *)(p->next)) {
+        if (!p->runs) continue;
+        int result = visitor(user_context, p);
+        if (result != 0) {
+            return result;
+        }
+    }
+    return 0;
+}
+
+WEAK halide_profiler_pipeline_visitor_t halide_set_profiler_call_handler(halide_profiler_pipeline_visitor_t handler) {
+    halide_profiler_pipeline_visitor_t result = profiler_call_handler;
+    profiler_call_handler = handler;
+    return result;
+}
+
 
 WEAK void halide_profiler_reset_unlocked(halide_profiler_state *s) {
     while (s->pipelines) {
@@ -452,8 +835,32 @@ WEAK void halide_windows_profiler_shutdown() {
 #endif
 }
 
+// Registered as a destructor by each pipeline, with its stats. In
+// per-call mode, hands the stats of the call to the handler and then
+// resets them.
+WEAK void halide_profiler_pipeline_call_end(void *user_context, void *pipeline_state) {
+    halide_profiler_pipeline_visitor_t handler = profiler_call_handler;
+    if (!handler) {
+        return;
+    }
+    halide_profiler_state *s = halide_profiler_get_state();
+    // Stop billing this thread's samples to the pipeline before
+    // taking the snapshot.
+    s->current_func = halide_profiler_outside_of_halide;
+    halide_profiler_pipeline_stats *p = (halide_profiler_pipeline_stats *)pipeline_state;
+    ScopedMutexLock lock(&s->lock);
+    handler(user_context, p);
+    reset_pipeline_stats(p);
+}
+
 WEAK void halide_profiler_pipeline_end(void *user_context, void *state) {
-    ((halide_profiler_state *)state)->current_func = halide_profiler_outside_of_halide;
+    halide_profiler_state *s = (halide_profiler_state *)state;
+    s->current_func = halide_profiler_outside_of_halide;
+    if (__sync_sub_and_fetch(&s->running_pipelines, 1) == 0) {
+        // A parallel task that fails doesn't release its thread
+        // slot. Once no pipelines are running, no slot should be held.
+        reset_thread_slots(s);
+    }
 }
 
 } // extern "C"
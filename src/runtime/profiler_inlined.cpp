@@ -1,5 +1,13 @@
 #include "HalideRuntime.h"
 
+namespace Halide { namespace Runtime { namespace Internal {
+
+// The thread slot handed out when all the real ones are taken. It's
+// written to, but never sampled.
+WEAK int unsampled_thread_func = halide_profiler_outside_of_halide;
+
+}}}
+
 extern "C" {
 
 WEAK __attribute__((always_inline)) int halide_profiler_set_current_func(halide_profiler_state *state, int tok, int t) {
@@ -12,6 +20,53 @@ WEAK __attribute__((always_inline)) int halide_profiler_set_current_func(halide_
     return 0;
 }
 
+WEAK __attribute__((always_inline)) int halide_profiler_set_thread_func(int *slot, int tok, int t) {
+    // As above, but for the thread slot of a parallel task.
+    volatile int *ptr = slot;
+    asm volatile ("":::);
+    *ptr = tok + t;
+    asm volatile ("":::);
+    return 0;
+}
+
+// Claim a thread slot for a parallel task, and mark it as computing
+// the given Func. Returns the slot to pass to
+// halide_profiler_set_thread_func, and then to
+// halide_profiler_release_thread_slot at the end of the task.
+WEAK __attribute__((always_inline)) int *halide_profiler_acquire_thread_slot(halide_profiler_state *state, int tok, int t) {
+    for (int w = 0; w < halide_profiler_max_threads / 32; w++) {
+        volatile uint32_t *mask = &(state->thread_slots_in_use[w]);
+        uint32_t in_use = *mask;
+        while (in_use != 0xffffffff) {
+            int i = __builtin_ctz(~in_use);
+            uint32_t old = __sync_val_compare_and_swap(mask, in_use, in_use | (1U << i));
+            if (old == in_use) {
+                volatile int *ptr = &(state->thread_funcs[w * 32 + i]);
+                *ptr = tok + t;
+                asm volatile ("":::);
+                return (int *)ptr;
+            }
+            in_use = old;
+        }
+    }
+    // All the slots are taken. This task won't be sampled.
+    return &Halide::Runtime::Internal::unsampled_thread_func;
+}
+
+WEAK __attribute__((always_inline)) int halide_profiler_release_thread_slot(halide_profiler_state *state, int *slot) {
+    int i = slot - state->thread_funcs;
+    if (i < 0 || i >= halide_profiler_max_threads) {
+        // The task wasn't given a real slot.
+        return 0;
+    }
+    volatile int *ptr = slot;
+    asm volatile ("":::);
+    *ptr = halide_profiler_outside_of_halide;
+    __sync_fetch_and_and(&(state->thread_slots_in_use[i / 32]), ~(1U << (i % 32)));
+    asm volatile ("":::);
+    return 0;
+}
+
 WEAK __attribute__((always_inline)) int halide_profiler_incr_active_threads(halide_profiler_state *state) {
     volatile int *ptr = &(state->active_threads);
     asm volatile ("":::);
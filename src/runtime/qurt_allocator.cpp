@@ -119,4 +119,17 @@ WEAK void halide_free(void *user_context, void *ptr) {
     halide_default_free(user_context, ptr);
 }
 
+// The small buffer pool above plays the role of the host allocation
+// cache on Hexagon, so these just report that it is not in use.
+WEAK int halide_reuse_host_allocations(void *user_context, bool flag) {
+    return 0;
+}
+
+WEAK bool halide_can_reuse_host_allocations(void *user_context) {
+    return false;
+}
+
+WEAK void halide_host_allocation_cache_set_size(int64_t size) {
+}
+
 }
@@ -21,6 +21,10 @@ void spawn_thread_helper(void *arg) {
     spawned_thread *t = (spawned_thread *)arg;
     t->f(t->closure);
 }
+
+// Extra stack space to give spawned threads, on top of
+// STACK_SIZE. See halide_reserve_thread_stack.
+int thread_stack_reserve = 0;
 }
 
 extern "C" {
@@ -54,12 +58,13 @@ WEAK struct halide_thread *halide_spawn_thread(void (*f)(void *), void *closure)
     spawned_thread *t = (spawned_thread *)malloc(sizeof(spawned_thread));
     t->f = f;
     t->closure = closure;
-    t->stack = memalign(128, STACK_SIZE);
+    size_t stack_size = STACK_SIZE + thread_stack_reserve;
+    t->stack = memalign(128, stack_size);
     memset(&t->handle, 0, sizeof(t->handle));
     qurt_thread_attr_t thread_attr;
     qurt_thread_attr_init(&thread_attr);
     qurt_thread_attr_set_stack_addr(&thread_attr, t->stack);
-    qurt_thread_attr_set_stack_size(&thread_attr, STACK_SIZE);
+    qurt_thread_attr_set_stack_size(&thread_attr, stack_size);
     qurt_thread_attr_set_priority(&thread_attr, priority);
     qurt_thread_create(&t->handle.val, &thread_attr, &spawn_thread_helper, t);
     return (halide_thread *)t;
@@ -19,6 +19,7 @@
 extern "C" __attribute__((used)) void *halide_runtime_api_functions[] = {
     (void *)&halide_buffer_copy,
     (void *)&halide_buffer_to_string,
+    (void *)&halide_can_reuse_host_allocations,
     (void *)&halide_can_use_target_features,
     (void *)&halide_cond_broadcast,
     (void *)&halide_cond_signal,
@@ -106,14 +107,17 @@ extern "C" __attribute__((used)) void *halide_runtime_api_functions[] = {
     (void *)&halide_hexagon_set_performance_mode,
     (void *)&halide_hexagon_set_thread_priority,
     (void *)&halide_hexagon_wrap_device_handle,
+    (void *)&halide_host_allocation_cache_set_size,
     (void *)&halide_int64_to_string,
     (void *)&halide_join_thread,
     (void *)&halide_load_library,
     (void *)&halide_malloc,
     (void *)&halide_matlab_call_pipeline,
     (void *)&halide_memoization_cache_cleanup,
+    (void *)&halide_memoization_cache_get_stats,
     (void *)&halide_memoization_cache_lookup,
     (void *)&halide_memoization_cache_release,
+    (void *)&halide_memoization_cache_set_eviction_policy,
     (void *)&halide_memoization_cache_set_size,
     (void *)&halide_memoization_cache_store,
     (void *)&halide_metal_acquire_context,
@@ -160,14 +164,19 @@ extern "C" __attribute__((used)) void *halide_runtime_api_functions[] = {
     (void *)&halide_profiler_get_state,
     (void *)&halide_profiler_memory_allocate,
     (void *)&halide_profiler_memory_free,
+    (void *)&halide_profiler_memory_unplanned,
     (void *)&halide_profiler_pipeline_start,
     (void *)&halide_profiler_report,
     (void *)&halide_profiler_reset,
     (void *)&halide_profiler_stack_peak_update,
+    (void *)&halide_profiler_visit_pipelines,
+    (void *)&halide_profiler_write_report,
     (void *)&halide_qurt_hvx_lock,
     (void *)&halide_qurt_hvx_unlock,
     (void *)&halide_qurt_hvx_unlock_as_destructor,
     (void *)&halide_release_jit_module,
+    (void *)&halide_reserve_thread_stack,
+    (void *)&halide_reuse_host_allocations,
     (void *)&halide_semaphore_init,
     (void *)&halide_semaphore_release,
     (void *)&halide_semaphore_try_acquire,
@@ -185,6 +194,7 @@ extern "C" __attribute__((used)) void *halide_runtime_api_functions[] = {
     (void *)&halide_set_error_handler,
     (void *)&halide_set_gpu_device,
     (void *)&halide_set_num_threads,
+    (void *)&halide_set_profiler_call_handler,
     (void *)&halide_set_trace_file,
     (void *)&halide_shutdown_thread_pool,
     (void *)&halide_shutdown_trace,
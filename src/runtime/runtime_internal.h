@@ -77,6 +77,7 @@ void *fopen(const char *, const char *);
 int fileno(void *);
 int fclose(void *);
 int close(int);
+size_t fread(void *, size_t, size_t, void *);
 size_t fwrite(const void *, size_t, size_t, void *);
 ssize_t write(int fd, const void *buf, size_t bytes);
 int remove(const char *pathname);
@@ -128,11 +129,25 @@ WEAK void halide_profiler_memory_free(void *user_context,
                                       void *pipeline_state,
                                       int func_id,
                                       uint64_t decr);
+WEAK void halide_profiler_memory_unplanned(void *user_context,
+                                           void *pipeline_state,
+                                           int64_t delta);
 WEAK int halide_profiler_pipeline_start(void *user_context,
                                         const char *pipeline_name,
                                         int num_funcs,
                                         const uint64_t *func_names);
 WEAK int halide_host_cpu_count();
+// Whether halide_spawn_thread works. Provided by the thread pool; the
+// fake one runs everything on the calling thread and can't spawn any.
+WEAK bool halide_can_spawn_threads();
+
+// NUMA placement used by the thread pool and host allocator. Provided
+// by linux_numa.cpp, or by fake_numa.cpp as a single node elsewhere.
+WEAK int halide_numa_init(void *user_context);
+WEAK int halide_numa_current_node();
+WEAK void halide_numa_bind_current_thread(int node);
+WEAK void halide_numa_unbind_all_threads();
+WEAK void halide_numa_place_allocation(void *ptr, size_t size);
 
 WEAK int halide_device_and_host_malloc(void *user_context, struct halide_buffer_t *buf,
                                        const struct halide_device_interface_t *device_interface);
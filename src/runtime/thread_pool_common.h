@@ -21,6 +21,20 @@ int gettid() {
 
 namespace Halide { namespace Runtime { namespace Internal {
 
+// The size of a cache line, assumed to be 64 bytes everywhere.
+#define WORK_RANGE_ALIGNMENT 64
+
+// One worker's share of a work-stealing job, see pack_range. Each
+// range gets a cache line of its own, so that the owner and stealers
+// of one range don't contend with those of its neighbours.
+struct work_range {
+    uint64_t bounds;
+    // The NUMA node whose workers should run this range.
+    int node;
+    // Whether a worker has taken this range as its own.
+    bool joined;
+} __attribute__((aligned(WORK_RANGE_ALIGNMENT)));
+
 struct work {
     halide_parallel_task_t task;
 
@@ -41,6 +55,14 @@ struct work {
     // which condition variable is the owner sleeping on. NULL if it isn't sleeping.
     bool owner_is_sleeping;
 
+    // Per-worker iteration ranges when the job runs in work-stealing
+    // mode (HL_THREAD_POOL=steal or numa). NULL for jobs that claim
+    // iterations one at a time under the work queue lock.
+    work_range *ranges;
+    int num_ranges;
+    // The number of ranges handed to joining workers so far.
+    int ranges_joined;
+
     bool make_runnable() {
         for (; next_semaphore < task.num_semaphores; next_semaphore++) {
             if (!halide_default_semaphore_try_acquire(task.semaphores[next_semaphore].semaphore,
@@ -88,6 +110,28 @@ WEAK int default_desired_num_threads() {
     return desired_num_threads;
 }
 
+// Thread pool modes, selected with HL_THREAD_POOL.
+enum thread_pool_mode {
+    // All jobs are claimed under the work queue lock.
+    thread_pool_locked,
+    // par_for iterations are split into per-worker ranges and stolen
+    // without the lock ("steal").
+    thread_pool_steal,
+    // As thread_pool_steal, with workers pinned to NUMA nodes and
+    // ranges handed out node-locally ("numa").
+    thread_pool_numa
+};
+
+WEAK thread_pool_mode default_thread_pool_mode() {
+    char *mode_str = getenv("HL_THREAD_POOL");
+    if (mode_str && strcmp(mode_str, "steal") == 0) {
+        return thread_pool_steal;
+    } else if (mode_str && strcmp(mode_str, "numa") == 0) {
+        return thread_pool_numa;
+    }
+    return thread_pool_locked;
+}
+
 // The work queue and thread pool is weak, so one big work queue is shared by all halide functions
 struct work_queue_t {
     // all fields are protected by this mutex.
@@ -100,6 +144,15 @@ struct work_queue_t {
     // Field serves both to mark the offset in struct and as layout padding.
     int zero_marker;
 
+    // Whether do_par_for jobs are split into per-worker ranges that
+    // are claimed and stolen without taking the lock. Read when the
+    // queue is initialized.
+    bool work_stealing;
+
+    // The number of NUMA nodes workers are spread across. One unless
+    // HL_THREAD_POOL=numa found several nodes.
+    int num_nodes;
+
     // Singly linked list for job stack
     work *jobs;
 
@@ -190,6 +243,115 @@ WEAK void dump_job_state() {
 #define dump_job_state()
 #endif
 
+// Work-stealing ranges. Each worker that joins a stealing job owns
+// one range and pops iterations from its front. A worker whose range
+// is empty steals the back half of another range. Both operations are
+// a single CAS on the packed range, so the work queue lock is only
+// taken when a worker joins or leaves the job.
+WEAK uint64_t pack_range(uint32_t begin, uint32_t end) {
+    return ((uint64_t)end << 32) | begin;
+}
+
+WEAK uint32_t range_begin(uint64_t r) {
+    return (uint32_t)r;
+}
+
+WEAK uint32_t range_end(uint64_t r) {
+    return (uint32_t)(r >> 32);
+}
+
+// Claim the first iteration of a range. Returns false if it is empty.
+WEAK bool pop_range(uint64_t *range, uint32_t *idx) {
+    uint64_t expected, desired;
+    Synchronization::atomic_load_acquire(range, &expected);
+    do {
+        uint32_t begin = range_begin(expected), end = range_end(expected);
+        if (begin >= end) {
+            return false;
+        }
+        *idx = begin;
+        desired = pack_range(begin + 1, end);
+    } while (!Synchronization::atomic_cas_weak_relacq_relaxed(range, &expected, &desired));
+    return true;
+}
+
+// Claim the back half of a victim's range. The first stolen iteration
+// is returned in idx and the rest is published in the thief's own
+// range, which must be empty.
+WEAK bool steal_range(uint64_t *victim, uint64_t *own, uint32_t *idx) {
+    uint64_t expected, desired;
+    uint32_t mid, end;
+    Synchronization::atomic_load_acquire(victim, &expected);
+    do {
+        uint32_t begin = range_begin(expected);
+        end = range_end(expected);
+        if (begin >= end) {
+            return false;
+        }
+        mid = begin + (end - begin) / 2;
+        desired = pack_range(begin, mid);
+    } while (!Synchronization::atomic_cas_weak_relacq_relaxed(victim, &expected, &desired));
+    *idx = mid;
+    uint64_t rest = pack_range(mid + 1, end);
+    Synchronization::atomic_store_release(own, &rest);
+    return true;
+}
+
+// Take an unowned range of a stealing job for the calling thread,
+// preferring one on the thread's NUMA node.
+WEAK int claim_range_already_locked(work *job) {
+    int node = work_queue.num_nodes > 1 ? halide_numa_current_node() : 0;
+    int slot = -1;
+    for (int i = 0; i < job->num_ranges; i++) {
+        if (!job->ranges[i].joined) {
+            if (job->ranges[i].node == node) {
+                slot = i;
+                break;
+            } else if (slot < 0) {
+                slot = i;
+            }
+        }
+    }
+    job->ranges[slot].joined = true;
+    job->ranges_joined++;
+    return slot;
+}
+
+// Run iterations of a stealing job until every range is empty or the
+// job has failed. Called without the work queue lock held.
+WEAK int do_stealing_work(work *job, int slot) {
+    work_range *own = job->ranges + slot;
+    int result = 0;
+    while (result == 0) {
+        int exit_status;
+        Synchronization::atomic_load_relaxed(&job->exit_status, &exit_status);
+        if (exit_status != 0) {
+            break;
+        }
+        uint32_t idx;
+        bool found = pop_range(&own->bounds, &idx);
+        // Steal from ranges on our own node first, so that data
+        // stays node-local for as long as possible.
+        for (int pass = 0; !found && pass < 2; pass++) {
+            for (int i = 1; !found && i < job->num_ranges; i++) {
+                work_range *victim = job->ranges + (slot + i) % job->num_ranges;
+                if ((victim->node == own->node) == (pass == 0)) {
+                    found = steal_range(&victim->bounds, &own->bounds, &idx);
+                }
+            }
+        }
+        if (!found) {
+            // Any range we saw as empty can only be refilled by the
+            // active worker that owns it, so nothing is left
+            // unclaimed.
+            break;
+        }
+        result = halide_do_task(job->user_context, job->task_fn,
+                                job->task.min + (int)idx, job->task.closure);
+    }
+    return result;
+}
+
 WEAK void worker_thread(void *);
 
 WEAK void worker_thread_already_locked(work *owned_job) {
@@ -308,7 +470,34 @@ WEAK void worker_thread_already_locked(work *owned_job) {
 
         int result = 0;
 
-        if (job->task.serial) {
+        if (job->ranges) {
+            // Take the next unowned range. Once every range has an
+            // owner, new workers can only help by stealing, so
+            // remove the job from the stack.
+            int slot = claim_range_already_locked(job);
+            if (job->ranges_joined == job->num_ranges) {
+                *prev_ptr = job->next_job;
+            }
+
+            // Release the lock and do the task.
+            halide_mutex_unlock(&work_queue.mutex);
+            result = do_stealing_work(job, slot);
+            halide_mutex_lock(&work_queue.mutex);
+
+            // All iterations have been claimed. The first worker to
+            // notice retires the job, removing it from the stack if
+            // it is still there.
+            if (job->task.extent != 0) {
+                if (job->ranges_joined < job->num_ranges) {
+                    work **ptr = &work_queue.jobs;
+                    while (*ptr != job) {
+                        ptr = &((*ptr)->next_job);
+                    }
+                    *ptr = job->next_job;
+                }
+                job->task.extent = 0;
+            }
+        } else if (job->task.serial) {
             // Remove it from the stack while we work on it
             *prev_ptr = job->next_job;
 
@@ -415,7 +604,14 @@ WEAK void worker_thread(void *arg) {
     halide_mutex_unlock(&work_queue.mutex);
 }
 
-WEAK void enqueue_work_already_locked(int num_jobs, work *jobs, work *task_parent) {
+// Entry point for workers in NUMA mode. The argument is the node to
+// pin the thread to.
+WEAK void numa_worker_thread(void *arg) {
+    halide_numa_bind_current_thread((int)(intptr_t)arg);
+    worker_thread(NULL);
+}
+
+WEAK void initialize_work_queue_already_locked() {
     if (!work_queue.initialized) {
         work_queue.assert_zeroed();
 
@@ -426,8 +622,15 @@ WEAK void enqueue_work_already_locked(int num_jobs, work *jobs, work *task_paren
             work_queue.desired_threads_working = default_desired_num_threads();
         }
         work_queue.desired_threads_working = clamp_num_threads(work_queue.desired_threads_working);
+        thread_pool_mode mode = default_thread_pool_mode();
+        work_queue.work_stealing = (mode != thread_pool_locked);
+        work_queue.num_nodes = (mode == thread_pool_numa) ? halide_numa_init(NULL) : 1;
         work_queue.initialized = true;
     }
+}
+
+WEAK void enqueue_work_already_locked(int num_jobs, work *jobs, work *task_parent) {
+    initialize_work_queue_already_locked();
 
     // Gather some information about the work.
 
@@ -485,8 +688,15 @@ WEAK void enqueue_work_already_locked(int num_jobs, work *jobs, work *task_paren
             // We might need to make some new threads, if work_queue.desired_threads_working has
             // increased, or if there aren't enough threads to complete this new task.
             work_queue.a_team_size++;
-            work_queue.threads[work_queue.threads_created++] =
-                halide_spawn_thread(worker_thread, NULL);
+            if (work_queue.num_nodes > 1) {
+                // Deal workers out round-robin across the nodes.
+                intptr_t node = work_queue.threads_created % work_queue.num_nodes;
+                work_queue.threads[work_queue.threads_created++] =
+                    halide_spawn_thread(numa_worker_thread, (void *)node);
+            } else {
+                work_queue.threads[work_queue.threads_created++] =
+                    halide_spawn_thread(worker_thread, NULL);
+            }
         }
         log_message("enqueue_work_already_locked top level job " << jobs[0].task.name << " with min_threads " << min_threads << " work_queue.threads_created " << work_queue.threads_created << " work_queue.threads_reserved " << work_queue.threads_reserved);
         if (job_has_acquires || job_may_block) {
@@ -600,7 +810,35 @@ WEAK int halide_default_do_par_for(void *user_context, halide_task_t f,
     job.siblings = &job; // guarantees no other job points to the same siblings.
     job.sibling_count = 0;
     job.parent_job = NULL;
+    job.ranges = NULL;
+    job.num_ranges = 0;
+    job.ranges_joined = 0;
     halide_mutex_lock(&work_queue.mutex);
+    initialize_work_queue_already_locked();
+    if (work_queue.work_stealing && size > 1) {
+        // Deal the iterations out evenly, one range per thread that
+        // might work on them.
+        int num_ranges = work_queue.desired_threads_working;
+        if (num_ranges > size) {
+            num_ranges = size;
+        }
+        // alloca doesn't respect the alignment of work_range, so
+        // over-allocate and align by hand.
+        uintptr_t ranges = (uintptr_t)__builtin_alloca(sizeof(work_range) * num_ranges + WORK_RANGE_ALIGNMENT - 1);
+        ranges = (ranges + WORK_RANGE_ALIGNMENT - 1) & ~(uintptr_t)(WORK_RANGE_ALIGNMENT - 1);
+        job.ranges = (work_range *)ranges;
+        job.num_ranges = num_ranges;
+        for (int i = 0; i < num_ranges; i++) {
+            job.ranges[i].bounds = pack_range((uint32_t)(((int64_t)size * i) / num_ranges),
+                                              (uint32_t)(((int64_t)size * (i + 1)) / num_ranges));
+            // Contiguous blocks of ranges go to each node, so the same
+            // part of the iteration space runs on the same node in
+            // every parallel loop of the same size. Buffers are then
+            // first touched by the node that later consumes them.
+            job.ranges[i].node = (i * work_queue.num_nodes) / num_ranges;
+            job.ranges[i].joined = false;
+        }
+    }
     enqueue_work_already_locked(1, &job, NULL);
     worker_thread_already_locked(&job);
     halide_mutex_unlock(&work_queue.mutex);
@@ -626,6 +864,9 @@ WEAK int halide_default_do_parallel_tasks(void *user_context, int num_tasks,
         jobs[i].next_semaphore = 0;
         jobs[i].owner_is_sleeping = false;
         jobs[i].parent_job = (work *)task_parent;
+        jobs[i].ranges = NULL;
+        jobs[i].num_ranges = 0;
+        jobs[i].ranges_joined = 0;
     }
 
     if (num_tasks == 0) {
@@ -664,6 +905,32 @@ WEAK int halide_set_num_threads(int n) {
     return old;
 }
 
+WEAK int halide_reserve_thread_stack(int bytes) {
+    // Threads are only spawned with the work queue lock held, so
+    // this can't race with a thread being created.
+    halide_mutex_lock(&work_queue.mutex);
+    int result = 0;
+    if (bytes > thread_stack_reserve) {
+        // Threads that already exist keep the stack they were spawned
+        // with. The default part of it is for their own frames, so
+        // only the extra they were given is available.
+        if (work_queue.threads_created > 0) {
+            error(NULL) << "halide_reserve_thread_stack: can't reserve " << bytes
+                        << " bytes of stack, as the thread pool has already spawned threads with "
+                        << thread_stack_reserve << " bytes to spare. Call halide_shutdown_thread_pool first.\n";
+            result = halide_error_code_generic_error;
+        } else {
+            thread_stack_reserve = bytes;
+        }
+    }
+    halide_mutex_unlock(&work_queue.mutex);
+    return result;
+}
+
+WEAK bool halide_can_spawn_threads() {
+    return true;
+}
+
 WEAK void halide_shutdown_thread_pool() {
     if (work_queue.initialized) {
         // Wake everyone up and tell them the party's over and it's time
@@ -680,6 +947,9 @@ WEAK void halide_shutdown_thread_pool() {
         for (int i = 0; i < work_queue.threads_created; i++) {
             halide_join_thread(work_queue.threads[i]);
         }
+        if (work_queue.num_nodes > 1) {
+            halide_numa_unbind_all_threads();
+        }
 
         // Tidy up
         work_queue.reset();
@@ -10,141 +10,534 @@ typedef int32_t (*trace_fn)(void *, const halide_trace_event_t *);
 
 namespace Halide { namespace Runtime { namespace Internal {
 
-// A spinlock that allows for shared and exclusive access. It's
-// equivalent to a reader-writer lock, but in my case the "readers"
-// will actually be writing simultaneously to the trace buffer, so
-// that's a bad name. We use the __sync primitives used elsewhere in
-// the runtime for atomic work. They are well supported by clang.
-class SharedExclusiveSpinLock {
-    volatile uint32_t lock;
-
-    // Covers a single bit indicating one owner has exclusive
-    // access. The waiting bit can be set while the exclusive bit is
-    // set, but the bits masked by shared_mask must be zero while this
-    // bit is set.
-    const static uint32_t exclusive_held_mask = 0x80000000;
-
-    // Set to indicate a thread needs to acquire exclusive
-    // access. Other fields of the lock may be set, but no shared
-    // access request will proceed while this bit is set.
-    const static uint32_t exclusive_waiting_mask = 0x40000000;
-
-    // Count of threads currently holding shared access. Must be zero
-    // if the exclusive bit is set. Cannot increase if the waiting bit
-    // is set.
-    const static uint32_t shared_mask = 0x3fffffff;
+// Packets are written to one of several lanes, chosen by the stack
+// address of the thread writing them, so that threads don't contend
+// with each other. Each lane is double-buffered: while a flusher
+// writes one half to the trace file, the thread carries on filling
+// the other.
+const static int trace_lanes = 64;
+const static uint32_t trace_half_size = 256 * 1024;
+
+// With HL_TRACE_COMPRESS=1, the packets are written in compressed
+// blocks of up to trace_half_size bytes, each indexed by the Funcs
+// in it. A block is cut short if it would index too many Funcs.
+const static uint32_t trace_block_max_funcs = 64;
+const static uint32_t trace_block_max_header_size =
+    sizeof(halide_trace_block_header_t) + trace_block_max_funcs * sizeof(halide_trace_block_func_t);
+// Enough for incompressible data in the LZ4 block format.
+const static uint32_t trace_block_max_size =
+    trace_block_max_header_size + trace_half_size + trace_half_size / 255 + 16;
+const static int trace_match_table_bits = 12;
+
+WEAK uint32_t trace_func_hash(const char *name) {
+    // FNV-1a
+    uint32_t h = 2166136261u;
+    while (*name) {
+        h = (h ^ (uint8_t)(*name++)) * 16777619u;
+    }
+    return h;
+}
 
-public:
-    __attribute__((always_inline)) void acquire_shared() {
-        while (1) {
-            uint32_t x = lock & shared_mask;
-            if (__sync_bool_compare_and_swap(&lock, x, x + 1)) {
-                return;
+WEAK uint8_t *lz4_put_length(uint8_t *dst, uint32_t len) {
+    while (len >= 255) {
+        *dst++ = 255;
+        len -= 255;
+    }
+    *dst++ = (uint8_t)len;
+    return dst;
+}
+
+// Compress size bytes of src in the LZ4 block format, with greedy
+// matching against a hash table of recent positions, which must have
+// 1 << trace_match_table_bits entries. Returns the compressed size.
+WEAK uint32_t lz4_compress(const uint8_t *src, uint32_t size, uint8_t *dst, uint32_t *table) {
+    memset(table, 0, sizeof(uint32_t) << trace_match_table_bits);
+    uint8_t *out = dst;
+    uint32_t anchor = 0, pos = 0;
+    // The format requires that the last match starts at least 12
+    // bytes, and ends at least 5 bytes, before the end.
+    while (size >= 13 && pos < size - 12) {
+        uint32_t seq;
+        memcpy(&seq, src + pos, 4);
+        uint32_t h = (seq * 2654435761u) >> (32 - trace_match_table_bits);
+        uint32_t ref = table[h];
+        table[h] = pos;
+        bool match = ref < pos && pos - ref <= 65535;
+        if (match) {
+            uint32_t prev;
+            memcpy(&prev, src + ref, 4);
+            match = (prev == seq);
+        }
+        if (!match) {
+            pos++;
+            continue;
+        }
+        uint32_t len = 4;
+        while (pos + len < size - 5 && src[ref + len] == src[pos + len]) {
+            len++;
+        }
+
+        uint32_t literals = pos - anchor;
+        uint8_t *token = out++;
+        *token = (uint8_t)((literals < 15 ? literals : 15) << 4);
+        if (literals >= 15) {
+            out = lz4_put_length(out, literals - 15);
+        }
+        memcpy(out, src + anchor, literals);
+        out += literals;
+        uint32_t offset = pos - ref;
+        *out++ = (uint8_t)offset;
+        *out++ = (uint8_t)(offset >> 8);
+        uint32_t extra = len - 4;
+        *token |= (uint8_t)(extra < 15 ? extra : 15);
+        if (extra >= 15) {
+            out = lz4_put_length(out, extra - 15);
+        }
+
+        pos += len;
+        anchor = pos;
+    }
+
+    // The remainder goes out as literals.
+    uint32_t literals = size - anchor;
+    *out++ = (uint8_t)((literals < 15 ? literals : 15) << 4);
+    if (literals >= 15) {
+        out = lz4_put_length(out, literals - 15);
+    }
+    memcpy(out, src + anchor, literals);
+    out += literals;
+    return (uint32_t)(out - dst);
+}
+
+struct TraceLane {
+    // Non-zero while claimed by a writer or the flusher.
+    volatile int busy;
+
+    // The two halves, allocated the first time the lane is used.
+    uint8_t *halves[2];
+
+    // The number of bytes written to each half.
+    uint32_t used[2];
+
+    // Whether each half is full and waiting to be flushed. At most one
+    // half is ever sealed, and it's never the one being filled.
+    volatile int sealed[2];
+
+    // The half being filled.
+    int filling;
+
+    // How far the flusher has got through the sealed half.
+    uint32_t flushed;
+};
+
+class TraceBuffer {
+    TraceLane lanes[trace_lanes];
+
+    // The id of the next packet. Ids are taken by a writer while it
+    // holds a lane, so packets within a lane are in id order, and
+    // the flusher can merge the lanes back into a single stream in
+    // the order the events happened.
+    volatile int32_t next_id;
+
+    // Whether some thread is flushing. Guarded by flusher_mutex, and
+    // flushed_cond is signaled when it's done.
+    bool flushing;
+    halide_cond flushed_cond;
+
+    // Packets are copied here in order before they're written out.
+    uint8_t *out;
+    uint32_t out_used;
+
+    // When compressing, the index of the packets in out, and space
+    // to compress them into.
+    bool compress;
+    halide_trace_block_header_t block;
+    halide_trace_block_func_t block_funcs[trace_block_max_funcs];
+    int last_block_func;
+    uint8_t *compressed;
+    uint32_t *match_table;
+
+    // The background flusher thread, if threads are available.
+    halide_thread *flusher;
+    halide_mutex flusher_mutex;
+    halide_cond flusher_cond;
+    bool flusher_pending, flusher_stop;
+
+    __attribute__((always_inline)) TraceLane *claim_lane() {
+        // Threads' stacks are far apart, so use the stack address as
+        // a cheap thread id.
+        int here;
+        uint32_t h = (uint32_t)(((uintptr_t)&here) >> 16) * 2654435761u;
+        for (uint32_t i = h >> 26;; i++) {
+            TraceLane *lane = lanes + (i & (trace_lanes - 1));
+            if (!lane->busy && __sync_bool_compare_and_swap(&lane->busy, 0, 1)) {
+                return lane;
             }
         }
     }
 
-     __attribute__((always_inline)) void release_shared() {
-        __sync_fetch_and_sub(&lock, 1);
+    __attribute__((always_inline)) void release_lane(TraceLane *lane) {
+        // Need a memory barrier to guarantee all the writes are done.
+        __sync_synchronize();
+        lane->busy = 0;
     }
 
-    __attribute__((always_inline)) void acquire_exclusive() {
-        while (1) {
-            // If multiple threads are trying to acquire exclusive
-            // ownership, we may need to rerequest exclusive waiting
-            // while we spin, as it gets unset whenever a thread
-            // acquires exclusive ownership.
-            __sync_fetch_and_or(&lock, exclusive_waiting_mask);
-            if (__sync_bool_compare_and_swap(&lock, exclusive_waiting_mask, exclusive_held_mask)) {
-                return;
+    // Seal the half being filled and start on the other one. The
+    // other one must not be sealed.
+    void seal(TraceLane *lane) {
+        int f = lane->filling;
+        lane->flushed = 0;
+        lane->used[1 - f] = 0;
+        lane->filling = 1 - f;
+        __sync_synchronize();
+        lane->sealed[f] = 1;
+    }
+
+    // Add a packet to the index of the block. Returns false if the
+    // block has no room for another Func.
+    bool index_packet(const halide_trace_packet_t *p) {
+        uint32_t hash = trace_func_hash(p->func());
+        // Consecutive packets are usually from the same Func.
+        int f = last_block_func;
+        if (f < 0 || block_funcs[f].func_hash != hash) {
+            f = 0;
+            while (f < (int)block.num_funcs && block_funcs[f].func_hash != hash) {
+                f++;
             }
+            if (f == (int)block.num_funcs) {
+                if (block.num_funcs == trace_block_max_funcs) {
+                    return false;
+                }
+                block_funcs[f].func_hash = hash;
+                block_funcs[f].event_mask = 0;
+                block.num_funcs++;
+            }
+            last_block_func = f;
+        }
+        block_funcs[f].event_mask |= 1u << p->event;
+        block.event_mask |= 1u << p->event;
+        if (!block.num_packets) {
+            block.first_id = p->id;
         }
+        block.last_id = p->id;
+        block.num_packets++;
+        return true;
     }
 
-    __attribute__((always_inline)) void release_exclusive() {
-        __sync_fetch_and_and(&lock, ~exclusive_held_mask);
+    void write_out(void *user_context, int fd) {
+        if (!out_used) {
+            return;
+        }
+        uint8_t *data = out;
+        uint32_t size = out_used;
+        if (compress) {
+            // Assemble the block, so that it's written in one go.
+            uint32_t funcs_size = block.num_funcs * sizeof(halide_trace_block_func_t);
+            uint32_t header_size = sizeof(halide_trace_block_header_t) + funcs_size;
+            block.magic = halide_trace_block_magic;
+            block.uncompressed_size = out_used;
+            block.compressed_size = lz4_compress(out, out_used, compressed + header_size, match_table);
+            memcpy(compressed, &block, sizeof(block));
+            memcpy(compressed + sizeof(block), block_funcs, funcs_size);
+            data = compressed;
+            size = header_size + block.compressed_size;
+            memset(&block, 0, sizeof(block));
+            last_block_func = -1;
+        }
+        bool success = (size == (uint32_t)write(fd, data, size));
+        out_used = 0;
+        halide_assert(user_context, success && "Could not write to trace file");
     }
 
-    __attribute__((always_inline)) void init() {
-    	lock = 0;
+    void append_out(void *user_context, int fd, const halide_trace_packet_t *p) {
+        if (out_used + p->size > trace_half_size) {
+            write_out(user_context, fd);
+        }
+        if (compress && !index_packet(p)) {
+            write_out(user_context, fd);
+            index_packet(p);
+        }
+        memcpy(out + out_used, p, p->size);
+        out_used += p->size;
     }
 
-    SharedExclusiveSpinLock() : lock(0) {}
-};
+    // Write out the sealed halves of all the lanes, merged in id
+    // order, up to the first id that some lane might still write.
+    // Returns the first id not written, if any lane has one.
+    int32_t flush_round(void *user_context, int fd) {
+        int32_t limit = next_id;
+
+        // Seal any lane that has packets pending, unless it still has
+        // a sealed half to be written, and find the first id still
+        // being filled.
+        for (int i = 0; i < trace_lanes; i++) {
+            TraceLane *lane = lanes + i;
+            if (!lane->halves[0]) continue;
+            while (!__sync_bool_compare_and_swap(&lane->busy, 0, 1)) {
+                // The writer only holds it to copy in a packet.
+            }
+            if (lane->used[lane->filling] && !lane->sealed[1 - lane->filling]) {
+                seal(lane);
+            }
+            if (lane->used[lane->filling]) {
+                halide_trace_packet_t *first = (halide_trace_packet_t *)lane->halves[lane->filling];
+                if (first->id < limit) {
+                    limit = first->id;
+                }
+            }
+            release_lane(lane);
+        }
+
+        // Merge the sealed halves with a heap of lanes ordered by the
+        // id of their next packet.
+        int heap[trace_lanes];
+        int heap_size = 0;
+        for (int i = 0; i < trace_lanes; i++) {
+            TraceLane *lane = lanes + i;
+            int h = lane->sealed[0] ? 0 : lane->sealed[1] ? 1 : -1;
+            if (h >= 0 && lane->flushed < lane->used[h]) {
+                heap[heap_size] = i;
+                sift_up(heap, heap_size++);
+            }
+        }
+        while (heap_size) {
+            TraceLane *lane = lanes + heap[0];
+            int h = lane->sealed[0] ? 0 : 1;
+            halide_trace_packet_t *p = (halide_trace_packet_t *)(lane->halves[h] + lane->flushed);
+            if (p->id >= limit) {
+                break;
+            }
+            append_out(user_context, fd, p);
+            lane->flushed += p->size;
+            if (lane->flushed == lane->used[h]) {
+                // Give the half back to the writer.
+                __sync_synchronize();
+                lane->sealed[h] = 0;
+                heap[0] = heap[--heap_size];
+            }
+            sift_down(heap, heap_size);
+        }
+        write_out(user_context, fd);
+        return limit;
+    }
 
-const static int buffer_size = 1024 * 1024;
+    int32_t next_packet_id(int lane) {
+        int h = lanes[lane].sealed[0] ? 0 : 1;
+        return ((halide_trace_packet_t *)(lanes[lane].halves[h] + lanes[lane].flushed))->id;
+    }
 
-class TraceBuffer {
-    SharedExclusiveSpinLock lock;
-    uint32_t cursor, overage;
-    uint8_t buf[buffer_size];
-
-    // Attempt to atomically acquire space in the buffer to write a
-    // packet. Returns NULL if the buffer was full.
-    __attribute__((always_inline)) halide_trace_packet_t *try_acquire_packet(void *user_context, uint32_t size) {
-        lock.acquire_shared();
-        halide_assert(user_context, size <= buffer_size);
-        uint32_t my_cursor = __sync_fetch_and_add(&cursor, size);
-        if (my_cursor + size > sizeof(buf)) {
-            // Don't try to back it out: instead, just allow this request to fail
-            // (along with all subsequent requests) and record the 'overage'
-            // that was added and should be ignored; then, in the next flush,
-            // remove the overage.
-            __sync_fetch_and_add(&overage, size);
-            lock.release_shared();
-            return NULL;
-        } else {
-            return (halide_trace_packet_t *)(buf + my_cursor);
+    void sift_up(int *heap, int i) {
+        while (i > 0 && next_packet_id(heap[(i - 1) / 2]) > next_packet_id(heap[i])) {
+            int parent = (i - 1) / 2;
+            int tmp = heap[parent];
+            heap[parent] = heap[i];
+            heap[i] = tmp;
+            i = parent;
+        }
+    }
+
+    void sift_down(int *heap, int size) {
+        int i = 0;
+        while (1) {
+            int smallest = i;
+            for (int c = 2 * i + 1; c <= 2 * i + 2 && c < size; c++) {
+                if (next_packet_id(heap[c]) < next_packet_id(heap[smallest])) {
+                    smallest = c;
+                }
+            }
+            if (smallest == i) return;
+            int tmp = heap[smallest];
+            heap[smallest] = heap[i];
+            heap[i] = tmp;
+            i = smallest;
+        }
+    }
+
+    static void flusher_thread(void *arg) {
+        TraceBuffer *b = (TraceBuffer *)arg;
+        halide_mutex_lock(&b->flusher_mutex);
+        while (!b->flusher_stop) {
+            if (!b->flusher_pending) {
+                halide_cond_wait(&b->flusher_cond, &b->flusher_mutex);
+                continue;
+            }
+            b->flusher_pending = false;
+            halide_mutex_unlock(&b->flusher_mutex);
+            b->flush(NULL, halide_get_trace_file(NULL), false);
+            halide_mutex_lock(&b->flusher_mutex);
         }
+        halide_mutex_unlock(&b->flusher_mutex);
+    }
+
+    void wake_flusher() {
+        halide_mutex_lock(&flusher_mutex);
+        flusher_pending = true;
+        halide_cond_signal(&flusher_cond);
+        halide_mutex_unlock(&flusher_mutex);
     }
 
 public:
 
-    // Wait for all writers to finish with their packets, stall any
-    // new writers, and flush the buffer to the fd.
-    __attribute__((always_inline)) void flush(void *user_context, int fd) {
-        lock.acquire_exclusive();
-        bool success = true;
-        if (cursor) {
-            cursor -= overage;
-            success = (cursor == (uint32_t)write(fd, buf, cursor));
-            cursor = 0;
-            overage = 0;
-        }
-        lock.release_exclusive();
-        halide_assert(user_context, success && "Could not write to trace file");
+    // Write out the packets that are ready, after waiting for any
+    // other thread that's flushing to finish. If drain is true, keeps
+    // going until every packet written so far is out.
+    void flush(void *user_context, int fd, bool drain) {
+        halide_mutex_lock(&flusher_mutex);
+        while (flushing) {
+            halide_cond_wait(&flushed_cond, &flusher_mutex);
+        }
+        flushing = true;
+        halide_mutex_unlock(&flusher_mutex);
+
+        int32_t end = next_id;
+        int32_t pending = flush_round(user_context, fd);
+        // A lane with a sealed half still to be written can't be
+        // sealed again until the next round, so draining takes a
+        // couple of rounds.
+        while (drain && pending < end) {
+            pending = flush_round(user_context, fd);
+        }
+
+        halide_mutex_lock(&flusher_mutex);
+        flushing = false;
+        halide_cond_broadcast(&flushed_cond);
+        halide_mutex_unlock(&flusher_mutex);
     }
 
-    // Acquire and return a packet's worth of space in the trace
-    // buffer, flushing the trace buffer to the given fd to make space
-    // if necessary. The region acquired is protected from other
-    // threads writing or reading to it, so it must be released before
-    // a flush can occur.
-    __attribute__((always_inline)) halide_trace_packet_t *acquire_packet(void *user_context, int fd, uint32_t size) {
-        halide_trace_packet_t *packet = NULL;
-        while (!(packet = try_acquire_packet(user_context, size))) {
-            // Couldn't acquire space to write a packet. Flush and try again.
-            flush(user_context, fd);
-        }
-        return packet;
+    // Acquire space for a packet in the calling thread's lane, and
+    // assign it an id. The lane is held until the packet is released,
+    // so this must be followed promptly by release_packet.
+    __attribute__((always_inline)) halide_trace_packet_t *acquire_packet(void *user_context, int fd, uint32_t size, TraceLane **lane_out) {
+        halide_assert(user_context, size <= trace_half_size);
+        while (1) {
+            TraceLane *lane = claim_lane();
+            if (!lane->halves[0]) {
+                uint8_t *mem = (uint8_t *)malloc(2 * trace_half_size);
+                halide_assert(user_context, mem && "Could not allocate trace buffer");
+                lane->halves[1] = mem + trace_half_size;
+                __sync_synchronize();
+                lane->halves[0] = mem;
+            }
+            int f = lane->filling;
+            if (lane->used[f] + size > trace_half_size) {
+                if (!lane->sealed[1 - f]) {
+                    // Hand this half to the flusher.
+                    seal(lane);
+                    f = lane->filling;
+                    if (flusher) {
+                        wake_flusher();
+                    } else {
+                        release_lane(lane);
+                        flush(user_context, fd, false);
+                        continue;
+                    }
+                } else {
+                    // Both halves are full. Wait for any flush in
+                    // progress to finish, then flush them ourselves
+                    // rather than waiting for the flusher to get
+                    // around to it.
+                    release_lane(lane);
+                    flush(user_context, fd, false);
+                    continue;
+                }
+            }
+            halide_trace_packet_t *packet = (halide_trace_packet_t *)(lane->halves[f] + lane->used[f]);
+            packet->id = __sync_fetch_and_add(&next_id, 1);
+            lane->used[f] += size;
+            *lane_out = lane;
+            return packet;
+        }
     }
 
     // Release a packet, allowing it to be written out with flush
-    __attribute__((always_inline)) void release_packet(halide_trace_packet_t *) {
-        // Need a memory barrier to guarantee all the writes are done.
-        __sync_synchronize();
-        lock.release_shared();
+    __attribute__((always_inline)) void release_packet(TraceLane *lane) {
+        release_lane(lane);
     }
 
-    __attribute__((always_inline)) void init() {
-    	cursor = 0;
-    	overage = 0;
-    	lock.init();
+    void init() {
+        memset(this, 0, sizeof(*this));
+        next_id = 1;
+        out = (uint8_t *)malloc(trace_half_size);
+        const char *c = getenv("HL_TRACE_COMPRESS");
+        compress = c && atoi(c) == 1;
+        last_block_func = -1;
+        if (compress) {
+            compressed = (uint8_t *)malloc(trace_block_max_size);
+            match_table = (uint32_t *)malloc(sizeof(uint32_t) << trace_match_table_bits);
+            // Fall back to writing packets as they are.
+            compress = compressed && match_table;
+        }
+        if (halide_can_spawn_threads()) {
+            flusher = halide_spawn_thread(flusher_thread, this);
+        }
     }
 
-    TraceBuffer() : cursor(0), overage(0) {}
+    // Stop the flusher thread, and write out everything that's left.
+    void shutdown(void *user_context, int fd) {
+        if (flusher) {
+            halide_mutex_lock(&flusher_mutex);
+            flusher_stop = true;
+            halide_cond_signal(&flusher_cond);
+            halide_mutex_unlock(&flusher_mutex);
+            halide_join_thread(flusher);
+            flusher = NULL;
+        }
+        flush(user_context, fd, true);
+        for (int i = 0; i < trace_lanes; i++) {
+            free(lanes[i].halves[0]);
+        }
+        free(out);
+        free(compressed);
+        free(match_table);
+    }
 };
 
+// Loads and stores can be sampled by setting HL_TRACE_SAMPLE_RATE to
+// N, in which case only every Nth one of each Func is traced. Funcs
+// are given a slot in a small hash table keyed by the address of
+// their name, which is a constant string. Like the trace buffer's
+// lanes, the counts are split by the stack address of the thread,
+// so that threads tracing the same Func don't contend for a count.
+const static int trace_sample_funcs = 256;
+const static int trace_sample_stripes = 32;
+
+WEAK int trace_sample_rate = 0; // 0 indicates uninitialized
+WEAK const char *trace_sample_func_slots[trace_sample_funcs];
+WEAK uint32_t trace_sample_counts[trace_sample_stripes][trace_sample_funcs];
+
+WEAK bool should_trace_event(const halide_trace_event_t *e) {
+    if (trace_sample_rate == 0) {
+        const char *rate = getenv("HL_TRACE_SAMPLE_RATE");
+        int r = rate ? atoi(rate) : 1;
+        trace_sample_rate = r > 1 ? r : 1;
+    }
+    if (trace_sample_rate == 1 ||
+        (e->event != halide_trace_load && e->event != halide_trace_store)) {
+        return true;
+    }
+    int here;
+    uint32_t stripe = ((uint32_t)(((uintptr_t)&here) >> 16) * 2654435761u) % trace_sample_stripes;
+    uint32_t h = (uint32_t)(((uintptr_t)e->func) >> 2) * 2654435761u;
+    for (int i = 0; i < trace_sample_funcs; i++) {
+        int slot = (h + i) & (trace_sample_funcs - 1);
+        const char *f = trace_sample_func_slots[slot];
+        if (!f) {
+            f = __sync_val_compare_and_swap(trace_sample_func_slots + slot, (const char *)NULL, e->func);
+            if (!f) {
+                f = e->func;
+            }
+        }
+        if (f == e->func) {
+            // Threads rarely share a stripe, so this is almost
+            // always uncontended.
+            uint32_t *count = &trace_sample_counts[stripe][slot];
+            return (__sync_fetch_and_add(count, 1) % trace_sample_rate) == 0;
+        }
+    }
+    // Too many Funcs to sample separately.
+    return true;
+}
+
 WEAK TraceBuffer *halide_trace_buffer = NULL;
 WEAK int halide_trace_file = -1; // -1 indicates uninitialized
 WEAK int halide_trace_file_lock = 0;
@@ -158,7 +551,13 @@ extern "C" {
 WEAK int32_t halide_default_trace(void *user_context, const halide_trace_event_t *e) {
     static int32_t ids = 1;
 
-    int32_t my_id = __sync_fetch_and_add(&ids, 1);
+    if (!should_trace_event(e)) {
+        // Only loads and stores are sampled, and nothing refers to
+        // their ids.
+        return 0;
+    }
+
+    int32_t my_id;
 
     // If we're dumping to a file, use a binary format
     int fd = halide_get_trace_file(user_context);
@@ -172,8 +571,10 @@ WEAK int32_t halide_default_trace(void *user_context, const halide_trace_event_t
         uint32_t total_size_without_padding = header_bytes + value_bytes + coords_bytes + name_bytes + trace_tag_bytes;
         uint32_t total_size = (total_size_without_padding + 3) & ~3;
 
-        // Claim some space to write to in the trace buffer
-        halide_trace_packet_t *packet = halide_trace_buffer->acquire_packet(user_context, fd, total_size);
+        // Claim some space to write to in this thread's trace buffer
+        TraceLane *lane;
+        halide_trace_packet_t *packet = halide_trace_buffer->acquire_packet(user_context, fd, total_size, &lane);
+        my_id = packet->id;
 
         if (total_size > 4096) {
             print(NULL) << total_size << "\n";
@@ -181,7 +582,6 @@ WEAK int32_t halide_default_trace(void *user_context, const halide_trace_event_t
 
         // Write a packet into it
         packet->size = total_size;
-        packet->id = my_id;
         packet->type = e->type;
         packet->event = e->event;
         packet->parent_id = e->parent_id;
@@ -197,15 +597,17 @@ WEAK int32_t halide_default_trace(void *user_context, const halide_trace_event_t
         memcpy((void *)packet->trace_tag(), e->trace_tag ? e->trace_tag : "", trace_tag_bytes);
 
         // Release it
-        halide_trace_buffer->release_packet(packet);
+        halide_trace_buffer->release_packet(lane);
 
         // We should also flush the trace buffer if we hit an event
         // that might be the end of the trace.
         if (e->event == halide_trace_end_pipeline) {
-            halide_trace_buffer->flush(user_context, fd);
+            halide_trace_buffer->flush(user_context, fd, true);
         }
 
     } else {
+        my_id = __sync_fetch_and_add(&ids, 1);
+
         uint8_t buffer[4096];
         Printer<StringStreamPrinter, sizeof(buffer)> ss(user_context, (char *)buffer);
 
@@ -332,11 +734,18 @@ WEAK trace_fn halide_set_custom_trace(trace_fn t) {
 
 WEAK void halide_set_trace_file(int fd) {
     halide_trace_file = fd;
+    // Make the next halide_get_trace_file set up the buffer for it.
+    halide_trace_file_initialized = false;
 }
 
 extern int errno;
 
 WEAK int halide_get_trace_file(void *user_context) {
+    // This is called for every event, so once the file and the buffer
+    // are set up, skip the lock.
+    if (halide_trace_file_initialized) {
+        return halide_trace_file;
+    }
     ScopedSpinLock lock(&halide_trace_file_lock);
     if (halide_trace_file < 0) {
         const char *trace_file_name = getenv("HL_TRACE_FILE");
@@ -345,14 +754,20 @@ WEAK int halide_get_trace_file(void *user_context) {
             halide_assert(user_context, file && "Failed to open trace file\n");
             halide_set_trace_file(fileno(file));
             halide_trace_file_internally_opened = file;
-            if (!halide_trace_buffer) {
-                halide_trace_buffer = (TraceBuffer *)malloc(sizeof(TraceBuffer));
-                halide_trace_buffer->init();
-            }
         } else {
             halide_set_trace_file(0);
         }
     }
+    // The trace file may also have been set with halide_set_trace_file.
+    if (halide_trace_file > 0 && !halide_trace_buffer) {
+        TraceBuffer *buffer = (TraceBuffer *)malloc(sizeof(TraceBuffer));
+        halide_assert(user_context, buffer && "Could not allocate trace buffer");
+        buffer->init();
+        halide_trace_buffer = buffer;
+    }
+    // Publish the file and buffer before the flag.
+    __sync_synchronize();
+    halide_trace_file_initialized = true;
     return halide_trace_file;
 }
 
@@ -361,14 +776,17 @@ WEAK int32_t halide_trace(void *user_context, const halide_trace_event_t *e) {
 }
 
 WEAK int halide_shutdown_trace() {
+    if (halide_trace_buffer) {
+        halide_trace_buffer->shutdown(NULL, halide_trace_file);
+        free(halide_trace_buffer);
+        halide_trace_buffer = NULL;
+        halide_trace_file_initialized = false;
+    }
     if (halide_trace_file_internally_opened) {
         int ret = fclose(halide_trace_file_internally_opened);
         halide_trace_file = 0;
         halide_trace_file_initialized = false;
         halide_trace_file_internally_opened = NULL;
-        if (halide_trace_buffer) {
-            free(halide_trace_buffer);
-        }
         return ret;
     } else {
         return 0;
@@ -44,6 +44,10 @@ WEAK void *spawn_thread_helper(void *arg) {
     return NULL;
 }
 
+// Extra stack space to give spawned threads, on top of the default
+// of 1MB. See halide_reserve_thread_stack.
+WEAK int thread_stack_reserve = 0;
+
 }}} // namespace Halide::Runtime::Internal
 
 extern "C" {
@@ -62,7 +66,12 @@ WEAK halide_thread *halide_spawn_thread(void(*f)(void *), void *closure) {
     spawned_thread *t = (spawned_thread *)malloc(sizeof(spawned_thread));
     t->f = f;
     t->closure = closure;
-    t->handle = CreateThread(NULL, 0, spawn_thread_helper, t, 0, NULL);
+    // A stack size of zero means the default for the executable.
+    size_t stack_size = 0;
+    if (thread_stack_reserve > 0) {
+        stack_size = 1024 * 1024 + thread_stack_reserve;
+    }
+    t->handle = CreateThread(NULL, stack_size, spawn_thread_helper, t, 0, NULL);
     return (halide_thread *)t;
 }
 
@@ -0,0 +1,119 @@
+#include "Halide.h"
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+
+#include "test/common/halide_test_dirs.h"
+
+using namespace Halide;
+
+std::string read_file(const std::string &filename) {
+    std::ifstream file(filename);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+// Returns the llvm assembly for f compiled for the given target.
+std::string llvm_assembly(Func f, const std::vector<Argument> &args, const Target &target) {
+    std::string filename = Internal::get_test_tmp_dir() + "arm_sve_gather_" + f.name() + ".ll";
+    Internal::ensure_no_file_exists(filename);
+    f.compile_to_llvm_assembly(filename, args, f.name(), target);
+    return read_file(filename);
+}
+
+// Returns the machine assembly for f compiled for the given target.
+std::string assembly(Func f, const std::vector<Argument> &args, const Target &target) {
+    std::string filename = Internal::get_test_tmp_dir() + "arm_sve_gather_" + f.name() + ".s";
+    Internal::ensure_no_file_exists(filename);
+    f.compile_to_assembly(filename, args, f.name(), target);
+    return read_file(filename);
+}
+
+int main(int argc, char **argv) {
+    ImageParam in(Int(32), 1, "in"), idx(Int(32), 1, "idx");
+    Var x("x");
+
+    // Vectors of 32-bit lanes loaded from and stored to arbitrary
+    // indices.
+    Func gather("gather");
+    gather(x) = in(clamp(idx(x), 0, 1023));
+    gather.vectorize(x, 8);
+
+    Func scatter("scatter");
+    RDom r(0, 1024);
+    scatter(x) = 0;
+    scatter(clamp(idx(r), 0, 1023)) = in(r);
+    scatter.update().allow_race_conditions().vectorize(r, 8);
+
+    // A vectorized loop with a masked tail.
+    Func tail("tail");
+    tail(x) = in(x) * 2;
+    tail.vectorize(x, 8, TailStrategy::Predicate);
+
+    // Without a known SVE vector length, LLVM can't use SVE for
+    // Halide's fixed-width vectors, so these must be left to the usual
+    // NEON codegen rather than made into masked gathers and scatters.
+    const char *targets[] = {
+        "arm-64-linux",
+        "arm-64-linux-sve",
+        "arm-64-linux-sve2",
+    };
+    for (const char *t : targets) {
+        Target target = Target(t).with_feature(Target::NoAsserts).with_feature(Target::NoBoundsQuery).with_feature(Target::NoRuntime);
+        if (!target.supported()) {
+            continue;
+        }
+        if (llvm_assembly(gather, {in, idx}, target).find("llvm.masked.gather") != std::string::npos) {
+            printf("Gather was made into a masked gather for %s\n", t);
+            return -1;
+        }
+        if (llvm_assembly(scatter, {in, idx}, target).find("llvm.masked.scatter") != std::string::npos) {
+            printf("Scatter was made into a masked scatter for %s\n", t);
+            return -1;
+        }
+    }
+
+    // With the vector length known, all three must use SVE
+    // registers. Halide only accepts vector_bits if its LLVM can
+    // generate SVE code for a known vector length.
+    if (!Target::validate_target_string("arm-64-linux-sve-vector_bits_256")) {
+        printf("[SKIP] vector_bits is not supported by this build of Halide.\n");
+        return 0;
+    }
+    const char *sve_targets[] = {
+        "arm-64-linux-sve-vector_bits_256",
+        "arm-64-linux-sve2-vector_bits_256",
+    };
+    for (const char *t : sve_targets) {
+        Target target = Target(t).with_feature(Target::NoAsserts).with_feature(Target::NoBoundsQuery).with_feature(Target::NoRuntime);
+        if (!target.supported()) {
+            continue;
+        }
+        if (target.natural_vector_size<int32_t>() != 8) {
+            printf("natural_vector_size<int32_t>() is %d instead of 8 for %s\n",
+                   target.natural_vector_size<int32_t>(), t);
+            return -1;
+        }
+        if (llvm_assembly(gather, {in, idx}, target).find("llvm.masked.gather") == std::string::npos) {
+            printf("Gather was not made into a masked gather for %s\n", t);
+            return -1;
+        }
+        if (llvm_assembly(scatter, {in, idx}, target).find("llvm.masked.scatter") == std::string::npos) {
+            printf("Scatter was not made into a masked scatter for %s\n", t);
+            return -1;
+        }
+        // SVE loads and stores name z registers, e.g. "ld1w { z0.s }".
+        Func fs[] = {gather, scatter, tail};
+        for (Func f : fs) {
+            std::string s = assembly(f, {in, idx}, target);
+            if (s.find("{ z") == std::string::npos) {
+                printf("No SVE loads or stores in %s for %s\n", f.name().c_str(), t);
+                return -1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,132 @@
+#include "Halide.h"
+#include <algorithm>
+#include <stdio.h>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    const int W = 500, H = 300;
+
+    Buffer<uint8_t> in(W, H);
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            in(x, y) = (uint8_t)((x * 31 + y * 17) ^ (x * y));
+        }
+    }
+
+    Var x;
+    RDom r(0, W, 0, H);
+
+    int correct_hist[64] = {0};
+    float correct_max[64];
+    std::fill(correct_max, correct_max + 64, 0.0f);
+    int correct_sum = 0;
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            int bin = in(x, y) % 64;
+            correct_hist[bin]++;
+            correct_max[bin] = std::max(correct_max[bin], in(x, y) * 0.5f + x);
+            correct_sum += in(x, y);
+        }
+    }
+
+    // A histogram updated from a parallel loop. Integer adds lower
+    // to atomic read-modify-writes.
+    {
+        Func hist("hist");
+        hist(x) = 0;
+        hist(in(r.x, r.y) % 64) += 1;
+        hist.update().atomic().parallel(r.y);
+
+        Buffer<int> result = hist.realize(64);
+        for (int i = 0; i < 64; i++) {
+            if (result(i) != correct_hist[i]) {
+                printf("hist(%d) = %d instead of %d\n", i, result(i), correct_hist[i]);
+                return -1;
+            }
+        }
+    }
+
+    // The same, but also vectorized across r.x. The vector of atomic
+    // updates is scalarized.
+    {
+        Func hist("hist_vec");
+        hist(x) = 0;
+        hist(in(r.x, r.y) % 64) += 1;
+        RVar rxo, rxi;
+        hist.update().atomic().split(r.x, rxo, rxi, 4).vectorize(rxi).parallel(r.y);
+
+        Buffer<int> result = hist.realize(64);
+        for (int i = 0; i < 64; i++) {
+            if (result(i) != correct_hist[i]) {
+                printf("hist_vec(%d) = %d instead of %d\n", i, result(i), correct_hist[i]);
+                return -1;
+            }
+        }
+    }
+
+    // A float max, which has no atomic instruction and needs a
+    // compare-and-swap loop.
+    {
+        Func hi("hi");
+        hi(x) = 0.0f;
+        hi(in(r.x, r.y) % 64) = max(hi(in(r.x, r.y) % 64), in(r.x, r.y) * 0.5f + r.x);
+        hi.update().atomic().parallel(r.y);
+
+        Buffer<float> result = hi.realize(64);
+        for (int i = 0; i < 64; i++) {
+            if (result(i) != correct_max[i]) {
+                printf("hi(%d) = %f instead of %f\n", i, result(i), correct_max[i]);
+                return -1;
+            }
+        }
+    }
+
+    // A sum into a single site, which gets privatized per task.
+    {
+        Func sum("sum");
+        sum() = 0;
+        sum() += cast<int>(in(r.x, r.y));
+        sum.update().atomic().parallel(r.y);
+
+        Buffer<int> result = sum.realize();
+        if (result() != correct_sum) {
+            printf("sum = %d instead of %d\n", result(), correct_sum);
+            return -1;
+        }
+    }
+
+    // The same histogram and sum over a parallel RVar with no
+    // iterations at runtime.
+    {
+        Param<int> rows;
+        RDom e(0, W, 0, rows);
+
+        Func hist("hist_empty");
+        hist(x) = 0;
+        hist(in(e.x, e.y) % 64) += 1;
+        hist.update().atomic().parallel(e.y);
+
+        Func sum("sum_empty");
+        sum() = 0;
+        sum() += cast<int>(in(e.x, e.y));
+        sum.update().atomic().parallel(e.y);
+
+        rows.set(0);
+        Buffer<int> hist_result = hist.realize(64);
+        for (int i = 0; i < 64; i++) {
+            if (hist_result(i) != 0) {
+                printf("hist_empty(%d) = %d instead of 0\n", i, hist_result(i));
+                return -1;
+            }
+        }
+        Buffer<int> sum_result = sum.realize();
+        if (sum_result() != 0) {
+            printf("sum_empty = %d instead of 0\n", sum_result());
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,115 @@
+#include "Halide.h"
+#include <atomic>
+#include <stdio.h>
+
+using namespace Halide;
+
+std::atomic<int> malloc_count;
+
+void *my_malloc(void *user_context, size_t x) {
+    malloc_count++;
+    void *orig = malloc(x + 32);
+    void *ptr = (void *)((((size_t)orig + 32) >> 5) << 5);
+    ((void **)ptr)[-1] = orig;
+    return ptr;
+}
+
+void my_free(void *user_context, void *ptr) {
+    free(((void **)ptr)[-1]);
+}
+
+int check(const Buffer<int> &result, int k) {
+    for (int y = 0; y < result.height(); y++) {
+        for (int x = 0; x < result.width(); x++) {
+            int correct = 0;
+            for (int i = 0; i < k; i++) {
+                correct += (x + i) * y + 3;
+            }
+            if (result(x, y) != correct) {
+                printf("result(%d, %d) = %d instead of %d\n", x, y, result(x, y), correct);
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (get_jit_target_from_environment().arch == Target::WebAssembly) {
+        printf("[SKIP] WebAssembly JIT does not support set_custom_allocator().\n");
+        return 0;
+    }
+
+    const int W = 32, H = 16, K = 50;
+    Var x("x"), y("y");
+
+    // The size of g depends on a Param, so it goes on the heap.
+    Param<int> k;
+    k.set(K);
+
+    // 0: not hoisted, 1: hoisted to f's loop over y, 2: hoisted to
+    // the root, 3: hoisted to f's loop over y, which is parallel.
+    for (int i = 0; i < 4; i++) {
+        Func f("f"), g("g");
+        RDom r(0, k);
+        g(x, y) = x * y + 3;
+        f(x, y) = 0;
+        f(x, y) += g(x + r, y);
+
+        g.compute_at(f, x);
+        if (i == 1 || i == 3) {
+            g.hoist_storage(f, y);
+        } else if (i == 2) {
+            g.hoist_storage_root();
+        }
+        if (i == 3) {
+            f.parallel(y);
+        }
+
+        f.set_custom_allocator(my_malloc, my_free);
+        malloc_count = 0;
+        Buffer<int> result = f.realize(W, H);
+        if (check(result, K) != 0) {
+            return -1;
+        }
+
+        int expected_count = (i == 0) ? W * H : (i == 2) ? 1 : H;
+        if (malloc_count != expected_count) {
+            printf("%d allocations instead of %d for case %d\n",
+                   (int)malloc_count, expected_count, i);
+            return -1;
+        }
+    }
+
+    // A Func with multiple outputs, with storage hoisted out of the
+    // inner loop of a split update.
+    {
+        Func f("f"), g("g");
+        RDom r(0, k);
+        g(x, y) = {x * y + 3, x};
+        f(x, y) = 0;
+        f(x, y) += g(x + r, y)[0] + g(x + r, y)[1] - (x + r);
+
+        Var xo("xo"), xi("xi");
+        f.update().split(x, xo, xi, 7, TailStrategy::GuardWithIf);
+        g.compute_at(f, xi).hoist_storage(f, xo);
+
+        f.set_custom_allocator(my_malloc, my_free);
+        malloc_count = 0;
+        Buffer<int> result = f.realize(W, H);
+        if (check(result, K) != 0) {
+            return -1;
+        }
+
+        // One allocation per output of g per iteration of xo.
+        int expected_count = 2 * H * ((W + 6) / 7);
+        if (malloc_count != expected_count) {
+            printf("%d allocations instead of %d for the tuple case\n",
+                   (int)malloc_count, expected_count);
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
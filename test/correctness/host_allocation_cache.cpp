@@ -0,0 +1,111 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+using namespace Halide;
+
+#ifdef _WIN32
+#define DLLEXPORT __declspec(dllexport)
+#else
+#define DLLEXPORT
+#endif
+
+// The host pointers of the buffers produce_bytes has been asked to
+// fill, in the order it was asked.
+std::vector<void *> hosts;
+
+extern "C" DLLEXPORT int produce_bytes(halide_buffer_t *out) {
+    if (out->is_bounds_query()) {
+        return 0;
+    }
+    hosts.push_back(out->host);
+    memset(out->host, 1, out->dim[0].extent);
+    return 0;
+}
+
+// A pipeline with one heap allocation, made by the default allocator,
+// of a little more than the given number of bytes.
+void *run_one(int size) {
+    Func f("f"), out("out");
+    f.define_extern("produce_bytes", {}, UInt(8), 1);
+    f.compute_root();
+    Var x("x");
+    out(x) = f(x) * 2;
+    hosts.clear();
+    out.realize(size);
+    return hosts.size() == 1 ? hosts[0] : nullptr;
+}
+
+// A pipeline with two heap allocations of the same size that are live
+// at the same time.
+std::vector<void *> run_two(int size) {
+    Func f("f"), g("g"), out("out");
+    f.define_extern("produce_bytes", {}, UInt(8), 1);
+    g.define_extern("produce_bytes", {}, UInt(8), 1);
+    f.compute_root();
+    g.compute_root();
+    Var x("x");
+    out(x) = f(x) + g(x);
+    hosts.clear();
+    out.realize(size);
+    return hosts;
+}
+
+int main(int argc, char **argv) {
+    Target t = get_jit_target_from_environment();
+    if (t.arch == Target::WebAssembly) {
+        printf("[SKIP] WebAssembly JIT does not use the host allocation cache.\n");
+        return 0;
+    }
+
+    // The JIT runtime caches freed host allocations by default.
+    Internal::JITSharedRuntime::reuse_host_allocations(true);
+
+    // A freed block is reused by the next allocation of the same size.
+    void *p = run_one(1000);
+    if (!p || run_one(1000) != p) {
+        printf("An allocation of the same size was not reused\n");
+        return -1;
+    }
+
+    // Allocations are binned by size class: 1000 and 1010 bytes are
+    // in the same class, and 3000 bytes is not. The cached block is
+    // still held while the 3000-byte allocation is live, so that must
+    // get a different block.
+    if (run_one(1010) != p) {
+        printf("An allocation in the same size class was not reused\n");
+        return -1;
+    }
+    if (run_one(3000) == p) {
+        printf("An allocation in a different size class reused a cached block\n");
+        return -1;
+    }
+    if (run_one(1000) != p) {
+        printf("The cached block was lost\n");
+        return -1;
+    }
+
+    // Reducing the cache size releases what it holds. With room for
+    // exactly one block of this class, only one of two blocks freed
+    // together can be kept, and if the earlier block had not been
+    // released there would be no room for either.
+    Internal::JITSharedRuntime::host_allocation_cache_set_size(0);
+    Internal::JITSharedRuntime::host_allocation_cache_set_size(1024);
+    std::vector<void *> first = run_two(1000);
+    std::vector<void *> second = run_two(1000);
+    if (first.size() != 2 || second.size() != 2 ||
+        (second[0] != first[0] && second[0] != first[1])) {
+        printf("A block freed after the cache was shrunk was not reused\n");
+        return -1;
+    }
+
+    // Turning reuse off releases everything, and leaves the cache
+    // empty for anything that runs afterwards.
+    Internal::JITSharedRuntime::host_allocation_cache_set_size(64 * 1024 * 1024);
+    Internal::JITSharedRuntime::reuse_host_allocations(false);
+    Internal::JITSharedRuntime::reuse_host_allocations(true);
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,216 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <dirent.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+using namespace Halide;
+
+#ifndef _WIN32
+int count_cached_objects(const std::string &dir) {
+    int count = 0;
+    DIR *d = opendir(dir.c_str());
+    if (!d) {
+        return 0;
+    }
+    while (dirent *e = readdir(d)) {
+        std::string name = e->d_name;
+        if (name.size() > 2 && name.substr(name.size() - 2) == ".o") {
+            count++;
+        }
+    }
+    closedir(d);
+    return count;
+}
+
+// Remove the cache directory and the files in it.
+void remove_dir(const std::string &dir) {
+    DIR *d = opendir(dir.c_str());
+    if (!d) {
+        return;
+    }
+    while (dirent *e = readdir(d)) {
+        std::string name = e->d_name;
+        if (name != "." && name != "..") {
+            unlink((dir + "/" + name).c_str());
+        }
+    }
+    closedir(d);
+    rmdir(dir.c_str());
+}
+
+Buffer<int> make_input() {
+    Buffer<int> in(65, 32);
+    in.for_each_element([&](int x, int y) { in(x, y) = x * 3 + y; });
+    return in;
+}
+
+const float scale_a = 0.1234567f, scale_b = 0.1234568f;
+
+// Compile and run a pipeline, returning the number of incorrect
+// output values.
+int run_pipeline(Buffer<int> in) {
+    ImageParam input(Int(32), 2, "input");
+    input.set(in);
+
+    Var x("x"), y("y");
+    Func f("f"), g("g");
+    f(x, y) = input(x, y) * 2 + x;
+    g(x, y) = f(x, y) + f(x + 1, y) - y;
+    f.compute_root().vectorize(x, 4);
+    g.parallel(y);
+
+    Buffer<int> out = g.realize(64, 32);
+    int errors = 0;
+    for (int y = 0; y < 32; y++) {
+        for (int x = 0; x < 64; x++) {
+            int correct = (in(x, y) * 2 + x) + (in(x + 1, y) * 2 + x + 1) - y;
+            if (out(x, y) != correct) {
+                errors++;
+            }
+        }
+    }
+    return errors;
+}
+
+// A pipeline that differs between calls only in a float constant.
+int run_scaled_pipeline(Buffer<int> in, float scale) {
+    ImageParam input(Int(32), 2, "input");
+    input.set(in);
+
+    Var x("x"), y("y");
+    Func s("s");
+    s(x, y) = cast<float>(input(x, y)) * scale;
+
+    Buffer<float> out = s.realize(64, 32);
+    int errors = 0;
+    for (int y = 0; y < 32; y++) {
+        for (int x = 0; x < 64; x++) {
+            if (out(x, y) != (float)in(x, y) * scale) {
+                errors++;
+            }
+        }
+    }
+    return errors;
+}
+
+// Run one of the pipelines above in a fresh process, so that it is
+// compiled from the same starting state each time. The process is a
+// new instance of this test, rather than a fork of this one, which
+// may already have thread pool threads running.
+const char *self = nullptr;
+
+bool run_in_child(const char *pipeline) {
+    char child[] = "child";
+    char *args[] = {(char *)self, child, (char *)pipeline, nullptr};
+    pid_t pid = fork();
+    if (pid == 0) {
+        execv(self, args);
+        _exit(1);
+    }
+    int status = 0;
+    return pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+int child_main(const char *pipeline) {
+    Buffer<int> in = make_input();
+    if (!strcmp(pipeline, "pipeline")) {
+        return run_pipeline(in);
+    } else if (!strcmp(pipeline, "scaled_a")) {
+        return run_scaled_pipeline(in, scale_a);
+    } else if (!strcmp(pipeline, "scaled_b")) {
+        return run_scaled_pipeline(in, scale_b);
+    }
+    return -1;
+}
+#endif
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+    printf("Test skipped on windows due to use of setenv\n");
+#else
+    if (argc == 3 && !strcmp(argv[1], "child")) {
+        return child_main(argv[2]) == 0 ? 0 : 1;
+    }
+    self = argv[0];
+
+    std::string dir = Internal::dir_make_temp();
+    setenv("HL_JIT_CACHE_DIR", dir.c_str(), 1);
+
+    Buffer<int> in = make_input();
+
+    // Names made up during lowering depend on what the process has
+    // compiled before, so populate the cache from a fresh process
+    // that has compiled exactly what this one is about to.
+    if (!run_in_child("pipeline")) {
+        printf("Pipeline failed in child process\n");
+        return -1;
+    }
+
+    int objects = count_cached_objects(dir);
+    if (objects == 0) {
+        printf("Nothing was written to the JIT cache\n");
+        return -1;
+    }
+
+    // This should load both the runtime and the pipeline from the cache.
+    if (run_pipeline(in) != 0) {
+        printf("Pipeline loaded from the JIT cache computed the wrong result\n");
+        return -1;
+    }
+    if (count_cached_objects(dir) != objects) {
+        printf("Compiling the same pipeline again added to the JIT cache\n");
+        return -1;
+    }
+
+    // A different pipeline must not hit the cache.
+    Var x("x"), y("y");
+    Func h("g");
+    h(x, y) = in(x, y) + 1;
+    Buffer<int> out = h.realize(64, 32);
+    if (out(3, 4) != in(3, 4) + 1) {
+        printf("Wrong result from a different pipeline\n");
+        return -1;
+    }
+    if (count_cached_objects(dir) != objects + 1) {
+        printf("A different pipeline was not compiled separately\n");
+        return -1;
+    }
+    objects++;
+
+    // Pipelines that differ only in a float constant must not share a
+    // cache entry, even when the constants print the same.
+    if (!run_in_child("scaled_a")) {
+        printf("Scaled pipeline failed in child process\n");
+        return -1;
+    }
+    int scaled_objects = count_cached_objects(dir);
+    if (scaled_objects == objects) {
+        printf("Nothing was written to the JIT cache for the scaled pipeline\n");
+        return -1;
+    }
+    if (!run_in_child("scaled_a") ||
+        count_cached_objects(dir) != scaled_objects) {
+        printf("Compiling the same scaled pipeline again added to the JIT cache\n");
+        return -1;
+    }
+    if (!run_in_child("scaled_b")) {
+        printf("Pipeline with a different float constant computed the wrong result\n");
+        return -1;
+    }
+    if (count_cached_objects(dir) != scaled_objects + 1) {
+        printf("Pipelines differing only in a float constant shared a cache entry\n");
+        return -1;
+    }
+
+    unsetenv("HL_JIT_CACHE_DIR");
+    remove_dir(dir);
+#endif
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,83 @@
+#include "Halide.h"
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+
+using namespace Halide;
+
+std::string read_file(const std::string &filename) {
+    std::ifstream f(filename);
+    std::stringstream contents;
+    contents << f.rdbuf();
+    return contents.str();
+}
+
+int count_occurrences(const std::string &haystack, const std::string &needle) {
+    int count = 0;
+    for (size_t pos = haystack.find(needle); pos != std::string::npos; pos = haystack.find(needle, pos + 1)) {
+        count++;
+    }
+    return count;
+}
+
+int main(int argc, char **argv) {
+    Var x("x"), y("y");
+    Func f("f"), g("g");
+    f(x, y) = x + y;
+    g(x, y) = f(x, y) + f(x + 1, y);
+    f.compute_at(g, y).store_root();
+
+    std::string filename = Internal::file_make_temp("lowering_profile", ".json");
+
+    Pipeline p(g);
+    p.profile_lowering(filename);
+    p.compile_jit();
+
+    std::string profile = read_file(filename);
+    if (profile.find("\"traceEvents\"") == std::string::npos) {
+        printf("Lowering profile is not a Chrome trace:\n%s\n", profile.c_str());
+        return -1;
+    }
+    if (count_occurrences(profile, "\"name\": \"lower ") != 1) {
+        printf("Expected one lowering in the profile:\n%s\n", profile.c_str());
+        return -1;
+    }
+    const char *passes[] = {"Performing sliding window optimization",
+                            "Performing storage folding optimization",
+                            "Vectorizing",
+                            "Partitioning loops to simplify boundary conditions"};
+    for (const char *pass : passes) {
+        if (profile.find(pass) == std::string::npos) {
+            printf("Pass \"%s\" is missing from the lowering profile:\n%s\n", pass, profile.c_str());
+            return -1;
+        }
+    }
+    // Only the work done before the initial loop nest is created
+    // should have no IR to count.
+    if (count_occurrences(profile, "\"ir_nodes_after\": 0,") != 1) {
+        printf("Passes reported empty IR:\n%s\n", profile.c_str());
+        return -1;
+    }
+
+    // Lowering again appends to the same profile.
+    p.invalidate_cache();
+    p.compile_jit();
+    profile = read_file(filename);
+    if (count_occurrences(profile, "\"name\": \"lower ") != 2) {
+        printf("Expected two lowerings in the profile:\n%s\n", profile.c_str());
+        return -1;
+    }
+
+    // Turning profiling off leaves the file alone.
+    p.profile_lowering("");
+    p.compile_jit();
+    if (read_file(filename) != profile) {
+        printf("Profile was written after profiling was turned off\n");
+        return -1;
+    }
+
+    Internal::file_unlink(filename);
+
+    printf("Success!\n");
+    return 0;
+}
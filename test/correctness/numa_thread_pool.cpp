@@ -0,0 +1,51 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    if (get_jit_target_from_environment().arch == Target::WebAssembly) {
+        printf("[SKIP] WebAssembly JIT does not support a thread pool.\n");
+        return 0;
+    }
+
+    // The pool mode is read when the thread pool starts up, so set it
+    // before anything runs, and start from a fresh runtime anyway. On
+    // machines with a single node this is the work-stealing pool.
+    char numa_env[] = "HL_THREAD_POOL=numa";
+    putenv(numa_env);
+    Internal::JITSharedRuntime::release_all();
+
+    const int W = 2048, H = 256;
+    Func f("f"), g("g"), h("h");
+    Var x("x"), y("y"), yi("yi");
+
+    // Each row of h needs a few rows of f, computed into an allocation
+    // large enough that pool threads pinned to a node place it
+    // themselves.
+    f(x, y) = x * 3 + y;
+    g(x, y) = f(x, y - 1) + f(x, y) * 2 + f(x, y + 1);
+    h(x, y) = g(x, y) - g(x, y + 1);
+    h.split(y, y, yi, 8).parallel(y);
+    f.compute_at(h, y).store_at(h, y);
+    g.compute_at(h, y);
+    // A nested parallel loop, so that pool threads enqueue work too.
+    g.parallel(y);
+
+    for (int i = 0; i < 3; i++) {
+        Buffer<int> out = h.realize(W, H);
+        for (int yy = 0; yy < H; yy++) {
+            for (int xx = 0; xx < W; xx++) {
+                // g(x, y) = 4 * (3x + y), so h(x, y) = -4.
+                if (out(xx, yy) != -4) {
+                    printf("h(%d, %d) = %d instead of -4\n", xx, yy, out(xx, yy));
+                    return -1;
+                }
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
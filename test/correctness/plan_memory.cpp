@@ -0,0 +1,199 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <string.h>
+
+using namespace Halide;
+
+int malloc_count = 0;
+
+void *my_malloc(void *user_context, size_t x) {
+    malloc_count++;
+    void *orig = malloc(x + 32);
+    void *ptr = (void *)((((size_t)orig + 32) >> 5) << 5);
+    ((void **)ptr)[-1] = orig;
+    return ptr;
+}
+
+void my_free(void *user_context, void *ptr) {
+    free(((void **)ptr)[-1]);
+}
+
+int planned_peak = 0, unplanned_peak = 0;
+
+void my_print(void *, const char *msg) {
+    const char *line = strstr(msg, "peak heap usage:");
+    if (line) {
+        int planned = 0, unplanned = 0;
+        int val = sscanf(line, "peak heap usage: %d bytes  (%d bytes without memory planning)",
+                         &planned, &unplanned);
+        if (val >= 1) {
+            planned_peak = planned;
+            unplanned_peak = val == 2 ? unplanned : planned;
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    Target t = get_jit_target_from_environment();
+    if (t.arch == Target::WebAssembly) {
+        printf("[SKIP] WebAssembly JIT does not support set_custom_allocator().\n");
+        return 0;
+    }
+    t = t.with_feature(Target::PlanMemory);
+
+    const int W = 200, H = 100;
+    Var x("x"), y("y");
+
+    // A chain of stages, each of which only needs the previous
+    // one. Two slots are enough for all of them, so there should be a
+    // single allocation.
+    {
+        const int N = 8;
+        std::vector<Func> chain;
+        Func in("in");
+        in(x, y) = x + y;
+        chain.push_back(in);
+        for (int i = 1; i < N; i++) {
+            Func f("f" + std::to_string(i));
+            f(x, y) = chain.back()(x, y) * 2 + chain.back()(x + 1, y);
+            chain.push_back(f);
+        }
+        Func out("out");
+        out(x, y) = chain.back()(x, y);
+        for (Func f : chain) {
+            f.compute_root().vectorize(x, 8).parallel(y);
+        }
+
+        out.set_custom_allocator(my_malloc, my_free);
+        malloc_count = 0;
+        Buffer<int> result = out.realize(W, H, t);
+        if (malloc_count != 1) {
+            printf("%d allocations instead of 1\n", malloc_count);
+            return -1;
+        }
+
+        for (int yy = 0; yy < H; yy++) {
+            for (int xx = 0; xx < W; xx++) {
+                // Each stage is a binomial filter of the previous one.
+                int correct = 0, c = 1;
+                for (int k = 0; k < N; k++) {
+                    correct += c * (1 << (N - 1 - k)) * (xx + k + yy);
+                    c = c * (N - 1 - k) / (k + 1);
+                }
+                if (result(xx, yy) != correct) {
+                    printf("result(%d, %d) = %d instead of %d\n", xx, yy, result(xx, yy), correct);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    // A stage with two consumers must stay alive until both have
+    // run, and mustn't share a slot with the first of them.
+    {
+        Func a("a"), b("b"), c("c"), d("d"), out("out");
+        a(x, y) = x * y;
+        b(x, y) = a(x, y) + 1;
+        c(x, y) = b(x, y) * 3;
+        d(x, y) = a(x, y) + c(x, y);
+        out(x, y) = d(x, y) - b(x, y);
+        a.compute_root();
+        b.compute_root();
+        c.compute_root();
+        d.compute_root();
+
+        Buffer<int> result = out.realize(W, H, t);
+        for (int yy = 0; yy < H; yy++) {
+            for (int xx = 0; xx < W; xx++) {
+                int av = xx * yy, bv = av + 1, cv = bv * 3;
+                int correct = av + cv - bv;
+                if (result(xx, yy) != correct) {
+                    printf("result(%d, %d) = %d instead of %d\n", xx, yy, result(xx, yy), correct);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    // A chain that alternates between element sizes. Only stages with
+    // the same element size share a slot, so this takes a slot of each
+    // size, which is still a single allocation. The float stages are
+    // vectorized wider than a cache line.
+    {
+        const int N = 8;
+        std::vector<Func> chain;
+        Func in("in");
+        in(x, y) = cast<uint8_t>(x + y);
+        chain.push_back(in);
+        for (int i = 1; i < N; i++) {
+            Func f("g" + std::to_string(i));
+            Expr a = cast<float>(chain.back()(x, y)), b = cast<float>(chain.back()(x + 1, y));
+            f(x, y) = (i % 2) ? a + b : cast<uint8_t>(a / 4 + b / 4);
+            chain.push_back(f);
+        }
+        Func out("out");
+        out(x, y) = cast<int>(chain.back()(x, y));
+        for (Func f : chain) {
+            f.compute_root().vectorize(x, 32);
+        }
+
+        out.set_custom_allocator(my_malloc, my_free);
+        malloc_count = 0;
+        Buffer<int> result = out.realize(W, H, t);
+        if (malloc_count != 1) {
+            printf("%d allocations instead of 1\n", malloc_count);
+            return -1;
+        }
+
+        for (int yy = 0; yy < H; yy++) {
+            for (int xx = 0; xx < W; xx++) {
+                // The same chain in C.
+                float v[N + 1];
+                for (int k = 0; k <= N; k++) {
+                    v[k] = (uint8_t)(xx + k + yy);
+                }
+                for (int i = 1; i < N; i++) {
+                    for (int k = 0; k + i <= N; k++) {
+                        v[k] = (i % 2) ? v[k] + v[k + 1] : (float)(uint8_t)(v[k] / 4 + v[k + 1] / 4);
+                    }
+                }
+                int correct = (int)v[0];
+                if (result(xx, yy) != correct) {
+                    printf("result(%d, %d) = %d instead of %d\n", xx, yy, result(xx, yy), correct);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    // The profiler should report the peak both with and without
+    // planning. The chain of eight stages is packed into two slots.
+    {
+        const int N = 8;
+        std::vector<Func> chain;
+        Func in("in");
+        in(x, y) = x + y;
+        chain.push_back(in);
+        for (int i = 1; i < N; i++) {
+            Func f("f" + std::to_string(i));
+            f(x, y) = chain.back()(x, y) + chain.back()(x + 1, y);
+            chain.push_back(f);
+        }
+        Func out("out");
+        out(x, y) = chain.back()(x, y);
+        for (Func f : chain) {
+            f.compute_root();
+        }
+
+        out.set_custom_print(my_print);
+        out.realize(W, H, t.with_feature(Target::Profile));
+        if (planned_peak == 0 || unplanned_peak < 3 * planned_peak) {
+            printf("Profiler reported a peak of %d bytes with planning and %d without\n",
+                   planned_peak, unplanned_peak);
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,136 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+size_t custom_malloc_size = 0;
+
+void *my_malloc(void *user_context, size_t x) {
+    custom_malloc_size = x;
+    void *orig = malloc(x + 32);
+    void *ptr = (void *)((((size_t)orig + 32) >> 5) << 5);
+    ((void **)ptr)[-1] = orig;
+    return ptr;
+}
+
+void my_free(void *user_context, void *ptr) {
+    free(((void **)ptr)[-1]);
+}
+
+// Check that the index math for accesses to the ring buffer has no
+// modulo in it.
+class CheckNoMod : public IRMutator {
+    const std::string name;
+
+    class HasMod : public IRVisitor {
+        using IRVisitor::visit;
+        void visit(const Mod *op) override {
+            result = true;
+        }
+
+    public:
+        bool result = false;
+    };
+
+    bool has_mod(const Expr &e) {
+        HasMod h;
+        e.accept(&h);
+        return h.result;
+    }
+
+public:
+    using IRMutator::mutate;
+
+    Expr mutate(const Expr &e) override {
+        const Load *op = e.as<Load>();
+        if (op && op->name == name && has_mod(op->index)) {
+            printf("Load from %s uses a modulo\n", name.c_str());
+            exit(-1);
+        }
+        return IRMutator::mutate(e);
+    }
+
+    Stmt mutate(const Stmt &s) override {
+        const Store *op = s.as<Store>();
+        if (op && op->name == name && has_mod(op->index)) {
+            printf("Store to %s uses a modulo\n", name.c_str());
+            exit(-1);
+        }
+        return IRMutator::mutate(s);
+    }
+
+    CheckNoMod(const std::string &n) : name(n) {}
+};
+
+int check(const Buffer<int> &result) {
+    for (int y = 0; y < result.height(); y++) {
+        for (int x = 0; x < result.width(); x++) {
+            int correct = (x * y + 3) * 2 + (x + 1) * y + 3;
+            if (result(x, y) != correct) {
+                printf("result(%d, %d) = %d instead of %d\n", x, y, result(x, y), correct);
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (get_jit_target_from_environment().arch == Target::WebAssembly) {
+        printf("[SKIP] WebAssembly JIT does not support set_custom_allocator().\n");
+        return 0;
+    }
+
+    const int W = 100, H = 50;
+    Var x("x"), y("y");
+
+    for (bool async : {false, true}) {
+        for (int slots : {1, 2, 3}) {
+            Func f("f"), g("g");
+            g(x, y) = x * y + 3;
+            f(x, y) = g(x, y) * 2 + g(x + 1, y);
+
+            g.compute_at(f, y).store_root().ring_buffer(slots);
+            if (async) {
+                g.async();
+            }
+
+            f.add_custom_lowering_pass(new CheckNoMod("g"));
+            f.set_custom_allocator(my_malloc, my_free);
+            custom_malloc_size = 0;
+            Buffer<int> result = f.realize(W, H);
+            if (check(result) != 0) {
+                return -1;
+            }
+
+            // One row of g per slot.
+            size_t expected_size = (W + 1) * slots * sizeof(int) + sizeof(int);
+            if (custom_malloc_size != expected_size) {
+                printf("Scratch space allocated was %d instead of %d\n",
+                       (int)custom_malloc_size, (int)expected_size);
+                return -1;
+            }
+        }
+    }
+
+    // Slots per tile, with the ring buffer continuing across rows of
+    // tiles.
+    {
+        Func f("f"), g("g");
+        g(x, y) = x * y + 3;
+        f(x, y) = g(x, y) * 2 + g(x + 1, y);
+
+        Var xo, yo, xi, yi;
+        f.tile(x, y, xo, yo, xi, yi, 16, 8);
+        g.compute_at(f, xo).store_root().async().ring_buffer(3).vectorize(x, 4);
+
+        Buffer<int> result = f.realize(W, H);
+        if (check(result) != 0) {
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,59 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+// The runtime's C++ modules are linked once per distinct set and the
+// result is reused by later compilations in the same process. Compile
+// the same pipeline for targets that share that set but differ in
+// their features, back to back, and check that each of them computes
+// the right thing.
+int check(const Target &target) {
+    const int W = 256, H = 64;
+    Func f("f");
+    Var x("x"), y("y");
+    f(x, y) = cast<uint8_t>(x * 3 + y) / 2 + cast<uint8_t>(y);
+    f.vectorize(x, 16).parallel(y);
+
+    Buffer<uint8_t> out = f.realize(W, H, target);
+    for (int yy = 0; yy < H; yy++) {
+        for (int xx = 0; xx < W; xx++) {
+            uint8_t correct = (uint8_t)((uint8_t)(xx * 3 + yy) / 2 + (uint8_t)yy);
+            if (out(xx, yy) != correct) {
+                printf("out(%d, %d) = %d instead of %d for %s\n",
+                       xx, yy, out(xx, yy), correct, target.to_string().c_str());
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    Target host = get_jit_target_from_environment();
+
+    std::vector<Target> targets;
+    targets.push_back(host);
+    if (host.arch == Target::X86) {
+        // The same OS and bits with at most SSE4.1 uses different
+        // hand-written modules alongside the same cached C++ ones.
+        Target sse41(host.os, host.arch, host.bits);
+        if (host.has_feature(Target::SSE41)) {
+            sse41.set_feature(Target::SSE41);
+        }
+        targets.push_back(sse41);
+    } else {
+        targets.push_back(host.with_feature(Target::NoAsserts));
+    }
+    // And back to the first target.
+    targets.push_back(host);
+
+    for (const Target &t : targets) {
+        if (check(t) != 0) {
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -42,11 +42,32 @@ struct Task {
     Expr expr;
 };
 
+// Finds a call to an inline reduction (e.g. one made by sum()).
+class HasInlineReduction : public Internal::IRVisitor {
+    using Internal::IRVisitor::visit;
+    void visit(const Internal::Call *op) override {
+        if (op->call_type == Internal::Call::Halide) {
+            Internal::Function f(op->func);
+            if (f.has_update_definition()) {
+                inline_reduction = f;
+                result = true;
+            }
+        }
+        IRVisitor::visit(op);
+    }
+
+public:
+    Internal::Function inline_reduction;
+    bool result = false;
+};
+
 size_t num_threads = Halide::Internal::ThreadPool<void>::num_processors_online();
 
 struct Test {
     bool use_avx2{false};
     bool use_avx512{false};
+    bool use_avx512_vnni{false};
+    bool use_avx512_bf16{false};
     bool use_avx{false};
     bool use_power_arch_2_07{false};
     bool use_sse41{false};
@@ -87,6 +108,9 @@ struct Test {
         if (target.has_feature(Target::AVX512) && !use_avx512) {
             std::cerr << "Warning: This test is only configured for the skylake variant of avx512. Expect failures\n";
         }
+        use_avx512_bf16 = target.has_feature(Target::AVX512_SapphireRapids);
+        use_avx512_vnni = use_avx512_bf16 || target.has_feature(Target::AVX512_Cascadelake);
+        use_avx512 = use_avx512 || use_avx512_vnni;
         use_avx2 = use_avx512 || (target.has_feature(Target::AVX512) || target.has_feature(Target::AVX2));
         use_avx = use_avx2 || target.has_feature(Target::AVX);
         use_sse41 = use_avx || target.has_feature(Target::SSE41);
@@ -120,6 +144,8 @@ struct Test {
         // compiled code and the host in order to run the code.
         for (Target::Feature f : {Target::SSE41, Target::AVX,
                     Target::AVX2, Target::AVX512,
+                    Target::AVX512_Cascadelake, Target::AVX512_SapphireRapids,
+                    Target::ARMDotProd, Target::ARMFp16,
                     Target::FMA, Target::FMA4, Target::F16C,
                     Target::VSX, Target::POWER_ARCH_2_07,
                     Target::ARMv7s, Target::NoNEON, Target::MinGW,
@@ -186,6 +212,19 @@ struct Test {
         f_scalar.bound(x, 0, W);
         f_scalar.compute_root();
 
+        // Vectorize any inline reduction across its reduction domain,
+        // and give the scalar version its own copy of it.
+        HasInlineReduction has_inline_reduction;
+        e.accept(&has_inline_reduction);
+        if (has_inline_reduction.result) {
+            Func g(has_inline_reduction.inline_reduction);
+            g.clone_in(f_scalar);
+            g.compute_at(f, x)
+                .update()
+                .allow_race_conditions()
+                .vectorize(g.rvars()[0]);
+        }
+
         // The output to the pipeline is the maximum absolute difference as a double.
         RDom r(0, W, 0, H);
         Func error("error_" + name);
@@ -496,6 +535,15 @@ struct Test {
             check(check_pmaddwd, 2*w, i32(i16_1) * 3 - i32(i16_2) * 4);
         }
 
+        // Sums of absolute differences of bytes, vectorized across the
+        // sum.
+        {
+            RDom r(0, 16);
+            Expr u8_r = in_u8(16 * x + r), u8_s = in_u8(16 * x + r + 32);
+            check("psadbw", 8, sum(u16(absd(u8_r, u8_s))));
+            check("psadbw", 8, sum(u32(absd(u8_r, u8_s))));
+        }
+
         // llvm doesn't distinguish between signed and unsigned multiplies
         //check("pmuldq", 4, i64(i32_1) * i64(i32_2));
 
@@ -694,6 +742,23 @@ struct Test {
             check("vreducepd", 8, f64_1 - trunc(f64_1*8)/8);
 #endif
         }
+        if (use_avx512_vnni) {
+            // Sums of 64 products, vectorized across the sum.
+            RDom r(0, 64);
+            Expr u8_r = in_u8(64 * x + r), i8_r = in_i8(64 * x + r);
+            Expr i16_r = in_i16(64 * x + r), i16_s = in_i16(64 * x + r + 32);
+            check("vpdpbusd", 8, sum(i32(u8_r) * i32(i8_r)));
+            check("vpdpbusd", 8, sum(i32(i8_r) * i32(u8_r)));
+            check("vpdpwssd", 8, sum(i32(i16_r) * i32(i16_s)));
+        }
+        if (use_avx512_bf16) {
+            // Small integers are exact in bfloat16, so the order of
+            // the sum doesn't matter.
+            RDom r(0, 64);
+            Expr bf16_r = cast(BFloat(16), f32(in_i8(64 * x + r)));
+            Expr bf16_s = cast(BFloat(16), f32(in_i8(64 * x + r + 32)));
+            check("vdpbf16ps", 8, sum(f32(bf16_r) * f32(bf16_s)));
+        }
         if (use_avx512) {
             check("vpabsq", 8, abs(i64_1));
             check("vpmaxuq", 8, max(u64_1, u64_2));
@@ -1480,6 +1545,23 @@ struct Test {
         // Interleave or deinterleave two vectors. Given that we use
         // interleaving loads and stores, it's hard to hit this op with
         // halide.
+
+        // ARMv8.2-a dot products, vectorized across the sum.
+        if (!arm32 && target.has_feature(Target::ARMDotProd)) {
+            RDom r(0, 16);
+            Expr u8_r = in_u8(16 * x + r), i8_r = in_i8(16 * x + r);
+            Expr u8_s = in_u8(16 * x + r + 32), i8_s = in_i8(16 * x + r + 32);
+            check("udot", 8, sum(u32(u8_r) * u8_s));
+            check("udot", 8, sum(i32(u8_r) * i32(u8_s)));
+            check("sdot", 8, sum(i32(i8_r) * i32(i8_s)));
+        }
+
+        // ARMv8.2-a half-precision arithmetic.
+        if (!arm32 && target.has_feature(Target::ARMFp16)) {
+            Expr f16_1 = cast(Float(16), f32_1), f16_2 = cast(Float(16), f32_2);
+            check("fadd*.8h", 8, f16_1 + f16_2);
+            check("fmul*.8h", 8, f16_1 * f16_2);
+        }
     }
 
     void check_hvx_all() {
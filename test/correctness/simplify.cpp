@@ -582,6 +582,18 @@ void check_vectors() {
         Stmt stmt = Store::make("f", value, index, Parameter(), pred, ModulusRemainder());
         check(stmt, Evaluate::make(0));
     }
+
+    {
+        // The sum of the lanes of an unsigned vector may wrap, so it
+        // isn't bounded by the bounds of each lane.
+        Expr load = Load::make(UInt(8, 8), "buf", ramp(x, 1, 8), Buffer<>(), Parameter(), const_true(8), ModulusRemainder());
+        Expr sum = VectorReduce::make(VectorReduce::Add, cast(UInt(32, 8), load), 1);
+        Expr cmp = simplify(sum < make_const(UInt(32), 256));
+        if (is_const(cmp)) {
+            std::cerr << "Comparison of a uint32 sum of lanes was folded to " << cmp << "\n";
+            abort();
+        }
+    }
 }
 
 void check_bounds() {
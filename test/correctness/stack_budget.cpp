@@ -0,0 +1,139 @@
+#include "Halide.h"
+#include <atomic>
+#include <stdio.h>
+
+using namespace Halide;
+
+std::atomic<int> malloc_count;
+
+void *my_malloc(void *user_context, size_t x) {
+    malloc_count++;
+    void *orig = malloc(x + 32);
+    void *ptr = (void *)((((size_t)orig + 32) >> 5) << 5);
+    ((void **)ptr)[-1] = orig;
+    return ptr;
+}
+
+void my_free(void *user_context, void *ptr) {
+    free(((void **)ptr)[-1]);
+}
+
+int check(const Buffer<int> &result, int k) {
+    for (int y = 0; y < result.height(); y++) {
+        for (int x = 0; x < result.width(); x++) {
+            int correct = 0;
+            for (int i = 0; i < k; i++) {
+                correct += x + i + y;
+            }
+            if (result(x, y) != correct) {
+                printf("result(%d, %d) = %d instead of %d\n", x, y, result(x, y), correct);
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    Target t = get_jit_target_from_environment();
+    if (t.arch == Target::WebAssembly) {
+        printf("[SKIP] WebAssembly JIT does not support set_custom_allocator().\n");
+        return 0;
+    }
+    t.stack_budget = 64 * 1024;
+
+    const int W = 32, H = 16;
+    Var x("x"), y("y");
+
+    // The size of g depends on a Param. Without a range on the Param,
+    // g has no constant bound and stays on the heap. With one, g goes
+    // on the stack, and the thread pool only reserves what it needs.
+    for (bool bounded : {false, true}) {
+        Param<int> k;
+        if (bounded) {
+            k.set_range(0, 64);
+        }
+        Func f("f"), g("g");
+        RDom r(0, k);
+        g(x, y) = x + y;
+        f(x, y) = 0;
+        f(x, y) += g(x + r, y);
+        f.bound(x, 0, W);
+        f.update().parallel(y);
+        g.compute_at(f, y);
+        f.set_custom_allocator(my_malloc, my_free);
+
+        k.set(18);
+        malloc_count = 0;
+        Buffer<int> result = f.realize(W, H, t);
+        if (check(result, 18) != 0) {
+            return -1;
+        }
+        int expected = bounded ? 0 : H;
+        if (malloc_count != expected) {
+            printf("%d allocations instead of %d when k is %s\n",
+                   (int)malloc_count, expected, bounded ? "bounded" : "unbounded");
+            return -1;
+        }
+    }
+
+    // A constant-sized allocation larger than the default stack
+    // limit, but within the budget, goes on the stack.
+    {
+        const int K = 8 * 1024;
+        Func f("f"), g("g");
+        RDom r(0, K);
+        g(x, y) = x + y;
+        f(x, y) = 0;
+        f(x, y) += g(x + r, y);
+        f.bound(x, 0, W);
+        f.update().parallel(y);
+        g.compute_at(f, y);
+        f.set_custom_allocator(my_malloc, my_free);
+
+        malloc_count = 0;
+        Buffer<int> result = f.realize(W, H, t);
+        if (check(result, K) != 0) {
+            return -1;
+        }
+        if (malloc_count != 0) {
+            printf("%d allocations instead of 0 for a constant-sized allocation\n", (int)malloc_count);
+            return -1;
+        }
+    }
+
+    // Sibling allocations all live in the task's stack frame at once,
+    // so they share the budget. Only one of these 40k allocations can
+    // go on the stack.
+    {
+        const int K = 10 * 1024;
+        Func a("a"), b("b"), g("g"), h("h"), out("out");
+        RDom r(0, K);
+        g(x, y) = x + y;
+        h(x, y) = cast<float>(x + y);
+        a(x, y) = 0;
+        a(x, y) += g(x + r, y);
+        b(x, y) = 0;
+        b(x, y) += cast<int>(h(x + r, y));
+        out(x, y) = (a(x, y) + b(x, y)) / 2;
+        out.parallel(y);
+        a.compute_at(out, y);
+        b.compute_at(out, y);
+        g.compute_at(a, y);
+        h.compute_at(b, y);
+        out.set_custom_allocator(my_malloc, my_free);
+
+        malloc_count = 0;
+        Buffer<int> result = out.realize(W, H, t);
+        if (check(result, K) != 0) {
+            return -1;
+        }
+        if (malloc_count != H) {
+            printf("%d allocations instead of %d for sibling allocations\n", (int)malloc_count, H);
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
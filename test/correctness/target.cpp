@@ -200,6 +200,38 @@ int main(int argc, char **argv) {
        return -1;
     }
 
+    // vector_bits is only accepted if Halide's LLVM can generate SVE
+    // code for a known vector length.
+    if (Target::validate_target_string("arm-64-linux-sve2-vector_bits_512")) {
+        t1 = Target("arm-64-linux-sve2-vector_bits_512");
+        ts = t1.to_string();
+        if (t1.vector_bits != 512 || ts != "arm-64-linux-sve2-vector_bits_512") {
+           printf("vector_bits failure: %s\n", ts.c_str());
+           return -1;
+        }
+        if (t1.natural_vector_size<float>() != 16) {
+           printf("SVE natural_vector_size failure: %d\n", t1.natural_vector_size<float>());
+           return -1;
+        }
+    } else {
+        printf("vector_bits is not supported by this build of Halide\n");
+    }
+    if (Target::validate_target_string("arm-64-linux-sve-vector_bits_96")) {
+       printf("vector_bits_96 should not be a valid target\n");
+       return -1;
+    }
+
+    t1 = Target("x86-64-linux-avx2-stack_budget_65536");
+    ts = t1.to_string();
+    if (t1.stack_budget != 65536 || ts != "x86-64-linux-avx2-stack_budget_65536") {
+       printf("stack_budget failure: %s\n", ts.c_str());
+       return -1;
+    }
+    if (Target::validate_target_string("x86-64-linux-stack_budget_0")) {
+       printf("stack_budget_0 should not be a valid target\n");
+       return -1;
+    }
+
     printf("Success!\n");
     return 0;
 }
@@ -0,0 +1,182 @@
+#include "Halide.h"
+#include "util/HalideTraceUtils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+const int W = 200, H = 200;
+
+// Check the decoder on a block made by hand, including a match that
+// overlaps its own output.
+int check_lz4_decoder() {
+    const uint8_t block[] = {0x35, 'a', 'b', 'c', 3, 0,
+                             0x50, 'd', 'e', 'f', 'g', 'h'};
+    const char *correct = "abcabcabcabcdefgh";
+    uint8_t out[17];
+    if (!lz4_decompress(block, sizeof(block), out, sizeof(out)) ||
+        memcmp(out, correct, sizeof(out)) != 0) {
+        printf("Failed to decompress a hand-made LZ4 block\n");
+        return -1;
+    }
+    // The wrong size, or an offset before the start, is an error.
+    uint8_t bad_offset[sizeof(block)];
+    memcpy(bad_offset, block, sizeof(block));
+    bad_offset[4] = 4;
+    if (lz4_decompress(block, sizeof(block), out, sizeof(out) - 1) ||
+        lz4_decompress(bad_offset, sizeof(bad_offset), out, sizeof(out))) {
+        printf("Decompressed a malformed LZ4 block\n");
+        return -1;
+    }
+    return 0;
+}
+
+struct ReadResult {
+    std::vector<int32_t> ids;
+    int f_stores = 0, g_stores = 0;
+};
+
+// Read every packet, checking the values of the stores.
+bool read_packets(TraceReader &reader, ReadResult *result) {
+    Packet p;
+    while (reader.next(&p)) {
+        result->ids.push_back(p.id);
+        if (p.event != halide_trace_store) {
+            continue;
+        }
+        int x = p.get_coord(0), y = p.get_coord(1);
+        int value = p.get_value_as<int>(0);
+        int correct = x + y * W;
+        if (!strcmp(p.func(), "f")) {
+            result->f_stores++;
+        } else if (!strcmp(p.func(), "g")) {
+            correct *= 2;
+            result->g_stores++;
+        }
+        if (value != correct) {
+            printf("%s(%d, %d) = %d instead of %d\n", p.func(), x, y, value, correct);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+    printf("[SKIP] Test skipped on windows due to use of setenv\n");
+    return 0;
+#else
+    if (get_jit_target_from_environment().arch == Target::WebAssembly) {
+        printf("[SKIP] WebAssembly JIT does not support tracing to a file.\n");
+        return 0;
+    }
+
+    if (check_lz4_decoder() != 0) {
+        return -1;
+    }
+
+    // The runtime compresses the trace as it writes it out.
+    std::string path = file_make_temp("tracing_compressed", ".bin");
+    file_unlink(path);
+    setenv("HL_TRACE_FILE", path.c_str(), 1);
+    setenv("HL_TRACE_COMPRESS", "1", 1);
+
+    Var x("x"), y("y");
+    Func f("f"), g("g");
+    f(x, y) = x + y * W;
+    g(x, y) = f(x, y) * 2;
+    f.compute_root().parallel(y).trace_stores();
+    g.parallel(y).trace_stores();
+    g.realize(W, H);
+
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file) {
+        printf("Couldn't open %s\n", path.c_str());
+        return -1;
+    }
+
+    // Read the file in order, as a stream would be.
+    ReadResult unindexed;
+    {
+        TraceReader reader(file, 2);
+        if (!read_packets(reader, &unindexed)) {
+            return -1;
+        }
+    }
+    if (unindexed.f_stores != W * H || unindexed.g_stores != W * H) {
+        printf("%d stores to f and %d stores to g instead of %d each\n",
+               unindexed.f_stores, unindexed.g_stores, W * H);
+        return -1;
+    }
+    for (size_t i = 1; i < unindexed.ids.size(); i++) {
+        if (unindexed.ids[i] != unindexed.ids[i - 1] + 1) {
+            printf("Packet %d has id %d after id %d\n",
+                   (int)i, unindexed.ids[i], unindexed.ids[i - 1]);
+            return -1;
+        }
+    }
+
+    // Index the blocks and decode them in parallel. The packets
+    // should be the same.
+    rewind(file);
+    ReadResult indexed;
+    uint64_t compressed_size = 0, uncompressed_size = 0;
+    {
+        TraceReader reader(file, 2);
+        if (!reader.index() || reader.blocks().size() < 2) {
+            printf("Couldn't index the blocks of the trace\n");
+            return -1;
+        }
+        for (const TraceBlock &block : reader.blocks()) {
+            compressed_size += block.header.compressed_size;
+            uncompressed_size += block.header.uncompressed_size;
+        }
+        if (!read_packets(reader, &indexed)) {
+            return -1;
+        }
+    }
+    if (indexed.ids != unindexed.ids) {
+        printf("Indexed read found different packets\n");
+        return -1;
+    }
+    if (compressed_size * 2 > uncompressed_size) {
+        printf("Trace only compressed from %d to %d bytes\n",
+               (int)uncompressed_size, (int)compressed_size);
+        return -1;
+    }
+
+    // With a filter on the index, only blocks with stores to g are
+    // decoded. f is computed first, so the early blocks are skipped.
+    rewind(file);
+    ReadResult filtered;
+    {
+        TraceReader reader(file, 2);
+        if (!reader.index()) {
+            printf("Couldn't index the blocks of the trace\n");
+            return -1;
+        }
+        uint32_t g_hash = trace_func_hash("g");
+        reader.set_block_filter([=](const TraceBlock &block) {
+            return block.contains(g_hash, halide_trace_store);
+        });
+        if (!read_packets(reader, &filtered)) {
+            return -1;
+        }
+    }
+    if (filtered.g_stores != W * H || filtered.ids.size() >= indexed.ids.size()) {
+        printf("Filtered read found %d stores to g in %d packets, out of %d\n",
+               filtered.g_stores, (int)filtered.ids.size(), (int)indexed.ids.size());
+        return -1;
+    }
+
+    fclose(file);
+    file_unlink(path);
+    unsetenv("HL_TRACE_FILE");
+    unsetenv("HL_TRACE_COMPRESS");
+
+    printf("Success!\n");
+    return 0;
+#endif
+}
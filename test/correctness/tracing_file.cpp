@@ -0,0 +1,79 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+    printf("[SKIP] Test skipped on windows due to use of setenv\n");
+    return 0;
+#else
+    if (get_jit_target_from_environment().arch == Target::WebAssembly) {
+        printf("[SKIP] WebAssembly JIT does not support tracing to a file.\n");
+        return 0;
+    }
+
+    std::string path = Internal::file_make_temp("tracing_file", ".bin");
+    Internal::file_unlink(path);
+    setenv("HL_TRACE_FILE", path.c_str(), 1);
+
+    // Many threads write packets at once, into their own parts of the
+    // trace buffer, which are merged back into one stream as they're
+    // written out.
+    const int W = 256, H = 256;
+    Var x("x"), y("y");
+    Func f("f"), g("g");
+    f(x, y) = x + y;
+    g(x, y) = f(x, y) + f(x + 1, y);
+    f.compute_root().parallel(y).trace_stores().trace_loads();
+    g.parallel(y).trace_stores();
+    g.realize(W, H);
+
+    std::vector<char> contents = Internal::read_entire_file(path);
+    Internal::file_unlink(path);
+    unsetenv("HL_TRACE_FILE");
+
+    // The ids of the packets should be consecutive, so none are
+    // missing or out of order, and the stores and loads all there.
+    int packets = 0, loads = 0, stores = 0;
+    int32_t last_id = 0;
+    halide_trace_event_code_t last_event = halide_trace_load;
+    size_t offset = 0;
+    while (offset + sizeof(halide_trace_packet_t) <= contents.size()) {
+        const halide_trace_packet_t *p = (const halide_trace_packet_t *)(contents.data() + offset);
+        if (p->size < sizeof(halide_trace_packet_t) || offset + p->size > contents.size()) {
+            printf("Bad packet size %u at offset %d\n", p->size, (int)offset);
+            return -1;
+        }
+        if (packets > 0 && p->id != last_id + 1) {
+            printf("Packet %d has id %d after id %d\n", packets, p->id, last_id);
+            return -1;
+        }
+        loads += (p->event == halide_trace_load);
+        stores += (p->event == halide_trace_store);
+        last_id = p->id;
+        last_event = p->event;
+        packets++;
+        offset += p->size;
+    }
+    if (offset != contents.size()) {
+        printf("Trace file ends with a partial packet\n");
+        return -1;
+    }
+    if (last_event != halide_trace_end_pipeline) {
+        printf("Last packet is event %d rather than the end of the pipeline\n", (int)last_event);
+        return -1;
+    }
+    const int correct_stores = (W + 1) * H + W * H;
+    const int correct_loads = 2 * W * H;
+    if (stores != correct_stores || loads != correct_loads) {
+        printf("%d stores and %d loads instead of %d and %d\n",
+               stores, loads, correct_stores, correct_loads);
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+#endif
+}
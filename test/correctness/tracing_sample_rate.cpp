@@ -0,0 +1,81 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace Halide;
+
+const int rate = 10;
+
+int all_loads_and_stores = 0, all_other_events = 0;
+
+int count_all(void *, const halide_trace_event_t *e) {
+    if (e->event == halide_trace_load || e->event == halide_trace_store) {
+        all_loads_and_stores++;
+    } else {
+        all_other_events++;
+    }
+    return 0;
+}
+
+int sampled_loads_and_stores = 0, sampled_other_events = 0;
+
+void count_sampled(void *, const char *msg) {
+    if (!strncmp(msg, "Load ", 5) || !strncmp(msg, "Store ", 6)) {
+        sampled_loads_and_stores++;
+    } else {
+        sampled_other_events++;
+    }
+}
+
+Func make_pipeline() {
+    Var x("x"), y("y");
+    Func f("f"), g("g");
+    f(x, y) = x + y;
+    g(x, y) = f(x, y) + f(x + 1, y);
+    f.compute_root().trace_stores().trace_loads().trace_realizations();
+    g.trace_stores().trace_realizations();
+    return g;
+}
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+    printf("[SKIP] Test skipped on windows due to use of setenv\n");
+    return 0;
+#else
+    // The rate is read the first time anything is traced.
+    setenv("HL_TRACE_SAMPLE_RATE", std::to_string(rate).c_str(), 1);
+    unsetenv("HL_TRACE_FILE");
+
+    const int W = 100, H = 100;
+
+    // A custom trace handler sees every event.
+    Func all = make_pipeline();
+    all.set_custom_trace(count_all);
+    all.realize(W, H);
+
+    // The default handler prints a line per event it keeps.
+    Func sampled = make_pipeline();
+    sampled.set_custom_print(count_sampled);
+    sampled.realize(W, H);
+
+    if (sampled_other_events != all_other_events) {
+        printf("%d other events with sampling instead of %d\n",
+               sampled_other_events, all_other_events);
+        return -1;
+    }
+
+    // Every rate'th load or store of each Func is kept, and each of
+    // the two Funcs may keep one extra.
+    int min_sampled = all_loads_and_stores / rate;
+    int max_sampled = min_sampled + 2;
+    if (sampled_loads_and_stores < min_sampled || sampled_loads_and_stores > max_sampled) {
+        printf("%d of %d loads and stores traced with a sample rate of %d\n",
+               sampled_loads_and_stores, all_loads_and_stores, rate);
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+#endif
+}
@@ -0,0 +1,138 @@
+#include "Halide.h"
+#include <algorithm>
+#include <cstdlib>
+#include <stdio.h>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+// Count the VectorReduce nodes in a lowered pipeline.
+class CountVectorReduces : public IRVisitor {
+    using IRVisitor::visit;
+    void visit(const VectorReduce *op) override {
+        count++;
+        IRVisitor::visit(op);
+    }
+
+public:
+    int count = 0;
+};
+
+int count_vector_reduces(Func f) {
+    Module m = f.compile_to_module({}, f.name(), get_jit_target_from_environment());
+    CountVectorReduces counter;
+    for (const LoweredFunc &lf : m.functions()) {
+        lf.body.accept(&counter);
+    }
+    return counter.count;
+}
+
+int main(int argc, char **argv) {
+    const int size = 1024;
+
+    Buffer<int16_t> a(size, 4), b(size, 4);
+    Buffer<uint8_t> u(size);
+    Buffer<int8_t> s(size);
+    for (int y = 0; y < a.height(); y++) {
+        for (int x = 0; x < a.width(); x++) {
+            a(x, y) = (int16_t)((x * 17 + y * 3) % 2001 - 1000);
+            b(x, y) = (int16_t)((x * 13 + y * 7) % 1999 - 1000);
+        }
+    }
+    for (int x = 0; x < u.width(); x++) {
+        u(x) = (uint8_t)(x * 37 + 11);
+        s(x) = (int8_t)(x * 53 + 7);
+    }
+
+    Var x("x");
+    RDom r(0, size);
+
+    for (int vector_width : {4, 8, 16, 32}) {
+        // A dot product of 16-bit values, accumulated in 32 bits.
+        Func dot("dot");
+        dot(x) = 0;
+        dot(x) += cast<int32_t>(a(r, x)) * b(r, x);
+        dot.update().allow_race_conditions().vectorize(r, vector_width);
+
+        // Horizontal sum, min, and max of bytes.
+        Func sum("sum"), lo("lo"), hi("hi");
+        sum() = cast<uint32_t>(0);
+        sum() += cast<uint32_t>(u(r));
+        sum.update().allow_race_conditions().vectorize(r, vector_width);
+        lo() = cast<uint8_t>(255);
+        lo() = min(lo(), u(r));
+        lo.update().allow_race_conditions().vectorize(r, vector_width);
+        hi() = cast<uint8_t>(0);
+        hi() = max(u(r), hi());
+        hi.update().allow_race_conditions().vectorize(r, vector_width);
+
+        // Sums of absolute differences of unsigned and signed bytes. x86
+        // uses psadbw for the unsigned one, which would get the signed
+        // one wrong.
+        Func usad("usad"), ssad("ssad");
+        usad() = cast<uint32_t>(0);
+        usad() += cast<uint32_t>(absd(u(r), u(size - 1 - r)));
+        usad.update().allow_race_conditions().vectorize(r, vector_width);
+        ssad() = cast<uint32_t>(0);
+        ssad() += cast<uint32_t>(absd(s(r), s(size - 1 - r)));
+        ssad.update().allow_race_conditions().vectorize(r, vector_width);
+
+        for (Func f : {dot, sum, lo, hi, usad, ssad}) {
+            if (count_vector_reduces(f) == 0) {
+                printf("Expected %s vectorized by %d to contain a VectorReduce node\n",
+                       f.name().c_str(), vector_width);
+                return -1;
+            }
+        }
+
+        Buffer<int32_t> dot_result = dot.realize(a.height());
+        for (int y = 0; y < a.height(); y++) {
+            int32_t correct = 0;
+            for (int i = 0; i < size; i++) {
+                correct += (int32_t)a(i, y) * b(i, y);
+            }
+            if (dot_result(y) != correct) {
+                printf("dot(%d) = %d instead of %d (vector width %d)\n",
+                       y, dot_result(y), correct, vector_width);
+                return -1;
+            }
+        }
+
+        uint32_t correct_sum = 0;
+        uint8_t correct_lo = 255, correct_hi = 0;
+        for (int i = 0; i < size; i++) {
+            correct_sum += u(i);
+            correct_lo = std::min(correct_lo, u(i));
+            correct_hi = std::max(correct_hi, u(i));
+        }
+
+        Buffer<uint32_t> sum_result = sum.realize();
+        Buffer<uint8_t> lo_result = lo.realize();
+        Buffer<uint8_t> hi_result = hi.realize();
+        if (sum_result() != correct_sum ||
+            lo_result() != correct_lo ||
+            hi_result() != correct_hi) {
+            printf("sum, min, max = %u, %d, %d instead of %u, %d, %d (vector width %d)\n",
+                   sum_result(), lo_result(), hi_result(),
+                   correct_sum, correct_lo, correct_hi, vector_width);
+            return -1;
+        }
+
+        uint32_t correct_usad = 0, correct_ssad = 0;
+        for (int i = 0; i < size; i++) {
+            correct_usad += (uint32_t)std::abs(u(i) - u(size - 1 - i));
+            correct_ssad += (uint32_t)std::abs(s(i) - s(size - 1 - i));
+        }
+        Buffer<uint32_t> usad_result = usad.realize();
+        Buffer<uint32_t> ssad_result = ssad.realize();
+        if (usad_result() != correct_usad ||
+            ssad_result() != correct_ssad) {
+            printf("sums of absolute differences = %u, %u instead of %u, %u (vector width %d)\n",
+                   usad_result(), ssad_result(), correct_usad, correct_ssad, vector_width);
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,97 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+class CountPredicatedStoreLoad : public IRMutator {
+public:
+    int store_count = 0;
+    int load_count = 0;
+
+    using IRMutator::mutate;
+
+    Expr mutate(const Expr &e) override {
+        if (const Load *op = e.as<Load>()) {
+            if (!is_one(op->predicate)) {
+                load_count++;
+            }
+        }
+        return IRMutator::mutate(e);
+    }
+
+    Stmt mutate(const Stmt &s) override {
+        if (const Store *op = s.as<Store>()) {
+            if (!is_one(op->predicate)) {
+                store_count++;
+            }
+        }
+        return IRMutator::mutate(s);
+    }
+};
+
+int main(int argc, char **argv) {
+    Target t = get_jit_target_from_environment();
+    if (t.has_gpu_feature()) {
+        printf("[SKIP] Predicated tails are only used on the host.\n");
+        return 0;
+    }
+
+    // Sizes that aren't a multiple of the vector width. The input is
+    // no larger than the output, so reading past the end of it in the
+    // tail would be caught by the bounds checks.
+    for (int w : {1, 5, 8, 13, 37}) {
+        Buffer<int> in(w);
+        for (int i = 0; i < w; i++) {
+            in(i) = i * 7 - 3;
+        }
+
+        Func f("f");
+        Var x("x");
+        f(x) = in(x) * 2 + x;
+        f.vectorize(x, 8, TailStrategy::Predicate);
+
+        CountPredicatedStoreLoad counter;
+        f.add_custom_lowering_pass(&counter, nullptr);
+        Buffer<int> result = f.realize(w);
+
+        if (w % 8 != 0 && (counter.store_count == 0 || counter.load_count == 0)) {
+            printf("Expected predicated loads and stores for w = %d, got %d stores and %d loads\n",
+                   w, counter.store_count, counter.load_count);
+            return -1;
+        }
+
+        for (int i = 0; i < w; i++) {
+            int correct = in(i) * 2 + i;
+            if (result(i) != correct) {
+                printf("f(%d) = %d instead of %d for w = %d\n", i, result(i), correct, w);
+                return -1;
+            }
+        }
+    }
+
+    // Predicate is also legal for RVars, where it must not touch
+    // values outside the reduction domain.
+    {
+        const int w = 29;
+        Func g("g");
+        Var x("x");
+        RDom r(0, w);
+        g(x) = x;
+        g(r) += 100;
+        RVar ro, ri;
+        g.update().split(r, ro, ri, 8, TailStrategy::Predicate).vectorize(ri);
+
+        Buffer<int> result = g.realize(w + 10);
+        for (int i = 0; i < w + 10; i++) {
+            int correct = i < w ? i + 100 : i;
+            if (result(i) != correct) {
+                printf("g(%d) = %d instead of %d\n", i, result(i), correct);
+                return -1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,120 @@
+#include <stdio.h>
+
+#include "HalideRuntime.h"
+#include "HalideBuffer.h"
+#include "memoize_cost.h"
+
+using namespace Halide::Runtime;
+
+namespace {
+
+const int width = 256;
+const int entry_bytes = width * sizeof(int32_t);
+
+// The cache holds this many results, and twice as many are computed.
+const int capacity = 128;
+
+const int cheap_work = 1;
+const int expensive_work = 1 << 14;
+
+int expected(int key, int work) {
+    int v = key;
+    for (int i = 0; i < work; i++) {
+        v = (v * 3 + i) & 0xffff;
+    }
+    return v;
+}
+
+// Even keys are expensive to compute, odd keys cheap.
+int work_for(int key) {
+    return (key & 1) ? cheap_work : expensive_work;
+}
+
+bool run(int key) {
+    Buffer<int32_t> out(width);
+    int work = work_for(key);
+    if (memoize_cost(key, work, out) != 0) {
+        printf("memoize_cost failed for key %d\n", key);
+        return false;
+    }
+    int correct = expected(key, work);
+    for (int x = 0; x < width; x++) {
+        if (out(x) != correct) {
+            printf("out(%d) = %d instead of %d for key %d\n", x, out(x), correct, key);
+            return false;
+        }
+    }
+    return true;
+}
+
+halide_memoization_cache_stats_t get_stats() {
+    halide_memoization_cache_stats_t stats;
+    halide_memoization_cache_get_stats(&stats);
+    return stats;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    halide_memoization_cache_set_eviction_policy(halide_memoization_cache_evict_cost_aware);
+    halide_memoization_cache_set_size(capacity * entry_bytes);
+
+    // Alternate between expensive and cheap results, computing twice
+    // as many as fit.
+    for (int key = 0; key < 2 * capacity; key++) {
+        if (!run(key)) {
+            return -1;
+        }
+    }
+
+    halide_memoization_cache_stats_t stats = get_stats();
+    printf("hits %d misses %d stores %d evictions %d entries %d size %d\n",
+           (int)stats.hits, (int)stats.misses, (int)stats.stores,
+           (int)stats.evictions, (int)stats.entries, (int)stats.current_size);
+    if (stats.hits != 0 ||
+        stats.misses != 2 * capacity ||
+        stats.stores != stats.misses ||
+        stats.evictions != capacity ||
+        stats.entries != (int32_t)(stats.stores - stats.evictions) ||
+        stats.current_size != (int64_t)stats.entries * entry_bytes ||
+        stats.max_size != capacity * entry_bytes) {
+        printf("Unexpected cache stats after filling the cache\n");
+        return -1;
+    }
+
+    // Find out which results survived, without evicting any more.
+    halide_memoization_cache_set_size(4 * capacity * entry_bytes);
+    int survivors[2] = {0, 0};
+    for (int key = 0; key < 2 * capacity; key++) {
+        uint64_t hits = get_stats().hits;
+        if (!run(key)) {
+            return -1;
+        }
+        survivors[key & 1] += (int)(get_stats().hits - hits);
+    }
+    printf("%d expensive and %d cheap results survived\n", survivors[0], survivors[1]);
+
+    // Eviction only chooses between the few least recently used
+    // entries of a shard of the cache, so some expensive results are
+    // evicted too, but far fewer.
+    if (survivors[0] + survivors[1] != capacity ||
+        survivors[0] < 2 * survivors[1]) {
+        printf("The cost-aware policy should evict cheap results first\n");
+        return -1;
+    }
+
+    stats = get_stats();
+    if (stats.hits != (uint64_t)capacity ||
+        stats.misses != 3 * capacity ||
+        stats.stores != stats.misses ||
+        stats.evictions != capacity ||
+        stats.entries != 2 * capacity) {
+        printf("Unexpected cache stats after looking up every result\n");
+        return -1;
+    }
+
+    halide_memoization_cache_cleanup();
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,31 @@
+#include "Halide.h"
+
+namespace {
+
+class MemoizeCost : public Halide::Generator<MemoizeCost> {
+public:
+    Input<int> key{"key"};
+    // How many iterations computing each value takes.
+    Input<int> work{"work"};
+
+    Output<Buffer<int32_t>> output{"output", 1};
+
+    void generate() {
+        Var x;
+        RDom r(0, work);
+        f(x) = key;
+        f(x) = (f(x) * 3 + r) & 0xffff;
+        output(x) = f(x);
+    }
+
+    void schedule() {
+        f.compute_root().memoize();
+    }
+
+private:
+    Func f{"f"};
+};
+
+}  // namespace
+
+HALIDE_REGISTER_GENERATOR(MemoizeCost, memoize_cost)
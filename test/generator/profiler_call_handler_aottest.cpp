@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "HalideRuntime.h"
+#include "HalideBuffer.h"
+#include "profiler_call_handler.h"
+
+using namespace Halide::Runtime;
+
+namespace {
+
+const int width = 10000;
+
+bool run(int offset) {
+    Buffer<int32_t> out(width);
+    if (profiler_call_handler(offset, out) != 0) {
+        printf("profiler_call_handler failed\n");
+        return false;
+    }
+    for (int x = 0; x < width; x++) {
+        int correct = 2 * (x + offset) + 1;
+        if (out(x) != correct) {
+            printf("out(%d) = %d instead of %d\n", x, out(x), correct);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool is_this_pipeline(const halide_profiler_pipeline_stats *p) {
+    return strcmp(p->name, "profiler_call_handler") == 0;
+}
+
+const halide_profiler_func_stats *find_func(const halide_profiler_pipeline_stats *p, const char *name) {
+    for (int i = 0; i < p->num_funcs; i++) {
+        if (strcmp(p->funcs[i].name, name) == 0) {
+            return p->funcs + i;
+        }
+    }
+    return nullptr;
+}
+
+int handler_calls = 0;
+bool handler_ok = true;
+
+// Each call should see the stats of that call alone.
+int check_call(void *user_context, const halide_profiler_pipeline_stats *p) {
+    handler_calls++;
+    const halide_profiler_func_stats *producer = find_func(p, "producer");
+    if (!is_this_pipeline(p) || !producer) {
+        printf("Handler called with the stats of %s\n", p->name);
+        handler_ok = false;
+    } else if (p->runs != 1 || p->num_allocs != 1 || producer->num_allocs != 1) {
+        printf("Handler saw %d runs and %d allocations instead of 1 and 1\n",
+               p->runs, p->num_allocs);
+        handler_ok = false;
+    } else if (p->memory_total < width * sizeof(int32_t)) {
+        printf("Handler saw %llu bytes allocated instead of at least %d\n",
+               (unsigned long long)p->memory_total, (int)(width * sizeof(int32_t)));
+        handler_ok = false;
+    }
+    return 0;
+}
+
+int visited_runs = 0;
+int visited_allocs = 0;
+
+int count_runs(void *user_context, const halide_profiler_pipeline_stats *p) {
+    if (is_this_pipeline(p)) {
+        visited_runs = p->runs;
+        visited_allocs = p->num_allocs;
+    }
+    return 0;
+}
+
+int stop_visiting(void *user_context, const halide_profiler_pipeline_stats *p) {
+    return 42;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    // In per-call mode, the handler sees each call, and the stats are
+    // reset after it.
+    const int per_call_runs = 5;
+    halide_set_profiler_call_handler(check_call);
+    for (int i = 0; i < per_call_runs; i++) {
+        if (!run(i)) {
+            return -1;
+        }
+    }
+    if (!handler_ok) {
+        return -1;
+    }
+    if (handler_calls != per_call_runs) {
+        printf("Handler called %d times instead of %d\n", handler_calls, per_call_runs);
+        return -1;
+    }
+
+    // Without a handler, the stats accumulate again, starting from
+    // the reset after the last call above.
+    const int cumulative_runs = 3;
+    if (halide_set_profiler_call_handler(nullptr) != check_call) {
+        printf("halide_set_profiler_call_handler didn't return the old handler\n");
+        return -1;
+    }
+    for (int i = 0; i < cumulative_runs; i++) {
+        if (!run(i)) {
+            return -1;
+        }
+    }
+    if (handler_calls != per_call_runs) {
+        printf("Handler called after being removed\n");
+        return -1;
+    }
+    if (halide_profiler_visit_pipelines(nullptr, count_runs) != 0) {
+        printf("halide_profiler_visit_pipelines failed\n");
+        return -1;
+    }
+    if (visited_runs != cumulative_runs || visited_allocs != cumulative_runs) {
+        printf("Visitor saw %d runs and %d allocations instead of %d and %d\n",
+               visited_runs, visited_allocs, cumulative_runs, cumulative_runs);
+        return -1;
+    }
+
+    // Visiting stops at, and returns, the first non-zero result.
+    if (halide_profiler_visit_pipelines(nullptr, stop_visiting) != 42) {
+        printf("halide_profiler_visit_pipelines didn't return the visitor's result\n");
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,29 @@
+#include "Halide.h"
+
+namespace {
+
+class ProfilerCallHandler : public Halide::Generator<ProfilerCallHandler> {
+public:
+    Input<int> offset{"offset"};
+
+    Output<Buffer<int32_t>> output{"output", 1};
+
+    void generate() {
+        Var x;
+        producer(x) = x + offset;
+        output(x) = producer(x) + producer(x + 1);
+    }
+
+    void schedule() {
+        // A heap allocation per call, so that the memory stats of a
+        // single call are known.
+        producer.compute_root();
+    }
+
+private:
+    Func producer{"producer"};
+};
+
+}  // namespace
+
+HALIDE_REGISTER_GENERATOR(ProfilerCallHandler, profiler_call_handler)
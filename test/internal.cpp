@@ -11,6 +11,7 @@
 #include "ModulusRemainder.h"
 #include "CSE.h"
 #include "IREquality.h"
+#include "IRHashConsing.h"
 #include "Solve.h"
 #include "Monotonic.h"
 #include "Reduction.h"
@@ -27,6 +28,7 @@ int main(int argc, const char **argv) {
     CodeGen_C::test();
     CodeGen_PyTorch::test();
     ir_equality_test();
+    hash_consing_test();
     bounds_test();
     expr_match_test();
     deinterleave_vector_test();
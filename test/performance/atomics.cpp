@@ -0,0 +1,117 @@
+#include "Halide.h"
+#include "halide_benchmark.h"
+#include <cmath>
+#include <stdio.h>
+
+using namespace Halide;
+using namespace Halide::Tools;
+
+int main(int argc, char **argv) {
+    Target t = get_jit_target_from_environment();
+    if (t.arch == Target::WebAssembly) {
+        printf("[SKIP] Performance tests are meaningless and/or misleading under WebAssembly interpreter.\n");
+        return 0;
+    }
+
+    const int W = 4096, H = 4096;
+
+    Buffer<uint8_t> in(W, H);
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            in(x, y) = rand();
+        }
+    }
+
+    Var x, u;
+    RDom r(0, W, 0, H);
+
+    // A 256-bin histogram, computed serially, with rfactor, and with
+    // atomic updates from a parallel loop.
+    Func ref("ref"), factored("factored"), atomic("atomic");
+    ref(x) = 0;
+    ref(in(r.x, r.y)) += 1;
+
+    factored(x) = 0;
+    factored(in(r.x, r.y)) += 1;
+    RVar ryo, ryi;
+    factored
+        .update()
+        .split(r.y, ryo, ryi, 16)
+        .rfactor(ryo, u)
+        .compute_root()
+        .vectorize(x, 8)
+        .update()
+        .parallel(u);
+    factored.update().vectorize(x, 8);
+
+    atomic(x) = 0;
+    atomic(in(r.x, r.y)) += 1;
+    atomic.update().atomic().parallel(r.y);
+
+    // A sum over a parallel RVar. Every iteration updates the same
+    // site, so the atomic updates are privatized per task.
+    Func sum_ref("sum_ref"), sum("sum");
+    sum_ref() = 0.0f;
+    sum_ref() += cast<float>(in(r.x, r.y));
+    sum() = 0.0f;
+    sum() += cast<float>(in(r.x, r.y));
+    sum.update().atomic().parallel(r.y);
+
+    Buffer<int> ref_result = ref.realize(256);
+    Buffer<int> factored_result = factored.realize(256);
+    Buffer<int> atomic_result = atomic.realize(256);
+    for (int i = 0; i < 256; i++) {
+        if (factored_result(i) != ref_result(i) || atomic_result(i) != ref_result(i)) {
+            printf("hist(%d): ref = %d, rfactor = %d, atomic = %d\n",
+                   i, ref_result(i), factored_result(i), atomic_result(i));
+            return -1;
+        }
+    }
+    // Each row sums to at most 4096 * 255 < 2^24, but the total
+    // doesn't, so allow for rounding in a different order.
+    Buffer<float> sum_ref_result = sum_ref.realize();
+    Buffer<float> sum_result = sum.realize();
+    if (std::abs(sum_result() - sum_ref_result()) > 1e-4f * sum_ref_result()) {
+        printf("sum = %f instead of %f\n", sum_result(), sum_ref_result());
+        return -1;
+    }
+
+    Buffer<int> result(256);
+    double t_ref = benchmark([&]() {
+        ref.realize(result);
+    });
+    double t_factored = benchmark([&]() {
+        factored.realize(result);
+    });
+    double t_atomic = benchmark([&]() {
+        atomic.realize(result);
+    });
+    Buffer<float> sum_buf = Buffer<float>::make_scalar();
+    double t_sum_ref = benchmark([&]() {
+        sum_ref.realize(sum_buf);
+    });
+    double t_sum = benchmark([&]() {
+        sum.realize(sum_buf);
+    });
+
+    double gbits = in.type().bits() * W * H / 1e9;
+
+    printf("Histogram ref: %fms, %f Gbps\n", t_ref * 1e3, gbits / t_ref);
+    printf("Histogram with rfactor: %fms, %f Gbps\n", t_factored * 1e3, gbits / t_factored);
+    printf("Histogram with atomics: %fms, %f Gbps\n", t_atomic * 1e3, gbits / t_atomic);
+    printf("Improvement over rfactor: %f\n\n", t_factored / t_atomic);
+    printf("Sum ref: %fms, %f Gbps\n", t_sum_ref * 1e3, gbits / t_sum_ref);
+    printf("Sum with atomics: %fms, %f Gbps\n", t_sum * 1e3, gbits / t_sum);
+    printf("Improvement: %f\n\n", t_sum_ref / t_sum);
+
+    // The bins are privatized per task, so the parallel loop only
+    // does atomic updates to merge them, and needs no separate
+    // intermediate like rfactor does.
+    if (t_atomic > t_factored) {
+        printf("Atomic histogram is slower than the one with rfactor\n");
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
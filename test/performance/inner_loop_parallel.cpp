@@ -13,32 +13,42 @@ int main(int argc, char **argv) {
 
     Pipeline p(f);
 
-    // Having more threads than tasks shouldn't hurt performance too much.
-    double correct_time = 0;
-
-    for (int t = 2; t <= 64; t *= 2) {
-        std::ostringstream ss;
-        ss << "HL_NUM_THREADS=" << t;
-        std::string str = ss.str();
-        char buf[32] = {0};
-        memcpy(buf, str.c_str(), str.size());
-        putenv(buf);
-        p.invalidate_cache();
-        Halide::Internal::JITSharedRuntime::release_all();
-
-        p.compile_jit();
-        // Start the thread pool without giving any hints as to the
-        // number of tasks we'll be using.
-        p.realize(t, 1);
-        double min_time = benchmark([&]() { return p.realize(2, 1000000); });
-
-        printf("%d: %f ms\n", t, min_time * 1e3);
-        if (t == 2) {
-            correct_time = min_time;
-        } else if (min_time > correct_time * 5) {
-            printf("Unacceptable overhead when using %d threads for 2 tasks: %f ms vs %f ms\n",
-                   t, min_time, correct_time);
-            return -1;
+    // Having more threads than tasks shouldn't hurt performance too
+    // much, with any of the thread pool modes.
+    // putenv keeps pointers to these, so they must outlive the loops.
+    char mode_buf[32] = {0};
+    char buf[32] = {0};
+    const char *modes[] = {"HL_THREAD_POOL=", "HL_THREAD_POOL=steal", "HL_THREAD_POOL=numa"};
+    for (const char *mode : modes) {
+        strncpy(mode_buf, mode, sizeof(mode_buf) - 1);
+        putenv(mode_buf);
+
+        double correct_time = 0;
+
+        for (int t = 2; t <= 64; t *= 2) {
+            std::ostringstream ss;
+            ss << "HL_NUM_THREADS=" << t;
+            std::string str = ss.str();
+            memset(buf, 0, sizeof(buf));
+            memcpy(buf, str.c_str(), str.size());
+            putenv(buf);
+            p.invalidate_cache();
+            Halide::Internal::JITSharedRuntime::release_all();
+
+            p.compile_jit();
+            // Start the thread pool without giving any hints as to the
+            // number of tasks we'll be using.
+            p.realize(t, 1);
+            double min_time = benchmark([&]() { return p.realize(2, 1000000); });
+
+            printf("%s %d: %f ms\n", mode, t, min_time * 1e3);
+            if (t == 2) {
+                correct_time = min_time;
+            } else if (min_time > correct_time * 5) {
+                printf("Unacceptable overhead when using %d threads for 2 tasks: %f ms vs %f ms\n",
+                       t, min_time, correct_time);
+                return -1;
+            }
         }
     }
 
@@ -1,15 +1,38 @@
 #include "Halide.h"
 #include "halide_benchmark.h"
 
+#include <atomic>
+
 using namespace Halide;
 
+// Count the heap allocations a pipeline makes.
+std::atomic<int> mallocs{0};
+
+void *counting_malloc(void *user_context, size_t x) {
+    mallocs++;
+    void *orig = malloc(x + 64);
+    void *ptr = (void *)((((size_t)orig + 64) >> 6) << 6);
+    ((void **)ptr)[-1] = orig;
+    return ptr;
+}
+
+void counting_free(void *user_context, void *ptr) {
+    free(((void **)ptr)[-1]);
+}
+
 int main(int argc, char **argv) {
     Param<int> p;
 
-    const char *names[3] = {"heap", "pseudostack", "stack"};
+    const char *names[5] = {"heap", "cached heap", "pseudostack", "stack", "hoisted heap"};
+
+    double t[5];
+    int heap_mallocs[5] = {0};
+    for (int i = 0; i < 5; i++) {
+        // The JIT runtime caches host allocations by default. Turn
+        // that off for the plain heap cases to see the cost of going
+        // to the system allocator every time.
+        Halide::Internal::JITSharedRuntime::reuse_host_allocations(i != 0 && i != 4);
 
-    double t[3];
-    for (int i = 0; i < 3; i++) {
         Var x("x");
 
         Func in;
@@ -29,10 +52,10 @@ int main(int argc, char **argv) {
         chain.back().split(x, xo, xi, p, TailStrategy::RoundUp);
         for (size_t j = 0; j < chain.size() - 1; j++) {
             chain[j].compute_at(chain.back(), xo);
-            if (i != 0) {
+            if (i >= 2) {
                 chain[j].store_in(MemoryType::Stack);
             }
-            if (i == 2) {
+            if (i == 3) {
                 chain[j].bound_extent(x, p);
             }
             // Vectorize. Otherwise llvm autovectorizes the stack version, confusing the results
@@ -42,7 +65,7 @@ int main(int argc, char **argv) {
         // they can serialize in the allocator, so we should
         // parallelize things too.
         Var xoo;
-        if (i == 2) {
+        if (i == 3) {
             chain.back().specialize(p == 200).split(xo, xoo, xo, 100, TailStrategy::RoundUp).parallel(xoo);
             chain.back().specialize_fail("Expected p == 200");
         } else {
@@ -50,21 +73,57 @@ int main(int argc, char **argv) {
         }
         chain.back().vectorize(xi, 8, TailStrategy::RoundUp);
 
+        // Alternatively, make one heap allocation per parallel task
+        // instead of one per iteration of xo.
+        if (i == 4) {
+            for (size_t j = 0; j < chain.size() - 1; j++) {
+                chain[j].hoist_storage(chain.back(), xoo);
+            }
+        }
+
         // Make it too large for llvm to promote into registers or
         // bother unrolling. We're trying to compare stack to
         // pseudostack, not stack to register.
         p.set(200);
 
         Buffer<int> out(16 * 1000 * 1000);
+
+        // Timings are noisy, so check the effect of hoisting on the
+        // number of allocations directly, with one counted run.
+        if (i == 0 || i == 4) {
+            mallocs = 0;
+            chain.back().set_custom_allocator(counting_malloc, counting_free);
+            chain.back().realize(out);
+            chain.back().set_custom_allocator(nullptr, nullptr);
+            heap_mallocs[i] = mallocs;
+        }
+
         t[i] = Halide::Tools::benchmark([&] {chain.back().realize(out);});
 
         printf("Time using %s: %f\n", names[i], t[i]);
     }
 
-    if (t[0] < t[1]) {
+    if (t[0] < t[2]) {
         printf("Heap allocation was faster than pseudostack!\n");
         return -1;
     }
 
+    if (t[1] > t[0]) {
+        printf("WARNING: Cached heap allocation was slower than uncached heap allocation\n");
+    }
+
+    // There are 100 iterations of xo per parallel task, and hoisting
+    // makes one allocation of each Func per task instead of one per
+    // iteration, so expect far fewer allocations.
+    printf("Heap allocations: %d unhoisted, %d hoisted\n", heap_mallocs[0], heap_mallocs[4]);
+    if (heap_mallocs[4] == 0 || heap_mallocs[4] * 50 > heap_mallocs[0]) {
+        printf("Hoisting storage didn't reduce the number of heap allocations enough!\n");
+        return -1;
+    }
+
+    if (t[4] > t[0]) {
+        printf("WARNING: Hoisted heap allocation was slower than unhoisted heap allocation\n");
+    }
+
     return 0;
 }
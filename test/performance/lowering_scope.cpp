@@ -0,0 +1,202 @@
+#include "Halide.h"
+#include "halide_benchmark.h"
+#include <map>
+#include <stdio.h>
+
+using namespace Halide;
+using namespace Halide::Tools;
+
+// The pipeline and CPU schedule from apps/local_laplacian, which has
+// enough stages and nested lets to make lowering time dominated by
+// the passes that walk the IR with a Scope.
+Var x("x"), y("y"), c("c"), k("k");
+
+Func downsample(Func f) {
+    Func downx, downy;
+    downx(x, y, _) = (f(2 * x - 1, y, _) + 3.0f * (f(2 * x, y, _) + f(2 * x + 1, y, _)) + f(2 * x + 2, y, _)) / 8.0f;
+    downy(x, y, _) = (downx(x, 2 * y - 1, _) + 3.0f * (downx(x, 2 * y, _) + downx(x, 2 * y + 1, _)) + downx(x, 2 * y + 2, _)) / 8.0f;
+    return downy;
+}
+
+Func upsample(Func f) {
+    Func upx, upy;
+    upx(x, y, _) = lerp(f((x / 2) - 1 + 2 * (x % 2), y, _), f(x / 2, y, _), 0.75f);
+    upy(x, y, _) = lerp(upx(x, (y / 2) - 1 + 2 * (y % 2), _), upx(x, y / 2, _), 0.75f);
+    return upy;
+}
+
+Pipeline make_local_laplacian(ImageParam input, Param<int> levels, Param<float> alpha, Param<float> beta) {
+    const int J = 8;
+
+    Func remap;
+    Expr fx = cast<float>(x) / 256.0f;
+    remap(x) = alpha * fx * exp(-fx * fx / 2.0f);
+
+    Func clamped = BoundaryConditions::repeat_edge(input);
+    Func floating;
+    floating(x, y, c) = clamped(x, y, c) / 65535.0f;
+    Func gray;
+    gray(x, y) = 0.299f * floating(x, y, 0) + 0.587f * floating(x, y, 1) + 0.114f * floating(x, y, 2);
+
+    Func gPyramid[J];
+    Expr level = k * (1.0f / (levels - 1));
+    Expr idx = gray(x, y) * cast<float>(levels - 1) * 256.0f;
+    idx = clamp(cast<int>(idx), 0, (levels - 1) * 256);
+    gPyramid[0](x, y, k) = beta * (gray(x, y) - level) + level + remap(idx - 256 * k);
+    for (int j = 1; j < J; j++) {
+        gPyramid[j](x, y, k) = downsample(gPyramid[j - 1])(x, y, k);
+    }
+
+    Func lPyramid[J];
+    lPyramid[J - 1](x, y, k) = gPyramid[J - 1](x, y, k);
+    for (int j = J - 2; j >= 0; j--) {
+        lPyramid[j](x, y, k) = gPyramid[j](x, y, k) - upsample(gPyramid[j + 1])(x, y, k);
+    }
+
+    Func inGPyramid[J];
+    inGPyramid[0](x, y) = gray(x, y);
+    for (int j = 1; j < J; j++) {
+        inGPyramid[j](x, y) = downsample(inGPyramid[j - 1])(x, y);
+    }
+
+    Func outLPyramid[J];
+    for (int j = 0; j < J; j++) {
+        Expr level = inGPyramid[j](x, y) * cast<float>(levels - 1);
+        Expr li = clamp(cast<int>(level), 0, levels - 2);
+        Expr lf = level - cast<float>(li);
+        outLPyramid[j](x, y) = (1.0f - lf) * lPyramid[j](x, y, li) + lf * lPyramid[j](x, y, li + 1);
+    }
+
+    Func outGPyramid[J];
+    outGPyramid[J - 1](x, y) = outLPyramid[J - 1](x, y);
+    for (int j = J - 2; j >= 0; j--) {
+        outGPyramid[j](x, y) = upsample(outGPyramid[j + 1])(x, y) + outLPyramid[j](x, y);
+    }
+
+    Func color;
+    float eps = 0.01f;
+    color(x, y, c) = outGPyramid[0](x, y) * (floating(x, y, c) + eps) / (gray(x, y) + eps);
+
+    Func output("local_laplacian");
+    output(x, y, c) = cast<uint16_t>(clamp(color(x, y, c), 0.0f, 1.0f) * 65535.0f);
+
+    remap.compute_root();
+    Var yo;
+    output.reorder(c, x, y).split(y, yo, y, 64).parallel(yo).vectorize(x, 8);
+    gray.compute_root().parallel(y, 32).vectorize(x, 8);
+    for (int j = 1; j < 5; j++) {
+        inGPyramid[j]
+            .compute_root()
+            .parallel(y, 32)
+            .vectorize(x, 8);
+        gPyramid[j]
+            .compute_root()
+            .reorder_storage(x, k, y)
+            .reorder(k, y)
+            .parallel(y, 8)
+            .vectorize(x, 8);
+        outGPyramid[j]
+            .store_at(output, yo)
+            .compute_at(output, y)
+            .fold_storage(y, 4)
+            .vectorize(x, 8);
+    }
+    outGPyramid[0].compute_at(output, y).vectorize(x, 8);
+    for (int j = 5; j < J; j++) {
+        inGPyramid[j].compute_root();
+        gPyramid[j].compute_root().parallel(k);
+        outGPyramid[j].compute_root();
+    }
+
+    return Pipeline(output);
+}
+
+// The std::map-backed table that Scope used to use, for comparison.
+struct MapScope {
+    std::map<std::string, std::vector<int>> table;
+    void push(const std::string &name, int value) {
+        table[name].push_back(value);
+    }
+    void pop(const std::string &name) {
+        auto iter = table.find(name);
+        iter->second.pop_back();
+        if (iter->second.empty()) {
+            table.erase(iter);
+        }
+    }
+    int get(const std::string &name) const {
+        return table.find(name)->second.back();
+    }
+};
+
+// Mimic a mutator walking a let-heavy loop nest: a few hundred outer
+// names stay bound while inner names are repeatedly bound, looked up,
+// and unbound.
+template<typename S>
+int walk_lets(S &scope, const std::vector<std::string> &outer, const std::vector<std::string> &inner) {
+    int result = 0;
+    for (size_t i = 0; i < outer.size(); i++) {
+        scope.push(outer[i], (int)i);
+    }
+    for (int iter = 0; iter < 20; iter++) {
+        for (size_t i = 0; i < inner.size(); i++) {
+            scope.push(inner[i], (int)i);
+            result += scope.get(inner[i]) + scope.get(outer[(i * 7) % outer.size()]);
+        }
+        for (size_t i = inner.size(); i > 0; i--) {
+            scope.pop(inner[i - 1]);
+        }
+    }
+    for (size_t i = 0; i < outer.size(); i++) {
+        scope.pop(outer[i]);
+    }
+    return result;
+}
+
+int main(int argc, char **argv) {
+    Target t = get_jit_target_from_environment();
+    if (t.arch == Target::WebAssembly) {
+        printf("[SKIP] Performance tests are meaningless and/or misleading under WebAssembly interpreter.\n");
+        return 0;
+    }
+
+    // Name lookups, in isolation.
+    std::vector<std::string> outer, inner;
+    for (int i = 0; i < 300; i++) {
+        outer.push_back("local_laplacian.s0.gPyramid_" + std::to_string(i) + ".y.min_realized");
+    }
+    for (int i = 0; i < 100; i++) {
+        inner.push_back("local_laplacian.s0.x.x" + std::to_string(i) + ".base");
+    }
+
+    int map_result = 0, scope_result = 0;
+    double map_time = benchmark(5, 10, [&]() {
+        MapScope scope;
+        map_result = walk_lets(scope, outer, inner);
+    });
+    double scope_time = benchmark(5, 10, [&]() {
+        Internal::Scope<int> scope;
+        scope_result = walk_lets(scope, outer, inner);
+    });
+    if (map_result != scope_result) {
+        printf("Scope lookups disagree with std::map: %d vs %d\n", scope_result, map_result);
+        return -1;
+    }
+    printf("Scope push/get/pop: %f ms (std::map: %f ms, %.2fx)\n",
+           scope_time * 1e3, map_time * 1e3, map_time / scope_time);
+
+    // Lowering of a real app.
+    ImageParam input(UInt(16), 3, "input");
+    Param<int> levels("levels");
+    Param<float> alpha("alpha"), beta("beta");
+    Pipeline p = make_local_laplacian(input, levels, alpha, beta);
+
+    double lower_time = benchmark(3, 1, [&]() {
+        p.invalidate_cache();
+        p.compile_to_module(p.infer_arguments(), "local_laplacian", t);
+    });
+    printf("Lowering local_laplacian: %f ms\n", lower_time * 1e3);
+
+    printf("Success!\n");
+    return 0;
+}
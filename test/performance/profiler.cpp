@@ -1,10 +1,20 @@
 #include "Halide.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 using namespace Halide;
 
 int percentage = 0;
 float ms = 0;
+bool hw_section = false;
+long long hw_cycles = 0;
 void my_print(void *, const char *msg) {
     float this_ms;
     int this_percentage;
@@ -13,9 +23,80 @@ void my_print(void *, const char *msg) {
         ms = this_ms;
         percentage = this_percentage;
     }
+    const char *hw = strstr(msg, " hardware counters (per run):");
+    long long this_cycles;
+    if (hw && sscanf(hw, " hardware counters (per run): cycles: %lld", &this_cycles) == 1) {
+        hw_section = true;
+        hw_cycles = this_cycles;
+    }
 }
 
-int main(int argc, char **argv) {
+// Whether this process can open the group of counters the profiler
+// uses. They're often unavailable in VMs and containers.
+bool hw_counters_available() {
+#ifdef __linux__
+    const uint64_t configs[] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES,
+    };
+    int fds[4];
+    int opened = 0;
+    for (uint64_t config : configs) {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = config;
+        attr.read_format = PERF_FORMAT_GROUP;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        int fd = syscall(SYS_perf_event_open, &attr, 0, -1, opened ? fds[0] : -1, 0UL);
+        if (fd < 0) {
+            break;
+        }
+        fds[opened++] = fd;
+    }
+    for (int i = 0; i < opened; i++) {
+        close(fds[i]);
+    }
+    return opened == 4;
+#else
+    return false;
+#endif
+}
+
+// Returns the value of the given column of the CSV row for fn13, or
+// -1 if there isn't one.
+long long csv_fn13_column(const std::string &csv, const std::string &column) {
+    size_t header_end = csv.find('\n');
+    std::string header = "," + csv.substr(0, header_end) + ",";
+    size_t column_start = header.find("," + column + ",");
+    if (header_end == std::string::npos || column_start == std::string::npos) {
+        return -1;
+    }
+    int index = 0;
+    for (size_t i = 1; i <= column_start; i++) {
+        index += (header[i] == ',');
+    }
+    size_t row = csv.find(",fn13,");
+    if (row == std::string::npos) {
+        return -1;
+    }
+    row = csv.rfind('\n', row) + 1;
+    for (int i = 0; i < index; i++) {
+        row = csv.find(',', row) + 1;
+    }
+    return atoll(csv.c_str() + row);
+}
+
+int run_test(bool use_parallel, bool use_hw_counters = false) {
+    percentage = 0;
+    ms = 0;
+    hw_section = false;
+    hw_cycles = 0;
+
     // Make a long chain of finely-interleaved Funcs, of which one is very expensive.
     Func f[30];
     Var c, x;
@@ -46,10 +127,59 @@ int main(int argc, char **argv) {
     for (int i = 0; i < 30; i++) {
         f[i].compute_at(out, x);
     }
+    if (use_parallel) {
+        // Each thread publishes its own current Func, so the time
+        // spent in fn13 on the worker threads should still be billed
+        // to fn13.
+        out.update().parallel(x);
+    }
 
     Target t = get_jit_target_from_environment().with_feature(Target::Profile);
+    std::string csv_path;
+    if (use_hw_counters) {
+        // The counters are only read at the start and end of the
+        // pipeline, so they shouldn't disturb the sampled times.
+        t = t.with_feature(Target::ProfileHW);
+        csv_path = Internal::file_make_temp("profiler_hw", ".csv");
+        Internal::file_unlink(csv_path);
+        setenv("HL_PROFILER_REPORT_FILE", csv_path.c_str(), 1);
+    }
     Buffer<float> im = out.realize(10, 1000, t);
 
+    if (use_hw_counters) {
+        std::vector<char> contents = Internal::read_entire_file(csv_path);
+        Internal::file_unlink(csv_path);
+        unsetenv("HL_PROFILER_REPORT_FILE");
+        std::string csv(contents.begin(), contents.end());
+
+        // The CSV always has the pipeline's counter columns, repeated
+        // on each row, including the one for fn13.
+        const char *columns[] = {"pipeline_cycles", "pipeline_instructions", "pipeline_ipc",
+                                 "pipeline_llc_misses", "pipeline_branch_misses"};
+        for (const char *column : columns) {
+            if (csv_fn13_column(csv, column) < 0) {
+                printf("CSV report has no %s for fn13:\n%s\n", column, csv.c_str());
+                return -1;
+            }
+        }
+
+        // The counters themselves can only be checked if the profiler
+        // could open them.
+        if (!hw_counters_available()) {
+            printf("[SKIP] Hardware counters are unavailable, not checking their values.\n");
+        } else {
+            if (!hw_section || hw_cycles <= 0) {
+                printf("Report has no hardware counters for the pipeline\n");
+                return -1;
+            }
+            if (csv_fn13_column(csv, "pipeline_cycles") <= 0 ||
+                csv_fn13_column(csv, "pipeline_instructions") <= 0) {
+                printf("CSV report has no counts for the pipeline:\n%s\n", csv.c_str());
+                return -1;
+            }
+        }
+    }
+
     //out.compile_to_assembly("/dev/stdout", {}, t.with_feature(Target::JIT));
 
     printf("Time spent in fn13: %fms\n", ms);
@@ -61,6 +191,27 @@ int main(int argc, char **argv) {
         return -1;
     }
 
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    printf("Testing serial...\n");
+    if (run_test(false) != 0) {
+        return -1;
+    }
+
+    printf("Testing parallel...\n");
+    if (run_test(true) != 0) {
+        return -1;
+    }
+
+    if (get_jit_target_from_environment().os == Target::Linux) {
+        printf("Testing with hardware counters...\n");
+        if (run_test(true, true) != 0) {
+            return -1;
+        }
+    }
+
     printf("Success!\n");
     return 0;
 }
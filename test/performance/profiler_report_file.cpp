@@ -0,0 +1,81 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace Halide;
+
+void my_print(void *, const char *msg) {
+    // Silence the text report.
+}
+
+std::string realize_and_read_report(const std::string &suffix) {
+    std::string path = Internal::file_make_temp("profiler_report", suffix);
+    Internal::file_unlink(path);
+    setenv("HL_PROFILER_REPORT_FILE", path.c_str(), 1);
+
+    Var x("x"), y("y");
+    Func producer("producer"), consumer("consumer");
+    producer(x, y) = x + y;
+    consumer(x, y) = producer(x, y) + producer(x + 1, y);
+    producer.compute_at(consumer, y);
+    consumer.set_custom_print(&my_print);
+
+    Target t = get_jit_target_from_environment().with_feature(Target::Profile);
+    consumer.realize(100, 100, t);
+    consumer.realize(100, 100, t);
+
+    std::vector<char> contents = Internal::read_entire_file(path);
+    Internal::file_unlink(path);
+    unsetenv("HL_PROFILER_REPORT_FILE");
+    return std::string(contents.begin(), contents.end());
+}
+
+int count_lines(const std::string &s) {
+    int lines = 0;
+    for (char c : s) {
+        lines += (c == '\n');
+    }
+    return lines;
+}
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+    printf("[SKIP] Test skipped on windows due to use of setenv\n");
+    return 0;
+#else
+    if (get_jit_target_from_environment().arch == Target::WebAssembly) {
+        printf("[SKIP] Performance tests are meaningless and/or misleading under WebAssembly interpreter.\n");
+        return 0;
+    }
+
+    // The JIT reports and resets after each realization, so each one
+    // appends a JSON object for the pipeline on a line of its own.
+    {
+        std::string json = realize_and_read_report(".json");
+        if (count_lines(json) != 2 ||
+            json.find("{\"pipeline\": \"consumer\"") != 0 ||
+            json.find("\"runs\": 1,") == std::string::npos ||
+            json.find("{\"name\": \"producer\"") == std::string::npos ||
+            json.find("{\"name\": \"consumer\"") == std::string::npos) {
+            printf("Unexpected JSON report:\n%s\n", json.c_str());
+            return -1;
+        }
+    }
+
+    // The CSV has a header, then a row per Func (including the
+    // overhead slot) per realization.
+    {
+        std::string csv = realize_and_read_report(".csv");
+        if (count_lines(csv) != 1 + 2 * 3 ||
+            csv.find("pipeline,func,runs,time_ns,") != 0 ||
+            csv.find("\nconsumer,producer,1,") == std::string::npos ||
+            csv.find("\nconsumer,consumer,1,") == std::string::npos) {
+            printf("Unexpected CSV report:\n%s\n", csv.c_str());
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+#endif
+}
@@ -0,0 +1,79 @@
+#include "Halide.h"
+#include "halide_benchmark.h"
+#include <stdio.h>
+
+using namespace Halide;
+using namespace Halide::Tools;
+
+int main(int argc, char **argv) {
+    Target t = get_jit_target_from_environment();
+    if (t.arch == Target::WebAssembly) {
+        printf("[SKIP] Performance tests are meaningless and/or misleading under WebAssembly interpreter.\n");
+        return 0;
+    }
+
+    // Narrow images, where the tail of each row is a large fraction
+    // of the work, as it is for small images or odd channel counts.
+    const int vec = t.natural_vector_size<float>();
+    const int H = 4096;
+
+    ImageParam in(Float(32), 2);
+    Var x("x"), y("y");
+
+    Func guarded("guarded"), predicated("predicated");
+    Expr e = sqrt(in(x, y) * 3.0f + 1.0f) * in(x, y);
+    guarded(x, y) = e;
+    predicated(x, y) = e;
+    guarded.vectorize(x, vec, TailStrategy::GuardWithIf);
+    predicated.vectorize(x, vec, TailStrategy::Predicate);
+
+    guarded.compile_jit();
+    predicated.compile_jit();
+
+    double total_guarded = 0, total_predicated = 0;
+    for (int w = 1; w <= 4 * vec; w++) {
+        Buffer<float> input(w, H);
+        input.for_each_element([&](int x, int y) {
+            input(x, y) = (float)((x * 17 + y * 3) % 100);
+        });
+        in.set(input);
+
+        Buffer<float> out_guarded(w, H), out_predicated(w, H);
+        guarded.realize(out_guarded);
+        predicated.realize(out_predicated);
+        for (int y = 0; y < H; y++) {
+            for (int x = 0; x < w; x++) {
+                if (out_guarded(x, y) != out_predicated(x, y)) {
+                    printf("predicated(%d, %d) = %f instead of %f\n",
+                           x, y, out_predicated(x, y), out_guarded(x, y));
+                    return -1;
+                }
+            }
+        }
+
+        double t_guarded = benchmark([&]() {
+            guarded.realize(out_guarded);
+        });
+        double t_predicated = benchmark([&]() {
+            predicated.realize(out_predicated);
+        });
+        total_guarded += t_guarded;
+        total_predicated += t_predicated;
+
+        printf("Width %3d: GuardWithIf %f ms, Predicate %f ms, speedup %f\n",
+               w, t_guarded * 1e3, t_predicated * 1e3, t_guarded / t_predicated);
+    }
+
+    printf("Total: GuardWithIf %f ms, Predicate %f ms, speedup %f\n",
+           total_guarded * 1e3, total_predicated * 1e3, total_guarded / total_predicated);
+
+    // Targets without cheap masked loads and stores may not win, but
+    // the predicated tail shouldn't be much worse than a scalar one.
+    if (total_predicated > total_guarded * 1.5) {
+        printf("Predicated tails are much slower than scalar ones\n");
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
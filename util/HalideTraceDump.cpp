@@ -7,6 +7,7 @@
 #include <stdint.h>
 #include <vector>
 #include <map>
+#include <set>
 #include <string>
 #include <fcntl.h>
 #include <string.h>
@@ -23,6 +24,7 @@ using namespace Halide;
 using namespace Internal;
 
 using std::map;
+using std::set;
 using std::vector;
 using std::string;
 using Halide::Runtime::Buffer;
@@ -270,13 +272,15 @@ void finish_dump(map<string, FuncInfo> &func_info, BufferOutputOpts output_opts)
 
 void usage(char * const *argv) {
     const string usage =
-        "Usage: " + string(argv[0]) + " -i trace_file -t {png,jpg,pgm,tmp,mat}\n"
+        "Usage: " + string(argv[0]) + " -i trace_file -t {png,jpg,pgm,tmp,mat} [-f func]...\n"
         "\n"
         "This tool reads a binary trace produced by Halide, and dumps all\n"
-        "Funcs into individual image files in the current directory.\n"
+        "Funcs, or those given with -f, into individual image files in the\n"
+        "current directory.\n"
         "To generate a suitable binary trace, use Func::trace_stores(), or the\n"
         "target features trace_stores and trace_realizations, and run with\n"
-        "HL_TRACE_FILE=<filename>.\n";
+        "HL_TRACE_FILE=<filename>. Traces written with HL_TRACE_COMPRESS=1 are\n"
+        "decompressed in parallel, skipping the blocks with nothing to dump.\n";
     fprintf(stderr, "%s\n", usage.c_str());
     exit(1);
 }
@@ -284,6 +288,7 @@ void usage(char * const *argv) {
 int main(int argc, char * const *argv) {
     char *buf_filename = nullptr;
     char *buf_imagetype = nullptr;
+    set<string> only_funcs;
     BufferOutputOpts outputopts;
     for (int i = 1; i < argc - 1; i++) {
         string arg = argv[i];
@@ -293,6 +298,9 @@ int main(int argc, char * const *argv) {
         } else if (arg == "-i") {
             i++;
             buf_filename = argv[i];
+        } else if (arg == "-f") {
+            i++;
+            only_funcs.insert(argv[i]);
         }
     }
 
@@ -328,13 +336,40 @@ int main(int argc, char * const *argv) {
     printf("[INFO] Starting parse of binary trace...\n");
     int packet_count = 0;
 
+    // Only loads and stores are dumped, so if the trace is made of
+    // compressed blocks, skip any blocks without them.
+    TraceReader reader(file_desc);
+    if (reader.index()) {
+        printf("[INFO] Indexed %d compressed blocks.\n", (int)reader.blocks().size());
+        vector<uint32_t> func_hashes;
+        for (const string &f : only_funcs) {
+            func_hashes.push_back(trace_func_hash(f.c_str()));
+        }
+        reader.set_block_filter([&only_funcs, func_hashes](const TraceBlock &b) {
+            if (only_funcs.empty()) {
+                return b.contains(halide_trace_store) || b.contains(halide_trace_load);
+            }
+            for (uint32_t h : func_hashes) {
+                if (b.contains(h, halide_trace_store) || b.contains(h, halide_trace_load)) {
+                    return true;
+                }
+            }
+            return false;
+        });
+    }
+
+    auto wanted = [&only_funcs](const Packet &p) {
+        return ((p.event == halide_trace_store) || (p.event == halide_trace_load)) &&
+               (only_funcs.empty() || only_funcs.count(p.func()));
+    };
+
     map<string, FuncInfo> func_info;
 
     printf("[INFO] First pass...\n");
 
     for (;;) {
         Packet p;
-        if (!p.read_from_filedesc(file_desc)) {
+        if (!reader.next(&p)) {
             printf("[INFO] Finished pass 1 after %d packets.\n", packet_count);
             break;
         }
@@ -346,7 +381,7 @@ int main(int argc, char * const *argv) {
         }
 
         // Check if this was a store packet.
-        if ( (p.event == halide_trace_store) || (p.event == halide_trace_load) ) {
+        if (wanted(p)) {
             if (func_info.find(string(p.func())) == func_info.end()) {
                 printf("[INFO] Found Func with tracked accesses: %s\n", p.func());
                 func_info[string(p.func())] = FuncInfo(&p);
@@ -356,8 +391,7 @@ int main(int argc, char * const *argv) {
     }
 
     packet_count = 0;
-    fseek(file_desc, 0, SEEK_SET);
-    if (ferror(file_desc)){
+    if (!reader.rewind() || ferror(file_desc)) {
         fprintf(stderr, "Error: couldn't seek back to beginning of trace file. Aborting.\n");
         exit(-1);
     }
@@ -368,7 +402,7 @@ int main(int argc, char * const *argv) {
 
     for (;;) {
         Packet p;
-        if (!p.read_from_filedesc(file_desc)) {
+        if (!reader.next(&p)) {
             printf("[INFO] Finished pass 2 after %d packets.\n", packet_count);
             if (file_desc != nullptr) {
                 fclose(file_desc);
@@ -384,7 +418,7 @@ int main(int argc, char * const *argv) {
         }
 
         // Check if this was a store packet.
-        if ( (p.event == halide_trace_store) || (p.event == halide_trace_load) ) {
+        if (wanted(p)) {
             if (func_info.find(string(p.func())) == func_info.end()) {
                 fprintf(stderr, "Unable to find Func on 2nd pass. Aborting.\n");
                 exit(-1);
@@ -1,8 +1,15 @@
+// Make off_t 64-bit on 32-bit Linux, for fseeko and ftello.
+#ifndef _FILE_OFFSET_BITS
+#define _FILE_OFFSET_BITS 64
+#endif
+
 #include "HalideTraceUtils.h"
+#include <algorithm>
 #include <stdint.h>
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
+#include <thread>
 
 namespace Halide {
 namespace Internal {
@@ -44,6 +51,294 @@ bool Packet::read(void *d, size_t size, FILE *fdesc) {
     return true;
 }
 
+namespace {
+
+// Blocks written by the runtime hold at most a few hundred KB of
+// packets and index at most 64 Funcs. Headers claiming far more are
+// corrupt, and are rejected before allocating anything for them.
+const uint32_t trace_block_max_uncompressed_size = 16 * 1024 * 1024;
+const uint32_t trace_block_max_funcs = 4096;
+
+// ftell and fseek take a long, which is 32 bits on Windows, so use
+// the 64-bit versions to handle traces larger than 2GB.
+int64_t file_tell(FILE *file) {
+#ifdef _WIN32
+    return _ftelli64(file);
+#else
+    return ftello(file);
+#endif
+}
+
+bool file_seek(FILE *file, int64_t offset, int whence) {
+#ifdef _WIN32
+    return _fseeki64(file, offset, whence) == 0;
+#else
+    return fseeko(file, (off_t)offset, whence) == 0;
+#endif
+}
+
+// Read some number of bytes, or fail if the file ends first.
+bool read_or_eof(void *d, size_t size, FILE *fdesc) {
+    if (!size) return true;
+    size_t s = fread(d, 1, size, fdesc);
+    if (s != size) {
+        if (ferror(fdesc) || !feof(fdesc)) {
+            perror("Failed during read");
+            exit(-1);
+        }
+        return false; //EOF
+    }
+    return true;
+}
+
+// Read the rest of a block header, after its magic, and its index.
+bool read_block_index(FILE *fdesc, TraceBlock *block) {
+    block->header.magic = halide_trace_block_magic;
+    uint8_t *rest = (uint8_t *)&block->header + sizeof(uint32_t);
+    if (!read_or_eof(rest, sizeof(block->header) - sizeof(uint32_t), fdesc)) {
+        return false;
+    }
+    // LZ4 expands incompressible data by at most one byte in 255.
+    const halide_trace_block_header_t &h = block->header;
+    if (h.uncompressed_size > trace_block_max_uncompressed_size ||
+        h.compressed_size > h.uncompressed_size + h.uncompressed_size / 255 + 16 ||
+        h.num_funcs > trace_block_max_funcs) {
+        fprintf(stderr, "Corrupt block header in trace stream\n");
+        exit(-1);
+    }
+    block->funcs.resize(block->header.num_funcs);
+    return read_or_eof(block->funcs.data(), block->funcs.size() * sizeof(halide_trace_block_func_t), fdesc);
+}
+
+std::vector<uint8_t> decode_block(const std::vector<uint8_t> &compressed, uint32_t size) {
+    std::vector<uint8_t> packets(size);
+    if (!lz4_decompress(compressed.data(), compressed.size(), packets.data(), size)) {
+        fprintf(stderr, "Corrupt compressed block in trace stream\n");
+        exit(-1);
+    }
+    return packets;
+}
+
+}  // namespace
+
+uint32_t trace_func_hash(const char *name) {
+    // FNV-1a, as in the runtime
+    uint32_t h = 2166136261u;
+    while (*name) {
+        h = (h ^ (uint8_t)(*name++)) * 16777619u;
+    }
+    return h;
+}
+
+bool lz4_decompress(const uint8_t *src, size_t src_size, uint8_t *dst, size_t dst_size) {
+    const uint8_t *in = src, *in_end = src + src_size;
+    uint8_t *out = dst, *out_end = dst + dst_size;
+
+    // Lengths of 15 or more continue in the following bytes.
+    auto read_length = [&](size_t len, size_t *result) {
+        if (len == 15) {
+            uint8_t b;
+            do {
+                if (in == in_end) return false;
+                b = *in++;
+                len += b;
+            } while (b == 255);
+        }
+        *result = len;
+        return true;
+    };
+
+    while (in < in_end) {
+        uint8_t token = *in++;
+        size_t literals;
+        if (!read_length(token >> 4, &literals) ||
+            literals > (size_t)(in_end - in) ||
+            literals > (size_t)(out_end - out)) {
+            return false;
+        }
+        memcpy(out, in, literals);
+        in += literals;
+        out += literals;
+
+        // The last sequence is literals only.
+        if (in == in_end) break;
+
+        if (in_end - in < 2) return false;
+        size_t offset = in[0] | (in[1] << 8);
+        in += 2;
+        size_t len;
+        if (!read_length(token & 15, &len)) return false;
+        len += 4;
+        if (offset == 0 || offset > (size_t)(out - dst) ||
+            len > (size_t)(out_end - out)) {
+            return false;
+        }
+        const uint8_t *match = out - offset;
+        if (offset >= len) {
+            memcpy(out, match, len);
+        } else {
+            // The match overlaps what it produces.
+            for (size_t i = 0; i < len; i++) {
+                out[i] = match[i];
+            }
+        }
+        out += len;
+    }
+    return out == out_end;
+}
+
+TraceReader::TraceReader(FILE *file, int threads)
+    : file(file), threads(threads) {
+    if (this->threads <= 0) {
+        this->threads = std::max(1, (int)std::thread::hardware_concurrency());
+    }
+}
+
+TraceReader::~TraceReader() {
+    reset();
+}
+
+bool TraceReader::index() {
+    int64_t start = file_tell(file);
+    if (start < 0 || !file_seek(file, 0, SEEK_END)) {
+        // Not seekable, e.g. a pipe.
+        return false;
+    }
+    int64_t end = file_tell(file);
+    file_seek(file, start, SEEK_SET);
+
+    std::vector<TraceBlock> blocks;
+    uint32_t magic;
+    bool success = true;
+    while (success && read_or_eof(&magic, sizeof(magic), file)) {
+        TraceBlock block;
+        success = (magic == halide_trace_block_magic &&
+                   read_block_index(file, &block) &&
+                   (block.offset = file_tell(file)) >= 0 &&
+                   block.offset + (int64_t)block.header.compressed_size <= end &&
+                   file_seek(file, block.offset + block.header.compressed_size, SEEK_SET));
+        blocks.push_back(block);
+    }
+    file_seek(file, start, SEEK_SET);
+    if (!success) {
+        // There are packets outside of blocks, or the last block is
+        // truncated.
+        return false;
+    }
+
+    reset();
+    indexed = true;
+    indexed_blocks.swap(blocks);
+    next_block = 0;
+    return true;
+}
+
+void TraceReader::set_block_filter(std::function<bool(const TraceBlock &)> filter) {
+    block_filter = filter;
+}
+
+void TraceReader::seek_to_block(size_t idx) {
+    reset();
+    next_block = idx;
+}
+
+bool TraceReader::rewind() {
+    reset();
+    if (indexed) {
+        next_block = 0;
+        return true;
+    }
+    return file_seek(file, 0, SEEK_SET);
+}
+
+void TraceReader::reset() {
+    // Wait for any blocks being decoded.
+    decoding.clear();
+    current.clear();
+    current_pos = 0;
+}
+
+bool TraceReader::load_next() {
+    current.clear();
+    current_pos = 0;
+
+    if (indexed) {
+        // Keep a couple of blocks per thread being decoded ahead of
+        // the one being read. Reading the compressed data from the
+        // file is left to this thread.
+        while (decoding.size() < (size_t)threads * 2 && next_block < indexed_blocks.size()) {
+            const TraceBlock &block = indexed_blocks[next_block++];
+            if (block_filter && !block_filter(block)) {
+                continue;
+            }
+            std::vector<uint8_t> compressed(block.header.compressed_size);
+            if (!file_seek(file, block.offset, SEEK_SET) ||
+                !read_or_eof(compressed.data(), compressed.size(), file)) {
+                fprintf(stderr, "Unable to read compressed block in trace stream\n");
+                exit(-1);
+            }
+            decoding.push_back(std::async(std::launch::async, decode_block,
+                                          std::move(compressed), block.header.uncompressed_size));
+        }
+        if (decoding.empty()) {
+            return false;
+        }
+        current = decoding.front().get();
+        decoding.pop_front();
+        return true;
+    }
+
+    uint32_t word;
+    if (!read_or_eof(&word, sizeof(word), file)) {
+        return false;
+    }
+    if (word == halide_trace_block_magic) {
+        TraceBlock block;
+        std::vector<uint8_t> compressed;
+        if (read_block_index(file, &block)) {
+            compressed.resize(block.header.compressed_size);
+            if (read_or_eof(compressed.data(), compressed.size(), file)) {
+                current = decode_block(compressed, block.header.uncompressed_size);
+                return true;
+            }
+        }
+        fprintf(stderr, "Unexpected EOF mid-block");
+        return false;
+    }
+
+    // A packet outside of any block. The word read was its size.
+    if (word < sizeof(halide_trace_packet_t) || word > sizeof(Packet)) {
+        fprintf(stderr, "Bad packet size in trace stream (%d)\n", (int)word);
+        exit(-1);
+    }
+    current.resize(word);
+    memcpy(current.data(), &word, sizeof(word));
+    if (!read_or_eof(current.data() + sizeof(word), word - sizeof(word), file)) {
+        fprintf(stderr, "Unexpected EOF mid-packet");
+        current.clear();
+        return false;
+    }
+    return true;
+}
+
+bool TraceReader::next(Packet *p) {
+    while (current_pos == current.size()) {
+        if (!load_next()) {
+            return false;
+        }
+    }
+    uint32_t size;
+    memcpy(&size, current.data() + current_pos, sizeof(size));
+    if (size < sizeof(halide_trace_packet_t) || size > sizeof(Packet) ||
+        size > current.size() - current_pos) {
+        fprintf(stderr, "Bad packet size in trace stream (%d)\n", (int)size);
+        exit(-1);
+    }
+    memcpy((void *)p, current.data() + current_pos, size);
+    current_pos += size;
+    return true;
+}
+
 void bad_type_error(halide_type_t type) {
     fprintf(stderr, "Can't convert packet with type: %d bits: %d\n", type.code, type.bits);
     exit(-1);
@@ -4,6 +4,10 @@
 #include "HalideRuntime.h"
 #include <stdio.h>
 #include <cstring>
+#include <deque>
+#include <functional>
+#include <future>
+#include <vector>
 
 namespace Halide {
 namespace Internal {
@@ -94,6 +98,94 @@ private:
     bool read(void *d, size_t size, FILE *fdesc);
 };
 
+// The hash of a Func name used to index compressed trace blocks.
+uint32_t trace_func_hash(const char *name);
+
+// Decompress data in the LZ4 block format, which must decompress to
+// exactly dst_size bytes. Returns false if it's malformed.
+bool lz4_decompress(const uint8_t *src, size_t src_size, uint8_t *dst, size_t dst_size);
+
+// A compressed block of a trace file.
+struct TraceBlock {
+    // Where the compressed packets start in the file.
+    int64_t offset;
+    halide_trace_block_header_t header;
+    std::vector<halide_trace_block_func_t> funcs;
+
+    // Whether the block holds any packets of the given event.
+    bool contains(halide_trace_event_code_t event) const {
+        return (header.event_mask >> event) & 1;
+    }
+
+    // Whether the block may hold packets of the given event for the
+    // Func with the given hash. Hashes may collide, so this may be a
+    // false positive.
+    bool contains(uint32_t func_hash, halide_trace_event_code_t event) const {
+        for (const halide_trace_block_func_t &f : funcs) {
+            if (f.func_hash == func_hash) {
+                return (f.event_mask >> event) & 1;
+            }
+        }
+        return false;
+    }
+};
+
+// Reads the packets of a binary trace, which may be a stream of
+// packets, of compressed blocks of them, or a mix of the two.
+class TraceReader {
+public:
+    // Decompresses blocks of an indexed file on up to the given
+    // number of threads, or one per core if it's zero. Doesn't take
+    // ownership of the file.
+    TraceReader(FILE *file, int threads = 0);
+    ~TraceReader();
+
+    // Find the blocks of a seekable file made up of compressed blocks
+    // only, without decompressing them, so that they may be decoded in
+    // parallel or skipped. Returns false if the file can't be indexed,
+    // in which case it's read sequentially as before.
+    bool index();
+
+    const std::vector<TraceBlock> &blocks() const {
+        return indexed_blocks;
+    }
+
+    // Skip the blocks of an indexed file for which the filter returns
+    // false. Blocks already being decoded aren't affected.
+    void set_block_filter(std::function<bool(const TraceBlock &)> filter);
+
+    // Continue reading an indexed file from the start of the given
+    // block.
+    void seek_to_block(size_t idx);
+
+    // Read from the start of the file again. Returns false if the file
+    // can't be seeked.
+    bool rewind();
+
+    // Grab the next packet. Returns false at the end of the file.
+    bool next(Packet *p);
+
+private:
+    FILE *file;
+    int threads;
+
+    bool indexed = false;
+    std::vector<TraceBlock> indexed_blocks;
+    std::function<bool(const TraceBlock &)> block_filter;
+
+    // The next block of an indexed file to start decoding, and the
+    // blocks being decoded, in order.
+    size_t next_block = 0;
+    std::deque<std::future<std::vector<uint8_t>>> decoding;
+
+    // The packets being read.
+    std::vector<uint8_t> current;
+    size_t current_pos = 0;
+
+    bool load_next();
+    void reset();
+};
+
 }
 }
 
@@ -25,11 +25,16 @@
 
 #include "inconsolata.h"
 #include "HalideRuntime.h"
+#include "HalideTraceUtils.h"
 
 #include "halide_trace_config.h"
 
 using namespace Halide;
 using namespace Halide::Trace;
+using Halide::Internal::Packet;
+using Halide::Internal::TraceBlock;
+using Halide::Internal::TraceReader;
+using Halide::Internal::trace_func_hash;
 
 namespace {
 
@@ -143,40 +148,6 @@ T get_value_as(const halide_trace_packet_t &p, int idx) {
     return value_as<double>(p.type, aligned_value);
 }
 
-struct PacketAndPayload : public halide_trace_packet_t {
-    uint8_t payload[4096];
-
-    static bool read_or_die(void *buf, size_t count) {
-        char *p = (char *)buf;
-        char *p_end = p + count;
-        while (p < p_end) {
-            int64_t bytes_read = ::read(STDIN_FILENO, p, p_end - p);
-            if (bytes_read == 0) {
-                return false;  // EOF
-            } else if (bytes_read < 0) {
-                fail() << "Unable to read packet";
-            }
-            p += bytes_read;
-        }
-        assert(p == p_end);
-        return true;
-    }
-
-    bool read() {
-        constexpr size_t header_size = sizeof(halide_trace_packet_t);
-        if (!read_or_die(this, header_size)) {
-            return false;  // EOF
-        }
-
-        const size_t payload_size = this->size - header_size;
-        if (payload_size > sizeof(this->payload) || !read_or_die(this->payload, payload_size)) {
-            // Shouldn't ever get EOF here
-            fail() << "Unable to read packet payload of size " << payload_size;
-        }
-        return true;
-    }
-};
-
 // -------------------------------------------------------------
 
 // A struct specifying how a single Func will get visualized.
@@ -286,6 +257,10 @@ stdin, and outputs them as raw 8-bit rgba32 pixel values to
 stdout. You should pipe the output of HalideTraceViz into a video
 encoder or player.
 
+Traces written with HL_TRACE_COMPRESS=1 are read too. If one is
+redirected from a file rather than piped, its blocks are decompressed
+in parallel, and blocks that don't affect the Funcs drawn are skipped.
+
 E.g. to encode a video:
  HL_TARGET=host-trace_all <command to make pipeline> && \
  HL_TRACE_FILE=/dev/stdout <command to run pipeline> | \
@@ -1028,6 +1003,14 @@ int run(bool ignore_trace_tags, FlagProcessor flag_processor) {
 
     std::unique_ptr<Surface> surface;
 
+    // If stdin is a file made of compressed blocks, they're decoded in
+    // parallel ahead of the packet being drawn.
+    TraceReader reader(stdin);
+    const bool indexed = reader.index();
+    if (indexed) {
+        info() << "Indexed " << reader.blocks().size() << " compressed blocks";
+    }
+
     const std::function<void()> finalize_state = [&]() -> void {
         if (is_state_finalized) return;
 
@@ -1078,6 +1061,34 @@ int run(bool ignore_trace_tags, FlagProcessor flag_processor) {
 
         do_auto_layout(state);
         finalize_func_config_values(state.globals, state.funcs);
+
+        // Only the loads and stores of Funcs that are drawn advance the
+        // clock or draw anything, so skip the blocks that have nothing
+        // else. Funcs may be named with or without their pipeline.
+        if (indexed) {
+            std::set<uint32_t> drawn;
+            for (const auto &p : state.funcs) {
+                if (p.second.config_valid) {
+                    drawn.insert(trace_func_hash(p.first.c_str()));
+                    size_t colon = p.first.find(':');
+                    if (colon != std::string::npos) {
+                        drawn.insert(trace_func_hash(p.first.c_str() + colon + 1));
+                    }
+                }
+            }
+            const uint32_t loads_and_stores = (1 << halide_trace_load) | (1 << halide_trace_store);
+            reader.set_block_filter([drawn, loads_and_stores](const TraceBlock &b) {
+                if (b.header.event_mask & ~loads_and_stores) {
+                    return true;
+                }
+                for (const auto &f : b.funcs) {
+                    if (drawn.count(f.func_hash)) {
+                        return true;
+                    }
+                }
+                return false;
+            });
+        }
     };
 
 
@@ -1144,8 +1155,8 @@ int run(bool ignore_trace_tags, FlagProcessor flag_processor) {
         }
 
         // Read a tracing packet
-        PacketAndPayload p;
-        if (!p.read()) {
+        Packet p;
+        if (!reader.next(&p)) {
             end_counter++;
             continue;
         }
@@ -1176,6 +1187,10 @@ int run(bool ignore_trace_tags, FlagProcessor flag_processor) {
                     continue;
                 }
                 FuncConfig cfg(p.trace_tag());
+                if (is_state_finalized) {
+                    // The set of Funcs drawn is changing.
+                    reader.set_block_filter(nullptr);
+                }
                 auto &fi = state.funcs[p.func()];
                 fi.config = cfg;
                 fi.config_valid = true;